@@ -0,0 +1,46 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+// Template instances needed by the tclntcon example
+//////////////////////////////////////////////////////////////////////
+
+#include "ks/clntcon.h"
+#include "ks/avticket.h"
+#include "ks/commobject.h"
+#include "ks/histparams.h"
+
+#if PLT_SEE_ALL_TEMPLATES
+#include "plt/priorityqueue.h"
+#include "plt/hashtable.h"
+#include "ks/array.h"
+#include "ks/handle.h"
+#else
+#include "plt/priorityqueue_impl.h"
+#include "plt/hashtable_impl.h"
+#include "ks/array_impl.h"
+#include "ks/handle_impl.h"
+#endif
+
+#if PLT_INSTANTIATE_TEMPLATES
+#include "tclntcon_inst.h"
+#endif
+
+// EOF tclntcon.cpp
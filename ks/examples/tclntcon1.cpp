@@ -0,0 +1,81 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+// tclntcon -- reads the variables given on the command line from one
+// server through the non-blocking client transport and prints the
+// outcome for every variable. This is built together with the server
+// library, so we notice when client transport applications can't be
+// linked against it anymore.
+//////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+
+#include "ks/clntcon.h"
+
+int main(int argc, char **argv)
+{
+    if ( argc < 3 ) {
+        fprintf(stderr, "usage: tclntcon //host/server /path/to/var...\n");
+        return 1;
+    }
+
+    KscEventLoop loop;
+    if ( !loop.isOk() ) {
+        fprintf(stderr, "can't create event loop\n");
+        return 2;
+    }
+    KscConnectionServer server(loop, KsString(argv[1]));
+
+    KsGetVarParams params(argc - 2);
+    int idx;
+    for ( idx = 2; idx < argc; ++idx ) {
+        params.identifiers[idx - 2] = KsString(argv[idx]);
+    }
+    KsGetVarResult result;
+    if ( !server.getVar(0, params, result)
+         || (result.result != KS_ERR_OK) ) {
+        fprintf(stderr, "can't read from %s: error 0x%04lx\n",
+                argv[1],
+                (unsigned long) (server.getLastResult() != KS_ERR_OK ?
+                                 server.getLastResult() : result.result));
+        return 3;
+    }
+
+    for ( idx = 0; idx < (int) result.items.size(); ++idx ) {
+        const KsGetVarItemResult &item = result.items[idx];
+        const KsVarCurrProps *props =
+            PLT_DYNAMIC_PCAST(KsVarCurrProps, item.item.getPtr());
+        if ( (item.result == KS_ERR_OK) && props && props->value ) {
+            printf("%s: type 0x%04lx, state %d\n",
+                   argv[idx + 2],
+                   (unsigned long) props->value->xdrTypeCode(),
+                   (int) props->state);
+        } else {
+            printf("%s: error 0x%04lx\n",
+                   argv[idx + 2],
+                   (unsigned long) item.result);
+        }
+    }
+
+    return 0;
+} // main
+
+// End of tclntcon1.cpp
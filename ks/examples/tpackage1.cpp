@@ -0,0 +1,76 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+// tpackage -- reads the variables given on the command line with a
+// single package and prints the outcome for every variable. Besides
+// being an example, this is built together with the client library,
+// so we notice when applications can't be linked against it anymore.
+//////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+
+#include "ks/client.h"
+#include "ks/commobject.h"
+#include "ks/package.h"
+
+int main(int argc, char **argv)
+{
+    if ( argc < 2 ) {
+        fprintf(stderr, "usage: tpackage //host/server/path/to/var...\n");
+        return 1;
+    }
+
+    KscPackage pkg;
+    int idx;
+    for ( idx = 1; idx < argc; ++idx ) {
+        KscVariableHandle var(new KscVariable(argv[idx]), PltOsNew);
+        if ( !var || !var->hasValidPath() || !pkg.add(var) ) {
+            fprintf(stderr, "can't add %s\n", argv[idx]);
+            return 2;
+        }
+    }
+
+    bool ok = pkg.getUpdate();
+
+    KscPkgVariableIterator *it = pkg.newVariableIterator();
+    if ( !it ) {
+        return 3;
+    }
+    for ( ; *it; ++*it ) {
+        const KscVariableHandle &var = **it;
+        const KsVarCurrProps *props = var->getCurrProps();
+        if ( (var->getLastResult() == KS_ERR_OK) && props && props->value ) {
+            printf("%s: type 0x%04lx, state %d\n",
+                   (const char *) var->getFullPath(),
+                   (unsigned long) props->value->xdrTypeCode(),
+                   (int) props->state);
+        } else {
+            printf("%s: error 0x%04lx\n",
+                   (const char *) var->getFullPath(),
+                   (unsigned long) var->getLastResult());
+        }
+    }
+    delete it;
+
+    return ok ? 0 : 4;
+} // main
+
+// End of tpackage1.cpp
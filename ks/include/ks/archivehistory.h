@@ -0,0 +1,187 @@
+/* -*-plt-c++-*- */
+#ifndef KS_ARCHIVEHISTORY_INCLUDED
+#define KS_ARCHIVEHISTORY_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ks/sampledhistory.h"
+
+#if PLT_USE_MMAP
+
+class KssArchiveMaintenanceEvent;
+
+
+// ----------------------------------------------------------------------------
+// The KssArchiveHistory class records the values of some variables into an
+// archive on disk, so the history survives restarts of the server and can
+// grow far beyond the size of the main memory.
+//
+// The archive is a directory of segment files, each of them holding a fixed
+// number of rows. A segment is laid out just like the columns in memory: the
+// time stamps and the values of each variable are contiguous arrays, plus a
+// sparse time index taking every stride-th time stamp. Segments are mapped
+// into memory only when a GetHist request needs them, so a request for some
+// range of time touches the index and the pages holding the rows requested,
+// but nothing else. Rows are copied straight from the mapped columns into the
+// reply, there is no deserialization at all. Raw replies are even streamed
+// from the mapped columns using a cursor, which refers to the segments by
+// their number; if a segment is deleted before its rows were sent, the reply
+// is aborted.
+//
+// Once the segment being written to is half full, the next one is created
+// in the background, so rolling over to it doesn't stall sampling. Old
+// segments are deleted according to the retention limits. The files are in
+// the host's byte order, so archives can't be moved between platforms.
+//
+// All variables must be tracked before the archive is opened and the same
+// variables must be tracked every time the archive is opened again.
+//
+class KssArchiveHistory
+    : public KssSampledHistory
+{
+public:
+    KssArchiveHistory(const KsString &id,
+                      const KsString &directory,
+                      size_t rowsPerSegment = 86400,
+                      KS_HIST_TYPE mode = KS_HT_TIME_DRIVEN,
+                      unsigned long period = 1000, // msecs
+                      KsTime ctime = KsTime::now(),
+                      KsString comment = KsString());
+    virtual ~KssArchiveHistory();
+
+    //
+    // Open the archive, creating the directory if necessary. Segments
+    // not matching the variables tracked are ignored.
+    //
+    bool open();
+    void close();
+    bool isOpen() const { return _opened; }
+
+    //
+    // Delete segments whose newest row is older than maxAge seconds and
+    // the oldest segments beyond maxSegments (zero means no limit). The
+    // segment being written to is never deleted.
+    //
+    void setRetention(unsigned long maxAge, size_t maxSegments)
+        { _max_age = maxAge; _max_segments = maxSegments; }
+    //
+    // Limit the number of segments kept mapped between requests.
+    //
+    void setMaxMapped(size_t maxMapped)
+        { _max_mapped = maxMapped ? maxMapped : 1; }
+
+    size_t getSegmentCount() const { return _segment_count; }
+
+    //
+    // The periodic housekeeping: creating the next segment in advance,
+    // flushing the current one, applying the retention limits and
+    // unmapping segments not used recently.
+    //
+    void maintain();
+
+    virtual void getHist(const KsGetHistParams &params,
+                         KsGetHistSingleResult &result);
+    virtual KssHistoryCursor *openCursor(const KsGetHistParams &params);
+
+protected:
+    friend class KssArchiveHistoryCursor;
+
+    struct Stamp {
+        unsigned int sec;
+        unsigned int usec;
+    };
+
+    struct Segment {
+        unsigned long  seq;       // number of the segment file
+        size_t         capacity;  // rows
+        size_t         stride;    // rows per index entry
+        size_t         count;     // rows written so far
+        Stamp          first;
+        Stamp          last;
+        char          *map;       // the mapped file or 0
+        size_t         length;    // length of the file
+        unsigned long  used;      // when the segment was used the last time
+    };
+
+    struct Span {                 // rows of a segment in a GetHist reply
+        Segment       *seg;
+        size_t         first;
+        size_t         count;
+    };
+
+    virtual bool addColumn(const Track &track);
+    virtual void removeColumn(const Track &track);
+    virtual void appendRow(const PltTime &t);
+
+    void segmentPath(unsigned long seq, PltString &path) const;
+    Segment *createSegment();
+    Segment *loadSegment(unsigned long seq);
+    bool mapSegment(Segment &seg, bool writable);
+    void unmapSegment(Segment &seg);
+    void deleteSegment(size_t idx);
+    bool appendSegment(Segment *seg);
+    void trimMappings();
+
+    static Stamp *getIndex(const Segment &seg);
+    static Stamp *getTimes(const Segment &seg);
+    static double *getColumn(const Segment &seg, size_t column);
+
+    static bool stampLess(const Stamp &a, const Stamp &b)
+        { return (a.sec < b.sec) || ((a.sec == b.sec) && (a.usec < b.usec)); }
+    static int compareSegments(const void *a, const void *b);
+
+    size_t findSegment(const Stamp &t) const;
+    Segment *segmentBySeq(unsigned long seq) const;
+    bool selectSpans(const Selection &sel, size_t limit,
+                     Span *&spans, size_t &nspans, size_t &total);
+    size_t rowBound(const Segment &seg, const Stamp &t, bool upper) const;
+    void selectBuckets(KssHistoryAggregator &agg, const Span *spans,
+                       size_t nspans, size_t total) const;
+    void accumulate(KssHistoryAggregator &agg, const Track &track,
+                    const Span *spans, size_t nspans) const;
+
+    KsString       _directory;
+    size_t         _rows_per_segment;
+    size_t         _stride;
+    Segment      **_segments;        // sorted by time (and number)
+    size_t         _segment_count;
+    size_t         _segment_alloc;
+    Segment       *_active;          // segment written to or 0
+    Segment       *_spare;           // the next one, if created already
+    unsigned long  _next_seq;
+    bool           _opened;
+    unsigned long  _max_age;
+    size_t         _max_segments;
+    size_t         _max_mapped;
+    unsigned long  _use_clock;
+    KssArchiveMaintenanceEvent *_maintenance;
+
+private:
+    KssArchiveHistory(const KssArchiveHistory &); // forbidden
+    KssArchiveHistory & operator = (const KssArchiveHistory &); // forbidden
+}; // class KssArchiveHistory
+
+
+#endif /* PLT_USE_MMAP */
+
+#endif // KS_ARCHIVEHISTORY_INCLUDED
+
+/* End of ks/archivehistory.h */
@@ -123,6 +123,7 @@ public:
 #if !PLT_SERVER_TRUNC_ONLY
     static bool registerAvTicketType(enum_t ticketType, KsTicketConstructor);
     static bool deregisterAvTicketType(enum_t ticketType);
+    static bool isAvTicketTypeRegistered(enum_t ticketType);
 #endif
 
     ////
@@ -27,6 +27,7 @@
 
 #include <stdio.h>
 #include <plt/hashtable.h>
+#include <plt/thread.h>
 
 #include "ks/rpc.h"
 #include "ks/hostent.h"
@@ -38,6 +39,9 @@
 //////////////////////////////////////////////////////////////////////
 // forward declaration
 class KscServerBase;
+class KscValueCache;
+class KscEPCache;
+class KscProbeThread;
 
 //////////////////////////////////////////////////////////////////////
 // timeout and max tries when contacting manager via UDP
@@ -47,6 +51,22 @@ const int KSC_UDP_MAX_TRIES = 5;
 const struct timeval KSC_UDP_TIMEOUT = {10, 0};      // DONT USE KsTime 
 const struct timeval KSC_RPCCALL_TIMEOUT = {30, 0};  // or PltTime
 
+//////////////////////////////////////////////////////////////////////
+// after a server could not be reached, requests to it fail at once
+// for this many seconds, doubling with every further failure up to
+// the maximum. The minimum is zero, so this is off unless switched
+// on with KscClient::setBackoff() or KscServer::setBackoff().
+//
+const long KSC_BACKOFF_MIN = 0;
+const long KSC_BACKOFF_MAX = 60;
+
+//////////////////////////////////////////////////////////////////////
+// packages split their requests to a server into chunks of at most
+// this many variables and (estimated) bytes of service parameters
+//
+const size_t KSC_CHUNK_MAX_ITEMS = 4096;
+const size_t KSC_CHUNK_MAX_SIZE  = 65536;
+
 //////////////////////////////////////////////////////////////////////
 // class KscClient
 //
@@ -57,6 +77,11 @@ const struct timeval KSC_RPCCALL_TIMEOUT = {30, 0};  // or PltTime
 // should use KscClient::getClient() to access it, but you should not
 // delete the object pointed to, since it is managed internally.
 //
+// The client and its server objects can be used by several threads
+// at the same time. Every thread talking to a server gets a transport
+// of its own, so requests to the same server don't wait for each
+// other.
+//
 // TODO: change server representation from pointers to handles
 //
 //////////////////////////////////////////////////////////////////////
@@ -83,7 +108,7 @@ public:
     //
     // find server by name, maybe returns 0
     //
-    KscServerBase *getServer(const KsString &host_and_name); 
+    KscServerBase *getServer(const KsString &host_and_name);
 
     //
     // AV related functions
@@ -102,6 +127,40 @@ public:
 		     PltTime &retry_wait,
 		     size_t &tries);
 
+    //
+    // set the backoff for unreachable servers, a zero minimum
+    // (the default) switches it off (see KscServer::setBackoff)
+    // (affects only server-objects that will be created later)
+    //
+    void setBackoff(const PltTimeSpan &min_backoff,
+                    const PltTimeSpan &max_backoff);
+    void getBackoff(PltTimeSpan &min_backoff,
+                    PltTimeSpan &max_backoff) const;
+
+    //
+    // set the limits for splitting packages into chunks
+    // (0 means no limit)
+    //
+    void setChunkLimits(size_t max_items,   // variables per request
+                        size_t max_size);   // bytes per request
+    void getChunkLimits(size_t &max_items,
+                        size_t &max_size);
+
+    //
+    // install a cache for the values of variables (see ks/valuecache.h),
+    // it is not owned by the client; 0 switches caching off
+    //
+    void setValueCache(KscValueCache *);
+    KscValueCache *getValueCache() const;
+
+    //
+    // keep the replies to GetEP requests for the given time (see
+    // ks/epcache.h), zero switches caching off
+    // (affects only server-objects that will be created later)
+    //
+    void setEPCacheTTL(const PltTimeSpan &ttl);
+    PltTimeSpan getEPCacheTTL() const;
+
 #if PLT_DEBUG
     void printServers();
 #endif
@@ -110,18 +169,26 @@ protected:
     KscClient();
 
     //
-    // find or create server, should only be used by KscCommObject objects
+    // find or create server and take a reference to it, should only
+    // be used by KscCommObject objects
     //
     friend class KscCommObject;
+    KS_RESULT attachServer(const KsString &host_and_name,
+                           u_short protocol_version,
+                           KscServerBase *&pServer);
+    //
+    // find or create server, called with _lock held
+    //
     virtual KS_RESULT createServer(KsString host_and_name,
                                    u_short protocol_version,
 				   KscServerBase *&pServer);
     //
-    // destroy an server, should only be used
-    // by KscServer objects
+    // remove a server from the table, should only be used by
+    // KscServerBase objects and called with _lock held. The caller
+    // destroys the server after releasing the lock.
     //
     friend class KscServerBase;
-    void deleteServer(KscServerBase *);
+    void removeServer(KscServerBase *);
 
     const KscAvModule *av_module;
 
@@ -129,8 +196,23 @@ protected:
     PltTime _retry_wait;
     size_t _tries;
 
+    PltTimeSpan _backoff_min;
+    PltTimeSpan _backoff_max;
+
+    size_t _chunk_items;
+    size_t _chunk_size;
+
+    KscValueCache *_value_cache;
+    PltTimeSpan _ep_cache_ttl;
+
     PltHashTable<KsString,KscServerBase *> server_table;
 
+    //
+    // protects the server table, the reference counts of the servers
+    // and the settings above
+    //
+    mutable PltMutex _lock;
+
 private:
     KscClient(const KscClient &); // forbidden
     KscClient &operator = (const KscClient &); // forbidden
@@ -206,6 +288,13 @@ public:
     virtual void setAvModule(const KscAvModule *);
     virtual const KscAvModule *getAvModule() const;
 
+    // cache for GetEP replies, zero ttl switches it off. Use
+    // getEPCache() to invalidate replies or to get statistics; it
+    // returns 0 if there is no cache.
+    //
+    void setEPCacheTTL(const PltTimeSpan &ttl);
+    KscEPCache *getEPCache() const;
+
     // selectors
     //
     KsString getHost() const;           // host
@@ -214,6 +303,11 @@ public:
     virtual u_short getProtocolVersion() const = 0;
     virtual PltTime getExpiresAt() const = 0;
     virtual bool isLiving() const = 0;
+    //
+    // result of the last request the calling thread has sent to this
+    // server, or of the last request of any thread if the calling
+    // thread has talked to another server in the meantime
+    //
     KS_RESULT getLastResult() const;
 
 protected:
@@ -227,10 +321,17 @@ protected:
     void incRefcount();
     void decRefcount();
 
+    bool requestEP(const KscAvModule *avm,
+                   const KsGetEPParams &params,
+                   KsGetEPResult &result);
+
+    void setLastResult(KS_RESULT result);
+
     KsString host_name, server_name, host_and_name;
     const KscAvModule *av_module;
     long ref_count;                // communication objects related to this server
     KS_RESULT _last_result;
+    KscEPCache *_ep_cache;
 };
 
 
@@ -304,9 +405,42 @@ public:
 		     PltTime &retry_wait,
 		     size_t &tries);
 
+    //
+    // Once the server could not be reached, all requests fail at once
+    // with KS_ERR_CANTCONTACT for min_backoff. Afterwards the server is
+    // probed in the background while requests still fail. If the probe
+    // fails, too, the span is doubled (but never exceeds max_backoff),
+    // if it succeeds, requests are sent again. A zero min_backoff, the
+    // default, switches this off, so every request tries to reach the
+    // server.
+    //
+    void setBackoff(const PltTimeSpan &min_backoff,
+                    const PltTimeSpan &max_backoff);
+    void getBackoff(PltTimeSpan &min_backoff,
+                    PltTimeSpan &max_backoff) const;
+    //
+    // false while requests fail at once
+    //
+    bool isReachable() const;
+
 
 protected:
-    KscNegotiator *getNegotiator(const KscAvModule *);
+    //
+    // A connection to the server together with the negotiators used on
+    // it. A transport is used by only one thread at a time. Idle
+    // transports are kept for later requests.
+    //
+    struct Transport {
+        Transport *next;
+        bool       busy;                  // checked out by a thread
+        CLIENT    *client;                // RPC client handle
+        PltHashTable<PltKeyPlainConstPtr<KscAvModule>,KscNegotiatorHandle> neg_table;
+    };
+
+    Transport *checkOut();
+    void checkIn(Transport *);
+
+    KscNegotiator *getNegotiator(Transport &, const KscAvModule *);
 
     friend class KscAvModule;
     void dismissNegotiator(const KscAvModule *);
@@ -319,9 +453,15 @@ protected:
                        KsGetServerResult &server_info);  // result
 
 
-    bool createTransport();
-    void destroyTransport();
-    virtual bool reconnectServer(size_t try_count, enum clnt_stat errcode);
+    friend class KscProbeThread;
+    bool admitRequest(bool &probe);
+    void requestDone(bool reachable, bool probe);
+    void requestAbandoned(bool probe);
+
+    bool createTransport(Transport &);
+    void destroyTransport(Transport &);
+    virtual bool reconnectServer(size_t try_count, enum clnt_stat errcode,
+                                 Transport &);
     virtual bool reconnectServer(KS_RESULT result);
     bool getHostAddr(struct sockaddr_in *addr);
     void setResultAfterService(enum clnt_stat errcode);
@@ -331,7 +471,7 @@ protected:
 
     KsServerDesc server_desc;      // server description given by user
     KsGetServerResult server_info; // server description given by manager
-    CLIENT *_client_transport;     // RPC client handle
+    Transport *_transports;        // all transports, busy or idle
 
     PltTime _rpc_timeout;
     PltTime _retry_wait;
@@ -339,9 +479,21 @@ protected:
     KSC_IP_TYPE last_ip;	
       	// last IP used to connect to server/manager   
 
-    PltHashTable<PltKeyPlainConstPtr<KscAvModule>,KscNegotiatorHandle> neg_table;
+    PltTimeSpan _backoff_min;
+    PltTimeSpan _backoff_max;
+    PltTimeSpan _backoff;          // current backoff span
+    unsigned long _failures;       // consecutive failures
+    PltTime _retry_at;             // requests fail at once until then
+    bool _probing;                 // probe under way
+    KscProbeThread *_probe;
+
     PltHashTable<KsString, u_long> ext_opcodes;
 
+    //
+    // protects everything above which is shared by the transports
+    //
+    mutable PltMutex _transport_lock;
+
     friend class KscClient;
     KscServer(KsString host, const KsServerDesc &server);
     KscServer(KsString hostAndName, u_short protocolVersion);
@@ -359,12 +511,6 @@ private:
 // KscServerBase
 //////////////////////////////////////////////////////////////////////
 
-inline
-KscServerBase::~KscServerBase()
-{}
-
-//////////////////////////////////////////////////////////////////////
-
 inline
 void 
 KscServerBase::setAvModule(const KscAvModule *avm)
@@ -383,6 +529,15 @@ KscServerBase::getAvModule() const
 
 //////////////////////////////////////////////////////////////////////
 
+inline
+KscEPCache *
+KscServerBase::getEPCache() const
+{
+    return _ep_cache;
+}
+
+//////////////////////////////////////////////////////////////////////
+
 inline
 KsString 
 KscServerBase::getHost() const
@@ -410,80 +565,17 @@ KscServerBase::getHostAndName() const
 
 //////////////////////////////////////////////////////////////////////
 
-inline
-KS_RESULT
-KscServerBase::getLastResult() const
-{
-    return _last_result;
-}
-
-//////////////////////////////////////////////////////////////////////
-// KscServer
-//////////////////////////////////////////////////////////////////////
-
-//////////////////////////////////////////////////////////////////////
-
-inline
-bool
-KscServer::ping()
-{
-    enum clnt_stat errcode;
-    
-    if ( !_client_transport ) {
-        if( !createTransport() ) {
-            if ( !reconnectServer(_last_result) ) {
-                return false;
-            }
-        }
-    }
-    errcode = clnt_call(_client_transport, 0, 
-			(xdrproc_t) xdr_void, 0, 
-			(xdrproc_t) xdr_void, 0, 
-			KSC_RPCCALL_TIMEOUT);
-
-    return errcode == RPC_SUCCESS;
-}
-
-//////////////////////////////////////////////////////////////////////
-
-inline
-u_short
-KscServer::getProtocolVersion() const
-{
-    return server_info.server.protocol_version;
-}
-
-//////////////////////////////////////////////////////////////////////
-
-inline
-PltTime
-KscServer::getExpiresAt() const
-{
-    // NOTE: without cast gcc reports internal
-    // compiler error
-    //
-    return PltTime(server_info.expires_at);
-}
-
-//////////////////////////////////////////////////////////////////////
-
-inline
-bool
-KscServer::isLiving() const
-{
-    return server_info.living;
-}
-
-//////////////////////////////////////////////////////////////////////
-
 inline
 KscClient *
 KscClient::getClient() 
 {
-    if(!_the_client) {
+    KscClient *cl =
+        (KscClient *) PltAtomic::loadPtr((void * volatile *) &_the_client);
+    if(!cl) {
         _createClient();
+        cl = _the_client;
     }
-    return _the_client;
+    return cl;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -547,6 +639,24 @@ KscClient::getAvModule() const
 {
     return av_module;
 }
+
+//////////////////////////////////////////////////////////////////////
+
+inline
+void
+KscClient::setValueCache(KscValueCache *cache)
+{
+    _value_cache = cache;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+inline
+KscValueCache *
+KscClient::getValueCache() const
+{
+    return _value_cache;
+}
  
 
 //////////////////////////////////////////////////////////////////////
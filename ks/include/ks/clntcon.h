@@ -0,0 +1,207 @@
+/* -*-plt-c++-*- */
+#ifndef KSC_CLNTCON_INCLUDED
+#define KSC_CLNTCON_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+// clntcon.h -- client side ACPLT/KS servers talking through the same
+//              non-blocking connections and XDR memory streams the
+//              servers use, instead of the ONC/RPC client transports.
+//              Thus only available with buffered XDR streams.
+//////////////////////////////////////////////////////////////////////
+
+#if PLT_USE_BUFFERED_STREAMS
+
+#include "ks/client.h"
+#include "ks/interserver.h"
+
+//////////////////////////////////////////////////////////////////////
+// class KscEventLoop
+//   hosts the connections of any number of KscConnectionServer
+//   objects, so a single thread can talk to many servers at once.
+//   The loop either waits for events itself (serveEvents()), or it
+//   is driven by an event loop of the application: ask for the file
+//   descriptors to watch and the longest time to wait, select() on
+//   them and hand the outcome to processEvents().
+//
+//   An event loop and its servers must only be used by one thread at
+//   a time. The loop must outlive its servers.
+//
+class KscEventLoop
+: public KssInterKsServerContext
+{
+public:
+    KscEventLoop();
+    virtual ~KscEventLoop();
+
+    bool isOk() const;
+
+    //
+    // for driving the loop from the outside: returns the number of
+    // file descriptors to select() on, and whether there is a time-
+    // out (otherwise wait until a file descriptor gets ready)
+    //
+    int getFdSets(fd_set &readables, fd_set &writeables);
+    bool getTimeout(KsTime &timeout);
+    void processEvents(fd_set &readables, fd_set &writeables,
+                       int ready);
+
+    //
+    // wait at most for timeout (or forever, if 0) and handle the
+    // events, returns false if nothing happened
+    //
+    bool serveEvents(const KsTime *timeout = 0);
+
+    //
+    // KssInterKsServerContext interface
+    //
+    virtual KssConnectionManager *getConnectionManager() const;
+    virtual bool addTimerEvent(KsTimerEvent *event);
+    virtual bool removeTimerEvent(KsTimerEvent *event);
+
+private:
+    KscEventLoop(const KscEventLoop &); // forbidden
+    KscEventLoop &operator = (const KscEventLoop &); // forbidden
+
+    void serveConnections();
+    void serveTimers();
+
+    KssConnectionManager *_cnx_manager;
+    PltPriorityQueue< PltPtrComparable<KsTimerEvent> > _timer_queue;
+};
+
+//////////////////////////////////////////////////////////////////////
+// class KscConnectionServer
+//   an ACPLT/KS server reached through a non-blocking TCP connection
+//   hosted by a KscEventLoop. The server is found the same way inter-
+//   server connections find their partners, and shares their pool of
+//   known server ports and idle connections.
+//
+//   Requests can be sent asynchronously with beginRequest(): the
+//   request is on its way when the event loop runs, and the reply is
+//   decoded into the result once it arrives. Then isBusy() turns false
+//   and requestCompleted() is called from within the event loop. The
+//   parameters and the result must stay alive until then. Only one
+//   request can be under way per server.
+//
+//   The usual service functions wait for the reply by running the
+//   event loop, so they must not be called from requestCompleted().
+//
+//   Only the A/V NONE scheme is supported. To have communication
+//   objects use such servers, derive from KscClient and create them
+//   in createServer().
+//
+class KscConnectionServer
+: public KscServerBase
+{
+public:
+    KscConnectionServer(KscEventLoop &loop, KsString hostAndName);
+    virtual ~KscConnectionServer();
+
+    bool beginRequest(u_long service,
+                      const KscAvModule *avm,
+                      const KsXdrAble &params,
+                      KsResult &result);
+    bool isBusy() const;
+    void cancelRequest();
+
+    //
+    // service functions defined in ks_core
+    //
+    virtual bool getPP(const KscAvModule *avm,
+                       const KsGetPPParams &params,
+                       KsGetPPResult &result);
+    virtual bool getVar(const KscAvModule *avm,
+                        const KsGetVarParams &params,
+                        KsGetVarResult &result);
+    virtual bool setVar(const KscAvModule *avm,
+                        const KsSetVarParams &params,
+                        KsSetVarResult &result);
+    virtual bool exgData(const KscAvModule *avm,
+                         const KsExgDataParams &params,
+                         KsExgDataResult &result);
+
+    virtual bool requestService(const KsString &extension,
+                                u_short minor_opcode,
+                                const KscAvModule *avm,
+                                const KsXdrAble &params,
+                                KsResult &result);
+    virtual bool requestByOpcode(u_long service,
+                                 const KscAvModule *avm,
+                                 const KsXdrAble &params,
+                                 KsResult &result);
+
+    virtual bool getServerVersion(u_long &version);
+
+    virtual u_short getProtocolVersion() const;
+    virtual PltTime getExpiresAt() const;
+    virtual bool isLiving() const;
+
+    //
+    // timeouts for opening the connection and for waiting for a reply,
+    // both in seconds
+    //
+    void setTimeouts(unsigned long connect_timeout,
+                     unsigned long call_timeout);
+    void getTimeouts(unsigned long &connect_timeout,
+                     unsigned long &call_timeout) const;
+
+protected:
+    virtual void requestCompleted(KS_RESULT result);
+
+private:
+    KscConnectionServer(const KscConnectionServer &); // forbidden
+    KscConnectionServer &operator = (const KscConnectionServer &); // forbidden
+
+    //
+    // the connection tells us about opens and replies
+    //
+    class Connection
+    : public KssInterKsServerConnection
+    {
+    public:
+        Connection(KscConnectionServer &server, KscEventLoop &loop);
+        virtual void async_attention(KssInterKsServerConnectionOperations op);
+    private:
+        KscConnectionServer &_server;
+    };
+    friend class Connection;
+
+    void attention(KssInterKsServerConnection::
+                   KssInterKsServerConnectionOperations op);
+    bool sendRequest();
+    void finishRequest(KS_RESULT result);
+    bool waitForRequest();
+
+    KscEventLoop &_loop;
+    Connection _connection;
+    bool _busy;
+    u_long _service;
+    const KsXdrAble *_params;
+    KsResult *_result;
+    u_short _protocol_version;
+    PltHashTable<KsString, u_long> _ext_opcodes;
+};
+
+#endif // PLT_USE_BUFFERED_STREAMS
+
+#endif // KSC_CLNTCON_INCLUDED
+
+// End of ks/clntcon.h
@@ -73,6 +73,8 @@ protected:
            last_comp;     // start of last component
 
     static const KsString praefixes[KSC_MAX_REL_DEPTH+1];
+
+    friend class KscPathHandle;
 };
 
 
@@ -129,6 +131,50 @@ protected:
 }; // class KscPathParser
 
 
+// ----------------------------------------------------------------------------
+// class KscPathHandle
+//   a handle to an interned resource locator. All handles created for the
+//   same resource locator share a single entry holding the parsed path, the
+//   host and server part, the hash value and the path components as integer
+//   ids. The ids of two paths are equal exactly where their components (and
+//   the delimiters in front of them) are equal. This way, sorting paths and
+//   finding out how many components they have in common doesn't need to
+//   compare strings. The ordering of handles keeps paths sharing a domain
+//   next to each other, but it is not the lexical one of the paths.
+//
+//   Handles may be used from several threads at once; the entry goes away
+//   together with the last handle referring to it.
+//
+class KscPathHandle
+{
+public:
+    KscPathHandle();
+    KscPathHandle(const KscPathParser &);
+    KscPathHandle(const KscPathHandle &);
+    ~KscPathHandle();
+
+    KscPathHandle &operator = (const KscPathHandle &);
+
+    bool isValid() const;
+    const KsString &getHostAndServer() const;
+    const KscPath &getPathAndName() const;
+    size_t countComponents() const;
+    unsigned long hash() const;
+
+    KsString relTo(const KscPathHandle &,
+                   size_t maxDepth = KSC_MAX_REL_DEPTH) const;
+
+    bool operator == (const KscPathHandle &) const;
+    bool operator != (const KscPathHandle &) const;
+    bool operator < (const KscPathHandle &) const;
+
+    class Entry; // interned paths, for internal use only
+
+private:
+    Entry *_entry;
+}; // class KscPathHandle
+
+
 //////////////////////////////////////////////////////////////////////
 // Inline Implementation
 //////////////////////////////////////////////////////////////////////
@@ -447,5 +493,39 @@ KscPathParser::operator != (const KscPathParser &other) const
 }
 
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// KscPathHandle inline implementation part
+//
+
+// ----------------------------------------------------------------------------
+// Returns true, if the handle refers to an interned path. This is the case
+// for valid resource locators with a path part and for valid paths only.
+//
+inline
+bool
+KscPathHandle::isValid() const
+{
+    return _entry != 0;
+} // KscPathHandle::isValid
+
+// ----------------------------------------------------------------------------
+// Handles are equal if they refer to the same interned path, which happens
+// if and only if they were created from the same resource locator.
+//
+inline
+bool
+KscPathHandle::operator == (const KscPathHandle &other) const
+{
+    return _entry == other._entry;
+} // KscPathHandle::operator ==
+
+inline
+bool
+KscPathHandle::operator != (const KscPathHandle &other) const
+{
+    return _entry != other._entry;
+} // KscPathHandle::operator !=
+
 #endif
 // End of file ks/clntpath.h
@@ -69,6 +69,7 @@ public:
     const KscPath &getPathAndName() const;
     KsString getHostAndServer() const;
     KsString getFullPath() const;
+    const KscPathHandle &getPathHandle() const;
 
     virtual KS_OBJ_TYPE typeCode() const = 0;
 
@@ -84,6 +85,12 @@ public:
 
     virtual void setAvModule(const KscAvModule *avm);
     virtual const KscAvModule *getAvModule() const;
+    //
+    // The A/V module requests are sent with: our own one if set,
+    // otherwise the one of the (innermost) package we are read with,
+    // our server's or the client's.
+    //
+    const KscAvModule *findAvModule(const KscAvModule *avm_package = 0) const;
 
     KS_RESULT getLastResult() const;
 
@@ -107,6 +114,7 @@ protected:
     virtual bool setEngProps(KsEngPropsHandle) = 0;
 
     KscPathParser path;
+    KscPathHandle _path_handle;
     KscServerBase *server;
     const KscAvModule *av_module;
     KS_RESULT _last_result;
@@ -339,6 +347,11 @@ public:
     bool getEngPropsUpdate();
     virtual bool getUpdate();
     virtual bool setUpdate();
+    //
+    // Like getUpdate(), but takes the value from the client's value
+    // cache if it isn't older than maxAge (see ks/valuecache.h).
+    //
+    bool getUpdate(const PltTimeSpan &maxAge);
     KsValueHandle getValue() const;
 
     const KsVarEngProps_THISTYPE *getEngProps() const;
@@ -357,6 +370,15 @@ protected:
 
     bool setEngProps(KsEngPropsHandle);
 
+    //
+    // Read the value as if contained in a package using avm_package
+    // (see KscSorter::findAvModule()).
+    //
+    friend class KscPackage;
+    bool fetchUpdate(const KscAvModule *avm_package);
+    bool getCachedUpdate(const PltTimeSpan &maxAge,
+                         const KscAvModule *avm_package);
+
     PLT_DECL_RTTI;
 
 private:
@@ -448,6 +470,17 @@ KscCommObject::getFullPath() const
     return path;
 }
 
+//////////////////////////////////////////////////////////////////////
+// Returns the interned path, which is shared with all other communi-
+// cation objects on the same resource locator.
+//
+inline
+const KscPathHandle &
+KscCommObject::getPathHandle() const
+{
+    return _path_handle;
+}
+
 //////////////////////////////////////////////////////////////////////
 
 inline
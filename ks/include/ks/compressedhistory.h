@@ -0,0 +1,141 @@
+/* -*-plt-c++-*- */
+#ifndef KS_COMPRESSEDHISTORY_INCLUDED
+#define KS_COMPRESSEDHISTORY_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ks/sampledhistory.h"
+#include "ks/histcodec.h"
+
+
+// ----------------------------------------------------------------------------
+// The KssCompressedHistory class records the values of some variables in
+// memory like KssRingHistory does, but keeps them compressed (see
+// ks/histcodec.h). This way, a history of regularly sampled, slowly
+// changing values takes about a tenth of the memory or less.
+//
+// New rows go into an uncompressed block of blockSize rows. Once this block
+// is full, it is sealed: its time stamps and every column are compressed
+// separately. The sealed blocks are kept in a ring of maxBlocks blocks, so
+// the oldest block is thrown away when the ring is full.
+//
+// GetHist requests only decompress the blocks overlapping the time range
+// requested. Clients asking for encoded replies get the rows re-encoded
+// as a whole. Raw replies are streamed using a cursor, which decompresses
+// one block at a time.
+//
+// All variables must be tracked before the first sample is taken.
+//
+class KssCompressedHistory
+    : public KssSampledHistory
+{
+public:
+    KssCompressedHistory(const KsString &id,
+                         size_t maxBlocks,
+                         size_t blockSize = KS_HISTBLOCK_SIZE,
+                         KS_HIST_TYPE mode = KS_HT_TIME_DRIVEN,
+                         unsigned long period = 1000, // msecs
+                         KsTime ctime = KsTime::now(),
+                         KsString comment = KsString());
+    virtual ~KssCompressedHistory();
+
+    virtual void getHist(const KsGetHistParams &params,
+                         KsGetHistSingleResult &result);
+    virtual KssHistoryCursor *openCursor(const KsGetHistParams &params);
+
+    size_t getBlockSize() const { return _block_size; }
+    size_t getMaxBlocks() const { return _max_blocks; }
+    size_t getCount() const;
+    //
+    // Bytes taken by the sealed blocks' compressed data.
+    //
+    size_t getEncodedSize() const { return _encoded_size; }
+
+protected:
+    friend class KssCompressedHistoryCursor;
+
+    struct Block {
+        size_t   seq;         // sequence number
+        PltTime  first;       // time stamp of the first row
+        PltTime  last;        // time stamp of the last row
+        size_t   count;       // number of rows
+        char    *times;       // compressed time stamps
+        size_t   times_size;
+        char   **columns;     // compressed values per track
+        size_t  *columns_size;
+    };
+
+    virtual bool addColumn(const Track &track);
+    virtual void removeColumn(const Track &track);
+    virtual void appendRow(const PltTime &t);
+
+    //
+    // Sealed blocks are addressed by their logical index: 0 is the oldest.
+    //
+    Block &blockAt(size_t i) const
+        { i += _first_block;
+          return _blocks[i < _max_blocks ? i : i - _max_blocks]; }
+    size_t rowsOf(size_t i) const
+        { return i < _block_count ? blockAt(i).count : _open_count; }
+    //
+    // Every block sealed gets the next sequence number, so blocks can be
+    // referred to no matter how often the ring has moved on. The open block
+    // has sequence number _sealed.
+    //
+    bool findBlock(size_t seq, size_t &i) const;
+
+    bool seal();
+    void releaseBlock(Block &block);
+    void selectBlocks(const Selection &sel, size_t &lo, size_t &hi) const;
+
+    //
+    // Decompress the rows of the blocks first up to (but not including)
+    // last; block _block_count stands for the open block.
+    //
+    bool decodeTimes(size_t first, size_t last, PltTime *dst) const;
+    bool decodeValues(size_t column, size_t first, size_t last,
+                      double *dst) const;
+
+    static size_t lowerBound(const PltTime *times, size_t count,
+                             const PltTime &t);
+    static size_t upperBound(const PltTime *times, size_t count,
+                             const PltTime &t);
+
+    size_t    _block_size;
+    size_t    _max_blocks;
+    Block    *_blocks;
+    size_t    _first_block;
+    size_t    _block_count;   // sealed blocks
+    size_t    _sealed;        // blocks sealed ever (wraps around)
+    size_t    _encoded_size;
+    PltTime  *_open_times;    // the open (uncompressed) block
+    double  **_open_columns;
+    size_t    _open_count;
+
+private:
+    KssCompressedHistory(const KssCompressedHistory &); // forbidden
+    KssCompressedHistory & operator = (const KssCompressedHistory &); // forbidden
+}; // class KssCompressedHistory
+
+
+#endif // KS_COMPRESSEDHISTORY_INCLUDED
+
+/* End of ks/compressedhistory.h */
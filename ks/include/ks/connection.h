@@ -33,6 +33,7 @@
 #include "ks/rpcproto.h"
 #include "ks/avticket.h"
 #include "ks/result.h"
+#include "ks/svrtransport.h"
 
 
 // ---------------------------------------------------------------------------
@@ -166,6 +167,11 @@ protected:
     
     void thisIsMyConnectionManager(KssConnectionManager *mgr)
     	{ _manager = mgr; }
+    //
+    // Tell the connection manager that this connection is dropped because
+    // it exceeded its memory quota.
+    //
+    void quotaExceeded();
 
     ConnectionType                   _cnx_type;    
     unsigned long                    _timeout;
@@ -213,10 +219,31 @@ public:
     virtual void sendReply(KsAvTicket &avt, KsResult &result) = 0;
     virtual void personaNonGrata() = 0;
 
+    //
+    // Some connections can send a large reply piece by piece while the
+    // peer reads it, instead of serializing it completely beforehand. The
+    // connection takes over the result object and deletes it when done.
+    // Connections not capable of streaming serialize the result in one go.
+    //
+    virtual bool canStreamReply() const { return false; }
+    virtual void sendStreamedReply(KsAvTicket &avt,
+                                   KssStreamedResult *result);
+
     virtual bool beginRequest(u_long xid, u_long prog_number,
 			      u_long prog_version, u_long proc_number) = 0;
     virtual void sendRequest() = 0;
     KsRpcHeader getRpcHeader() const { return _rpc_header; }
+
+    //
+    // Some connections allow the reply to a request to be sent later, so
+    // a server can wait for other servers before answering. The connection
+    // is then left alone by the connection manager until the reply has been
+    // sent and the connection has been tracked again.
+    //
+    virtual bool canDeferReply() const { return false; }
+    void deferReply() { _reply_deferred = true; }
+    bool takeDeferredReply()
+        { bool d = _reply_deferred; _reply_deferred = false; return d; }
     
 protected:
     virtual void freeStreamMemory() { }
@@ -226,6 +253,7 @@ protected:
 
     XDR         _xdrs;
     bool        _cleanup_xdr_stream;
+    bool        _reply_deferred;
     KsRpcHeader _rpc_header;
 }; // class KssXDRConnection
 
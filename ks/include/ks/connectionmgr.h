@@ -143,6 +143,7 @@ public:
     inline unsigned int getIoErrorCount() { return _io_errors; }
     inline unsigned int getIoRxErrorCount() { return _io_rx_errors; }
     inline unsigned int getIoTxErrorCount() { return _io_tx_errors; }
+    inline unsigned int getQuotaDropCount() { return _quota_drops; }
     
 protected:
     friend class KssConnection;
@@ -151,6 +152,8 @@ protected:
     
     // TODO: incomming notifications from dying connections
     virtual void connectionShutdownNotification(KssConnection &) { }
+    // connections dropped because they ran out of memory quota
+    virtual void connectionOverQuota(KssConnection &) { ++_quota_drops; }
     
 private:
     _KssConnectionItem *getConnectionItem(int fd);
@@ -168,6 +171,7 @@ private:
     unsigned int        _io_errors;
     unsigned int        _io_rx_errors;
     unsigned int        _io_tx_errors;
+    unsigned int        _quota_drops;
         
     _PltDLinkedListNode _active_connections; // for timeouts
     _PltDLinkedListNode _serviceable_connections;  // waiting to be served
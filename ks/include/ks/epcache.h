@@ -0,0 +1,133 @@
+/* -*-plt-c++-*- */
+#ifndef KSC_EPCACHE_INCLUDED
+#define KSC_EPCACHE_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+
+#include <plt/thread.h>
+#include <plt/time.h>
+
+#include "ks/serviceparams.h"
+#include "ks/avmodule.h"
+
+//////////////////////////////////////////////////////////////////////
+// class KscEPCache
+//   remembers the replies to GetEP requests sent to a single server,
+//   so browsing the same domains again and again doesn't need a round
+//   trip every time. Replies are identified by the A/V module used and
+//   the service parameters (domain path, type mask, name mask and
+//   scope flags). They are kept for a fixed time (ttl) or until they
+//   are invalidated explicitly.
+//
+//   The query for a single object, as sent by the communication object
+//   proxies when they read their engineered properties, is answered
+//   from the listing of its domain if that is in the cache. Note that
+//   a listing of both the children and the parts of a domain can't
+//   tell the one from the other, so if a child and a part share the
+//   same name, the one listed first is taken.
+//
+//   Replies are kept XDR encoded, so no handles are shared between the
+//   threads using the cache.
+//
+class KscEPCache
+{
+public:
+    KscEPCache(const PltTimeSpan &ttl, size_t buckets = 251);
+    ~KscEPCache();
+
+    void setTTL(const PltTimeSpan &ttl);
+    PltTimeSpan getTTL() const;
+
+    bool lookup(const KscAvModule *avm,
+                const KsGetEPParams &params,
+                KsGetEPResult &result);
+    void store(const KscAvModule *avm,
+               const KsGetEPParams &params,
+               const KsGetEPResult &result);
+
+    //
+    // Forget the listings of a domain and of everything below it.
+    //
+    void invalidate(const KsString &path);
+    void clear();
+
+    struct Statistics {
+        unsigned long hits;         // replies found
+        unsigned long child_hits;   // single objects found in listings
+        unsigned long misses;
+        unsigned long stores;
+        unsigned long invalidations;
+    };
+    void getStatistics(Statistics &stats) const;
+    void resetStatistics();
+
+protected:
+    struct Child {
+        KsString  name;
+        enum_t    type;
+        u_int     offset;       // where its XDR representation starts
+        u_int     size;
+    };
+
+    struct Entry {
+        Entry              *next;   // next entry in the same bucket
+        const KscAvModule  *avm;
+        KsString            path;
+        KS_OBJ_TYPE         type_mask;
+        KsString            name_mask;
+        KS_EP_FLAGS         scope_flags;
+        PltTime             time;   // when the reply has been stored
+        char               *encoded;
+        u_int               encoded_size;
+        Child              *children;
+        size_t              child_count;
+        size_t             *slots;  // hashed index into children
+        size_t              slot_count;
+    };
+
+    bool isFresh(const Entry &entry, const PltTime &now) const;
+    static bool findChild(const Entry &entry, const KsString &name,
+                          size_t &child);
+    bool lookupChild(const KscAvModule *avm,
+                     const KsGetEPParams &params,
+                     KsGetEPResult &result,
+                     const PltTime &now);
+    static bool isPattern(const KsString &mask);
+    static bool isBelow(const KsString &path, const KsString &domain);
+    static bool encode(Entry &entry, const KsGetEPResult &result);
+    static void destroy(Entry *entry);
+
+    Entry            **_buckets;
+    size_t             _bucket_count;
+    PltTimeSpan        _ttl;
+    mutable PltMutex   _mutex;
+    Statistics         _stats;
+
+private:
+    KscEPCache(const KscEPCache &); // forbidden
+    KscEPCache &operator = (const KscEPCache &); // forbidden
+};
+
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// EOF epcache.h
+//////////////////////////////////////////////////////////////////////
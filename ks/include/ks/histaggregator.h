@@ -0,0 +1,127 @@
+/* -*-plt-c++-*- */
+#ifndef KS_HISTAGGREGATOR_INCLUDED
+#define KS_HISTAGGREGATOR_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ks/value.h"
+#include "plt/time.h"
+
+
+// ----------------------------------------------------------------------------
+// Upper limit for the number of buckets of an aggregated GetHist reply.
+//
+const size_t KSS_HISTORY_MAX_BUCKETS = 65536;
+
+
+// ----------------------------------------------------------------------------
+// The KssHistoryAggregator class reduces the samples of a history to a fixed
+// number of buckets, so the size of a GetHist reply depends on the number of
+// buckets (think of the pixels of a trend display) and not on the number of
+// samples within the time range requested.
+//
+// The time range is divided into buckets of equal width: either the width
+// is given (the delta of a time selector), or the range is divided into
+// the maximum number of buckets allowed. There are never more buckets than
+// KSS_HISTORY_MAX_BUCKETS, whatever the client asks for. The history then tells which of
+// its rows fall into which bucket; as rows are sorted by time, this only
+// takes one search per bucket boundary. Finally, the values of the rows of
+// each bucket are fed column by column into accumulate(), which computes
+// minimum, maximum, sum and last value in one pass over the column.
+//
+// The result per bucket depends on the interpolation mode requested:
+//   KS_IPM_MIN     minimum value
+//   KS_IPM_MAX     maximum value
+//   KS_IPM_LINEAR  mean value
+//   KS_IPM_HOLD    last value
+// Buckets without any samples are left out of the result; the time stamp
+// of a bucket is its start time.
+//
+class KssHistoryAggregator
+{
+public:
+    KssHistoryAggregator();
+    ~KssHistoryAggregator();
+
+    //
+    // Divide the time range [from, to] with its rows rows into buckets.
+    // A zero delta means to use maxBuckets buckets, but not more than
+    // there are rows. No more than maxBuckets are used in any case. Returns
+    // KS_ERR_BADPARAM if the delta asks for more than KSS_HISTORY_MAX_BUCKETS
+    // buckets and KS_ERR_GENERIC if running out of memory.
+    //
+    KS_RESULT setup(const PltTime &from, const PltTime &to,
+                    const PltTimeSpan &delta, size_t maxBuckets,
+                    size_t rows);
+
+    size_t getBucketCount() const { return _buckets; }
+    //
+    // Returns the start of bucket b. The end of the last bucket is
+    // returned as the start of the non-existing bucket getBucketCount().
+    //
+    const PltTime &getBucketStart(size_t b) const { return _starts[b]; }
+
+    //
+    // The rows of bucket b are rows getBucketRow(b) up to (but not
+    // including) getBucketRow(b+1). How rows are numbered is up to the
+    // history, it just needs to set the first row of every bucket and the
+    // end of the last one.
+    //
+    void setBucketRow(size_t b, size_t row) { _rows[b] = row; }
+    size_t getBucketRow(size_t b) const { return _rows[b]; }
+    size_t getBucketSize(size_t b) const { return _rows[b + 1] - _rows[b]; }
+
+    //
+    // Start with the next column and feed the values of (some of) the
+    // rows of bucket b into the accumulators.
+    //
+    void reset();
+    void accumulate(size_t b, const double *values, size_t count);
+
+    //
+    // Results for the non-empty buckets: their start times and the values
+    // according to the interpolation mode.
+    //
+    KsValueHandle getTimes() const;
+    KsValueHandle getValues(KS_INTERPOLATION_MODE mode) const;
+
+    static bool isSupported(KS_INTERPOLATION_MODE mode);
+
+private:
+    KssHistoryAggregator(const KssHistoryAggregator &); // forbidden
+    KssHistoryAggregator & operator = (const KssHistoryAggregator &); // forbidden
+
+    void release();
+    size_t getFilledCount() const;
+
+    size_t   _buckets;
+    PltTime *_starts;
+    size_t  *_rows;
+    double  *_min;
+    double  *_max;
+    double  *_sum;
+    double  *_last;
+}; // class KssHistoryAggregator
+
+
+#endif // KS_HISTAGGREGATOR_INCLUDED
+
+/* End of ks/histaggregator.h */
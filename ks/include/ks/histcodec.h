@@ -0,0 +1,180 @@
+/* -*-plt-c++-*- */
+#ifndef KS_HISTCODEC_INCLUDED
+#define KS_HISTCODEC_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ks/value.h"
+
+
+// ----------------------------------------------------------------------------
+// A compact encoding for the columns of history data: either a column of
+// time stamps or one of doubles is compressed into a sequence of blocks.
+// Every block starts with a header of KS_HISTBLOCK_HEADER_SIZE bytes:
+//
+//   4 bytes   'K' 'S' 'H' and the kind of column, 'T' or 'V'
+//   4 bytes   number of samples within the block
+//   4 bytes   number of bytes of the compressed samples following
+//   8 bytes   first time stamp (microseconds) or minimum value
+//   8 bytes   last time stamp (microseconds) or maximum value
+//
+// So readers can skip whole blocks (by time or by value) without decoding
+// them. All numbers are in network byte order, doubles in IEEE format.
+//
+// Time stamps are encoded as the difference between consecutive deltas in
+// microseconds ("delta of delta"), which is just one bit for samples taken
+// at regular intervals. Values are encoded as the XOR of their bits with the
+// bits of the previous value, leaving out the leading and trailing zero bits
+// where possible ("Gorilla" encoding), which is just one bit for a value
+// that didn't change and a few bits for a value that changed slightly.
+//
+#define KS_HISTBLOCK_HEADER_SIZE 28
+#define KS_HISTBLOCK_SIZE        1024    // default samples per block
+
+
+// ----------------------------------------------------------------------------
+// The encoder compresses one column. Samples are added one by one or as
+// arrays; a block is completed whenever it holds the number of samples per
+// block given. Finally, getValue() (or detach()) returns the encoded column.
+//
+class KsHistEncoder
+{
+public:
+    enum Kind { TIMES = 'T', VALUES = 'V' };
+
+    KsHistEncoder(Kind kind, size_t blockSize = KS_HISTBLOCK_SIZE);
+    ~KsHistEncoder();
+
+    bool addTime(const PltTime &t);
+    bool addValue(double v);
+    bool addTimes(const KsTime *t, size_t count);
+    bool addValues(const double *v, size_t count);
+
+    size_t getCount() const { return _count; }
+
+    //
+    // Complete the current block and return the encoded column as a byte
+    // vector or hand over the buffer (allocated using new []) to the
+    // caller. The encoder is empty afterwards.
+    //
+    KsValueHandle getValue();
+    char *detach(size_t &size);
+
+    //
+    // Encode a time or double vector as a whole. Other values are returned
+    // unchanged.
+    //
+    static KsValueHandle encode(const KsValueHandle &value,
+                                size_t blockSize = KS_HISTBLOCK_SIZE);
+
+private:
+    KsHistEncoder(const KsHistEncoder &); // forbidden
+    KsHistEncoder & operator = (const KsHistEncoder &); // forbidden
+
+    bool reserve(size_t bytes);
+    bool putBits(PltUInt64 bits, unsigned int n);
+    bool beginBlock();
+    void endBlock();
+    bool addSample(PltUInt64 sample);
+
+    Kind        _kind;
+    size_t      _block_size;
+    char       *_buf;
+    size_t      _size;        // bytes used
+    size_t      _alloc;       // bytes allocated
+    unsigned    _free_bits;   // unused bits in the last byte
+    size_t      _count;       // samples in all blocks
+    size_t      _block_start; // offset of the current block's header
+    size_t      _block_count; // samples in the current block
+    PltUInt64   _first;
+    PltUInt64   _prev;
+    PltInt64    _prev_delta;
+    unsigned    _prev_lead;
+    unsigned    _prev_trail;
+    double      _min;
+    double      _max;
+}; // class KsHistEncoder
+
+
+// ----------------------------------------------------------------------------
+// The decoder walks through the blocks of an encoded column. The buffer is
+// not copied, so it must stay valid as long as the decoder is used.
+//
+class KsHistDecoder
+{
+public:
+    KsHistDecoder(const char *data, size_t size);
+
+    //
+    // Check the headers of all blocks. Returns the kind of column and the
+    // total number of samples, or false if the data is corrupt.
+    //
+    bool check(KsHistEncoder::Kind &kind, size_t &count) const;
+
+    //
+    // Move on to the next block (the first one at the beginning) and get
+    // the information from its header.
+    //
+    bool nextBlock();
+    size_t getBlockCount() const { return _block_count; }
+    PltTime getBlockFirstTime() const;
+    PltTime getBlockLastTime() const;
+    double getBlockMin() const;
+    double getBlockMax() const;
+
+    //
+    // Decode the samples of the current block. "dst" must have room for
+    // getBlockCount() samples.
+    //
+    bool decodeTimes(KsTime *dst);
+    bool decodeTimes(PltTime *dst);
+    bool decodeValues(double *dst);
+
+    //
+    // Decode a byte vector holding an encoded column into a time or
+    // double vector. Other values are returned unchanged, corrupt data
+    // gives an empty handle.
+    //
+    static bool isEncoded(const KsValueHandle &value);
+    static KsValueHandle decode(const KsValueHandle &value);
+
+private:
+    bool getBits(unsigned int n, PltUInt64 &bits);
+    bool nextSample(PltUInt64 &sample);
+
+    const unsigned char *_data;
+    size_t               _size;
+    size_t               _next;        // offset of the next block
+    const unsigned char *_block;       // current block header or 0
+    size_t               _block_count;
+    size_t               _pos;         // bit position within payload
+    size_t               _bits;        // payload size in bits
+    size_t               _decoded;
+    PltUInt64            _prev;
+    PltInt64             _prev_delta;
+    unsigned             _prev_lead;
+    unsigned             _prev_trail;
+}; // class KsHistDecoder
+
+
+#endif // KS_HISTCODEC_INCLUDED
+
+/* End of ks/histcodec.h */
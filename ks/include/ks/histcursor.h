@@ -0,0 +1,141 @@
+/* -*-plt-c++-*- */
+#ifndef KS_HISTCURSOR_INCLUDED
+#define KS_HISTCURSOR_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ks/svrobjects.h"
+#include "ks/svrtransport.h"
+
+
+// ----------------------------------------------------------------------------
+// A KssHistoryCursor hands out the rows of a GetHist reply block by block,
+// so the reply can be serialized while it is sent instead of being built
+// completely in memory first. A history opens a cursor for a request (see
+// KssHistory::openCursor()) and decides about the rows and the items of the
+// reply right then; the rows themselves are read later, when the reply is
+// serialized.
+//
+// The items of the reply are in the order of the request: the time stamps,
+// a column of values (as doubles), or just an error. Every time stamp or
+// value item has getRowCount() rows.
+//
+// As the history may record new rows (or throw away old ones) while the
+// reply is being sent, a cursor must refer to the rows in a way which stays
+// valid. If rows are gone before they could be read, readTimes() or
+// readValues() return false and the reply is aborted.
+//
+#define KSS_HISTCURSOR_BLOCK 1024    // rows read at once
+
+class KssHistoryCursor
+{
+public:
+    KssHistoryCursor();
+    virtual ~KssHistoryCursor();
+
+    bool setItemCount(size_t count);
+    void setTimeItem(size_t item);
+    void setValueItem(size_t item, size_t column);
+    void setBadItem(size_t item, KS_RESULT result);
+
+    size_t getItemCount() const { return _item_count; }
+    KS_RESULT getItemResult(size_t item) const
+        { return _items[item].result; }
+    bool isTimeItem(size_t item) const { return _items[item].time; }
+    size_t getItemColumn(size_t item) const { return _items[item].column; }
+
+    void setRowCount(size_t rows) { _rows = rows; }
+    size_t getRowCount() const { return _rows; }
+
+    //
+    // Keep the history alive as long as the cursor is in use.
+    //
+    void hold(const KssCommObjectHandle &history) { _history = history; }
+
+    //
+    // Read "count" rows of the time stamps or of a column, starting with
+    // row "row" of the reply.
+    //
+    virtual bool readTimes(size_t row, size_t count, PltTime *dst) = 0;
+    virtual bool readValues(size_t column, size_t row, size_t count,
+                            double *dst) = 0;
+
+protected:
+    struct Item {
+        KS_RESULT result;
+        bool      time;
+        size_t    column;
+    };
+
+    Item                *_items;
+    size_t               _item_count;
+    size_t               _rows;
+    KssCommObjectHandle  _history;
+
+private:
+    KssHistoryCursor(const KssHistoryCursor &); // forbidden
+    KssHistoryCursor & operator = (const KssHistoryCursor &); // forbidden
+}; // class KssHistoryCursor
+
+
+// ----------------------------------------------------------------------------
+// The result of a GetHist service which is serialized piece by piece. It
+// produces exactly the same XDR data as KsGetHistResult; for every path, the
+// reply is either built as usual or taken from a cursor.
+//
+class KssGetHistStreamResult
+    : public KssStreamedResult
+{
+public:
+    KssGetHistStreamResult(size_t paths);
+    virtual ~KssGetHistStreamResult();
+
+    bool isValid() const;
+
+    //
+    // Let the reply for a path come from a cursor. The result takes over
+    // the cursor.
+    //
+    void setCursor(size_t path, KssHistoryCursor *cursor);
+
+    virtual bool xdrEncodeNext(XDR *xdr, size_t budget, bool &done);
+
+    KsArray<KsGetHistSingleResult> replies;
+
+private:
+    KssGetHistStreamResult(const KssGetHistStreamResult &); // forbidden
+    KssGetHistStreamResult & operator = (const KssGetHistStreamResult &); // forbidden
+
+    enum State { BEGIN, REPLY, ITEM, ROWS };
+
+    KssHistoryCursor **_cursors;
+    PltTime           *_times;
+    double            *_values;
+    State              _state;
+    size_t             _reply;
+    size_t             _item;
+    size_t             _row;
+}; // class KssGetHistStreamResult
+
+
+#endif // KS_HISTCURSOR_INCLUDED
+
+/* End of ks/histcursor.h */
@@ -29,6 +29,26 @@
 #include "ks/commobject.h"
 #include "ks/histparams.h"
 
+/////////////////////////////////////////////////////////////////////////////
+// A KscHistBlockHandler gets the reply of KscHistory::getHistBlocks() block
+// by block while the reply is decoded, so large histories don't have to be
+// held in memory as a whole. The items are reported in the order of the
+// selectors: beginItem() tells about the result and the number of rows of
+// an item, the rows then follow in blocks. Numeric vectors are handed out
+// as doubles. Only time and numeric vectors can be read this way.
+//
+class KscHistBlockHandler
+{
+public:
+    virtual ~KscHistBlockHandler() {}
+
+    virtual void beginItem(size_t item, KS_RESULT result, size_t count) = 0;
+    virtual void timeBlock(size_t item, const KsTime *times,
+                           size_t count) = 0;
+    virtual void valueBlock(size_t item, const double *values,
+                            size_t count) = 0;
+};
+
 /////////////////////////////////////////////////////////////////////////////
 
 class KscHistory
@@ -59,6 +79,14 @@ public:
     // Read max entries at most
     void setMaxEntries(u_long max = ULONG_MAX);
 
+    // Ask the server for compressed time and double vectors (see
+    // ks/histcodec.h). This is off by default and needs a time selector.
+    // Compressed replies are decoded transparently, and servers which
+    // reject the request as malformed are asked again the usual way.
+    // Only if that works, they aren't asked for compression any more.
+    void setEncoding(bool on = true);
+    bool getEncoding() const { return encoding; }
+
     // Read parts of a history
     bool getParts(KsList<KsEngPropsHandle> &parts);
 
@@ -66,6 +94,11 @@ public:
     // result is not stored in object
     bool getHist(KsGetHistResult &result);
 
+    // Read history with currently set parameters, handing
+    // the result block by block to a handler. This never asks
+    // for compressed replies, so servers can stream the reply.
+    bool getHistBlocks(KscHistBlockHandler &handler);
+
     // Read history with current parameters and
     // store result
     bool updateHist();
@@ -79,7 +112,17 @@ public:
     KS_RESULT getStateValue(KsString selector, KsStateVecValue &val);
 
 protected:
+    bool requestHist(KsGetHistResult &result, bool encode);
+    bool requestHist(KscServerBase *server,
+                     const KsGetHistParams &params,
+                     KsGetHistResult &result,
+                     bool encoded);
+    static KS_RESULT replyResult(const KsGetHistResult &result);
+    static void decodeResult(KsGetHistResult &result);
+
     u_long                 max_entries;
+    bool                   encoding;
+    bool                   encoding_refused; // server can't compress
 
     KsList<KsGetHistItem>  selectors;
 
@@ -95,7 +138,9 @@ protected:
 inline
 KscHistory::KscHistory(const char *object_path)
     : KscCommObject(object_path),
-      max_entries(ULONG_MAX)
+      max_entries(ULONG_MAX),
+      encoding(false),
+      encoding_refused(false)
 {}
 
 /////////////////////////////////////////////////////////////////////////////
@@ -149,6 +194,16 @@ KscHistory::setMaxEntries(u_long max)
     max_entries = max;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+
+inline
+void
+KscHistory::setEncoding(bool on)
+{
+    encoding = on;
+    encoding_refused = false;
+}
+
 
 #endif // KS_HISTORY_INCLUDED
 // End of history.h
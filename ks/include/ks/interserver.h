@@ -39,6 +39,7 @@
 #include "ks/xdrtcpcon.h"
 #include "ks/xdrudpcon.h"
 #include "ks/register.h"
+#include "ks/resolver.h"
 
 #if PLT_USE_DEPRECIATED_HEADER
 #include <iostream.h>
@@ -47,6 +48,98 @@
 #endif
 
 
+class KssInterKsServerOpenEvent;
+
+
+// ---------------------------------------------------------------------------
+// Inter-server connections do their i/o through a connection manager and
+// need a timer queue while opening. Usually they run within the server
+// object, but other event loops -- like the one of a client -- can host
+// them, too, by implementing this interface.
+//
+class KssInterKsServerContext {
+public:
+    virtual ~KssInterKsServerContext() { }
+
+    virtual KssConnectionManager *getConnectionManager() const = 0;
+    virtual bool addTimerEvent(KsTimerEvent *event) = 0;
+    virtual bool removeTimerEvent(KsTimerEvent *event) = 0;
+}; // class KssInterKsServerContext
+
+
+// ---------------------------------------------------------------------------
+// All inter-server connections share a pool. The pool remembers where an
+// ACPLT/KS server has been found, so later opens can skip the portmapper
+// and the manager, and even the DNS lookup. It also keeps idle TCP/IP
+// connections to servers warm, so opening a connection to a server used
+// shortly before usually does not even need a connect. Several calls to
+// the same server can run side by side, each on its own pooled connection.
+// Servers are identified by their "host/server" key, which is also the
+// way they were specified when creating the inter-server connections.
+// The pool may be used from several threads, each running its own client
+// event loop.
+//
+class KssInterKsServerPool {
+public:
+    //
+    // Control how long a resolved server port is trusted, how long an
+    // idle connection is kept, and how many idle connections are kept
+    // per server. All spans are in seconds.
+    //
+    static void setLimits(unsigned long resolveTtl,
+                          unsigned long idleTimeout,
+                          unsigned int maxIdle);
+    static void getLimits(unsigned long &resolveTtl,
+                          unsigned long &idleTimeout,
+                          unsigned int &maxIdle);
+    //
+    // Close all idle connections and forget all resolved ports.
+    //
+    static void flush();
+
+private:
+    friend class KssInterKsServerConnection;
+
+    struct IdleConnection {
+	IdleConnection   *next;
+	KssXDRConnection *con;
+	PltTime           idle_until;
+    };
+
+    struct Entry {
+	Entry          *next;
+	KsString        key;
+	bool            resolved;
+	struct in_addr  ip;
+	u_short         port;
+	u_short         protocol_version;
+	PltTime         resolved_until;
+	IdleConnection *idle;
+	unsigned int    idle_count;
+    };
+
+    static Entry *find(const KsString &key, bool create);
+
+    static bool lookupServer(const KsString &key, struct in_addr &ip,
+			     u_short &port, u_short &protocolVersion);
+    static void rememberServer(const KsString &key, struct in_addr ip,
+			       u_short port, u_short protocolVersion);
+    static void forgetServer(const KsString &key);
+
+    static KssXDRConnection *checkOut(const KsString &key,
+				      u_short &protocolVersion);
+    static bool checkIn(const KsString &key, KssXDRConnection *con);
+
+    static void dropConnection(KssXDRConnection *con);
+    static bool isAlive(KssXDRConnection *con);
+
+    static Entry         *_entries;
+    static unsigned long  _resolve_ttl;
+    static unsigned long  _idle_timeout;
+    static unsigned int   _max_idle;
+}; // class KssInterKsServerPool
+
+
 // ---------------------------------------------------------------------------
 // The class KssInterKsServerConnection provides client functionality to
 // ACPLT/KS server, so servers can send ACPLT/KS service requests to other
@@ -56,7 +149,8 @@
 class KssInterKsServerConnection : protected KssConnectionAttentionInterface
 {
 public:
-    KssInterKsServerConnection(KsString host, KsString server);
+    KssInterKsServerConnection(KsString host, KsString server,
+			       KssInterKsServerContext *context = 0);
     virtual ~KssInterKsServerConnection();
 
     //
@@ -84,7 +178,8 @@ public:
     bool open();
 
     //
-    // Immediately close the connection
+    // Immediately close the connection. An open connection which is
+    // currently not in use is handed back to the pool instead.
     //
     void close();
 
@@ -139,6 +234,7 @@ protected:
     //
     enum ISCSubState {
 	ISC_SUBSTATE_NONE,
+	ISC_SUBSTATE_RESOLVING,
 	ISC_SUBSTATE_CONNECTING_PMAP,
 	ISC_SUBSTATE_CONNECTING_MANAGER,
 	ISC_SUBSTATE_CONNECTING_SERVER
@@ -149,11 +245,25 @@ protected:
     //
     virtual bool attention(KssConnection &con);
 
+    friend class KssInterKsServerOpenEvent;
+    void pooledOpenCompleted();
+    bool reopenWithoutCache();
+    void resolveStep();
+    bool hostResolved(const KsHostAddresses &addrs);
+
     u_long makeXid();
 
     void activateConnection();
     void closeConnection();
 
+    //
+    // Access to the context we're running in, which is the server object
+    // unless another context has been given.
+    //
+    KssConnectionManager *getConnectionManager() const;
+    bool addTimerEvent(KsTimerEvent *event);
+    bool removeTimerEvent(KsTimerEvent *event);
+
     bool openPortmapperConnection();
     bool openManagerConnection(u_short port, int protocol);
     bool openServerConnection(u_short port);
@@ -169,6 +279,7 @@ protected:
     u_short                          _host_port;
     struct sockaddr_in               _host_addr; 
     struct in_addr                   _old_ip;
+    PltTime                          _resolve_until;
     KsString                         _server;
     u_short                          _server_port;
 
@@ -176,6 +287,12 @@ protected:
     unsigned long                    _call_timeout;
 
     unsigned short                   _protocol_version;
+
+    KsString                         _pool_key;
+    bool                             _from_cache;
+    KssInterKsServerOpenEvent       *_open_event;
+
+    KssInterKsServerContext         *_context;
 }; // class KssInterKsServerConnection
 
 
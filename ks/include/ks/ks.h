@@ -279,6 +279,12 @@ ENUMDEF(KS_INTERPOLATION_MODE)
 #define KS_IPM_MAX      ENUMVAL(KS_INTERPOLATION_MODE, 0x0004)
 #define KS_IPM_HOLD     ENUMVAL(KS_INTERPOLATION_MODE, 0x0008)
 #define KS_IPM_DEFAULT  ENUMVAL(KS_INTERPOLATION_MODE, 0x8000)
+/*
+ * Not an interpolation mode but a flag which may be combined with any of the
+ * modes above: the client accepts the history parts compressed into blocks
+ * (see ks/histcodec.h) as byte vectors.
+ */
+#define KS_IPM_ENCODED  ENUMVAL(KS_INTERPOLATION_MODE, 0x4000)
 
 
 /* ----------------------------------------------------------------------------
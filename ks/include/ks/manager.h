@@ -99,13 +99,38 @@ private:
     void removeServer(KsmServer *p);
     bool isLocal(KssTransport &t);
 
+    bool indexServer(KsmServer *p);
+    void unindexServer(KsmServer *p);
+    KsmServer *findServer(const KsServerDesc &desc) const;
+
 #if !PLT_USE_BUFFERED_STREAMS
     SVCXPRT *_udp_transport;
 #else
+    //
+    // GETSERVER requests arriving via UDP are answered from a reply
+    // datagram cached with each registered server, bypassing the
+    // generic ticket and service parameter machinery. Everything not
+    // fitting the fast path is left to the usual dispatcher.
+    //
+    bool quickGetServer(KssUDPXDRConnection &con);
+    bool encodeGetServerReply(KsmServer *p);
+
+    class KsmUDPAttentionDispatcher:
+        public KssConnectionAttentionInterface {
+    public:
+        KsmUDPAttentionDispatcher(KsManager &m) : _manager(m) { }
+        virtual bool attention(KssConnection &conn);
+    private:
+        KsManager &_manager;
+    };
+
     KssXDRConnection *_udp_transport;
+    KsmUDPAttentionDispatcher _udp_dispatcher;
 #endif
     bool _registered;
     PltHashTable<PltKeyPtr<KsServerDesc>, KsmServer *> _server_table;
+    // server name -> registration with the highest protocol version
+    PltHashTable<KsString, KsmServer *> _server_index;
     KssSimpleDomain _servers_domain;
     KsHostInAddrSet _localIpAddresses;
 
@@ -124,6 +149,8 @@ public:
         : KsTimerEvent(at), pserver(p), _manager(m) { }
 
     virtual void trigger();
+    // only while not queued
+    void expireAt(const KsTime & at) { _trigger_at = at; }
     KsmServer * pserver;
 private:
     KsManager & _manager;
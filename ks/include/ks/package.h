@@ -30,6 +30,8 @@
 #include "ks/commobject.h"
 #include "ks/sorter.h"
 
+class KscValueCache;
+
 //////////////////////////////////////////////////////////////////////
 // class _KscPackageBase
 //   encapsulates some copy routines to create service parameters and
@@ -37,12 +39,46 @@
 //
 class _KscPackageBase
 {
+public:
+    //
+    // Every bucket of a package becomes a request to a single ACPLT/KS
+    // server. See package.cpp for the details.
+    //
+    class Request;
+    struct RequestBatch;
+
 protected:
     _KscPackageBase() {}
+
+    class GetVarRequest;
+    class SetVarRequest;
+    class ExgDataRequest;
+    friend class GetVarRequest;
+    friend class SetVarRequest;
+    friend class ExgDataRequest;
+
+    //
+    // Issue a list of requests to all servers at once, wait for the
+    // replies and copy back the results.
+    //
+    static bool appendRequest(Request **&tail, Request *request);
+    static bool appendGetVarRequests(Request **&tail,
+                                     KscBucketHandle bucket);
+    static bool appendSetVarRequests(Request **&tail,
+                                     KscBucketHandle bucket);
+    static bool appendExgDataRequests(Request **&tail,
+                                      KscBucketHandle getBucket,
+                                      KscBucketHandle setBucket);
+    static bool issueRequests(Request *requests, KS_RESULT &lastResult);
+    static void deleteRequests(Request *requests);
+    static bool startChain(Request *req, RequestBatch &batch,
+                           KS_RESULT &lastResult);
+    static bool finishRequest(Request *req, KS_RESULT &lastResult);
     
     static bool fillGetVarParams(const PltArray< KscSortVarPtr > &,
                                  KsArray<KsString> &);
-    static bool copyGetVarResults(const PltArray< KscSortVarPtr > &,
+    static bool copyGetVarResults(const KscAvModule *,
+                                  const PltArray< KscSortVarPtr > &,
                                   const KsArray<KsGetVarItemResult> &);
     static bool fillSetVarParams(const PltArray< KscSortVarPtr > &,
                                  KsArray<KsSetVarItem> &);
@@ -52,6 +88,24 @@ protected:
                               KsArray<KsString> &);
     static void distributeErrorResult(KS_RESULT result,
 				      const PltArray< KscSortVarPtr > &);
+    static bool copyCachedProps(KscVariable &var, KsVarCurrProps &props);
+
+    //
+    // Large buckets are split into chunks, which become requests of
+    // their own (see KscClient::setChunkLimits()).
+    //
+    struct ChunkBudget {
+        ChunkBudget();
+        size_t items;     // variables left
+        size_t bytes;     // bytes of parameters left
+        bool   empty;     // nothing taken so far
+    };
+    static size_t chunkLength(const PltArray< KscSortVarPtr > &vars,
+                              size_t first, bool withValues,
+                              ChunkBudget &budget);
+    static bool sliceVars(const PltArray< KscSortVarPtr > &vars,
+                          size_t first, size_t count,
+                          PltArray< KscSortVarPtr > &slice);
 }; // class _KscPackageBase
 
 //////////////////////////////////////////////////////////////////////
@@ -82,6 +136,23 @@ public:
 
     bool getUpdate();
     bool setUpdate(bool force = false);
+    //
+    // Take the values of variables from the client's value cache if
+    // they aren't older than maxAge (see ks/valuecache.h). All other
+    // variables are read using a single getUpdate().
+    //
+    bool getUpdate(const PltTimeSpan &maxAge);
+
+    //
+    // A prepared package sorts its variables and sets up (and encodes)
+    // the GetVar requests only once. Every getUpdate() then reuses them
+    // until variables or subpackages are added to or removed from the
+    // package or one of its subpackages. Changing the A/V module of a
+    // variable isn't noticed, so prepare the package again afterwards.
+    //
+    bool prepare();
+    void unprepare();
+    bool isPrepared() const;
 
     KscPkgVariableIterator *newVariableIterator(bool deep=false) const;
     KscSubpackageIterator *newSubpackageIterator() const;
@@ -90,8 +161,16 @@ public:
     const KscAvModule *getAvModule() const;
 
 protected:
-    bool getSimpleUpdate(KscBucketHandle);
-    bool setSimpleUpdate(KscBucketHandle);
+    bool compile();
+    unsigned long getGeneration() const;
+    void touch();
+    bool collectMisses(KscValueCache &cache, const PltTimeSpan &maxAge,
+                       const KscAvModule *avm_default,
+                       KscPackage &fetch, KscPackage &busy);
+    void completeMisses(KscValueCache &cache,
+                        const KscAvModule *avm_default) const;
+    bool waitForBusy(const PltTimeSpan &maxAge,
+                     const KscAvModule *avm_default);
 
     PltList<KscVariableHandle> vars;
     size_t num_vars;
@@ -107,6 +186,15 @@ protected:
 
     KS_RESULT _last_result;
 
+    // the prepared GetVar requests and the generation of the package
+    // (including its subpackages) they were set up for. Every change
+    // to a package gives it a new generation.
+    bool _prepared;
+    Request *_plan;
+    unsigned long _plan_generation;
+    unsigned long _generation;
+    static unsigned long _last_generation;
+
     //
     // class DeepIterator
     // helper class to iterate over variables contained in a package
@@ -176,7 +264,6 @@ public:
 
 protected:
     bool mergeSorters(KscSorter &, KscSorter &);
-    bool doSimpleExchange(KscBucketHandle, KscBucketHandle);
 
     KscPackageHandle get_pkg,
                      set_pkg;
@@ -223,12 +310,33 @@ KscPackage::getLastResult() const
 
 //////////////////////////////////////////////////////////////////////
 
+inline
+bool
+KscPackage::isPrepared() const
+{
+    return _prepared;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+inline
+void
+KscPackage::touch()
+{
+    _generation = ++_last_generation;
+}
+
+//////////////////////////////////////////////////////////////////////
+
 inline
 void
 KscPackage::setAvModule(const KscAvModule *avm)
 {
     // don't delete old AvModule
-    av_module = avm;
+    if ( avm != av_module ) {
+        av_module = avm;
+        touch();
+    }
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -0,0 +1,277 @@
+/* -*-plt-c++-*- */
+#ifndef KS_PROXYSERVER_INCLUDED
+#define KS_PROXYSERVER_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * proxyserver.h -- an ACPLT/KS server which mounts the namespaces of other
+ *                  ACPLT/KS servers and forwards GetVar, SetVar and GetEP
+ *                  requests for them using inter-server connections.
+ *                  As these need the connection manager, the proxy server
+ *                  is only available with the buffered XDR streams.
+ */
+
+#if PLT_USE_BUFFERED_STREAMS
+
+#include "ks/simpleserver.h"
+#include "ks/interserver.h"
+#include "plt/hashtable.h"
+
+
+class KsProxyServer;
+class KssProxyMount;
+class KssProxyRequest;
+
+
+// ---------------------------------------------------------------------------
+// A read of a particular remote variable. As long as the read is pending,
+// all client requests asking for the same variable just wait for it, so
+// concurrent identical reads go downstream only once.
+//
+struct KssProxyRead {
+    struct Waiter {
+	Waiter          *next;
+	KssProxyRequest *request;
+	size_t           index;
+    };
+
+    KssProxyRead(const KsString &p) : path(p), waiters(0), next(0) { }
+
+    KsString      path;    // path of the variable on the remote server
+    Waiter       *waiters;
+    KssProxyRead *next;    // next read in the queue or in the same call
+}; // struct KssProxyRead
+
+
+// ---------------------------------------------------------------------------
+// A SetVar or GetEP request forwarded unchanged (well, apart from the paths)
+// to the remote server.
+//
+struct KssProxyForward {
+    KssProxyForward(KssProxyRequest *r, u_long s)
+	: request(r), service(s), params(0), indices(0), next(0) { }
+    ~KssProxyForward();
+
+    KssProxyRequest *request;
+    u_long           service;
+    KsXdrAble       *params;   // downstream service parameters
+    size_t          *indices;  // SetVar: item indices in client request
+    KssProxyForward *next;
+}; // struct KssProxyForward
+
+
+// ---------------------------------------------------------------------------
+// A current value received from a remote server, which can be handed out to
+// clients until it expires.
+//
+struct KssProxyCacheEntry {
+    KsGetVarItemResult item;
+    PltTime            expires_at;
+}; // struct KssProxyCacheEntry
+
+
+// ---------------------------------------------------------------------------
+// A client request which may not be answered at once, because it needs
+// replies from remote servers first. The dispatcher itself holds one item
+// until it has worked through the request and then releases it. If there
+// are still items outstanding, the client connection stays on hold until
+// the last one has been completed, then the reply is sent.
+//
+class KssProxyRequest {
+public:
+    KssProxyRequest(KssTransport &transport, KsResult *result);
+    ~KssProxyRequest();
+
+    void addItem() { ++_outstanding; }
+    void itemDone();
+    void release(KsAvTicket &ticket);
+
+    KsResult *getResult() { return _result; }
+
+private:
+    KssProxyRequest(const KssProxyRequest &); // forbidden
+    KssProxyRequest & operator = (const KssProxyRequest &); // forbidden
+
+    KssTransport   &_transport;
+    KsAvNoneTicket  _ticket;
+    KsResult       *_result;
+    unsigned int    _outstanding;
+}; // class KssProxyRequest
+
+
+// ---------------------------------------------------------------------------
+// One of the connections to the remote server of a mount. It carries one
+// downstream call at a time: either a batch of reads or a forwarded request.
+//
+class KssProxyChannel : public KssInterKsServerConnection {
+public:
+    KssProxyChannel(KssProxyMount &mount,
+		    const KsString &host, const KsString &server);
+
+    virtual void async_attention(KssInterKsServerConnectionOperations op);
+
+    KssProxyRead    *_reads;    // reads carried by the current call
+    KssProxyForward *_forward;  // ...or the forwarded request
+
+private:
+    KssProxyMount &_mount;
+}; // class KssProxyChannel
+
+
+// ---------------------------------------------------------------------------
+// A mount makes the namespace of a remote server (or a part of it) appear
+// below a local path. It queues reads and forwarded requests for the remote
+// server and hands them out to a limited number of channels, so no matter
+// how many clients there are, there are never more downstream calls than
+// channels at the same time. Reads waiting in the queue are batched into
+// one GetVar call.
+//
+class KssProxyMount {
+public:
+    KssProxyMount(KsProxyServer &server, const KsString &localPath,
+		  const KsString &host, const KsString &serverName,
+		  const KsString &remotePath);
+    ~KssProxyMount();
+
+    bool mapPath(const KsString &localPath, KsString &remotePath) const;
+
+    bool lookup(const KsString &path, KsGetVarItemResult &item);
+    void read(const KsString &path, KssProxyRequest *request, size_t index);
+    void forward(KssProxyForward *fwd);
+    void kick();
+
+    void channelAttention(KssProxyChannel &channel,
+			  KssInterKsServerConnection::
+			  KssInterKsServerConnectionOperations op);
+
+    void shutdown();
+
+    KssProxyMount *_next;
+
+private:
+    KssProxyMount(const KssProxyMount &); // forbidden
+    KssProxyMount & operator = (const KssProxyMount &); // forbidden
+
+    bool startCall(KssProxyChannel &channel);
+    void readsDone(KssProxyRead *reads, KsGetVarResult *result,
+		   KS_RESULT error);
+    void forwardDone(KssProxyForward *fwd, KsResult *result,
+		     KS_RESULT error);
+    void failQueued(KS_RESULT error);
+    void flushCache();
+
+    KsProxyServer      &_server;
+    KsString            _local_path;
+    KsString            _host;
+    KsString            _server_name;
+    KsString            _remote_path;
+
+    KssProxyChannel   **_channels;
+    unsigned int        _channel_count;
+
+    PltHashTable<KsString, KssProxyRead *>       _reads;
+    KssProxyRead       *_queued_reads;
+    KssProxyRead       *_last_queued_read;
+    size_t              _queued_read_count;
+    KssProxyForward    *_queued_forwards;
+    KssProxyForward    *_last_queued_forward;
+
+    PltHashTable<KsString, KssProxyCacheEntry *> _cache;
+}; // class KssProxyMount
+
+
+// ---------------------------------------------------------------------------
+// The proxy server: an otherwise ordinary simple server whose namespace can
+// contain mounts of remote servers. GetVar, SetVar and GetEP requests for
+// paths below a mount are forwarded to the remote server; the replies for
+// GetVar are cached for a short time, so clients asking repeatedly for the
+// same variables are served locally. Requests which need a remote server
+// are answered only after the remote server has answered, which works with
+// TCP/IP clients using the A/V NONE scheme. Other clients only see cached
+// values (a miss fetches the value in the background for the next time),
+// anything else fails with KS_ERR_NOREMOTE.
+//
+// Like KsSimpleServer, this class is abstract. Derive from it (and from
+// KsServer, if the proxy should register with the manager).
+//
+class KsProxyServer
+: public KsSimpleServer
+{
+public:
+    KsProxyServer(int port = KS_ANYPORT);
+    virtual ~KsProxyServer();
+
+    //
+    // Mount the namespace of "server" on "host" below the path "remote"
+    // as domain "id" within domain "dompath".
+    //
+    bool mount(const KsPath &dompath, const KsString &id,
+	       const KsString &host, const KsString &server,
+	       const KsString &remote = KsString("/"));
+
+    //
+    // Control how long GetVar replies are cached (in milliseconds, zero
+    // disables the cache) and how many values are kept at most for each
+    // mount, as well as the number of channels per mount and the number
+    // of reads batched into one GetVar call.
+    //
+    void setCacheLimits(unsigned long ttl, size_t maxEntries)
+	{ _cache_ttl = ttl; _cache_max_entries = maxEntries; }
+    unsigned long getCacheTtl() const { return _cache_ttl; }
+    size_t getCacheMaxEntries() const { return _cache_max_entries; }
+
+    void setChannelLimits(unsigned int channels, size_t batch)
+	{ _max_channels = channels ? channels : 1;
+	  _max_batch = batch ? batch : 1; }
+    unsigned int getMaxChannels() const { return _max_channels; }
+    size_t getMaxBatch() const { return _max_batch; }
+
+    virtual void stopServer();
+
+protected:
+    virtual void dispatch(u_long serviceId,
+                          KssTransport &transport,
+                          XDR *incomingXdr,
+                          KsAvTicket &ticket);
+
+    KssProxyMount *findMount(const KsPath &path, KsString &remote) const;
+    void kickMounts();
+
+    void proxyGetVar(KssTransport &transport, KsAvTicket &ticket,
+		     const KsGetVarParams &params, bool canDefer);
+    void proxySetVar(KssTransport &transport, KsAvTicket &ticket,
+		     const KsSetVarParams &params, bool canDefer);
+    void proxyGetEP(KssTransport &transport, KsAvTicket &ticket,
+		    const KsGetEPParams &params, bool canDefer);
+
+private:
+    KssProxyMount *_mounts;
+    unsigned long  _cache_ttl;
+    size_t         _cache_max_entries;
+    unsigned int   _max_channels;
+    size_t         _max_batch;
+}; // class KsProxyServer
+
+
+#endif /* PLT_USE_BUFFERED_STREAMS */
+
+#endif // KS_PROXYSERVER_INCLUDED
+
+/* End of ks/proxyserver.h */
@@ -0,0 +1,126 @@
+/* -*-plt-c++-*- */
+#ifndef KS_RESOLVER_INCLUDED
+#define KS_RESOLVER_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <plt/thread.h>
+#include <plt/time.h>
+
+#include "ks/rpc.h"
+#include "ks/string.h"
+
+#if PLT_USE_GETADDRINFO && PLT_SYSTEM_NT
+#include <ws2tcpip.h>
+#endif
+
+
+// ---------------------------------------------------------------------------
+// The addresses of a host as found by the resolver. IPv6 addresses are only
+// known when the resolver uses getaddrinfo(). As our transports still speak
+// IPv4 only, most users will want pickIPv4().
+//
+class KsHostAddresses {
+public:
+    KsHostAddresses();
+
+    enum { MAX_ADDRESSES = 8 };
+
+    size_t           count;          // IPv4 addresses
+    struct in_addr   ipv4[MAX_ADDRESSES];
+#if PLT_USE_GETADDRINFO
+    size_t           count6;         // IPv6 addresses
+    struct in6_addr  ipv6[MAX_ADDRESSES];
+#endif
+
+    //
+    // Pick an IPv4 address. If the host has more than one, the address
+    // tried last time (avoid) is not picked again, so a multi-homed host
+    // isn't asked at the same address twice in a row.
+    //
+    bool pickIPv4(struct in_addr &ip, const struct in_addr &avoid) const;
+}; // class KsHostAddresses
+
+
+class KsResolverThread;
+
+// ---------------------------------------------------------------------------
+// The KsHostResolver resolves host names in the background and remembers
+// the outcome for some time, failed lookups included. Clients may simply
+// call resolve(), which blocks until the addresses are known. Event driven
+// code like the inter-server connections calls lookup() instead, which
+// never blocks but starts resolving the name in the background and asks
+// the caller to come back later. Dotted IPv4 addresses are returned at
+// once and never cached.
+//
+// The resolver is shared by all threads of a process. Without thread
+// support, lookup() has to resolve the name itself and thus blocks.
+//
+class KsHostResolver {
+public:
+    enum Status {
+	RESOLVED, // addresses are known
+	PENDING,  // still resolving, ask again later
+	FAILED    // host is unknown
+    };
+
+    static Status lookup(const KsString &host, KsHostAddresses &addrs);
+    static bool resolve(const KsString &host, KsHostAddresses &addrs);
+
+    //
+    // Control how long resolved addresses and failed lookups are
+    // remembered. Both spans are in seconds.
+    //
+    static void setLimits(unsigned long ttl, unsigned long negativeTtl);
+    static void getLimits(unsigned long &ttl, unsigned long &negativeTtl);
+    //
+    // Forget everything resolved so far.
+    //
+    static void flush();
+
+private:
+    friend class KsResolverThread;
+
+    struct Entry {
+	Entry            *next;
+	KsString          host;
+	Status            status;
+	KsHostAddresses   addrs;
+	PltTime           valid_until;
+	KsResolverThread *thread;
+    };
+
+    static Entry *find(const KsString &host);
+    static Status lookupLocked(const KsString &host, KsHostAddresses &addrs);
+    static Status check(Entry *entry, KsHostAddresses &addrs);
+    static void finish(Entry *entry, bool ok, const KsHostAddresses &addrs);
+    static bool resolveNow(const KsString &host, KsHostAddresses &addrs);
+    static bool isNumeric(const KsString &host, KsHostAddresses &addrs);
+
+    static Entry         *_entries;
+    static unsigned long  _ttl;
+    static unsigned long  _negative_ttl;
+    static PltMutex       _lock;
+    static PltCondition   _resolved;
+}; // class KsHostResolver
+
+
+#endif // KS_RESOLVER_INCLUDED
+
+/* End of ks/resolver.h */
@@ -0,0 +1,104 @@
+/* -*-plt-c++-*- */
+#ifndef KS_RINGHISTORY_INCLUDED
+#define KS_RINGHISTORY_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ks/sampledhistory.h"
+
+
+// ----------------------------------------------------------------------------
+// The KssRingHistory class is a ready-to-use history, which records the values
+// of some variables in memory. The rows are kept in a ring buffer of fixed
+// size, so the oldest rows are overwritten when the buffer is full.
+//
+// The storage is columnar: the time stamps as well as the values of each
+// variable live in separate contiguous arrays. As the rows are ordered by
+// time, time selections are resolved by a binary search and the values can
+// be copied into the reply as whole blocks.
+//
+// Raw replies are streamed using a cursor, which refers to the rows by their
+// sequence number. If the rows are overwritten before they were sent, the
+// reply is aborted.
+//
+// All variables must be tracked before the first sample is taken.
+//
+class KssRingHistory
+    : public KssSampledHistory
+{
+public:
+    KssRingHistory(const KsString &id,
+                   size_t capacity,
+                   KS_HIST_TYPE mode = KS_HT_TIME_DRIVEN,
+                   unsigned long period = 1000, // msecs
+                   KsTime ctime = KsTime::now(),
+                   KsString comment = KsString());
+    virtual ~KssRingHistory();
+
+    virtual void getHist(const KsGetHistParams &params,
+                         KsGetHistSingleResult &result);
+    virtual KssHistoryCursor *openCursor(const KsGetHistParams &params);
+
+    size_t getCapacity() const { return _capacity; }
+    size_t getCount() const { return _count; }
+
+protected:
+    friend class KssRingHistoryCursor;
+
+    virtual bool addColumn(const Track &track);
+    virtual void removeColumn(const Track &track);
+    virtual void appendRow(const PltTime &t);
+
+    //
+    // Rows are addressed by their logical index: 0 is the oldest row.
+    //
+    size_t physical(size_t row) const
+        { row += _first; return row < _capacity ? row : row - _capacity; }
+    const PltTime &timeAt(size_t row) const { return _times[physical(row)]; }
+
+    size_t lowerBound(const PltTime &t) const;
+    size_t upperBound(const PltTime &t) const;
+    void selectRows(const Selection &sel, size_t &first, size_t &last) const;
+
+    void selectBuckets(KssHistoryAggregator &agg,
+                       size_t first, size_t last) const;
+    void accumulate(KssHistoryAggregator &agg, const Track &track) const;
+
+    void copyTimes(size_t first, size_t count, KsTime *dst) const;
+    void copyValues(size_t column, size_t first, size_t count,
+                    double *dst) const;
+
+    PltTime  *_times;
+    double  **_columns;
+    size_t    _capacity;
+    size_t    _first;
+    size_t    _count;
+    size_t    _appended;   // rows appended ever (wraps around)
+
+private:
+    KssRingHistory(const KssRingHistory &); // forbidden
+    KssRingHistory & operator = (const KssRingHistory &); // forbidden
+}; // class KssRingHistory
+
+
+#endif // KS_RINGHISTORY_INCLUDED
+
+/* End of ks/ringhistory.h */
@@ -0,0 +1,163 @@
+/* -*-plt-c++-*- */
+#ifndef KS_SAMPLEDHISTORY_INCLUDED
+#define KS_SAMPLEDHISTORY_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ks/histdomain.h"
+#include "ks/event.h"
+#include "ks/histaggregator.h"
+#include "ks/histcursor.h"
+
+
+class KssSampledHistorySampleEvent;
+
+
+// ----------------------------------------------------------------------------
+// The KssSampledHistory class is the common base of the histories which
+// record the values of some variables themselves. Every sample is a row of
+// the history table: the time stamp (part "t") and the current value of each
+// variable tracked (one part per variable, values are stored as doubles).
+// Derived classes only have to store the rows and answer GetHist requests.
+//
+// A time-driven history (KS_HT_TIME_DRIVEN) takes a sample every period. A
+// change-driven one (KS_HT_CHANGE_DRIVEN) checks the variables every period,
+// but only takes a sample if at least one of them has changed. In both cases
+// samples can also be taken explicitly using sample() or record().
+//
+// Besides the raw rows, the minimum, maximum, mean or last value per bucket
+// of time can be requested using the interpolation modes KS_IPM_MIN,
+// KS_IPM_MAX, KS_IPM_LINEAR or KS_IPM_HOLD of the time selector. Clients
+// setting the KS_IPM_ENCODED flag get the parts as compressed byte vectors.
+// Large raw replies can be streamed using a cursor (see ks/histcursor.h).
+//
+class KssSampledHistory
+    : public KssHistoryDomain
+{
+public:
+    KssSampledHistory(const KsString &id,
+                      KS_HIST_TYPE mode,
+                      unsigned long period, // msecs
+                      KsTime ctime = KsTime::now(),
+                      KsString comment = KsString());
+    virtual ~KssSampledHistory();
+
+    //
+    // Record the value of a variable as part "part". Only numeric values
+    // can be recorded. Whether variables can still be added once samples
+    // have been taken depends on the derived class.
+    //
+    bool trackVariable(const KsString &part,
+                       const KssCommObjectHandle &var,
+                       const KsString &comment = KsString());
+
+    //
+    // Start or stop taking samples every period.
+    //
+    bool startSampling();
+    void stopSampling();
+
+    //
+    // Take a sample now, if it's time-driven or some value has changed. A
+    // sample forced using record() is always taken.
+    //
+    bool sample(const KsTime &t = KsTime::now());
+    void record(const KsTime &t = KsTime::now());
+
+    virtual KS_SEMANTIC_FLAGS getSemanticFlags() const { return 0; }
+
+    unsigned long getPeriod() const { return _period; }
+    size_t getTrackCount() const { return _track_count; }
+
+protected:
+    struct Track {
+        Track               *next;
+        size_t               index;   // column number, starting with 0
+        KsString             part;
+        KssCommObjectHandle  var;
+        double               last;    // value of the latest row
+    };
+
+    //
+    // Make room for another column. Returns false if the history can't
+    // take any more variables.
+    //
+    virtual bool addColumn(const Track &track) = 0;
+    //
+    // Free the column just added for a track which couldn't be set up
+    // after all.
+    //
+    virtual void removeColumn(const Track &track) = 0;
+    //
+    // Store a new row: the time stamp given and the value "last" of every
+    // track.
+    //
+    virtual void appendRow(const PltTime &t) = 0;
+
+    Track *findTrack(const KsString &part) const;
+
+    //
+    // What a GetHist request asks for, taken from its time selector. Only
+    // the time part may have a (time) selector; relative times are relative
+    // to now. "selected" is false if there is no time selector, so all rows
+    // are requested. "ipm" is KS_IPM_NONE if raw rows are requested,
+    // otherwise the rows are to be aggregated into buckets of width "delta"
+    // (see KssHistoryAggregator). "encoded" is true if the client accepts
+    // the parts compressed (KS_IPM_ENCODED, see ks/histcodec.h).
+    //
+    struct Selection {
+        bool                  selected;
+        PltTime               from;
+        PltTime               to;
+        KS_INTERPOLATION_MODE ipm;
+        PltTimeSpan           delta;
+        bool                  encoded;
+    };
+
+    KS_RESULT getSelection(const KsGetHistParams &params,
+                           Selection &sel) const;
+    //
+    // Compress the time and double vectors of a GetHist reply.
+    //
+    static void encodeItems(KsArray<KsGetHistResultItem> &items);
+    //
+    // Set up the items of a cursor for a GetHist request with "rows" rows.
+    //
+    bool initCursor(KssHistoryCursor &cursor,
+                    const KsGetHistParams &params, size_t rows) const;
+
+    static bool getNumber(const KssCommObjectHandle &var, double &value);
+
+    Track                        *_tracks;
+    size_t                        _track_count;
+    unsigned long                 _period;
+    bool                          _recorded;  // any row since startup?
+    KssSampledHistorySampleEvent *_event;
+
+private:
+    KssSampledHistory(const KssSampledHistory &); // forbidden
+    KssSampledHistory & operator = (const KssSampledHistory &); // forbidden
+}; // class KssSampledHistory
+
+
+#endif // KS_SAMPLEDHISTORY_INCLUDED
+
+/* End of ks/sampledhistory.h */
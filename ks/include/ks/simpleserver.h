@@ -57,10 +57,21 @@ public:
     virtual void getEP(KsAvTicket &ticket, 
                        const KsGetEPParams & params,
                        KsGetEPResult & result);
+    virtual void getHist(KsAvTicket &ticket,
+                         const KsGetHistParams &params,
+                         KsGetHistResult &result);
+    virtual void getHistStreamed(KsAvTicket &ticket,
+                                 const KsGetHistParams &params,
+                                 KssGetHistStreamResult &result);
 
 protected:
     KssSimpleDomain _root_domain;
 
+    KS_RESULT getHistories(KsAvTicket &ticket,
+                           const KsGetHistParams &params,
+                           KsGetHistSingleResult *replies,
+                           KssGetHistStreamResult *stream);
+
     virtual void getVarItem(KsAvTicket &ticket,
                             const KsPath & path,
                             KsGetVarItemResult &result);
@@ -192,7 +192,7 @@ KscSortVarPtr::operator < (const KscSortVarPtr &other) const
 {
     PLT_PRECONDITION(p && other.p);
 
-    return p->getPathAndName() < other.p->getPathAndName();
+    return p->getPathHandle() < other.p->getPathHandle();
 }
 
 //////////////////////////////////////////////////////////////////////
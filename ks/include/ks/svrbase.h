@@ -26,11 +26,14 @@
 #include "ks/event.h"
 #if !PLT_SERVER_TRUNC_ONLY
 #include "ks/serviceparams.h"
+#include "ks/histparams.h"
 #endif
 #include "plt/comparable.h"
 #include "plt/priorityqueue.h"
 #include "ks/svrtransport.h"
 
+class KssGetHistStreamResult;
+
 #include <signal.h>
 
 // This is currently missing in Cygnus' headers...
@@ -118,6 +121,17 @@ public:
     virtual void exgData(KsAvTicket &ticket,
                          const KsExgDataParams &params,
                          KsExgDataResult &result);
+
+    virtual void getHist(KsAvTicket &ticket,
+                         const KsGetHistParams &params,
+                         KsGetHistResult &result);
+    //
+    // GetHist for transports able to stream the reply. Replies may come
+    // from history cursors then; by default, getHist() is used.
+    //
+    virtual void getHistStreamed(KsAvTicket &ticket,
+                                 const KsGetHistParams &params,
+                                 KssGetHistStreamResult &result);
 #endif
 
 #if PLT_USE_BUFFERED_STREAMS
@@ -129,6 +143,13 @@ public:
     	{ _receive_buffer_size = rxBuffSize;
           _send_buffer_size = txBuffSize; }
 
+#if PLT_USE_BUFFERED_STREAMS
+    // per-connection memory quotas for TCP transports, 0 = unlimited
+    inline void setTransportQuotas(u_long rxQuota, u_long txQuota)
+	{ _receive_quota = rxQuota;
+	  _send_quota = txQuota; }
+#endif
+
 
     void dispatchTransport(KssTransport &transp);
 
@@ -185,6 +206,10 @@ private:
 
     int _send_buffer_size;
     int _receive_buffer_size;
+#if PLT_USE_BUFFERED_STREAMS
+    u_long _send_quota;
+    u_long _receive_quota;
+#endif
 
     int serveRequests(const KsTime *pTimeout);
     
@@ -43,6 +43,9 @@
 #include "ks/path.h"
 #include "ks/mask.h"
 #include "ks/props.h"
+#include "ks/histparams.h"
+
+class KssHistoryCursor;
 
 
 // ----------------------------------------------------------------------------
@@ -287,6 +290,70 @@ public:
 }; // class KssVariable
 
 
+// ----------------------------------------------------------------------------
+// class KssEncodedVarCurrProps: the current properties of a variable together
+// with their XDR representation. The properties are serialized only once
+// when the object is created, and then these bytes are just copied into
+// every reply carrying the properties. If the encoded form would exceed
+// maxEncodedSize bytes, the object behaves like plain KsVarCurrProps.
+// Such an object must not be changed after creation.
+//
+class KssEncodedVarCurrProps
+: public KsVarCurrProps
+{
+public:
+    KssEncodedVarCurrProps(KsValueHandle v, const KsTime &t, KS_STATE s,
+                           u_int maxEncodedSize);
+    ~KssEncodedVarCurrProps();
+
+    bool  isEncoded() const { return _encoded != 0; }
+    u_int getEncodedSize() const { return _encoded_size; }
+
+protected:
+    bool xdrEncodeVariant(XDR *) const;
+
+private:
+    KssEncodedVarCurrProps(const KssEncodedVarCurrProps &); // forbidden
+    KssEncodedVarCurrProps &
+        operator = (const KssEncodedVarCurrProps &); // forbidden
+
+    char  *_encoded;
+    u_int  _encoded_size;
+
+    PLT_DECL_RTTI;
+}; // class KssEncodedVarCurrProps
+
+
+// ----------------------------------------------------------------------------
+// class KssCurrPropsCache: keeps the pre-encoded current properties of a
+// variable until they change. A variable implementation opts in by
+// embedding a cache, returning getCurrProps(*this) from its own getCurrProps
+// and calling invalidate() whenever its value, timestamp or state changes.
+// Replies still referencing older properties keep them alive through their
+// handles, so invalidating never affects replies in progress. The version
+// counts the invalidations, so others can tell whether the properties
+// have changed since they last looked.
+//
+class KssCurrPropsCache
+{
+public:
+    KssCurrPropsCache() : _version(0) { }
+
+    KsCurrPropsHandle getCurrProps(const KssVariable &var) const;
+    void invalidate() { _hprops = KsCurrPropsHandle(); ++_version; }
+    u_long getVersion() const { return _version; }
+
+    static void  setMaxEncodedSize(u_int size) { _max_encoded_size = size; }
+    static u_int getMaxEncodedSize() { return _max_encoded_size; }
+
+private:
+    mutable KsCurrPropsHandle _hprops;
+    u_long                    _version;
+
+    static u_int _max_encoded_size;
+}; // class KssCurrPropsCache
+
+
 // ----------------------------------------------------------------------------
 // class KssLink: ACPLT/KS links can be references to other communication
 // objects with either local scope (naming scope) or global scope (within the
@@ -387,6 +454,15 @@ public:
     virtual KS_INTERPOLATION_MODE getSupportedInterpolations() const = 0;
     virtual KsString              getTypeIdentifier() const = 0;
 
+    //// modifiers
+    //   service
+    virtual void getHist(const KsGetHistParams &params,
+                         KsGetHistSingleResult &result) = 0;
+    // Open a cursor for streaming the reply (see ks/histcursor.h). Returns
+    // 0 if the reply is to be built by getHist() instead (the default).
+    virtual KssHistoryCursor *openCursor(const KsGetHistParams &)
+        { return 0; }
+
     PLT_DECL_RTTI;
 }; // class KssHistory
 
@@ -221,6 +221,8 @@ public:
     virtual KsTime        getTime() const;
     virtual KS_STATE      getState() const;
 
+    virtual KsCurrPropsHandle getCurrProps() const;
+
     //// modifiers
     //   projected properties
     void setTechUnit(const KsString &);
@@ -247,6 +249,11 @@ public:
     //// modifier
     void lock();
     void unlock();
+    // Call this after changing the value object in place, without
+    // going through setValue(). Subclasses computing their value in
+    // getValue() or getTime() must override getCurrProps() instead and
+    // return KssVariable::getCurrProps(), which isn't cached.
+    void currPropsChanged() { _curr_props.invalidate(); }
 
 private:
     KS_ACCESS     _access_mode;
@@ -254,6 +261,7 @@ private:
     KsValueHandle _value;
     KsTime        _time;
     KS_STATE      _state;
+    KssCurrPropsCache _curr_props;
     PLT_DECL_RTTI;
 };
 
@@ -518,6 +526,14 @@ KssSimpleVariable::getState() const
     return _state;
 }
 
+//////////////////////////////////////////////////////////////////////
+
+inline KsCurrPropsHandle
+KssSimpleVariable::getCurrProps() const
+{
+    return _curr_props.getCurrProps(*this);
+}
+
 
 //////////////////////////////////////////////////////////////////////
 
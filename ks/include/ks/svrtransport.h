@@ -38,6 +38,30 @@
 #include "ks/avticket.h"
 #include "ks/result.h"
 
+
+// ---------------------------------------------------------------------------
+// A service result which can be serialized piece by piece, so a transport
+// can send a large reply as a sequence of RPC record fragments instead of
+// building it completely in memory first. The result is expected to
+// produce its data only when asked for the next piece.
+//
+// xdrEncodeNext() serializes roughly "budget" bytes (at least some progress
+// is always made) and sets "done" when the result is complete. Serializing
+// the result using xdrEncode() produces it in one go, which is what all
+// transports not capable of streaming do.
+//
+class KssStreamedResult
+    : public KsResult
+{
+public:
+    KssStreamedResult(KS_RESULT res = KS_ERR_OK) : KsResult(res) { }
+
+    virtual bool xdrEncodeNext(XDR *xdr, size_t budget, bool &done) = 0;
+
+    bool xdrEncode(XDR *xdr) const;
+    bool xdrDecode(XDR *) { return false; }
+}; // class KssStreamedResult
+
 #if !PLT_USE_BUFFERED_STREAMS
 
 // ---------------------------------------------------------------------------
@@ -75,6 +99,12 @@ public:
     void       sendErrorReply(KsAvTicket &avt, KS_RESULT error);
     void       sendReply(KsAvTicket &avt, KsResult &result);
     //
+    // The ONC/RPC package can't stream replies, so a streamed result is
+    // sent as a whole. The transport takes over the result object.
+    //
+    bool       canStreamReply() const { return false; }
+    void       sendStreamedReply(KsAvTicket &avt, KssStreamedResult *result);
+    //
     // Get the peer's IP address.
     //
     sockaddr  *getPeerAddress(int &namelen);
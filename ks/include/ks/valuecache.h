@@ -0,0 +1,141 @@
+/* -*-plt-c++-*- */
+#ifndef KSC_VALUECACHE_INCLUDED
+#define KSC_VALUECACHE_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+
+#include <plt/thread.h>
+#include <plt/time.h>
+
+#include "ks/props.h"
+#include "ks/avmodule.h"
+
+//////////////////////////////////////////////////////////////////////
+// class KscValueCache
+//   remembers the current properties of variables read recently, so
+//   parts of an application reading the same variables shortly after
+//   each other don't need a round trip every time. The cache is opt-in:
+//   install it with KscClient::setValueCache() and then read with
+//   KscVariable::getUpdate(maxAge) or KscPackage::getUpdate(maxAge).
+//   Variables are identified by their full path ("//host/server/path")
+//   together with the A/V module they are read with, as the server may
+//   well answer differently depending on who is asking.
+//
+//   Values are kept XDR encoded, so no handles are shared between the
+//   threads using the cache. At most maxEntries values are kept, and
+//   none of them longer than maxAge; the oldest ones are dropped first.
+//
+//   A lookup which misses makes the caller responsible for fetching
+//   the value, until it calls complete(). Others asking for the same
+//   variable in the meantime are told the value is being fetched and
+//   can wait() for it instead of sending a request of their own.
+//
+class KscValueCache
+{
+public:
+    KscValueCache(size_t buckets = 1021,
+                  size_t maxEntries = 4096,
+                  const PltTimeSpan &maxAge = PltTimeSpan(300));
+    ~KscValueCache();
+
+    void setLimits(size_t maxEntries, const PltTimeSpan &maxAge);
+    void getLimits(size_t &maxEntries, PltTimeSpan &maxAge) const;
+
+    enum Status {
+        FRESH,    // the value was fresh enough
+        FETCH,    // the caller has to fetch the value and complete()
+        BUSY      // someone else is fetching the value, so wait()
+    };
+
+    Status lookup(const KscAvModule *avm, const KsString &key,
+                  const PltTimeSpan &maxAge, KsVarCurrProps &props);
+    Status wait(const KscAvModule *avm, const KsString &key,
+                const PltTimeSpan &maxAge, KsVarCurrProps &props);
+    //
+    // End a fetch. Pass a null pointer if it failed or if the value
+    // has already been store()d.
+    //
+    void complete(const KscAvModule *avm, const KsString &key,
+                  const KsVarCurrProps *props);
+
+    //
+    // Remember a value read without asking the cache first, or forget
+    // a value because the variable has been written. The latter drops
+    // the value for all A/V modules.
+    //
+    void store(const KscAvModule *avm, const KsString &key,
+               const KsVarCurrProps &props);
+    void invalidate(const KsString &key);
+    void clear();
+
+    struct Statistics {
+        unsigned long hits;         // fresh values found
+        unsigned long misses;       // values which had to be fetched
+        unsigned long coalesced;    // values fetched by someone else
+        unsigned long stores;       // values put into the cache
+        unsigned long invalidations;
+        unsigned long evictions;    // values dropped to meet the limits
+    };
+    void getStatistics(Statistics &stats) const;
+    void resetStatistics();
+
+protected:
+    struct Entry {
+        Entry              *next;   // next entry in the same bucket
+        Entry              *older;  // entries with values, oldest first
+        Entry              *newer;
+        const KscAvModule  *avm;
+        KsString            key;
+        PltTime             time;   // when the value has been stored
+        char               *encoded; // the value, or 0 if there is none
+        u_int               encoded_size;
+        bool                fetching; // somebody fetches the value
+    };
+
+    Entry *find(const KscAvModule *avm, const KsString &key);
+    Entry *create(const KscAvModule *avm, const KsString &key);
+    void remove(Entry *entry);
+    void trim();
+    bool isFresh(const Entry &entry, const PltTimeSpan &maxAge) const;
+    bool decode(const Entry &entry, KsVarCurrProps &props) const;
+    void setValue(Entry &entry, const KsVarCurrProps *props);
+
+    Entry            **_buckets;
+    size_t             _bucket_count;
+    Entry             *_oldest;
+    Entry             *_newest;
+    size_t             _value_count;
+    size_t             _max_entries;
+    PltTimeSpan        _max_age;
+    mutable PltMutex   _mutex;
+    PltCondition       _fetched;
+    Statistics         _stats;
+
+private:
+    KscValueCache(const KscValueCache &); // forbidden
+    KscValueCache &operator = (const KscValueCache &); // forbidden
+};
+
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// EOF valuecache.h
+//////////////////////////////////////////////////////////////////////
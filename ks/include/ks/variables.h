@@ -53,6 +53,7 @@ public:
     bool getEngPropsUpdate();
     // may fail due to type error
     bool getUpdate();
+    bool getUpdate(const PltTimeSpan &maxAge);
     // may fail due to type error
     bool setCurrProps(KsVarCurrProps &cp);
 
@@ -46,6 +46,12 @@ bool_t xdrmemstream_create(XDR *xdrs);
 void   xdrmemstream_clear(XDR *xdrs);
 void   xdrmemstream_rewind(XDR *xdrs, enum xdr_op op);
 
+/*
+ * Per-stream memory limits: a limit of zero means unlimited.
+ */
+void   xdrmemstream_set_limit(XDR *xdrs, u_int limit);
+bool_t xdrmemstream_over_limit(XDR *xdrs);
+
 /*
  * External I/O for filling and draining XDR dynamic memory streams.
  */
@@ -74,6 +80,22 @@ bool_t xdrmemstream_controlusage(u_int fragmentsize, u_int quota,
 	                         u_int watermark, u_int freepercentage);
 void   xdrmemstream_freegarbage();
 
+/*
+ * Fragments are recycled through per-thread caches which spill over into
+ * a shared pool. These functions report the figures of the individual
+ * thread caches, and give the cache of the current thread back to the
+ * shared pool (done automatically on thread exit with POSIX threads).
+ */
+typedef struct {
+    bool_t         current;   /* TRUE for the calling thread          */
+    u_int          freepool;  /* bytes cached by this thread          */
+    unsigned long  allocated; /* # of fragments taken by this thread  */
+    unsigned long  released;  /* # of fragments given back            */
+} xdrmemstream_thread_usage;
+void   xdrmemstream_getthreadusage(xdrmemstream_thread_usage *desc,
+                                   unsigned long *thread_count);
+void   xdrmemstream_thread_exit();
+
 #ifdef __cplusplus
 }
 #endif
@@ -43,6 +43,12 @@ public:
         
     virtual ConnectionIoMode getIoMode() const;
 
+    //
+    // Memory quotas handed down to every connection accepted from now on.
+    //
+    void setQuotas(u_long receiveQuota, u_long sendQuota)
+	{ _receive_quota = receiveQuota; _send_quota = sendQuota; }
+
     virtual void sendPingReply();
     virtual void sendErrorReply(KsAvTicket &avt, KS_RESULT error);
     virtual void sendReply(KsAvTicket &avt, KsResult &result);
@@ -58,6 +64,9 @@ protected:
     virtual ConnectionIoMode timedOut();
     virtual ConnectionIoMode reset();
 
+    u_long _receive_quota;
+    u_long _send_quota;
+
 private:
     KssListenTCPXDRConnection(KssListenTCPXDRConnection &); // forbidden
 }; // class KssListenTCPXDRConnection
@@ -66,14 +75,42 @@ private:
 // ---------------------------------------------------------------------------
 // A real TCP connection to communicate with clients.
 //
+// Each connection can be limited in how much memory it may tie up: the
+// receive quota limits the size of an incomming RPC telegramme and the send
+// quota limits the size of the encoded reply (or request). A connection
+// exceeding one of its quotas is dropped. As a server connection doesn't
+// read from its socket while it still has unsent reply data, a client which
+// doesn't read its replies can't make the server buffer any more requests
+// from it; they are left in the socket buffers instead. A quota of zero
+// means unlimited.
+//
+// Streamed replies are sent as a sequence of RPC record fragments of about
+// the fragment size each. The next fragment is only serialized after the
+// previous one has been written to the socket, so a large reply never ties
+// up more than one fragment of memory. In this case the send quota limits
+// the size of a fragment, not the size of the whole reply.
+//
+#define KSS_STREAM_FRAGMENT_SIZE 65536
+#define KSS_STREAM_TRAILER_SIZE  64
+
 class KssTCPXDRConnection : public KssXDRConnection {
 public:
     KssTCPXDRConnection(int fd, unsigned long timeout,
 	                struct sockaddr_in &clientAddr, int clientAddrLen,
 	                ConnectionType type);
+    virtual ~KssTCPXDRConnection();
         
     virtual ConnectionIoMode getIoMode() const;
 
+    void setQuotas(u_long receiveQuota, u_long sendQuota)
+	{ _receive_quota = receiveQuota; _send_quota = sendQuota; }
+    u_long getReceiveQuota() const { return _receive_quota; }
+    u_long getSendQuota() const { return _send_quota; }
+
+    void setFragmentSize(u_long size)
+	{ _fragment_size = size ? size : KSS_STREAM_FRAGMENT_SIZE; }
+    u_long getFragmentSize() const { return _fragment_size; }
+
     virtual void sendPingReply();
     virtual void sendErrorReply(KsAvTicket &avt, KS_RESULT error);
     virtual void sendReply(KsAvTicket &avt, KsResult &result);
@@ -83,6 +120,12 @@ public:
 			      u_long prog_version, u_long proc_number);
     virtual void sendRequest();
 
+    virtual bool canDeferReply() const { return true; }
+
+    virtual bool canStreamReply() const { return true; }
+    virtual void sendStreamedReply(KsAvTicket &avt,
+				   KssStreamedResult *result);
+
 protected:
     virtual ConnectionIoMode receive();
     virtual ConnectionIoMode send();
@@ -91,7 +134,13 @@ protected:
 
     virtual void freeStreamMemory();
 
-    ConnectionIoMode enterSendingState();
+    void beginReply();
+    void replyFailed();
+    ConnectionIoMode enterSendingState(bool lastFragment = true);
+    ConnectionIoMode dropOverQuota();
+    bool encodeStreamFragment();
+    ConnectionIoMode nextStreamFragment();
+    void dropStream();
     
     enum FragmentState { FRAGMENT_HEADER, FRAGMENT_BODY };
     
@@ -100,6 +149,13 @@ protected:
     u_long            _remaining_len;
     char              _fragment_header[4];
     char             *_ptr;
+    u_long            _record_len;    // length of telegramme received so far
+    u_long            _receive_quota;
+    u_long            _send_quota;
+    u_long            _fragment_size;
+    KssStreamedResult *_stream;       // streamed reply still being sent
+    char              _stream_trailer[KSS_STREAM_TRAILER_SIZE];
+    u_int             _stream_trailer_len;
     
 private:
     KssTCPXDRConnection(KssTCPXDRConnection &); // forbidden
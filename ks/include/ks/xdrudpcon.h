@@ -51,6 +51,12 @@ public:
     virtual void sendErrorReply(KsAvTicket &avt, KS_RESULT error);
     virtual void sendReply(KsAvTicket &avt, KsResult &result);
     virtual void personaNonGrata();
+    //
+    // Send back a reply datagram which has already been encoded in full,
+    // RPC header included. Only the transaction ID of the current request
+    // is patched into the first four bytes of the copy that gets sent.
+    //
+    void sendEncodedReply(const char *reply, u_int len);
 
     virtual bool beginRequest(u_long xid, u_long prog_number,
 			      u_long prog_version, u_long proc_number);
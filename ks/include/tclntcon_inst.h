@@ -0,0 +1,89 @@
+template class KsArray<KsGetHistItem>;
+template class KsArray<KsGetHistResultItem>;
+template class KsArray<KsGetHistSingleResult>;
+template class KsPtrHandle<KsSelector>;
+template class PltArray<KsGetHistItem>;
+template class PltArray<KsGetHistResultItem>;
+template class PltArray<KsGetHistSingleResult>;
+template class PltArrayHandle<KsGetHistItem>;
+template class PltArrayHandle<KsGetHistResultItem>;
+template class PltArrayHandle<KsGetHistSingleResult>;
+template class PltArrayIterator<KsGetHistItem>;
+template class PltArrayIterator<KsGetHistResultItem>;
+template class PltArrayIterator<KsGetHistSingleResult>;
+template class PltArrayed<KsGetHistItem>;
+template class PltArrayed<KsGetHistResultItem>;
+template class PltArrayed<KsGetHistSingleResult>;
+template class PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)>;
+template class PltAssoc<KsString, KscServerBase *>;
+template class PltAssoc<KsString, unsigned long>;
+template class PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>>;
+template class PltBidirIterator<KsGetHistItem>;
+template class PltBidirIterator<KsGetHistResultItem>;
+template class PltBidirIterator<KsGetHistSingleResult>;
+template class PltContainer<KsGetHistItem>;
+template class PltContainer<KsGetHistResultItem>;
+template class PltContainer<KsGetHistSingleResult>;
+template class PltContainer<PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)> >;
+template class PltContainer<PltAssoc<KsString, KscServerBase *> >;
+template class PltContainer<PltAssoc<KsString, unsigned long> >;
+template class PltContainer<PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>> >;
+template class PltContainer<PltPtrComparable<KsTimerEvent> >;
+template class PltContainer_<KsGetHistItem>;
+template class PltContainer_<KsGetHistResultItem>;
+template class PltContainer_<KsGetHistSingleResult>;
+template class PltContainer_<PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)> >;
+template class PltContainer_<PltAssoc<KsString, KscServerBase *> >;
+template class PltContainer_<PltAssoc<KsString, unsigned long> >;
+template class PltContainer_<PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>> >;
+template class PltContainer_<PltPtrComparable<KsTimerEvent> >;
+template class PltDictionary<KsAuthType, KsAvTicket *(*)(XDR *)>;
+template class PltDictionary<KsString, KscServerBase *>;
+template class PltDictionary<KsString, unsigned long>;
+template class PltDictionary<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>>;
+template class PltHandle<KsGetHistItem>;
+template class PltHandle<KsGetHistResultItem>;
+template class PltHandle<KsGetHistSingleResult>;
+template class PltHandle<KsSelector>;
+template class PltHandle<KscNegotiator>;
+template class PltHashIterator<KsAuthType, KsAvTicket *(*)(XDR *)>;
+template class PltHashIterator<KsString, KscServerBase *>;
+template class PltHashIterator<KsString, unsigned long>;
+template class PltHashIterator<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>>;
+template class PltHashTable<KsAuthType, KsAvTicket *(*)(XDR *)>;
+template class PltHashTable<KsString, KscServerBase *>;
+template class PltHashTable<KsString, unsigned long>;
+template class PltHashTable<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>>;
+template class PltHashTable_<KsAuthType, KsAvTicket *(*)(XDR *)>;
+template class PltHashTable_<KsString, KscServerBase *>;
+template class PltHashTable_<KsString, unsigned long>;
+template class PltHashTable_<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>>;
+template class PltIterator<KsGetHistItem>;
+template class PltIterator<KsGetHistResultItem>;
+template class PltIterator<KsGetHistSingleResult>;
+template class PltIterator<PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)> >;
+template class PltIterator<PltAssoc<KsString, KscServerBase *> >;
+template class PltIterator<PltAssoc<KsString, unsigned long> >;
+template class PltIterator<PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>> >;
+template class PltIterator<PltPtrComparable<KsTimerEvent> >;
+template class PltIterator_<KsGetHistItem>;
+template class PltIterator_<KsGetHistResultItem>;
+template class PltIterator_<KsGetHistSingleResult>;
+template class PltIterator_<PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)> >;
+template class PltIterator_<PltAssoc<KsString, KscServerBase *> >;
+template class PltIterator_<PltAssoc<KsString, unsigned long> >;
+template class PltIterator_<PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator>> >;
+template class PltIterator_<PltPtrComparable<KsTimerEvent> >;
+template class PltKeyPlainConstPtr<KscAvModule>;
+template class PltPQIterator<PltPtrComparable<KsTimerEvent> >;
+template class PltPriorityQueue<PltPtrComparable<KsTimerEvent> >;
+template class PltPtrComparable<KsTimerEvent>;
+template class PltPtrHandle<KsSelector>;
+template class PltPtrHandle<KscNegotiator>;
+template class Plt_AtArrayNew<KsGetHistItem>;
+template class Plt_AtArrayNew<KsGetHistResultItem>;
+template class Plt_AtArrayNew<KsGetHistSingleResult>;
+template class Plt_AtArrayNew<KsSelector>;
+template class Plt_AtArrayNew<KscNegotiator>;
+template class Plt_AtNew<KsSelector>;
+template class Plt_AtNew<KscNegotiator>;
@@ -1,18 +1,22 @@
 template class PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)>;
 template class PltAssoc<KsString, PltPtrHandle<KssCommObject> >;
 template class PltAssoc<PltKeyPtr<KsServerDesc>, KsmServer *>;
+template class PltAssoc<KsString, KsmServer *>;
 template class PltContainer<PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)> >;
 template class PltContainer<PltAssoc<KsString, PltPtrHandle<KssCommObject> > >;
 template class PltContainer<PltAssoc<PltKeyPtr<KsServerDesc>, KsmServer *> >;
+template class PltContainer<PltAssoc<KsString, KsmServer *> >;
 template class PltContainer<PltPtrComparable<KsTimerEvent> >;
 template class PltContainer_<KssCommObject>;
 template class PltContainer_<PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)> >;
 template class PltContainer_<PltAssoc<KsString, PltPtrHandle<KssCommObject> > >;
 template class PltContainer_<PltAssoc<PltKeyPtr<KsServerDesc>, KsmServer *> >;
+template class PltContainer_<PltAssoc<KsString, KsmServer *> >;
 template class PltContainer_<PltPtrComparable<KsTimerEvent> >;
 template class PltDictionary<KsAuthType, KsAvTicket *(*)(XDR *)>;
 template class PltDictionary<KsString, PltPtrHandle<KssCommObject> >;
 template class PltDictionary<PltKeyPtr<KsServerDesc>, KsmServer *>;
+template class PltDictionary<KsString, KsmServer *>;
 template class PltHandle<KssCommObject>;
 template class PltHandle<KssDomain>;
 template class PltHandle<PltHandleIterator<KssCommObject> >;
@@ -21,20 +25,25 @@ template class PltHandleIterator<KssCommObject>;
 template class PltHashIterator<KsAuthType, KsAvTicket *(*)(XDR *)>;
 template class PltHashIterator<KsString, PltPtrHandle<KssCommObject> >;
 template class PltHashIterator<PltKeyPtr<KsServerDesc>, KsmServer *>;
+template class PltHashIterator<KsString, KsmServer *>;
 template class PltHashTable<KsAuthType, KsAvTicket *(*)(XDR *)>;
 template class PltHashTable<KsString, PltPtrHandle<KssCommObject> >;
 template class PltHashTable<PltKeyPtr<KsServerDesc>, KsmServer *>;
+template class PltHashTable<KsString, KsmServer *>;
 template class PltHashTable_<KsAuthType, KsAvTicket *(*)(XDR *)>;
 template class PltHashTable_<KsString, PltPtrHandle<KssCommObject> >;
 template class PltHashTable_<PltKeyPtr<KsServerDesc>, KsmServer *>;
+template class PltHashTable_<KsString, KsmServer *>;
 template class PltIterator<PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)> >;
 template class PltIterator<PltAssoc<KsString, PltPtrHandle<KssCommObject> > >;
 template class PltIterator<PltAssoc<PltKeyPtr<KsServerDesc>, KsmServer *> >;
+template class PltIterator<PltAssoc<KsString, KsmServer *> >;
 template class PltIterator<PltPtrComparable<KsTimerEvent> >;
 template class PltIterator_<KssCommObject>;
 template class PltIterator_<PltAssoc<KsAuthType, KsAvTicket *(*)(XDR *)> >;
 template class PltIterator_<PltAssoc<KsString, PltPtrHandle<KssCommObject> > >;
 template class PltIterator_<PltAssoc<PltKeyPtr<KsServerDesc>, KsmServer *> >;
+template class PltIterator_<PltAssoc<KsString, KsmServer *> >;
 template class PltIterator_<PltPtrComparable<KsTimerEvent> >;
 template class PltKeyPtr<KsServerDesc>;
 template class PltPQIterator<PltPtrComparable<KsTimerEvent> >;
@@ -0,0 +1,87 @@
+template class PltArray<KscSortVarPtr>;
+template class PltArrayHandle<KscSortVarPtr>;
+template class PltArrayIterator<KscSortVarPtr>;
+template class PltArrayed<KscSortVarPtr>;
+template class PltAssoc<KsString, KscServerBase *>;
+template class PltAssoc<KsString, unsigned long>;
+template class PltAssoc<KscSorter::Key, PltPtrHandle<KscSorterBucket> >;
+template class PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> >;
+template class PltBidirIterator<KscSortVarPtr>;
+template class PltBidirIterator<PltPtrHandle<KscPackage> >;
+template class PltBidirIterator<PltPtrHandle<KscVariable> >;
+template class PltContainer<KscSortVarPtr>;
+template class PltContainer<PltAssoc<KsString, KscServerBase *> >;
+template class PltContainer<PltAssoc<KsString, unsigned long> >;
+template class PltContainer<PltAssoc<KscSorter::Key, PltPtrHandle<KscSorterBucket> > >;
+template class PltContainer<PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> > >;
+template class PltContainer<PltPtrHandle<KscPackage> >;
+template class PltContainer<PltPtrHandle<KscVariable> >;
+template class PltContainer_<KscSortVarPtr>;
+template class PltContainer_<PltAssoc<KsString, KscServerBase *> >;
+template class PltContainer_<PltAssoc<KsString, unsigned long> >;
+template class PltContainer_<PltAssoc<KscSorter::Key, PltPtrHandle<KscSorterBucket> > >;
+template class PltContainer_<PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> > >;
+template class PltContainer_<PltPtrHandle<KscPackage> >;
+template class PltContainer_<PltPtrHandle<KscVariable> >;
+template class PltDictionary<KsString, KscServerBase *>;
+template class PltDictionary<KsString, unsigned long>;
+template class PltDictionary<KscSorter::Key, PltPtrHandle<KscSorterBucket> >;
+template class PltDictionary<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> >;
+template class PltHandle<KscNegotiator>;
+template class PltHandle<KscPackage>;
+template class PltHandle<KscSortVarPtr>;
+template class PltHandle<KscSorterBucket>;
+template class PltHandle<KscVariable>;
+template class PltHashIterator<KsString, KscServerBase *>;
+template class PltHashIterator<KsString, unsigned long>;
+template class PltHashIterator<KscSorter::Key, PltPtrHandle<KscSorterBucket> >;
+template class PltHashIterator<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> >;
+template class PltHashTable<KsString, KscServerBase *>;
+template class PltHashTable<KsString, unsigned long>;
+template class PltHashTable<KscSorter::Key, PltPtrHandle<KscSorterBucket> >;
+template class PltHashTable<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> >;
+template class PltHashTable_<KsString, KscServerBase *>;
+template class PltHashTable_<KsString, unsigned long>;
+template class PltHashTable_<KscSorter::Key, PltPtrHandle<KscSorterBucket> >;
+template class PltHashTable_<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> >;
+template class PltIterator<KscSortVarPtr>;
+template class PltIterator<PltAssoc<KsString, KscServerBase *> >;
+template class PltIterator<PltAssoc<KsString, unsigned long> >;
+template class PltIterator<PltAssoc<KscSorter::Key, PltPtrHandle<KscSorterBucket> > >;
+template class PltIterator<PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> > >;
+template class PltIterator<PltPtrHandle<KscPackage> >;
+template class PltIterator<PltPtrHandle<KscSorterBucket> >;
+template class PltIterator<PltPtrHandle<KscVariable> >;
+template class PltIterator_<KscSortVarPtr>;
+template class PltIterator_<PltAssoc<KsString, KscServerBase *> >;
+template class PltIterator_<PltAssoc<KsString, unsigned long> >;
+template class PltIterator_<PltAssoc<KscSorter::Key, PltPtrHandle<KscSorterBucket> > >;
+template class PltIterator_<PltAssoc<PltKeyPlainConstPtr<KscAvModule>, PltPtrHandle<KscNegotiator> > >;
+template class PltIterator_<PltPtrHandle<KscPackage> >;
+template class PltIterator_<PltPtrHandle<KscSorterBucket> >;
+template class PltIterator_<PltPtrHandle<KscVariable> >;
+template class PltKeyPlainConstPtr<KscAvModule>;
+template class PltList<KscSortVarPtr>;
+template class PltList<PltPtrHandle<KscPackage> >;
+template class PltList<PltPtrHandle<KscVariable> >;
+template class PltListIterator<KscSortVarPtr>;
+template class PltListIterator<PltPtrHandle<KscPackage> >;
+template class PltListIterator<PltPtrHandle<KscVariable> >;
+template class PltListNode<KscSortVarPtr>;
+template class PltListNode<PltPtrHandle<KscPackage> >;
+template class PltListNode<PltPtrHandle<KscVariable> >;
+template class PltPtrHandle<KscNegotiator>;
+template class PltPtrHandle<KscPackage>;
+template class PltPtrHandle<KscSorterBucket>;
+template class PltPtrHandle<KscVariable>;
+template class PltSort<KscSortVarPtr>;
+template class Plt_AtArrayNew<KscNegotiator>;
+template class Plt_AtArrayNew<KscPackage>;
+template class Plt_AtArrayNew<KscSortVarPtr>;
+template class Plt_AtArrayNew<KscSorterBucket>;
+template class Plt_AtArrayNew<KscVariable>;
+template class Plt_AtNew<KscNegotiator>;
+template class Plt_AtNew<KscPackage>;
+template class Plt_AtNew<KscSortVarPtr>;
+template class Plt_AtNew<KscSorterBucket>;
+template class Plt_AtNew<KscVariable>;
@@ -0,0 +1,1146 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "ks/archivehistory.h"
+
+#if PLT_USE_MMAP
+
+#include "ks/svrbase.h"
+#include "plt/log.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+// ----------------------------------------------------------------------------
+// The layout of a segment file: the header, the sparse time index, the time
+// stamps and then one column of doubles per variable. All parts are multiples
+// of eight bytes, so the columns are properly aligned within the mapping.
+//
+struct KssArchiveSegmentHeader {
+    char         magic[4];     // "KSHA"
+    unsigned int version;
+    unsigned int columns;
+    unsigned int capacity;
+    unsigned int stride;
+    unsigned int count;        // updated after every row written
+    unsigned int reserved[10];
+}; // struct KssArchiveSegmentHeader
+
+static const char         KSS_ARCHIVE_MAGIC[4] = { 'K', 'S', 'H', 'A' };
+static const unsigned int KSS_ARCHIVE_VERSION  = 1;
+static const size_t       KSS_ARCHIVE_STRIDE   = 256;
+static const unsigned long KSS_ARCHIVE_MAINTENANCE_INTERVAL = 10; // secs
+
+
+static inline size_t
+indexEntries(size_t capacity, size_t stride)
+{
+    return (capacity + stride - 1) / stride;
+} // indexEntries
+
+
+static inline size_t
+segmentLength(size_t capacity, size_t stride, size_t columns)
+{
+    return sizeof(KssArchiveSegmentHeader)
+        + 8 * indexEntries(capacity, stride)
+        + 8 * capacity * (1 + columns);
+} // segmentLength
+
+
+// ----------------------------------------------------------------------------
+// The timer event doing the housekeeping of an archive.
+//
+class KssArchiveMaintenanceEvent
+    : public KsTimerEvent
+{
+public:
+    KssArchiveMaintenanceEvent(KssArchiveHistory &archive)
+        : KsTimerEvent(KsTime::now(KSS_ARCHIVE_MAINTENANCE_INTERVAL)),
+          _archive(archive) { }
+
+    virtual void trigger();
+
+private:
+    KssArchiveHistory &_archive;
+}; // class KssArchiveMaintenanceEvent
+
+
+void
+KssArchiveMaintenanceEvent::trigger()
+{
+    _archive.maintain();
+    _trigger_at = KsTime::now(KSS_ARCHIVE_MAINTENANCE_INTERVAL);
+    KsServerBase::getServerObject().addTimerEvent(this);
+} // KssArchiveMaintenanceEvent::trigger
+
+
+// ----------------------------------------------------------------------------
+// Access to the parts of a mapped segment.
+//
+static inline KssArchiveSegmentHeader *
+segmentHeader(char *map)
+{
+    return (KssArchiveSegmentHeader *) map;
+} // segmentHeader
+
+
+KssArchiveHistory::Stamp *
+KssArchiveHistory::getIndex(const Segment &seg)
+{
+    return (Stamp *) (seg.map + sizeof(KssArchiveSegmentHeader));
+} // KssArchiveHistory::getIndex
+
+
+KssArchiveHistory::Stamp *
+KssArchiveHistory::getTimes(const Segment &seg)
+{
+    return getIndex(seg) + indexEntries(seg.capacity, seg.stride);
+} // KssArchiveHistory::getTimes
+
+
+double *
+KssArchiveHistory::getColumn(const Segment &seg, size_t column)
+{
+    return (double *) (getTimes(seg) + seg.capacity)
+        + column * seg.capacity;
+} // KssArchiveHistory::getColumn
+
+
+// ----------------------------------------------------------------------------
+//
+KssArchiveHistory::KssArchiveHistory(const KsString &id,
+                                     const KsString &directory,
+                                     size_t rowsPerSegment,
+                                     KS_HIST_TYPE mode,
+                                     unsigned long period,
+                                     KsTime ctime,
+                                     KsString comment)
+    : KssSampledHistory(id, mode, period, ctime, comment),
+      _directory(directory),
+      _rows_per_segment(rowsPerSegment ? rowsPerSegment : 1),
+      _stride(KSS_ARCHIVE_STRIDE),
+      _segments(0),
+      _segment_count(0),
+      _segment_alloc(0),
+      _active(0),
+      _spare(0),
+      _next_seq(1),
+      _opened(false),
+      _max_age(0),
+      _max_segments(0),
+      _max_mapped(16),
+      _use_clock(0),
+      _maintenance(0)
+{
+} // KssArchiveHistory::KssArchiveHistory
+
+
+KssArchiveHistory::~KssArchiveHistory()
+{
+    stopSampling();
+    close();
+} // KssArchiveHistory::~KssArchiveHistory
+
+
+// ----------------------------------------------------------------------------
+// The number of columns of the segments is fixed once the archive has been
+// opened.
+//
+bool
+KssArchiveHistory::addColumn(const Track &)
+{
+    return !_opened;
+} // KssArchiveHistory::addColumn
+
+
+void
+KssArchiveHistory::removeColumn(const Track &)
+{
+} // KssArchiveHistory::removeColumn
+
+
+// ----------------------------------------------------------------------------
+//
+void
+KssArchiveHistory::segmentPath(unsigned long seq, PltString &path) const
+{
+    char name[32];
+    sprintf(name, "/%010lu.seg", seq);
+    path = PltString((const char *) _directory, name);
+} // KssArchiveHistory::segmentPath
+
+
+// ----------------------------------------------------------------------------
+// Scan the archive directory for segments. Only the headers and the first
+// and last time stamps are read, the segments are mapped later on demand.
+// Segments are sorted by their numbers, which also sorts them by time.
+//
+int
+KssArchiveHistory::compareSegments(const void *a, const void *b)
+{
+    unsigned long sa = (*(Segment * const *) a)->seq;
+    unsigned long sb = (*(Segment * const *) b)->seq;
+    return sa < sb ? -1 : (sa > sb ? 1 : 0);
+} // KssArchiveHistory::compareSegments
+
+
+bool
+KssArchiveHistory::open()
+{
+    if ( _opened ) {
+        return true;
+    }
+    if ( (mkdir(_directory, 0777) < 0) && (errno != EEXIST) ) {
+        PltLog::Error("KssArchiveHistory::open(): "
+                      "can't create archive directory.");
+        return false;
+    }
+    DIR *dir = opendir(_directory);
+    if ( !dir ) {
+        PltLog::Error("KssArchiveHistory::open(): "
+                      "can't read archive directory.");
+        return false;
+    }
+    struct dirent *entry;
+    while ( (entry = readdir(dir)) != 0 ) {
+        char *end;
+        unsigned long seq = strtoul(entry->d_name, &end, 10);
+        if ( (end == entry->d_name) || strcmp(end, ".seg") ) {
+            continue;
+        }
+        //
+        // New segments must be numbered above all existing ones, even
+        // the ones we can't use, as their files are still in the way.
+        //
+        if ( seq >= _next_seq ) {
+            _next_seq = seq + 1;
+        }
+        Segment *seg = loadSegment(seq);
+        if ( !seg ) {
+            PltLog::Warning("KssArchiveHistory::open(): "
+                            "ignoring unusable segment.");
+            continue;
+        }
+        if ( !appendSegment(seg) ) {
+            delete seg;
+            closedir(dir);
+            close();
+            return false;
+        }
+    }
+    closedir(dir);
+
+    if ( _segment_count ) {
+        qsort(_segments, _segment_count, sizeof(Segment *),
+              compareSegments);
+        //
+        // Continue writing to the newest segment if it has room left.
+        //
+        Segment *last = _segments[_segment_count - 1];
+        if ( (last->count < last->capacity) && mapSegment(*last, true) ) {
+            _active = last;
+        }
+    }
+
+    _maintenance = new KssArchiveMaintenanceEvent(*this);
+    if ( _maintenance
+         && !KsServerBase::getServerObject().addTimerEvent(_maintenance) ) {
+        delete _maintenance;
+        _maintenance = 0;
+    }
+    _opened = true;
+    return true;
+} // KssArchiveHistory::open
+
+
+// ----------------------------------------------------------------------------
+// Flush and unmap all segments. The spare segment is left on disk, it will
+// be used the next time the archive is opened.
+//
+void
+KssArchiveHistory::close()
+{
+    if ( _maintenance ) {
+        KsServerBase::getServerObject().removeTimerEvent(_maintenance);
+        delete _maintenance;
+        _maintenance = 0;
+    }
+    for ( size_t i = 0; i < _segment_count; ++i ) {
+        unmapSegment(*_segments[i]);
+        delete _segments[i];
+    }
+    delete [] _segments;
+    _segments = 0;
+    _segment_count = 0;
+    _segment_alloc = 0;
+    if ( _spare ) {
+        unmapSegment(*_spare);
+        delete _spare;
+        _spare = 0;
+    }
+    _active = 0;
+    _opened = false;
+} // KssArchiveHistory::close
+
+
+// ----------------------------------------------------------------------------
+// Read the header of an existing segment and check that it matches this
+// archive.
+//
+KssArchiveHistory::Segment *
+KssArchiveHistory::loadSegment(unsigned long seq)
+{
+    PltString path;
+    segmentPath(seq, path);
+    int fd = ::open(path, O_RDONLY);
+    if ( fd < 0 ) {
+        return 0;
+    }
+    KssArchiveSegmentHeader hdr;
+    struct stat st;
+    if ( (read(fd, &hdr, sizeof(hdr)) != (ssize_t) sizeof(hdr))
+         || (fstat(fd, &st) < 0)
+         || memcmp(hdr.magic, KSS_ARCHIVE_MAGIC, sizeof(hdr.magic))
+         || (hdr.version != KSS_ARCHIVE_VERSION)
+         || (hdr.columns != _track_count)
+         || !hdr.capacity || !hdr.stride || (hdr.count > hdr.capacity)
+         || ((size_t) st.st_size
+             < segmentLength(hdr.capacity, hdr.stride, hdr.columns)) ) {
+        ::close(fd);
+        return 0;
+    }
+
+    Segment *seg = new Segment;
+    if ( !seg ) {
+        ::close(fd);
+        return 0;
+    }
+    seg->seq      = seq;
+    seg->capacity = hdr.capacity;
+    seg->stride   = hdr.stride;
+    seg->count    = hdr.count;
+    seg->map      = 0;
+    seg->length   = segmentLength(hdr.capacity, hdr.stride, hdr.columns);
+    seg->used     = 0;
+    if ( seg->count ) {
+        off_t times = sizeof(hdr) + 8 * indexEntries(hdr.capacity,
+                                                      hdr.stride);
+        if ( (pread(fd, &seg->first, sizeof(Stamp), times)
+              != (ssize_t) sizeof(Stamp))
+             || (pread(fd, &seg->last, sizeof(Stamp),
+                       times + 8 * (seg->count - 1))
+                 != (ssize_t) sizeof(Stamp)) ) {
+            delete seg;
+            seg = 0;
+        }
+    }
+    ::close(fd);
+    return seg;
+} // KssArchiveHistory::loadSegment
+
+
+// ----------------------------------------------------------------------------
+// Create a new, empty segment with the next free number. The file is sized
+// at once, the blocks are allocated by the file system when the rows are
+// written.
+//
+KssArchiveHistory::Segment *
+KssArchiveHistory::createSegment()
+{
+    Segment *seg = new Segment;
+    if ( !seg ) {
+        return 0;
+    }
+    seg->seq      = _next_seq;
+    seg->capacity = _rows_per_segment;
+    seg->stride   = _stride;
+    seg->count    = 0;
+    seg->map      = 0;
+    seg->length   = segmentLength(_rows_per_segment, _stride, _track_count);
+    seg->used     = 0;
+
+    PltString path;
+    segmentPath(seg->seq, path);
+    int fd = ::open(path, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if ( fd < 0 ) {
+        delete seg;
+        return 0;
+    }
+    KssArchiveSegmentHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, KSS_ARCHIVE_MAGIC, sizeof(hdr.magic));
+    hdr.version  = KSS_ARCHIVE_VERSION;
+    hdr.columns  = _track_count;
+    hdr.capacity = seg->capacity;
+    hdr.stride   = seg->stride;
+    hdr.count    = 0;
+    bool ok = (ftruncate(fd, seg->length) == 0)
+        && (write(fd, &hdr, sizeof(hdr)) == (ssize_t) sizeof(hdr));
+    ::close(fd);
+    if ( !ok || !mapSegment(*seg, true) ) {
+        unlink(path);
+        delete seg;
+        return 0;
+    }
+    ++_next_seq;
+    return seg;
+} // KssArchiveHistory::createSegment
+
+
+// ----------------------------------------------------------------------------
+// Map a segment. Only the segment currently written to is mapped writable.
+// Mapping never unmaps other segments, so a GetHist request can safely map
+// all the segments it needs; trimMappings() cleans up afterwards.
+//
+bool
+KssArchiveHistory::mapSegment(Segment &seg, bool writable)
+{
+    seg.used = ++_use_clock;
+    if ( seg.map ) {
+        return true;
+    }
+    PltString path;
+    segmentPath(seg.seq, path);
+    int fd = ::open(path, writable ? O_RDWR : O_RDONLY);
+    if ( fd < 0 ) {
+        return false;
+    }
+    void *map = mmap(0, seg.length,
+                     writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                     MAP_SHARED, fd, 0);
+    ::close(fd);
+    if ( map == MAP_FAILED ) {
+        return false;
+    }
+    seg.map = (char *) map;
+    return true;
+} // KssArchiveHistory::mapSegment
+
+
+void
+KssArchiveHistory::unmapSegment(Segment &seg)
+{
+    if ( seg.map ) {
+        if ( &seg == _active ) {
+            msync(seg.map, seg.length, MS_ASYNC);
+        }
+        munmap(seg.map, seg.length);
+        seg.map = 0;
+    }
+} // KssArchiveHistory::unmapSegment
+
+
+// ----------------------------------------------------------------------------
+// Unmap the least recently used segments until no more than the maximum
+// number of segments are mapped. The active segment always stays mapped.
+//
+void
+KssArchiveHistory::trimMappings()
+{
+    for ( ;; ) {
+        size_t mapped = 0;
+        Segment *lru = 0;
+        for ( size_t i = 0; i < _segment_count; ++i ) {
+            Segment *seg = _segments[i];
+            if ( !seg->map || (seg == _active) ) {
+                continue;
+            }
+            ++mapped;
+            if ( !lru || (seg->used < lru->used) ) {
+                lru = seg;
+            }
+        }
+        if ( !lru || (mapped <= _max_mapped) ) {
+            break;
+        }
+        unmapSegment(*lru);
+    }
+} // KssArchiveHistory::trimMappings
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KssArchiveHistory::appendSegment(Segment *seg)
+{
+    if ( _segment_count == _segment_alloc ) {
+        size_t alloc = _segment_alloc ? 2 * _segment_alloc : 64;
+        Segment **segments = new Segment *[alloc];
+        if ( !segments ) {
+            return false;
+        }
+        for ( size_t i = 0; i < _segment_count; ++i ) {
+            segments[i] = _segments[i];
+        }
+        delete [] _segments;
+        _segments = segments;
+        _segment_alloc = alloc;
+    }
+    _segments[_segment_count++] = seg;
+    return true;
+} // KssArchiveHistory::appendSegment
+
+
+void
+KssArchiveHistory::deleteSegment(size_t idx)
+{
+    Segment *seg = _segments[idx];
+    unmapSegment(*seg);
+    PltString path;
+    segmentPath(seg->seq, path);
+    unlink(path);
+    delete seg;
+    --_segment_count;
+    for ( size_t i = idx; i < _segment_count; ++i ) {
+        _segments[i] = _segments[i + 1];
+    }
+} // KssArchiveHistory::deleteSegment
+
+
+// ----------------------------------------------------------------------------
+// Append a row to the active segment, rolling over to the next segment when
+// necessary. As with the ring history, time stamps must not go backwards.
+// The row count in the segment header is updated last, so a crash never
+// leaves a partially written row behind.
+//
+void
+KssArchiveHistory::appendRow(const PltTime &t)
+{
+    if ( !_opened ) {
+        return;
+    }
+    if ( !_active ) {
+        Segment *seg = _spare ? _spare : createSegment();
+        if ( !seg || !appendSegment(seg) ) {
+            PltLog::Error("KssArchiveHistory::appendRow(): "
+                          "can't create a new segment, sample lost.");
+            if ( seg && (seg != _spare) ) {
+                unmapSegment(*seg);
+                delete seg;
+            }
+            return;
+        }
+        _spare = 0;
+        _active = seg;
+    }
+
+    Stamp stamp;
+    stamp.sec  = t.tv_sec > 0 ? t.tv_sec : 0;
+    stamp.usec = t.tv_sec > 0 ? t.tv_usec : 0;
+    const Segment *prev = _active->count ? _active
+        : (_segment_count > 1 ? _segments[_segment_count - 2] : 0);
+    if ( prev && prev->count
+         && ((stamp.sec < prev->last.sec)
+             || ((stamp.sec == prev->last.sec)
+                 && (stamp.usec < prev->last.usec))) ) {
+        stamp = prev->last;
+    }
+
+    Segment &seg = *_active;
+    size_t row = seg.count;
+    getTimes(seg)[row] = stamp;
+    if ( (row % seg.stride) == 0 ) {
+        getIndex(seg)[row / seg.stride] = stamp;
+    }
+    for ( Track *track = _tracks; track; track = track->next ) {
+        getColumn(seg, track->index)[row] = track->last;
+    }
+    segmentHeader(seg.map)->count = row + 1;
+
+    if ( !row ) {
+        seg.first = stamp;
+    }
+    seg.last = stamp;
+    seg.count = row + 1;
+    if ( seg.count == seg.capacity ) {
+        msync(seg.map, seg.length, MS_ASYNC);
+        _active = 0;
+    }
+} // KssArchiveHistory::appendRow
+
+
+// ----------------------------------------------------------------------------
+//
+void
+KssArchiveHistory::maintain()
+{
+    if ( !_opened ) {
+        return;
+    }
+    if ( !_spare
+         && (!_active || (2 * _active->count >= _active->capacity)) ) {
+        _spare = createSegment();
+    }
+    if ( _active && _active->map ) {
+        msync(_active->map, _active->length, MS_ASYNC);
+    }
+
+    unsigned long now = PltTime::now().tv_sec;
+    while ( _segment_count && (_segments[0] != _active) ) {
+        const Segment *oldest = _segments[0];
+        if ( (_max_segments && (_segment_count > _max_segments))
+             || (_max_age && oldest->count
+                 && (oldest->last.sec + _max_age < now)) ) {
+            deleteSegment(0);
+        } else {
+            break;
+        }
+    }
+
+    trimMappings();
+} // KssArchiveHistory::maintain
+
+
+// ----------------------------------------------------------------------------
+// Return the first segment which may contain rows at or after time t, that
+// is, whose last row isn't older than t.
+//
+size_t
+KssArchiveHistory::findSegment(const Stamp &t) const
+{
+    size_t lo = 0;
+    size_t hi = _segment_count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        const Segment *seg = _segments[mid];
+        if ( seg->count && stampLess(seg->last, t) ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+} // KssArchiveHistory::findSegment
+
+
+//
+// Segments are sorted by their numbers, so a binary search finds them.
+//
+KssArchiveHistory::Segment *
+KssArchiveHistory::segmentBySeq(unsigned long seq) const
+{
+    size_t lo = 0;
+    size_t hi = _segment_count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( _segments[mid]->seq < seq ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return ((lo < _segment_count) && (_segments[lo]->seq == seq)) ?
+        _segments[lo] : 0;
+} // KssArchiveHistory::segmentBySeq
+
+
+// ----------------------------------------------------------------------------
+// Return the first row of a (mapped) segment at or after time t, or after t
+// if "upper" is set. The sparse index narrows the search down to the rows
+// between two index entries, so only one page of the time stamps is touched.
+//
+size_t
+KssArchiveHistory::rowBound(const Segment &seg, const Stamp &t,
+                            bool upper) const
+{
+    const Stamp *index = getIndex(seg);
+    const Stamp *times = getTimes(seg);
+
+    size_t lo = 0;
+    size_t hi = indexEntries(seg.count, seg.stride);
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( upper ? !stampLess(t, index[mid]) : stampLess(index[mid], t) ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if ( !lo ) {
+        return 0;
+    }
+    hi = lo * seg.stride;
+    if ( hi > seg.count ) {
+        hi = seg.count;
+    }
+    lo = (lo - 1) * seg.stride + 1;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( upper ? !stampLess(t, times[mid]) : stampLess(times[mid], t) ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+} // KssArchiveHistory::rowBound
+
+
+// ----------------------------------------------------------------------------
+// Locate the rows within the time range selected segment by segment, but no
+// more than limit rows. The segments involved are mapped. Returns false if
+// a segment couldn't be mapped; the caller trims the mappings in any case.
+//
+bool
+KssArchiveHistory::selectSpans(const Selection &sel, size_t limit,
+                               Span *&spans, size_t &nspans, size_t &total)
+{
+    Stamp from, to;
+    if ( sel.selected ) {
+        from.sec  = sel.from.tv_sec > 0 ? sel.from.tv_sec : 0;
+        from.usec = sel.from.tv_sec > 0 ? sel.from.tv_usec : 0;
+        to.sec    = sel.to.tv_sec > 0 ? sel.to.tv_sec : 0;
+        to.usec   = sel.to.tv_sec > 0 ? sel.to.tv_usec : 0;
+    } else {
+        from.sec = from.usec = 0;
+        to.sec = to.usec = (unsigned int) -1;
+    }
+
+    spans = 0;
+    nspans = 0;
+    total = 0;
+    if ( _segment_count ) {
+        spans = new Span[_segment_count];
+        if ( !spans ) {
+            return false;
+        }
+    }
+    for ( size_t i = findSegment(from);
+          (i < _segment_count) && (total < limit); ++i ) {
+        Segment *seg = _segments[i];
+        if ( !seg->count ) {
+            continue;
+        }
+        if ( stampLess(to, seg->first) ) {
+            break;
+        }
+        if ( !mapSegment(*seg, false) ) {
+            delete [] spans;
+            spans = 0;
+            return false;
+        }
+        size_t lo = rowBound(*seg, from, false);
+        size_t hi = rowBound(*seg, to, true);
+        if ( hi > lo ) {
+            size_t n = hi - lo;
+            if ( n > limit - total ) {
+                n = limit - total;
+            }
+            spans[nspans].seg   = seg;
+            spans[nspans].first = lo;
+            spans[nspans].count = n;
+            ++nspans;
+            total += n;
+        }
+    }
+    return true;
+} // KssArchiveHistory::selectSpans
+
+
+// ----------------------------------------------------------------------------
+// Tell the aggregator which rows fall into which bucket. Rows are numbered
+// consecutively through the spans of rows within the time range, the spans
+// being sorted by time. Both the buckets and the spans are walked through
+// only once.
+//
+void
+KssArchiveHistory::selectBuckets(KssHistoryAggregator &agg,
+                                 const Span *spans, size_t nspans,
+                                 size_t total) const
+{
+    size_t buckets = agg.getBucketCount();
+    if ( !buckets ) {
+        return;
+    }
+    size_t k = 0;
+    size_t base = 0;
+    agg.setBucketRow(0, 0);
+    for ( size_t b = 1; b < buckets; ++b ) {
+        const PltTime &start = agg.getBucketStart(b);
+        Stamp t;
+        t.sec  = start.tv_sec > 0 ? start.tv_sec : 0;
+        t.usec = start.tv_sec > 0 ? start.tv_usec : 0;
+        while ( (k < nspans)
+                && stampLess(getTimes(*spans[k].seg)[spans[k].first
+                                                     + spans[k].count - 1],
+                             t) ) {
+            base += spans[k].count;
+            ++k;
+        }
+        size_t row = total;
+        if ( k < nspans ) {
+            size_t bound = rowBound(*spans[k].seg, t, false);
+            bound = bound > spans[k].first ? bound - spans[k].first : 0;
+            row = base + (bound < spans[k].count ? bound : spans[k].count);
+        }
+        agg.setBucketRow(b, row);
+    }
+    agg.setBucketRow(buckets, total);
+} // KssArchiveHistory::selectBuckets
+
+
+// ----------------------------------------------------------------------------
+// Feed a column into the aggregator, bucket by bucket. The rows of a bucket
+// may lie in more than one segment.
+//
+void
+KssArchiveHistory::accumulate(KssHistoryAggregator &agg, const Track &track,
+                              const Span *spans, size_t nspans) const
+{
+    size_t k = 0;
+    size_t base = 0;
+    agg.reset();
+    for ( size_t b = 0; b < agg.getBucketCount(); ++b ) {
+        size_t row = agg.getBucketRow(b);
+        size_t end = row + agg.getBucketSize(b);
+        while ( row < end ) {
+            while ( (k < nspans) && (row >= base + spans[k].count) ) {
+                base += spans[k].count;
+                ++k;
+            }
+            if ( k >= nspans ) {
+                break;
+            }
+            size_t count = base + spans[k].count;
+            if ( count > end ) {
+                count = end;
+            }
+            count -= row;
+            agg.accumulate(b,
+                           getColumn(*spans[k].seg, track.index)
+                           + spans[k].first + (row - base),
+                           count);
+            row += count;
+        }
+    }
+} // KssArchiveHistory::accumulate
+
+
+// ----------------------------------------------------------------------------
+// Answer a GetHist request. First, the rows requested are located segment by
+// segment, then they are copied into the reply vectors (or aggregated). The
+// time part is returned as a vector of time stamps, every other part as a
+// vector of doubles, all for the same rows.
+//
+void
+KssArchiveHistory::getHist(const KsGetHistParams &params,
+                           KsGetHistSingleResult &result)
+{
+    Selection sel;
+    KS_RESULT res = getSelection(params, sel);
+    if ( res != KS_ERR_OK ) {
+        result.result = res;
+        return;
+    }
+    if ( !_opened ) {
+        result.result = KS_ERR_GENERIC;
+        return;
+    }
+    //
+    // When aggregating, all rows within the time range are needed, the
+    // number of buckets is limited instead.
+    //
+    size_t limit = sel.ipm != KS_IPM_NONE ? (size_t) -1 : params.max_entries;
+    Span *spans;
+    size_t nspans, total;
+    if ( !selectSpans(sel, limit, spans, nspans, total) ) {
+        trimMappings();
+        result.result = KS_ERR_GENERIC;
+        return;
+    }
+
+    KssHistoryAggregator agg;
+    if ( sel.ipm != KS_IPM_NONE ) {
+        res = agg.setup(sel.from, sel.to, sel.delta, params.max_entries,
+                        total);
+        if ( res != KS_ERR_OK ) {
+            delete [] spans;
+            trimMappings();
+            result.result = res;
+            return;
+        }
+        selectBuckets(agg, spans, nspans, total);
+    }
+
+    size_t nitems = params.items.size();
+    KsArray<KsGetHistResultItem> items(nitems);
+    if ( items.size() != nitems ) {
+        delete [] spans;
+        trimMappings();
+        result.result = KS_ERR_GENERIC;
+        return;
+    }
+
+    for ( size_t i = 0; i < nitems; ++i ) {
+        const KsString &part = params.items[i].part_id;
+        KsGetHistResultItem &item = items[i];
+        if ( part == "t" ) {
+            if ( sel.ipm != KS_IPM_NONE ) {
+                item.value = agg.getTimes();
+            } else {
+                KsTimeVecValue *tv = new KsTimeVecValue(total);
+                if ( !tv || (tv->size() != total) ) {
+                    delete tv;
+                    item.result = KS_ERR_GENERIC;
+                    continue;
+                }
+                KsTime *dst = tv->getPtr();
+                for ( size_t s = 0; s < nspans; ++s ) {
+                    const Stamp *times =
+                        getTimes(*spans[s].seg) + spans[s].first;
+                    for ( size_t r = 0; r < spans[s].count; ++r ) {
+                        *dst++ = KsTime(times[r].sec, times[r].usec);
+                    }
+                }
+                item.value = KsValueHandle(tv, KsOsNew);
+            }
+        } else {
+            Track *track = findTrack(part);
+            if ( !track ) {
+                item.result = KS_ERR_BADPATH;
+                continue;
+            }
+            if ( sel.ipm != KS_IPM_NONE ) {
+                accumulate(agg, *track, spans, nspans);
+                item.value = agg.getValues(sel.ipm);
+            } else {
+                KsDoubleVecValue *dv = new KsDoubleVecValue(total);
+                if ( !dv || (dv->size() != total) ) {
+                    delete dv;
+                    item.result = KS_ERR_GENERIC;
+                    continue;
+                }
+                double *dst = dv->getPtr();
+                for ( size_t s = 0; s < nspans; ++s ) {
+                    memcpy(dst,
+                           getColumn(*spans[s].seg, track->index)
+                           + spans[s].first,
+                           spans[s].count * sizeof(double));
+                    dst += spans[s].count;
+                }
+                item.value = KsValueHandle(dv, KsOsNew);
+            }
+        }
+        item.result = item.value ? KS_ERR_OK : KS_ERR_GENERIC;
+    }
+
+    delete [] spans;
+    trimMappings();
+    if ( sel.encoded ) {
+        encodeItems(items);
+    }
+    result.items = items;
+    result.result = KS_ERR_OK;
+} // KssArchiveHistory::getHist
+
+
+// ----------------------------------------------------------------------------
+// A cursor over the rows of an archive. It keeps the spans of rows by the
+// number of their segment, as segments may be deleted while the reply is
+// sent. Segments are mapped again as necessary.
+//
+class KssArchiveHistoryCursor
+    : public KssHistoryCursor
+{
+public:
+    KssArchiveHistoryCursor(KssArchiveHistory &hist);
+    virtual ~KssArchiveHistoryCursor();
+
+    bool setSpans(const KssArchiveHistory::Span *spans, size_t nspans);
+
+    virtual bool readTimes(size_t row, size_t count, PltTime *dst);
+    virtual bool readValues(size_t column, size_t row, size_t count,
+                            double *dst);
+
+private:
+    struct Span {
+        unsigned long  seq;
+        size_t         first;
+        size_t         count;
+    };
+
+    KssArchiveHistory::Segment *locate(size_t row, size_t &offset,
+                                       size_t &avail);
+
+    KssArchiveHistory &_hist;
+    Span              *_spans;
+    size_t             _nspans;
+    size_t             _span;       // span visited last
+    size_t             _span_row;   // its first row in the reply
+}; // class KssArchiveHistoryCursor
+
+
+KssArchiveHistoryCursor::KssArchiveHistoryCursor(KssArchiveHistory &hist)
+    : _hist(hist),
+      _spans(0),
+      _nspans(0),
+      _span(0),
+      _span_row(0)
+{
+} // KssArchiveHistoryCursor::KssArchiveHistoryCursor
+
+
+KssArchiveHistoryCursor::~KssArchiveHistoryCursor()
+{
+    delete [] _spans;
+} // KssArchiveHistoryCursor::~KssArchiveHistoryCursor
+
+
+bool
+KssArchiveHistoryCursor::setSpans(const KssArchiveHistory::Span *spans,
+                                  size_t nspans)
+{
+    _spans = new Span[nspans ? nspans : 1];
+    if ( !_spans ) {
+        return false;
+    }
+    for ( size_t s = 0; s < nspans; ++s ) {
+        _spans[s].seq   = spans[s].seg->seq;
+        _spans[s].first = spans[s].first;
+        _spans[s].count = spans[s].count;
+    }
+    _nspans = nspans;
+    return true;
+} // KssArchiveHistoryCursor::setSpans
+
+
+//
+// Find and map the segment holding a row of the reply. Returns where the
+// row is in the segment and how many rows of the span follow it (including
+// the row itself).
+//
+KssArchiveHistory::Segment *
+KssArchiveHistoryCursor::locate(size_t row, size_t &offset, size_t &avail)
+{
+    if ( row < _span_row ) {
+        _span = 0;
+        _span_row = 0;
+    }
+    while ( (_span < _nspans) && (row >= _span_row + _spans[_span].count) ) {
+        _span_row += _spans[_span].count;
+        ++_span;
+    }
+    if ( _span >= _nspans ) {
+        return 0;
+    }
+    KssArchiveHistory::Segment *seg = _hist.segmentBySeq(_spans[_span].seq);
+    if ( !seg || !_hist.mapSegment(*seg, false) ) {
+        return 0;
+    }
+    offset = _spans[_span].first + (row - _span_row);
+    avail = _spans[_span].count - (row - _span_row);
+    return seg;
+} // KssArchiveHistoryCursor::locate
+
+
+bool
+KssArchiveHistoryCursor::readTimes(size_t row, size_t count, PltTime *dst)
+{
+    while ( count ) {
+        size_t offset, n;
+        KssArchiveHistory::Segment *seg = locate(row, offset, n);
+        if ( !seg ) {
+            _hist.trimMappings();
+            return false;
+        }
+        if ( n > count ) {
+            n = count;
+        }
+        const KssArchiveHistory::Stamp *times =
+            KssArchiveHistory::getTimes(*seg) + offset;
+        for ( size_t r = 0; r < n; ++r ) {
+            *dst++ = PltTime(times[r].sec, times[r].usec);
+        }
+        row += n;
+        count -= n;
+    }
+    _hist.trimMappings();
+    return true;
+} // KssArchiveHistoryCursor::readTimes
+
+
+bool
+KssArchiveHistoryCursor::readValues(size_t column, size_t row, size_t count,
+                                    double *dst)
+{
+    while ( count ) {
+        size_t offset, n;
+        KssArchiveHistory::Segment *seg = locate(row, offset, n);
+        if ( !seg ) {
+            _hist.trimMappings();
+            return false;
+        }
+        if ( n > count ) {
+            n = count;
+        }
+        memcpy(dst, KssArchiveHistory::getColumn(*seg, column) + offset,
+               n * sizeof(double));
+        dst += n;
+        row += n;
+        count -= n;
+    }
+    _hist.trimMappings();
+    return true;
+} // KssArchiveHistoryCursor::readValues
+
+
+// ----------------------------------------------------------------------------
+// Open a cursor for raw replies; aggregated and encoded replies as well as
+// erroneous requests are left to getHist(). The rows are located right now,
+// but not read until the reply is sent.
+//
+KssHistoryCursor *
+KssArchiveHistory::openCursor(const KsGetHistParams &params)
+{
+    Selection sel;
+    if ( !_opened || (getSelection(params, sel) != KS_ERR_OK)
+         || (sel.ipm != KS_IPM_NONE) || sel.encoded ) {
+        return 0;
+    }
+    Span *spans;
+    size_t nspans, total;
+    if ( !selectSpans(sel, params.max_entries, spans, nspans, total) ) {
+        trimMappings();
+        return 0;
+    }
+    KssArchiveHistoryCursor *cursor = new KssArchiveHistoryCursor(*this);
+    if ( cursor && !(cursor->setSpans(spans, nspans)
+                     && initCursor(*cursor, params, total)) ) {
+        delete cursor;
+        cursor = 0;
+    }
+    delete [] spans;
+    trimMappings();
+    return cursor;
+} // KssArchiveHistory::openCursor
+
+#endif /* PLT_USE_MMAP */
+
+/* End of archivehistory.cpp */
@@ -61,6 +61,15 @@ KsAvTicket::deregisterAvTicketType(enum_t ticketType)
     KsTicketConstructor dummy;
     return _factory.remove(KsAuthType(ticketType), dummy);
 }
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KsAvTicket::isAvTicketTypeRegistered(enum_t ticketType)
+{
+    KsTicketConstructor dummy;
+    return _factory.query(KsAuthType(ticketType), dummy);
+}
 #endif
 
 //////////////////////////////////////////////////////////////////////
@@ -27,10 +27,13 @@
 #include <string.h>
 
 #include <plt/log.h>
+#include <plt/thread.h>
 
 #include "ks/client.h"
 #include "ks/ks.h"
 #include "ks/commobject.h"
+#include "ks/epcache.h"
+#include "ks/resolver.h"
 
 #if PLT_USE_DEPRECIATED_HEADER
 #include <iostream.h>
@@ -56,6 +59,19 @@ KscClient *KscClient::_the_client = 0;
 // _clean_up is a static object which is responsible for destroying
 // the client object when the application exits.
 KscClient::CleanUp KscClient::_clean_up;
+// _ksc_clientLock serializes the few places where server objects talking
+// to different servers at the same time (see KscPackage) share state:
+// the A/V modules with their negotiators.
+static PltMutex _ksc_clientLock;
+// _ksc_createLock makes sure that only one client object gets created,
+// even if several threads ask for it at the same time.
+static PltMutex _ksc_createLock;
+// Every thread remembers the result of its last request and the server
+// it was sent to, see KscServerBase::getLastResult(). _ksc_resultLock
+// protects the result of the last request of any thread.
+static PltMutex _ksc_resultLock;
+static PLT_THREAD_LOCAL const KscServerBase *_ksc_lastServer = 0;
+static PLT_THREAD_LOCAL KS_RESULT _ksc_lastResult = KS_ERR_OK;
 
 
 //////////////////////////////////////////////////////////////////////
@@ -119,7 +135,13 @@ KscClient::KscClient()
 : av_module(0),
   _rpc_timeout(KSC_RPCCALL_TIMEOUT),
   _retry_wait(0, 0),
-  _tries(1)
+  _tries(1),
+  _backoff_min(KSC_BACKOFF_MIN, 0),
+  _backoff_max(KSC_BACKOFF_MAX, 0),
+  _chunk_items(KSC_CHUNK_MAX_ITEMS),
+  _chunk_size(KSC_CHUNK_MAX_SIZE),
+  _value_cache(0),
+  _ep_cache_ttl(0, 0)
 {}
 
 //////////////////////////////////////////////////////////////////////
@@ -152,7 +174,12 @@ KscClient::~KscClient()
 void
 KscClient::_createClient()
 {
-    PLT_PRECONDITION(!_the_client);
+    PltMutexLock lock(_ksc_createLock);
+
+    if(_the_client) {
+        // another thread has been faster
+        return;
+    }
 
     KscClient *cl = new KscClient();
     if(!cl) {
@@ -160,13 +187,8 @@ KscClient::_createClient()
         exit(-1);
     }
 
-#if PLT_DEBUG
-    bool ok = setClient(cl, KsOsNew);
-    PLT_ASSERT(ok);
-#else
-    setClient(cl, KsOsNew);
-#endif
-
+    _clean_up.shutdown_delete = true;
+    PltAtomic::storePtr((void * volatile *) &_the_client, cl);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -174,6 +196,8 @@ KscClient::_createClient()
 bool 
 KscClient::setClient(KscClient *cl, KsOwnership os)
 {
+    PltMutexLock lock(_ksc_createLock);
+
     if(_the_client || !cl) {
         return false;
     } else {
@@ -185,7 +209,7 @@ KscClient::setClient(KscClient *cl, KsOwnership os)
             // invalid ownership status
             return false;
         }
-        _the_client = cl;
+        PltAtomic::storePtr((void * volatile *) &_the_client, cl);
 
         return true;
     }
@@ -204,6 +228,7 @@ KscClient::setClient(KscClient *cl, KsOwnership os)
 KscServerBase *
 KscClient::getServer(const KsString &host_and_name) 
 {
+    PltMutexLock lock(_lock);
     KscServerBase *pServer;
 
     bool ok = server_table.query(host_and_name, pServer);
@@ -212,12 +237,35 @@ KscClient::getServer(const KsString &host_and_name)
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// Find or create a server object and take a reference to it for the
+// calling communication object. Both happen while the server table is
+// locked, so another thread can't destroy the server object in
+// between by releasing its last reference.
+//
+KS_RESULT
+KscClient::attachServer(const KsString &host_and_name,
+                        u_short protocol_version,
+                        KscServerBase *&pServer)
+{
+    PltMutexLock lock(_lock);
+
+    KS_RESULT result = createServer(host_and_name, protocol_version,
+                                    pServer);
+    if ( pServer ) {
+        pServer->ref_count++;
+    }
+    return result;
+} // KscClient::attachServer
+
+
 //////////////////////////////////////////////////////////////////////
 // Create a server object for the given host&server name (of the form
 // "//host/server") and return the pointer to it. In any case, success
 // or failure is indicated by the error return value -- the well known
 // KS_RESULT enumeration. This allows the caller to act appropriate
-// and set usefull error codes on its own behalf.
+// and set usefull error codes on its own behalf. Must be called with
+// the server table locked.
 //
 KS_RESULT
 KscClient::createServer(KsString host_and_name,
@@ -272,6 +320,8 @@ KscClient::createServer(KsString host_and_name,
 		//
 		if ( server_table.add(host_and_name, temp) ) {
 		    temp->setTimeouts(_rpc_timeout, _retry_wait, _tries);
+		    temp->setBackoff(_backoff_min, _backoff_max);
+		    temp->setEPCacheTTL(_ep_cache_ttl);
 		    pServer = temp;
 		} else {
 		    delete temp;
@@ -299,22 +349,19 @@ KscClient::createServer(KsString host_and_name,
 } // KscClient::createServer
 
 //////////////////////////////////////////////////////////////////////
-
+// Must be called with the server table locked.
+//
 void
-KscClient::deleteServer(KscServerBase *server)
+KscClient::removeServer(KscServerBase *server)
 {
     KscServerBase *temp = 0;
 
-    // remove server from table
-    //
 #if PLT_DEBUG
     bool ok =
 #endif 
         server_table.remove(server->getHostAndName(), temp);
 
     PLT_ASSERT(ok && (temp == server));
-
-    delete server;
 }
 
 
@@ -326,6 +373,7 @@ KscClient::setTimeouts(const PltTime &rpc_timeout,
                        const PltTime &retry_wait,         
                        size_t tries)
 {
+    PltMutexLock lock(_lock);
     _rpc_timeout = rpc_timeout;
     _retry_wait  = retry_wait;
     _tries       = tries;
@@ -336,12 +384,64 @@ KscClient::getTimeouts(PltTime &rpc_timeout,
 		       PltTime &retry_wait,
 		       size_t &tries)
 {
+    PltMutexLock lock(_lock);
     rpc_timeout = _rpc_timeout;
     retry_wait  = _retry_wait;
     tries       = _tries;
 } // KscClient::getTimeouts
 
 
+void
+KscClient::setBackoff(const PltTimeSpan &min_backoff,
+                      const PltTimeSpan &max_backoff)
+{
+    PltMutexLock lock(_lock);
+    _backoff_min = min_backoff;
+    _backoff_max = max_backoff;
+} // KscClient::setBackoff
+
+void
+KscClient::getBackoff(PltTimeSpan &min_backoff,
+                      PltTimeSpan &max_backoff) const
+{
+    PltMutexLock lock(_lock);
+    min_backoff = _backoff_min;
+    max_backoff = _backoff_max;
+} // KscClient::getBackoff
+
+
+void
+KscClient::setChunkLimits(size_t max_items, size_t max_size)
+{
+    PltMutexLock lock(_lock);
+    _chunk_items = max_items;
+    _chunk_size  = max_size;
+} // KscClient::setChunkLimits
+
+void
+KscClient::getChunkLimits(size_t &max_items, size_t &max_size)
+{
+    PltMutexLock lock(_lock);
+    max_items = _chunk_items;
+    max_size  = _chunk_size;
+} // KscClient::getChunkLimits
+
+
+void
+KscClient::setEPCacheTTL(const PltTimeSpan &ttl)
+{
+    PltMutexLock lock(_lock);
+    _ep_cache_ttl = ttl;
+} // KscClient::setEPCacheTTL
+
+PltTimeSpan
+KscClient::getEPCacheTTL() const
+{
+    PltMutexLock lock(_lock);
+    return _ep_cache_ttl;
+} // KscClient::getEPCacheTTL
+
+
 //////////////////////////////////////////////////////////////////////
 
 #if PLT_DEBUG
@@ -376,7 +476,8 @@ KscServerBase::KscServerBase(KsString host, KsString name)
   host_and_name("//", host),
   av_module(0),
   ref_count(0),
-  _last_result(KS_ERR_OK)
+  _last_result(KS_ERR_OK),
+  _ep_cache(0)
 {
     host_and_name += "/";
     host_and_name += name;
@@ -386,12 +487,35 @@ KscServerBase::KscServerBase(KsString hostAndName)
 : host_and_name(hostAndName),
   av_module(0),
   ref_count(0),
-  _last_result(KS_ERR_OK)
+  _last_result(KS_ERR_OK),
+  _ep_cache(0)
 {
     _last_result = _ksc_extractHostAndServer(host_and_name, 
 					     host_name, server_name);
 }
 
+KscServerBase::~KscServerBase()
+{
+    delete _ep_cache;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Switch the cache for GetEP replies on or off, or change how long
+// replies are kept.
+//
+void
+KscServerBase::setEPCacheTTL(const PltTimeSpan &ttl)
+{
+    if ( ttl <= PltTimeSpan(0, 0) ) {
+        delete _ep_cache;
+        _ep_cache = 0;
+    } else if ( _ep_cache ) {
+        _ep_cache->setTTL(ttl);
+    } else {
+        _ep_cache = new KscEPCache(ttl);
+    }
+}
+
 //////////////////////////////////////////////////////////////////////
 // Section for handling of communication objects
 //
@@ -399,6 +523,8 @@ KscServerBase::KscServerBase(KsString hostAndName)
 void
 KscServerBase::incRefcount() 
 {
+    KscClient *the_client = KscClient::getClient();
+    PltMutexLock lock(the_client->_lock);
     ref_count++;
 }
 
@@ -407,16 +533,53 @@ KscServerBase::incRefcount()
 void
 KscServerBase::decRefcount()
 {
-    if( !(--ref_count) ) {
-        // no more referring objects left
-        // destroy this object
+    KscClient *the_client = KscClient::getClient();
+    bool last;
+    {
+        PltMutexLock lock(the_client->_lock);
+        last = !(--ref_count);
+        if( last ) {
+            // no more referring objects left, so nobody else can
+            // find this object any more
+            //
+            the_client->removeServer(this);
+        }
+    }
+    if( last ) {
+        // Destroy this object without holding the lock, as it may
+        // have to wait for a probe talking to the server (see
+        // KscServer::~KscServer), which must not hold up other
+        // threads attaching to their servers.
         //
-        KscClient *the_client =
-            KscClient::getClient();
-        the_client->deleteServer(this);
+        delete this;
     }
 }
 
+//////////////////////////////////////////////////////////////////////
+// As several threads may talk to the same server at the same time,
+// the result of a request is remembered per thread, too.
+//
+KS_RESULT
+KscServerBase::getLastResult() const
+{
+    if ( _ksc_lastServer == this ) {
+        return _ksc_lastResult;
+    }
+    PltMutexLock lock(_ksc_resultLock);
+    return _last_result;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscServerBase::setLastResult(KS_RESULT result)
+{
+    _ksc_lastServer = this;
+    _ksc_lastResult = result;
+    PltMutexLock lock(_ksc_resultLock);
+    _last_result = result;
+}
+
 
 // ----------------------------------------------------------------------------
 // The new ACPLT/KS protocol version 2 GETEP service. This superceedes the old
@@ -427,10 +590,30 @@ KscServerBase::decRefcount()
 // issue a GETPP and convert the result back into a list of engineered
 // properties.
 //
+// If the GetEP cache is switched on, replies are taken from it whenever
+// possible.
+//
 bool 
 KscServerBase::getEP(const KscAvModule *avm,
 		     const KsGetEPParams &params,
 		     KsGetEPResult &result)
+{
+    if ( _ep_cache && _ep_cache->lookup(avm, params, result) ) {
+	setLastResult(KS_ERR_OK);
+	return true;
+    }
+    bool ok = requestEP(avm, params, result);
+    if ( ok && _ep_cache ) {
+	_ep_cache->store(avm, params, result);
+    }
+    return ok;
+} // KscServerBase::getEP
+
+
+bool 
+KscServerBase::requestEP(const KscAvModule *avm,
+			 const KsGetEPParams &params,
+			 KsGetEPResult &result)
 {
     u_long version;
 
@@ -581,11 +764,32 @@ KscServerBase::getEP(const KscAvModule *avm,
 	//
 	return requestByOpcode(KS_GETEP, avm, params, result);
     }
-} // KscServerBase::getEP
+} // KscServerBase::requestEP
 
 
 
     
+// ----------------------------------------------------------------------------
+// A thread probing an unreachable server, so requests don't have to wait
+// for it.
+//
+class KscProbeThread : public PltThread {
+public:
+    KscProbeThread(KscServer &server) : _server(server) { }
+protected:
+    virtual void run();
+private:
+    KscServer &_server;
+}; // class KscProbeThread
+
+
+void
+KscProbeThread::run()
+{
+    _server.requestDone(_server.ping(), true);
+} // KscProbeThread::run
+
+
 //////////////////////////////////////////////////////////////////////
 // class KscServer
 //
@@ -596,11 +800,16 @@ KscServer::KscServer(KsString host,
                      const KsServerDesc &server)
 : KscServerBase(host, server.name),
   server_desc(server),
-  _client_transport(0),
+  _transports(0),
   _rpc_timeout(KSC_RPCCALL_TIMEOUT),
   _retry_wait(0, 0),
   _tries(1),
-  last_ip(INADDR_NONE)
+  last_ip(INADDR_NONE),
+  _backoff_min(KSC_BACKOFF_MIN, 0),
+  _backoff_max(KSC_BACKOFF_MAX, 0),
+  _failures(0),
+  _probing(false),
+  _probe(0)
 {
   initExtTable(); // make mandatory services available
 }
@@ -610,11 +819,16 @@ KscServer::KscServer(KsString host,
 KscServer::KscServer(KsString hostAndName, u_short protocolVersion)
 : KscServerBase(hostAndName),
   server_desc(server_name, protocolVersion),
-  _client_transport(0),
+  _transports(0),
   _rpc_timeout(KSC_RPCCALL_TIMEOUT),
   _retry_wait(0, 0),
   _tries(1),
-  last_ip(INADDR_NONE)
+  last_ip(INADDR_NONE),
+  _backoff_min(KSC_BACKOFF_MIN, 0),
+  _backoff_max(KSC_BACKOFF_MAX, 0),
+  _failures(0),
+  _probing(false),
+  _probe(0)
 {
   initExtTable(); // make mandatory services available
 }
@@ -631,11 +845,23 @@ KscServer::initExtTable()
 
 //////////////////////////////////////////////////////////////////////
 // Destructor
-// We close the TCP connection. 
+// We close the TCP connections. 
 //
 KscServer::~KscServer()
 {
-    destroyTransport();
+    //
+    // A probe still running uses this server object, so wait for it.
+    //
+    if ( _probe ) {
+        _probe->join();
+        delete _probe;
+    }
+    while ( _transports ) {
+        Transport *t = _transports;
+        _transports = t->next;
+        destroyTransport(*t);
+        delete t;
+    }
 }
 
 
@@ -647,24 +873,14 @@ KscServer::setTimeouts(const PltTime &rpc_timeout,
                        const PltTime &retry_wait,         
                        size_t tries)
 {
+    //
+    // The new RPC timeout is applied to the transports when they are
+    // checked out the next time.
+    //
+    PltMutexLock lock(_transport_lock);
     _rpc_timeout = rpc_timeout;
     _retry_wait = retry_wait;
     _tries = tries;
-
-    if( _client_transport ) {
-#if PLT_SYSTEM_SOLARIS || PLT_SYSTEM_HPUX || PLT_SYSTEM_LINUX
-        bool ok = clnt_control(_client_transport,
-                               CLSET_TIMEOUT,
-                               (char *)((struct timeval *)(&_rpc_timeout)));
-#else
-        bool ok = clnt_control(_client_transport,
-                               CLSET_TIMEOUT,
-                               (struct timeval *)(&_rpc_timeout));
-#endif
-        if(!ok) {
-            PltLog::Warning("Failed to specifify timeout value for RPC");
-        }
-    }
 } // KscServer::setTimeouts
 
 void
@@ -672,39 +888,275 @@ KscServer::getTimeouts(PltTime &rpc_timeout,
 		       PltTime &retry_wait,
 		       size_t &tries)
 {
+    PltMutexLock lock(_transport_lock);
     rpc_timeout = _rpc_timeout;
     retry_wait  = _retry_wait;
     tries       = _tries;
 } // KscServer::getTimeouts
 
 
+//////////////////////////////////////////////////////////////////////
+// Accessors to the backoff for unreachable servers.
+//
+void
+KscServer::setBackoff(const PltTimeSpan &min_backoff,
+                      const PltTimeSpan &max_backoff)
+{
+    PltMutexLock lock(_transport_lock);
+    _backoff_min = min_backoff;
+    _backoff_max = max_backoff;
+} // KscServer::setBackoff
+
+void
+KscServer::getBackoff(PltTimeSpan &min_backoff,
+                      PltTimeSpan &max_backoff) const
+{
+    PltMutexLock lock(_transport_lock);
+    min_backoff = _backoff_min;
+    max_backoff = _backoff_max;
+} // KscServer::getBackoff
+
+bool
+KscServer::isReachable() const
+{
+    PltMutexLock lock(_transport_lock);
+    return (_failures == 0) || (_backoff_min == PltTimeSpan(0, 0));
+} // KscServer::isReachable
+
+
+//////////////////////////////////////////////////////////////////////
+// Accessors to what the manager told us about the server.
+//
+u_short
+KscServer::getProtocolVersion() const
+{
+    PltMutexLock lock(_transport_lock);
+    return server_info.server.protocol_version;
+} // KscServer::getProtocolVersion
+
+PltTime
+KscServer::getExpiresAt() const
+{
+    PltMutexLock lock(_transport_lock);
+    return PltTime(server_info.expires_at);
+} // KscServer::getExpiresAt
+
+bool
+KscServer::isLiving() const
+{
+    PltMutexLock lock(_transport_lock);
+    return server_info.living;
+} // KscServer::isLiving
+
+
+// ----------------------------------------------------------------------------
+// Set the timeout for calls through an ONC/RPC client transport.
+//
+static void
+_ksc_setRpcTimeout(CLIENT *transport, const PltTime &timeout)
+{
+#if PLT_SYSTEM_SOLARIS || PLT_SYSTEM_HPUX || PLT_SYSTEM_LINUX
+    bool ok = clnt_control(transport, CLSET_TIMEOUT, 
+                           (char *)((struct timeval *)(&timeout)));
+#else
+    bool ok = clnt_control(transport, CLSET_TIMEOUT, 
+                           (struct timeval *)(&timeout));
+#endif
+    if ( !ok ) {
+        PltLog::Warning("Failed to set the timeout value for the RPC transport");
+    }
+} // _ksc_setRpcTimeout
+
+
+// ----------------------------------------------------------------------------
+// Does a request outcome tell us that the server can't be reached at all?
+// Only failures to find or to connect to the server count. A timeout or a
+// broken connection may well be caused by a single slow or large request,
+// and everything else, even a KS_ERR_GENERIC, means we've been talking to
+// the server.
+//
+static bool
+_ksc_isUnreachable(KS_RESULT result)
+{
+    switch ( result ) {
+    case KS_ERR_SERVERUNKNOWN:
+    case KS_ERR_HOSTUNKNOWN:
+    case KS_ERR_CANTCONTACT:
+    case KS_ERR_NOMANAGER:
+        return true;
+    default:
+        return false;
+    }
+} // _ksc_isUnreachable
+
+
+// ----------------------------------------------------------------------------
+// Decide whether a request may be sent to the server. While the backoff of
+// an unreachable server runs, requests are turned down. Afterwards the first
+// request starts a probe in the background and is turned down, too. Without
+// threads, that request becomes the probe itself (probe is set then).
+//
+bool
+KscServer::admitRequest(bool &probe)
+{
+    probe = false;
+    PltMutexLock lock(_transport_lock);
+    if ( (_failures == 0) || (_backoff_min == PltTimeSpan(0, 0)) ) {
+        return true;
+    }
+    if ( _probing || (PltTime::now() < _retry_at) ) {
+        return false;
+    }
+
+    //
+    // The last probe has reported back, so its thread is about to end.
+    //
+    if ( _probe ) {
+        _probe->join();
+        delete _probe;
+    }
+    _probing = true;
+    _probe = new KscProbeThread(*this);
+    if ( _probe && _probe->start() ) {
+        return false;
+    }
+    delete _probe;
+    _probe = 0;
+    probe = true;
+    return true;
+} // KscServer::admitRequest
+
+
+// ----------------------------------------------------------------------------
+// Record whether the server could be reached. Every failure while requests
+// are still admitted doubles the backoff, but failures of requests sent
+// before the backoff started don't count.
+//
+void
+KscServer::requestDone(bool reachable, bool probe)
+{
+    PltMutexLock lock(_transport_lock);
+    if ( probe ) {
+        _probing = false;
+    }
+    if ( reachable ) {
+        _failures = 0;
+        return;
+    }
+    PltTime now = PltTime::now();
+    if ( _failures && !probe && (now < _retry_at) ) {
+        return;
+    }
+    if ( _failures++ == 0 ) {
+        _backoff = _backoff_min;
+    } else {
+        _backoff += _backoff;
+    }
+    if ( _backoff > _backoff_max ) {
+        _backoff = _backoff_max;
+    }
+    _retry_at = now + _backoff;
+} // KscServer::requestDone
+
+
+// ----------------------------------------------------------------------------
+// A request which could not even be sent tells us nothing about the server,
+// so leave the failures alone. If it was the probe, make room for the next
+// one, though.
+//
+void
+KscServer::requestAbandoned(bool probe)
+{
+    if ( probe ) {
+        PltMutexLock lock(_transport_lock);
+        _probing = false;
+    }
+} // KscServer::requestAbandoned
+
+
+// ----------------------------------------------------------------------------
+// Get a transport for the calling thread. We prefer idle transports which
+// are still connected to the server. If all transports are busy, a new one
+// is set up, which gets connected by the caller. Returns 0 if we run out of
+// memory.
+//
+KscServer::Transport *
+KscServer::checkOut()
+{
+    Transport *t = 0;
+    PltTime timeout;
+    {
+        PltMutexLock lock(_transport_lock);
+        for ( Transport *idle = _transports; idle; idle = idle->next ) {
+            if ( !idle->busy && (!t || (idle->client && !t->client)) ) {
+                t = idle;
+            }
+        }
+        if ( !t ) {
+            t = new Transport;
+            if ( !t ) {
+                return 0;
+            }
+            t->client = 0;
+            t->next = _transports;
+            _transports = t;
+        }
+        t->busy = true;
+        timeout = _rpc_timeout;
+    }
+    if ( t->client ) {
+        _ksc_setRpcTimeout(t->client, timeout);
+    }
+    return t;
+} // KscServer::checkOut
+
+
+// ----------------------------------------------------------------------------
+// Return a transport after use, so other threads can use it, too.
+//
+void
+KscServer::checkIn(Transport *t)
+{
+    PltMutexLock lock(_transport_lock);
+    t->busy = false;
+} // KscServer::checkIn
+
+
+// ----------------------------------------------------------------------------
+// Ping the server using a transport of our own.
+//
+bool
+KscServer::ping()
+{
+    Transport *t = checkOut();
+    if ( !t ) {
+        return false;
+    }
+    if ( !t->client ) {
+        createTransport(*t);
+    }
+    bool ok = t->client
+        && (clnt_call(t->client, 0,
+                      (xdrproc_t) xdr_void, 0,
+                      (xdrproc_t) xdr_void, 0,
+                      KSC_RPCCALL_TIMEOUT) == RPC_SUCCESS);
+    checkIn(t);
+    return ok;
+} // KscServer::ping
+
+
 //////////////////////////////////////////////////////////////////////
 // Get the IP address of the host this server object points to. This
 // helper function also deals with multi-homed hosts (respective hosts
 // with multiple IP addresses) and makes sure that on consecutive
 // requests we will never try the same address twice in a row if the
-// host has more than one address.
+// host has more than one address. Host names are resolved through the
+// KsHostResolver, which caches the addresses and lets several threads
+// resolve names at the same time.
 //
 bool
 KscServer::getHostAddr(struct sockaddr_in *addr)
 {
-#if 0
-    // hostentry struct used for debbugging only
-    //
-    KSC_IP_TYPE ip_terra = inet_addr("134.130.125.131");
-    KSC_IP_TYPE ip_pc212 = inet_addr("134.130.125.76");
-
-    KSC_IP_TYPE *dummy1[3] = { &ip_terra, &ip_pc212, 0 };
-    struct hostent dummy = { 
- 	"", 0, AF_INET, sizeof(KSC_IP_TYPE),
-	(char **)dummy1 };
-    KscHostEnt he(&dummy);
-#endif
-
-    // TODO: check data type for 64 bits
-    const unsigned long INVALID_IP = INADDR_NONE;
-    const unsigned long NO_IP      = INADDR_ANY;
-
     //
     // As of version 1.02 we now support a explicit given port address
     // of the ACPLT/KS manager in the hostname. This is desirable in order
@@ -744,66 +1196,68 @@ KscServer::getHostAddr(struct sockaddr_in *addr)
     // 0, that is, "0.0.0.0". Okay, in principle this is an invalid IP
     // address. It can be only used by a boot-strapping client which
     // do not know yet its own IP address. But we aren't in this
-    // situation here, so "0.0.0.0" is simply forbidden.
+    // situation here, so "0.0.0.0" is simply forbidden. The resolver
+    // takes care of this and of dotted addresses, and remembers the
+    // addresses of DNS names for a while.
     //
-    KSC_IP_TYPE ip;
-    if ( DNS_name.len() ) {
-	ip = inet_addr(DNS_name);
-    } else {
-	ip = INVALID_IP;
-    }
-
-    if ( (ip == INVALID_IP) || (ip == NO_IP) ) {
+    KsHostAddresses addrs;
+    struct in_addr ip, last;
+    if ( !KsHostResolver::resolve(DNS_name, addrs) ) {
+	//
+	// The name lookup failed. So we can't do anything more...
 	//
-        // host_name is no valid dotted IP address, so we try now to
-        // resolve it as a DNS name.
-        //
-#if 1
-	KscHostEnt he(gethostbyname((const char *) DNS_name));
-#endif
-	if ( (he.numIP() > 1) && (he.getIP(0) == last_ip) ) {
-	    ip = he.getIP(1);
-	} else if ( he.numIP() ) {
-	    ip = he.getIP(0);
-	} else {
-	    //
-	    // The name lookup failed. So we can't do anything more...
-	    //
 #if PLT_DEBUG
-            PltString err_msg("Failed to get IP address of host: ", host_name);
-            PltLog::Warning(err_msg);
+	PltString err_msg("Failed to get IP address of host: ", host_name);
+	PltLog::Warning(err_msg);
 #endif
-            return false;
-        }  
-    } 
+	return false;
+    }
 
-    last_ip = ip;    
-    addr->sin_addr.s_addr = ip;
+    PltMutexLock lock(_transport_lock);
+    last.s_addr = last_ip;
+    if ( !addrs.pickIPv4(ip, last) ) {
+	//
+	// The host has no IPv4 address, and that's all we can talk.
+	//
+	return false;
+    }
+
+    last_ip = ip.s_addr;
+    addr->sin_addr = ip;
     return true;
 } // KscServer::getHostAddr
 
 
 // ----------------------------------------------------------------------------
-// Try to establish a RPC connection to the ACPLT/KS server. This includes
-// querying the portmapper and ACPLT/KS manager on the host where the server
-// is supposed to reside. If this function succeeds then it will return true,
-// otherwise false. The last result will be set accordingly.
+// Try to establish a RPC connection to the ACPLT/KS server for the given
+// transport. This includes querying the portmapper and ACPLT/KS manager on
+// the host where the server is supposed to reside. If this function succeeds
+// then it will return true, otherwise false. The last result will be set
+// accordingly. Several threads may connect at the same time, each one its
+// own transport, so we only touch the shared state while it is locked.
 //
 bool
-KscServer::createTransport()
+KscServer::createTransport(Transport &t)
 {
     //
     // Destroy the old transport connection if one exists already.
     // This way we can make a fresh start even after something went
     // really wrong during a previous communication procedure.
     //
-    destroyTransport();
+    destroyTransport(t);
 
     //
     // Delete the cached data as the server may have been restarted.
     //
-    ext_opcodes.reset();
-    initExtTable();
+    KsServerDesc desc;
+    PltTime timeout;
+    {
+        PltMutexLock lock(_transport_lock);
+        ext_opcodes.reset();
+        initExtTable();
+        desc = server_desc;
+        timeout = _rpc_timeout;
+    }
 
     struct sockaddr_in host_addr; 
     int socket = RPC_ANYSOCK;
@@ -816,7 +1270,7 @@ KscServer::createTransport()
     // on the status member, but just in case someone forgets this...
     //
     if ( !getHostAddr(&host_addr) ) {
-        _last_result = KS_ERR_HOSTUNKNOWN;
+        setLastResult(KS_ERR_HOSTUNKNOWN);
         return false;
     }
 
@@ -844,11 +1298,11 @@ KscServer::createTransport()
             if ( (port_no > 0l) && (port_no <= 65535l) ) {
                 port = (unsigned short) port_no;
             } else {
-                _last_result = KS_ERR_MALFORMEDPATH;
+                setLastResult(KS_ERR_MALFORMEDPATH);
                 return false;
             }
         } else {
-            _last_result = KS_ERR_MALFORMEDPATH;
+            setLastResult(KS_ERR_MALFORMEDPATH);
             return false;
         }
     }
@@ -865,7 +1319,8 @@ KscServer::createTransport()
     // server implements (especially for transparently switching between
     // the GetEP/GetPP services in the client).
     //
-    if ( !getServerDesc(&host_addr, port, server_desc, server_info) ) {
+    KsGetServerResult info;
+    if ( !getServerDesc(&host_addr, port, desc, info) ) {
 	//
 	// We could not contact the ACPLT/KS manager. In this case,
 	// _last_result has been already set by getServerDesc(),
@@ -875,7 +1330,11 @@ KscServer::createTransport()
 	return false;
     }
     
-    if ( server_info.result != KS_ERR_OK ) {
+    {
+        PltMutexLock lock(_transport_lock);
+        server_info = info;
+    }
+    if ( info.result != KS_ERR_OK ) {
         //
         // If the ACPLT/KS manager returned a service error, then we
         // will fall back to the error "unknown server". If we would
@@ -884,7 +1343,7 @@ KscServer::createTransport()
         // from the server lookup and not from the requested operation
         // itself.
         //
-        _last_result = KS_ERR_SERVERUNKNOWN;
+        setLastResult(KS_ERR_SERVERUNKNOWN);
         PLT_DMSG("Unknown server " << getHostAndName() << endl);
         return false;
     }
@@ -894,13 +1353,16 @@ KscServer::createTransport()
     // version number for the next reconnection procedure, in case the
     // connection should be lost.
     //
-    server_desc.protocol_version = server_info.server.protocol_version;
+    {
+        PltMutexLock lock(_transport_lock);
+        server_desc.protocol_version = info.server.protocol_version;
+    }
 
 #if PLT_DEBUG_PEDANTIC
     cerr << "Trying to connect server at port "
-         << server_info.port
+         << info.port
 	 << " running protocol version "
-	 << server_info.server.protocol_version
+	 << info.server.protocol_version
          << endl;
 #endif
 
@@ -915,17 +1377,17 @@ KscServer::createTransport()
     // Volume 1: "Networking APIs: Sockets and XTI", Second Edition, p. 542
     //
     host_addr.sin_family = AF_INET;
-    host_addr.sin_port = htons(server_info.port);
+    host_addr.sin_port = htons(info.port);
     
     // TODO: do a timeout-controllable connect(). See R. Stevens for details
-    _client_transport = clnttcp_create(&host_addr,
-				       KS_RPC_PROGRAM_NUMBER,
-				       server_desc.protocol_version,
-				       &socket,
-				       0, 0);
-
-    if( !_client_transport ) {
-        _last_result = KS_ERR_CANTCONTACT;
+    t.client = clnttcp_create(&host_addr,
+			      KS_RPC_PROGRAM_NUMBER,
+			      info.server.protocol_version,
+			      &socket,
+			      0, 0);
+
+    if( !t.client ) {
+        setLastResult(KS_ERR_CANTCONTACT);
         return false;
     }
 
@@ -933,37 +1395,28 @@ KscServer::createTransport()
     // Now set the timeout parameter for this particular communication
     // transport.
     //
-#if PLT_SYSTEM_SOLARIS || PLT_SYSTEM_HPUX || PLT_SYSTEM_LINUX
-    bool ok = clnt_control(_client_transport, CLSET_TIMEOUT, 
-                           (char *)((struct timeval *)(&_rpc_timeout)));
-#else
-    bool ok = clnt_control(_client_transport, CLSET_TIMEOUT, 
-                           (struct timeval *)(&_rpc_timeout));
-#endif
-    if ( !ok ) {
-        PltLog::Warning("Failed to set the timeout value for the RPC transport");
-    }
+    _ksc_setRpcTimeout(t.client, timeout);
 
-    _last_result = KS_ERR_OK;
+    setLastResult(KS_ERR_OK);
     return true;
 } // KscServer::createTransport
 
 
 // ----------------------------------------------------------------------------
-// Destroy the ONC/RPC transport, that is basically the connection to the
+// Destroy an ONC/RPC transport, that is basically a connection to the
 // ACPLT/KS server this object is a proxy for. In addition to getting rid of
-// the transport, we also clear the negotiator cache, so no spurious nego-
+// the transport, we also clear its negotiator cache, so no spurious nego-
 // tiator problems can occur due to fired negotiators getting in the way.
 //
 void 
-KscServer::destroyTransport()
+KscServer::destroyTransport(Transport &t)
 {
     //
     // Shut down the ONC/RPC client transport.
     //
-    if ( _client_transport ) {
-        clnt_destroy(_client_transport);
-        _client_transport = 0;
+    if ( t.client ) {
+        clnt_destroy(t.client);
+        t.client = 0;
     }
     //
     // Get rid of all old negotiatiors which need to be fired whenever the
@@ -971,7 +1424,8 @@ KscServer::destroyTransport()
     // for new reconnected transports as the A/V state is lost when a
     // connection goes away.
     //
-    neg_table.reset();
+    PltMutexLock lock(_ksc_clientLock);
+    t.neg_table.reset();
 } // KscServer::destroyTransport
 
 
@@ -980,14 +1434,31 @@ KscServer::destroyTransport()
 bool
 KscServer::getServerVersion(u_long &version)
 {
+    bool probe;
+    if ( !admitRequest(probe) ) {
+        setLastResult(KS_ERR_CANTCONTACT);
+        return false;
+    }
+    Transport *t = checkOut();
+    if ( !t ) {
+        setLastResult(KS_ERR_GENERIC);
+        requestAbandoned(probe);
+        return false;
+    }
     // FIXME retry count?
-    if ( !_client_transport ) {
-        if( !createTransport() ) {
-            if ( !reconnectServer(_last_result) ) {
+    if ( !t->client ) {
+        if( !createTransport(*t) ) {
+            if ( !reconnectServer(getLastResult()) ) {
+                checkIn(t);
+                requestDone(!_ksc_isUnreachable(getLastResult()), probe);
                 return false;
             }
         }
     }
+    checkIn(t);
+    requestDone(true, probe);
+
+    PltMutexLock lock(_transport_lock);
     version = server_desc.protocol_version;
     return true;
 } // KscServer::getServerVersion
@@ -1041,17 +1512,25 @@ KscServer::getStateUpdate()
 // based on the retries already carried out and the exact communication
 // failure. Note that this function does *NOT* set the last result.
 // If reconnectServer() decides that a reconnect is possible, then it
-// will sleep (configurable) and then try to reopen a communication
-// transport.
+// will sleep (configurable) and then try to reopen the communication
+// transport which failed.
 //
 bool
-KscServer::reconnectServer(size_t try_count, enum clnt_stat errcode)
+KscServer::reconnectServer(size_t try_count, enum clnt_stat errcode,
+                           Transport &t)
 {
+    size_t tries;
+    PltTime retry_wait;
+    {
+        PltMutexLock lock(_transport_lock);
+        tries = _tries;
+        retry_wait = _retry_wait;
+    }
     //
     // Have we reached the maximum number of tries? Then we'll bail out
     // in every case. No more chances. Game over. Tilt.
     //
-    if ( try_count >= _tries ) {
+    if ( try_count >= tries ) {
         return false;
     }
 
@@ -1069,9 +1548,9 @@ KscServer::reconnectServer(size_t try_count, enum clnt_stat errcode)
 	// timespan before trying to re-establish a communication
 	// transport.
 	//
-        _retry_wait.sleep();
-        createTransport();
-        return reconnectServer(_last_result);
+        retry_wait.sleep();
+        createTransport(t);
+        return reconnectServer(getLastResult());
     } else {
 	//
 	// No. You loose.
@@ -1088,24 +1567,24 @@ KscServer::setResultAfterService(enum clnt_stat errcode)
 {
     switch ( errcode ) {
     case RPC_SUCCESS :
-        _last_result = KS_ERR_OK;
+        setLastResult(KS_ERR_OK);
         return;
     case RPC_TIMEDOUT:
-        _last_result = KS_ERR_TIMEOUT;
+        setLastResult(KS_ERR_TIMEOUT);
         return;
     case RPC_CANTSEND:
     case RPC_CANTRECV:
-	_last_result = KS_ERR_NETWORKERROR;
+	setLastResult(KS_ERR_NETWORKERROR);
 	return;
     case RPC_CANTENCODEARGS:
     case RPC_CANTDECODERES:
-	_last_result = KS_ERR_GENERIC;
+	setLastResult(KS_ERR_GENERIC);
 	return;
     case RPC_CANTDECODEARGS:
-	_last_result = KS_ERR_NETWORKERROR;
+	setLastResult(KS_ERR_NETWORKERROR);
 	return;
     default:
-        _last_result = KS_ERR_GENERIC;
+        setLastResult(KS_ERR_GENERIC);
     }
 } // KscServer::setResultAfterService
 
@@ -1282,10 +1761,10 @@ KscServer::getServerDesc(struct sockaddr_in *host_addr,
 	    case RPC_PROGNOTREGISTERED:
 	    case RPC_PROGUNAVAIL:
 	    case RPC_PROGVERSMISMATCH:
-		_last_result = KS_ERR_NOMANAGER;
+		setLastResult(KS_ERR_NOMANAGER);
 		break;
 	    default:
-		_last_result = KS_ERR_CANTCONTACT;
+		setLastResult(KS_ERR_CANTCONTACT);
 	    }
 	    return false;
 	}
@@ -1333,20 +1812,20 @@ KscServer::getServerDesc(struct sockaddr_in *host_addr,
 	clnt_destroy(transport);
 
 	if ( errcode == RPC_SUCCESS ) {
-	    _last_result = KS_ERR_OK;
+	    setLastResult(KS_ERR_OK);
 	    return true;
 	}
 	if ( errcode != RPC_PROGVERSMISMATCH ) {
 	    PLT_DMSG("function call to MANAGER failed, error code " << (unsigned) errcode << endl);
 
-	    _last_result = KS_ERR_CANTCONTACT;
+	    setLastResult(KS_ERR_CANTCONTACT);
 	    return false;
 	}
 	//
 	// Step down one version number and retry the call to the MANAGER.
 	//
     } while ( --version >= KS_MINPROTOCOL_VERSION ); 
-    _last_result = KS_ERR_CANTCONTACT;
+    setLastResult(KS_ERR_CANTCONTACT);
     return false;
 } // KscServer::getServerDesc
 
@@ -1365,11 +1844,16 @@ KscServer::requestService(const KsString &extension,
                           KsResult &result)
 {
     u_long opcode = 0;
+    bool known;
     //
     // Lookup the major opcode in cache. If the lookup fails then query the
     // ACPLT/KS server (ask for /vendor/extensions/pipapo/major_opcode).
     //
-    if( !ext_opcodes.query(extension, opcode) ) {
+    {
+        PltMutexLock lock(_transport_lock);
+        known = ext_opcodes.query(extension, opcode);
+    }
+    if( !known ) {
 	//
       	// Fetch the opcode from the ACPLT/KS server.
       	// NOTE: It is safe to use a KscVariable as
@@ -1390,27 +1874,28 @@ KscServer::requestService(const KsString &extension,
 	// wise return the error code resulting from the failed communication.
 	//
 	if ( !var.hasValidPath() ) {
-	    _last_result = KS_ERR_NOTIMPLEMENTED;
+	    setLastResult(KS_ERR_NOTIMPLEMENTED);
 	    return false;
 	}
 	if ( !var.getUpdate() ) {
-	    _last_result = var.getLastResult();
-	    if ( (_last_result == KS_ERR_BADNAME) ||
-	         (_last_result == KS_ERR_BADPATH) ) {
-		_last_result = KS_ERR_NOTIMPLEMENTED;
+	    KS_RESULT var_result = var.getLastResult();
+	    if ( (var_result == KS_ERR_BADNAME) ||
+	         (var_result == KS_ERR_BADPATH) ) {
+		var_result = KS_ERR_NOTIMPLEMENTED;
 	    }
+	    setLastResult(var_result);
 	    return false;
 	}
 	
 	hval = var.getValue();
 	if ( !hval ) {
-	    _last_result = KS_ERR_NOTIMPLEMENTED;
+	    setLastResult(KS_ERR_NOTIMPLEMENTED);
 	    return false;
 	}
 
 	KsIntValue *pval = PLT_DYNAMIC_PCAST(KsIntValue, hval.getPtr());
 	if ( !pval ) {
-	    _last_result = KS_ERR_NOTIMPLEMENTED;
+	    setLastResult(KS_ERR_NOTIMPLEMENTED);
 	    return false;
 	}
 
@@ -1507,7 +1992,28 @@ KscServer::requestByOpcode(u_long service,
     //
     // Init
     //
-    _last_result = KS_ERR_OK;
+    setLastResult(KS_ERR_OK);
+
+    //
+    // Don't keep the caller waiting for a server which couldn't be
+    // reached just a moment ago.
+    //
+    bool probe;
+    if ( !admitRequest(probe) ) {
+        setLastResult(KS_ERR_CANTCONTACT);
+        return false;
+    }
+
+    //
+    // Get a transport of our own, so other threads can talk to the same
+    // server meanwhile.
+    //
+    Transport *t = checkOut();
+    if ( !t ) {
+        setLastResult(KS_ERR_GENERIC);
+        requestAbandoned(probe);
+        return false;
+    }
     
     //
     // Create client transport for the communication with the ACPLT/KS
@@ -1515,9 +2021,11 @@ KscServer::requestByOpcode(u_long service,
     // host or server then we will fail at this point and return to the
     // caller immediately. It makes no sense here to try reconnects yet.
     //
-    if ( !_client_transport ) {
-        if( !createTransport() ) {
-            if ( !reconnectServer(_last_result) ) {
+    if ( !t->client ) {
+        if( !createTransport(*t) ) {
+            if ( !reconnectServer(getLastResult()) ) {
+                checkIn(t);
+                requestDone(!_ksc_isUnreachable(getLastResult()), probe);
                 return false;
             }
         }
@@ -1540,7 +2048,7 @@ KscServer::requestByOpcode(u_long service,
         cerr << "Trying for the " << (try_count+1) << "th. time" << endl;
 #endif
 
-        if ( _client_transport ) {
+        if ( t->client ) {
 	    //
 	    // Now if we have an ONC/RPC client transport, we can try to
 	    // make a call.
@@ -1551,7 +2059,7 @@ KscServer::requestByOpcode(u_long service,
 	    // (connection) might have been killed just the last round so
 	    // we might get a fresh negotiator for the fresh connection.
 	    //
-	    KscNegotiator *negotiator = getNegotiator(avm);
+	    KscNegotiator *negotiator = getNegotiator(*t, avm);
 
 	    //
 	    // Set up the ingoing and outcomming service parameters and
@@ -1561,8 +2069,8 @@ KscServer::requestByOpcode(u_long service,
 	    KscRequestInStruct inData(negotiator, &params);
 	    KscRequestOutStruct outData(negotiator, &result);
 
-            _last_result = KS_ERR_OK;
-            errcode = clnt_call(_client_transport, service,
+            setLastResult(KS_ERR_OK);
+            errcode = clnt_call(t->client, service,
 				(xdrproc_t) KscRequestInHelper,
 				(char *) &inData,
 				(xdrproc_t) KscRequestOutHelper,
@@ -1577,7 +2085,7 @@ KscServer::requestByOpcode(u_long service,
             errcode = RPC_FAILED;
         }
     } while ( (errcode != RPC_SUCCESS)
-	      && reconnectServer(++try_count, errcode) );
+	      && reconnectServer(++try_count, errcode, *t) );
 
     //
     // If the communication itself failed (*NOT* a failure on the ACPLT/KS
@@ -1588,12 +2096,14 @@ KscServer::requestByOpcode(u_long service,
     // and discard a potential service reply very soon.
     //
     if ( errcode != RPC_SUCCESS ) {
-        destroyTransport();
+        destroyTransport(*t);
     }
+    checkIn(t);
 
-    if(_last_result == KS_ERR_OK) {
+    if(getLastResult() == KS_ERR_OK) {
         setResultAfterService(errcode);
     }
+    requestDone(!_ksc_isUnreachable(getLastResult()), probe);
     
 #if PLT_DEBUG
     if ( errcode == RPC_SUCCESS ) {
@@ -1609,7 +2119,7 @@ KscServer::requestByOpcode(u_long service,
     // happened or not. It can get the details with getLastResult()
     // later...
     //
-    return _last_result == KS_ERR_OK;
+    return getLastResult() == KS_ERR_OK;
 } // KscServer::requestByOpcode
 
 
@@ -1672,13 +2182,14 @@ KscServer::exgData(const KscAvModule *avm,
 //
 // But now for the next function below. It returns a suitable nego-
 // tiator for the given A/V module object. If no such negotiator for
-// this server currently exists, then a new negotiator is created.
+// this transport (connection) to the server currently exists, then a
+// new negotiator is created.
 //
 // CAUTION:
 //   pointers returned by this function are for temporary use only
 //
 KscNegotiator *
-KscServer::getNegotiator(const KscAvModule *avm)
+KscServer::getNegotiator(Transport &t, const KscAvModule *avm)
 {
     //
     // If no A/V module object has been specified, then fall back
@@ -1699,12 +2210,13 @@ KscServer::getNegotiator(const KscAvModule *avm)
 
     if ( avm ) {
 	//
-        // Try to find a negotiator in the cache of this server object.
+        // Try to find a negotiator in the cache of this transport.
         //
+        PltMutexLock lock(_ksc_clientLock);
         PltKeyPlainConstPtr<KscAvModule> tkey(avm);
         KscNegotiatorHandle hneg;
 
-        if ( neg_table.query(tkey, hneg) ) {
+        if ( t.neg_table.query(tkey, hneg) ) {
 	    //
             // Okay, we've found one. Return it to the caller.
             //
@@ -1718,7 +2230,7 @@ KscServer::getNegotiator(const KscAvModule *avm)
             //
             hneg = avm->getNegotiator(this);
             if ( hneg ) {
-                if ( neg_table.add(tkey, hneg) ) {
+                if ( t.neg_table.add(tkey, hneg) ) {
                     return hneg.getPtr();
                 }
             }
@@ -1749,14 +2261,18 @@ void
 KscServer::dismissNegotiator(const KscAvModule *avm)
 {
     //
-    // Try to find a negotiator in the cache of this server object for the
-    // given A/V module. Note that there can be only at most one negotiator
-    // for a given A/V module and server connection.
+    // Try to find a negotiator in the caches of the transports of this
+    // server object for the given A/V module. Note that there can be only
+    // at most one negotiator for a given A/V module and server connection.
     //
     if ( avm != 0 ) {
+	PltMutexLock lock(_transport_lock);
+	PltMutexLock negLock(_ksc_clientLock);
 	PltKeyPlainConstPtr<KscAvModule> key(avm);
-	KscNegotiatorHandle hNegotiator;
-    	neg_table.remove(key, hNegotiator);
+	for ( Transport *t = _transports; t; t = t->next ) {
+	    KscNegotiatorHandle hNegotiator;
+	    t->neg_table.remove(key, hNegotiator);
+	}
     }
 } // KscServer::dismissNegotiator
 
@@ -0,0 +1,592 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+
+#include "ks/clntcon.h"
+
+#if PLT_USE_BUFFERED_STREAMS
+
+#include "plt/log.h"
+
+#if PLT_SYSTEM_NT
+#define KSC_ERRNO WSAGetLastError()
+#else
+#include <errno.h>
+#define KSC_ERRNO errno
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// class KscEventLoop
+//////////////////////////////////////////////////////////////////////
+
+KscEventLoop::KscEventLoop()
+: _cnx_manager(new KssConnectionManager())
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+
+KscEventLoop::~KscEventLoop()
+{
+    while ( !_timer_queue.isEmpty() ) {
+        delete _timer_queue.removeFirst();
+    }
+    delete _cnx_manager;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscEventLoop::isOk() const
+{
+    return _cnx_manager && _cnx_manager->isOk();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+KssConnectionManager *
+KscEventLoop::getConnectionManager() const
+{
+    return _cnx_manager;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscEventLoop::addTimerEvent(KsTimerEvent *event)
+{
+    return _timer_queue.add(event);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscEventLoop::removeTimerEvent(KsTimerEvent *event)
+{
+    return _timer_queue.remove(event);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int
+KscEventLoop::getFdSets(fd_set &readables, fd_set &writeables)
+{
+    return _cnx_manager->getFdSets(readables, writeables);
+}
+
+//////////////////////////////////////////////////////////////////////
+// The time to wait is limited by the next timer event and by the
+// earliest connection timeout.
+//
+bool
+KscEventLoop::getTimeout(KsTime &timeout)
+{
+    bool has_timeout = false;
+    if ( !_timer_queue.isEmpty() ) {
+        timeout = _timer_queue.peek()->remainingTime();
+        has_timeout = true;
+    }
+    if ( _cnx_manager->mayHaveTimeout() ) {
+        KsTime cnx_timeout(_cnx_manager->getEarliestTimeoutSpan());
+        if ( !has_timeout || (cnx_timeout < timeout) ) {
+            timeout = cnx_timeout;
+        }
+        has_timeout = true;
+    }
+    return has_timeout;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Hand the connections which need attention to their inter-server
+// connections, just like the server object does.
+//
+void
+KscEventLoop::serveConnections()
+{
+    for ( ; ; ) {
+        KssConnection *con = _cnx_manager->getNextServiceableConnection();
+        if ( !con ) {
+            break;
+        }
+        KssConnectionAttentionInterface *attn = con->getAttentionPartner();
+        bool reactivate = true;
+        if ( attn ) {
+            reactivate = attn->attention(*con);
+        } else {
+            PltLog::Error("KscEventLoop::serveConnections(): "
+                          "connection without attention partner.");
+        }
+        if ( reactivate ) {
+            _cnx_manager->trackConnection(*con);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscEventLoop::serveTimers()
+{
+    while ( !_timer_queue.isEmpty()
+            && _timer_queue.peek()->remainingTime().isZero() ) {
+        _timer_queue.removeFirst()->trigger();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscEventLoop::processEvents(fd_set &readables, fd_set &writeables,
+                            int ready)
+{
+    if ( ready > 0 ) {
+        _cnx_manager->processConnections(readables, writeables);
+    }
+    if ( _cnx_manager->mayHaveTimeout() ) {
+        _cnx_manager->processTimeout();
+    }
+    serveConnections();
+    serveTimers();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Wait for something to happen on the connections, but not longer
+// than the next timer event or connection timeout, and not longer
+// than the caller wants us to.
+//
+bool
+KscEventLoop::serveEvents(const KsTime *timeout)
+{
+    serveConnections();
+
+    KsTime wait;
+    bool has_wait = getTimeout(wait);
+    if ( timeout && (!has_wait || (*timeout < wait)) ) {
+        wait = *timeout;
+        has_wait = true;
+    }
+
+    fd_set readables, writeables;
+    int numfds = getFdSets(readables, writeables);
+#if PLT_SYSTEM_HPUX && PLT_SYSTEM_HPUX_MAJOR<10
+    int ready = select(numfds, (int *) &readables, (int *) &writeables, 0,
+                       has_wait ? &wait : 0);
+#else
+    int ready = select(numfds, &readables, &writeables, 0,
+                       has_wait ? &wait : 0);
+#endif
+    if ( (ready < 0) && (KSC_ERRNO != EINTR) ) {
+        PltLog::Error("KscEventLoop::serveEvents(): select failed.");
+        return false;
+    }
+    processEvents(readables, writeables, ready);
+    return ready > 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// class KscConnectionServer
+//////////////////////////////////////////////////////////////////////
+
+KscConnectionServer::Connection::Connection(KscConnectionServer &server,
+                                            KscEventLoop &loop)
+: KssInterKsServerConnection(server.getHost(), server.getName(), &loop),
+  _server(server)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscConnectionServer::Connection::async_attention(
+    KssInterKsServerConnectionOperations op)
+{
+    _server.attention(op);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+KscConnectionServer::KscConnectionServer(KscEventLoop &loop,
+                                         KsString hostAndName)
+: KscServerBase(hostAndName),
+  _loop(loop),
+  _connection(*this, loop),
+  _busy(false),
+  _service(0),
+  _params(0),
+  _result(0),
+  _protocol_version(0)
+{
+    _ext_opcodes.add(KsString("ks_core"), 0);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+KscConnectionServer::~KscConnectionServer()
+{
+    _connection.close();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscConnectionServer::setTimeouts(unsigned long connect_timeout,
+                                 unsigned long call_timeout)
+{
+    _connection.setTimeouts(connect_timeout, call_timeout);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscConnectionServer::getTimeouts(unsigned long &connect_timeout,
+                                 unsigned long &call_timeout) const
+{
+    _connection.getTimeouts(connect_timeout, call_timeout);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Start a request. If there is no open connection yet, it is opened
+// first and the request is sent as soon as that succeeded. Without
+// parameters, we only open the connection.
+//
+bool
+KscConnectionServer::beginRequest(u_long service,
+                                  const KscAvModule *avm,
+                                  const KsXdrAble &params,
+                                  KsResult &result)
+{
+    if ( _busy ) {
+        setLastResult(KS_ERR_GENERIC);
+        return false;
+    }
+    if ( !avm ) {
+        avm = getAvModule();
+    }
+    if ( avm && (avm->typeCode() != KS_AUTH_NONE) ) {
+        setLastResult(KS_ERR_NOTIMPLEMENTED);
+        return false;
+    }
+    _service = service;
+    _params = &params;
+    _result = &result;
+    _busy = true;
+    setLastResult(KS_ERR_OK);
+
+    if ( _connection.getState()
+         == KssInterKsServerConnection::ISC_STATE_OPEN ) {
+        return sendRequest();
+    }
+    if ( !_connection.open() ) {
+        _busy = false;
+        setLastResult(_connection.getLastResult());
+        return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscConnectionServer::isBusy() const
+{
+    return _busy;
+}
+
+//////////////////////////////////////////////////////////////////////
+// A request can't be taken back once it is on its way, so drop the
+// connection. A reply arriving later will then go nowhere.
+//
+void
+KscConnectionServer::cancelRequest()
+{
+    if ( _busy ) {
+        _connection.close();
+        _busy = false;
+        _params = 0;
+        _result = 0;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Serialize the request using the A/V NONE scheme into the stream of
+// the connection and put it on its way.
+//
+bool
+KscConnectionServer::sendRequest()
+{
+    if ( !_params ) {
+        finishRequest(KS_ERR_OK);
+        return true;
+    }
+    if ( !_connection.beginSend(_service) ) {
+        finishRequest(_connection.getLastResult());
+        return false;
+    }
+    enum_t avscheme = KS_AUTH_NONE;
+    if ( !ks_xdre_enum(_connection.getXdr(), &avscheme)
+         || !_params->xdrEncode(_connection.getXdr()) ) {
+        finishRequest(KS_ERR_GENERIC);
+        return false;
+    }
+    if ( !_connection.endSend() ) {
+        finishRequest(_connection.getLastResult());
+        return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscConnectionServer::finishRequest(KS_RESULT result)
+{
+    _busy = false;
+    _params = 0;
+    _result = 0;
+    setLastResult(result);
+    requestCompleted(result);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscConnectionServer::requestCompleted(KS_RESULT)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// Called by the connection when the open has completed or a reply
+// has arrived, or when either failed.
+//
+void
+KscConnectionServer::attention(
+    KssInterKsServerConnection::KssInterKsServerConnectionOperations op)
+{
+    if ( !_busy ) {
+        return;
+    }
+    if ( _connection.getState()
+         != KssInterKsServerConnection::ISC_STATE_OPEN ) {
+        KS_RESULT result = _connection.getLastResult();
+        finishRequest(result != KS_ERR_OK ? result : KS_ERR_NETWORKERROR);
+        return;
+    }
+    switch ( op ) {
+    case KssInterKsServerConnection::ISC_OP_OPEN:
+        _protocol_version = _connection.getProtocolVersion();
+        sendRequest();
+        break;
+    case KssInterKsServerConnection::ISC_OP_CALL:
+        if ( _connection.receive(*_result) ) {
+            finishRequest(KS_ERR_OK);
+        } else {
+            finishRequest(_connection.getLastResult());
+        }
+        break;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Run the event loop until the request has completed.
+//
+bool
+KscConnectionServer::waitForRequest()
+{
+    while ( _busy ) {
+        //
+        // A request under way always has a timeout pending. Without one,
+        // nothing will ever complete the request.
+        //
+        KsTime timeout;
+        if ( !_loop.getTimeout(timeout) ) {
+            cancelRequest();
+            setLastResult(KS_ERR_GENERIC);
+            return false;
+        }
+        _loop.serveEvents();
+    }
+    return getLastResult() == KS_ERR_OK;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscConnectionServer::requestByOpcode(u_long service,
+                                     const KscAvModule *avm,
+                                     const KsXdrAble &params,
+                                     KsResult &result)
+{
+    return beginRequest(service, avm, params, result)
+        && waitForRequest();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Opening the connection tells us about the protocol version.
+//
+bool
+KscConnectionServer::getServerVersion(u_long &version)
+{
+    if ( _connection.getState()
+         != KssInterKsServerConnection::ISC_STATE_OPEN ) {
+        if ( _busy ) {
+            setLastResult(KS_ERR_GENERIC);
+            return false;
+        }
+        _busy = true;
+        _params = 0;
+        setLastResult(KS_ERR_OK);
+        if ( !_connection.open() ) {
+            _busy = false;
+            setLastResult(_connection.getLastResult());
+            return false;
+        }
+        if ( !waitForRequest() ) {
+            return false;
+        }
+    }
+    version = _protocol_version;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscConnectionServer::getPP(const KscAvModule *avm,
+                           const KsGetPPParams &params,
+                           KsGetPPResult &result)
+{
+    return requestByOpcode(KS_GETPP, avm, params, result);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscConnectionServer::getVar(const KscAvModule *avm,
+                            const KsGetVarParams &params,
+                            KsGetVarResult &result)
+{
+    return requestByOpcode(KS_GETVAR, avm, params, result);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscConnectionServer::setVar(const KscAvModule *avm,
+                            const KsSetVarParams &params,
+                            KsSetVarResult &result)
+{
+    return requestByOpcode(KS_SETVAR, avm, params, result);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscConnectionServer::exgData(const KscAvModule *avm,
+                             const KsExgDataParams &params,
+                             KsExgDataResult &result)
+{
+    return requestByOpcode(KS_EXGDATA, avm, params, result);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Like KscServer::requestService(), but the major opcode is read
+// through this very server and remembered afterwards.
+//
+bool
+KscConnectionServer::requestService(const KsString &extension,
+                                    u_short minor_opcode,
+                                    const KscAvModule *avm,
+                                    const KsXdrAble &params,
+                                    KsResult &result)
+{
+    u_long opcode = 0;
+    if ( !_ext_opcodes.query(extension, opcode) ) {
+        KsGetVarParams var_params(1);
+        var_params.identifiers[0] = "/vendor/extensions/";
+        var_params.identifiers[0] += extension;
+        var_params.identifiers[0] += "/major_opcode";
+        KsGetVarResult var_result(1);
+
+        if ( !getVar(avm, var_params, var_result) ) {
+            return false;
+        }
+        KS_RESULT res = var_result.result;
+        if ( (res == KS_ERR_OK) && (var_result.items.size() == 1) ) {
+            res = var_result.items[0].result;
+        }
+        if ( res != KS_ERR_OK ) {
+            if ( (res == KS_ERR_BADNAME) || (res == KS_ERR_BADPATH) ) {
+                res = KS_ERR_NOTIMPLEMENTED;
+            }
+            setLastResult(res);
+            return false;
+        }
+        KsCurrPropsHandle hprops = var_result.items[0].item;
+        KsVarCurrProps *props = PLT_DYNAMIC_PCAST(KsVarCurrProps,
+                                                  hprops.getPtr());
+        KsIntValue *pval = props
+            ? PLT_DYNAMIC_PCAST(KsIntValue, props->value.getPtr())
+            : 0;
+        if ( !pval ) {
+            setLastResult(KS_ERR_NOTIMPLEMENTED);
+            return false;
+        }
+        opcode = (u_long)((long)(*pval));
+        _ext_opcodes.add(extension, opcode);
+    }
+
+    opcode <<= 16;
+    opcode |= minor_opcode;
+
+    return requestByOpcode(opcode, avm, params, result);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+u_short
+KscConnectionServer::getProtocolVersion() const
+{
+    return _protocol_version;
+}
+
+//////////////////////////////////////////////////////////////////////
+// We don't ask the manager ourselves, so we can only tell whether
+// the server talks to us.
+//
+PltTime
+KscConnectionServer::getExpiresAt() const
+{
+    return PltTime(0, 0);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscConnectionServer::isLiving() const
+{
+    return _protocol_version != 0;
+}
+
+#endif // PLT_USE_BUFFERED_STREAMS
+
+//////////////////////////////////////////////////////////////////////
+// EOF clntcon.cpp
+//////////////////////////////////////////////////////////////////////
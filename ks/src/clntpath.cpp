@@ -28,6 +28,13 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "ks/clntpath.h"
+#include "plt/thread.h"
+
+#if PLT_SEE_ALL_TEMPLATES
+#include "plt/hashtable.h"
+#else
+#include "plt/hashtable_impl.h"
+#endif
 
 //////////////////////////////////////////////////////////////////////
 
@@ -782,5 +789,472 @@ KscPathParser::resolve(const char *sz) const
     return final;
 } // KscPathParser::resolve
 
+
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// class KscPathHandle
+
+//
+// The kind of delimiter in front of a path component is kept in the lower
+// bits of a component id, so "/a" and ".a" get different ids. A "/." at the
+// beginning of a path (a part of the root domain) is a delimiter of its own,
+// as it is for KscPath::inCommon().
+//
+enum {
+    KSC_PCK_DOMAIN   = 0, // "/name"
+    KSC_PCK_PART     = 1, // ".name"
+    KSC_PCK_ROOTPART = 2, // "/.name" at the beginning of a path
+    KSC_PCK_BITS     = 2
+};
+
+//
+// Names of path components and host/server parts are interned, too, so
+// every name gets a number as long as some path is using it.
+//
+struct KscPathName
+{
+    KsString      name;
+    u_long        id;
+    unsigned long refcount;
+};
+
+struct KscPathComponent
+{
+    u_long       id;     // name id and kind of delimiter
+    size_t       offset; // index of the delimiter within the path
+    KscPathName *name;
+};
+
+class KscPathHandle::Entry
+{
+public:
+    Entry(const KsString &key, const KsString &hostserver,
+          const KscPath &path);
+    ~Entry();
+
+    bool internNames();
+    void releaseNames();
+
+    KsString          key;        // the full resource locator
+    KsString          hostserver; // "//host/server" or empty
+    KscPath           path;       // "/path/to/object"
+    unsigned long     hashValue;
+    KscPathName      *hostserverName;
+    size_t            count;      // number of components
+    KscPathComponent *components;
+    volatile long     refcount;
+
+private:
+    Entry(const Entry &); // forbidden
+    Entry &operator = (const Entry &); // forbidden
+}; // class KscPathHandle::Entry
+
+//
+// The tables are only created when the first path is interned, so handles
+// can be used during static initialization, and are then kept for good.
+// They're protected by _ksc_pathLock, with the exception of taking another
+// reference to an entry through a handle which is already holding one.
+//
+static PltMutex _ksc_pathLock;
+static PltHashTable<KsString, KscPathHandle::Entry *> *_ksc_paths = 0;
+static PltHashTable<KsString, KscPathName *> *_ksc_pathNames = 0;
+static u_long _ksc_nextNameId = 0;
+
+static const KsString _ksc_emptyHostAndServer;
+static const KscPath _ksc_emptyPath;
+
+
+// ----------------------------------------------------------------------------
+// Intern a name and return its entry with a reference taken, or 0 if we ran
+// out of memory. Must be called with _ksc_pathLock held.
+//
+static KscPathName *
+ksc_internName(const KsString &name)
+{
+    KscPathName *n;
+
+    if ( _ksc_pathNames->query(name, n) ) {
+	++n->refcount;
+	return n;
+    }
+    n = new KscPathName;
+    if ( !n ) {
+	return 0;
+    }
+    n->name = name;
+    n->id = ++_ksc_nextNameId;
+    n->refcount = 1;
+    if ( !_ksc_pathNames->add(name, n) ) {
+	delete n;
+	return 0;
+    }
+    return n;
+} // ksc_internName
+
+
+// ----------------------------------------------------------------------------
+// Release a reference to an interned name. Must be called with _ksc_pathLock
+// held.
+//
+static void
+ksc_releaseName(KscPathName *n)
+{
+    if ( n && (--n->refcount == 0) ) {
+	KscPathName *dummy;
+	_ksc_pathNames->remove(n->name, dummy);
+	delete n;
+    }
+} // ksc_releaseName
+
+
+// ----------------------------------------------------------------------------
+// Set up an entry for an interned path. The components are only known after
+// internNames() succeeded.
+//
+KscPathHandle::Entry::Entry(const KsString &k, const KsString &hs,
+                            const KscPath &p)
+: key(k),
+  hostserver(hs),
+  path(p),
+  hashValue(k.hash()),
+  hostserverName(0),
+  count(0),
+  components(0),
+  refcount(1)
+{
+} // KscPathHandle::Entry::Entry
+
+
+KscPathHandle::Entry::~Entry()
+{
+    delete [] components;
+} // KscPathHandle::Entry::~Entry
+
+
+// ----------------------------------------------------------------------------
+// Split the path into its components and intern their names as well as the
+// host and server part. The root domain "/" has no components at all. Must
+// be called with _ksc_pathLock held.
+//
+bool
+KscPathHandle::Entry::internNames()
+{
+    hostserverName = ksc_internName(hostserver);
+    if ( !hostserverName ) {
+	return false;
+    }
+    if ( path.isRootDomain() ) {
+	return true;
+    }
+
+    const char *sz = path;
+    size_t comps = 0;
+    size_t pos;
+    for ( pos = 0; sz[pos]; ++pos ) {
+	if ( ((sz[pos] == '/') || (sz[pos] == '.'))
+	     && !((pos == 1) && (sz[pos] == '.')) ) {
+	    ++comps;
+	}
+    }
+    components = new KscPathComponent[comps];
+    if ( !components ) {
+	return false;
+    }
+
+    pos = 0;
+    while ( sz[pos] ) {
+	//
+	// We're sitting on a delimiter, so find out which kind it is and
+	// where the name following it ends.
+	//
+	KscPathComponent &comp = components[count];
+	u_long kind;
+	size_t start;
+	if ( (pos == 0) && (sz[1] == '.') ) {
+	    kind = KSC_PCK_ROOTPART;
+	    comp.offset = 1;
+	    start = 2;
+	} else {
+	    kind = (sz[pos] == '/') ? KSC_PCK_DOMAIN : KSC_PCK_PART;
+	    comp.offset = pos;
+	    start = pos + 1;
+	}
+	pos = start;
+	while ( sz[pos] && (sz[pos] != '/') && (sz[pos] != '.') ) {
+	    ++pos;
+	}
+	comp.name = ksc_internName(KsString(sz + start, pos - start));
+	if ( !comp.name ) {
+	    return false;
+	}
+	comp.id = (comp.name->id << KSC_PCK_BITS) | kind;
+	++count;
+    }
+    return true;
+} // KscPathHandle::Entry::internNames
+
+
+// ----------------------------------------------------------------------------
+// Give back the names used by this path. Must be called with _ksc_pathLock
+// held.
+//
+void
+KscPathHandle::Entry::releaseNames()
+{
+    for ( size_t idx = 0; idx < count; ++idx ) {
+	ksc_releaseName(components[idx].name);
+    }
+    count = 0;
+    ksc_releaseName(hostserverName);
+    hostserverName = 0;
+} // KscPathHandle::Entry::releaseNames
+
+
+// ----------------------------------------------------------------------------
+// Construct an invalid path handle.
+//
+KscPathHandle::KscPathHandle()
+: _entry(0)
+{
+} // KscPathHandle::KscPathHandle
+
+
+// ----------------------------------------------------------------------------
+// Construct a handle for the resource locator (or path) held by a path
+// parser. If it hasn't been interned yet, then its entry is set up now. In
+// case the resource locator has no path part, is invalid or we run out of
+// memory, the handle will be invalid.
+//
+KscPathHandle::KscPathHandle(const KscPathParser &parser)
+: _entry(0)
+{
+    if ( !parser.isValid()
+	 || ((parser.getType() != KSC_PT_RESOURCELOCATOR)
+	     && (parser.getType() != KSC_PT_PATHONLY)) ) {
+	return;
+    }
+    KsString key(parser);
+
+    PltMutexLock lock(_ksc_pathLock);
+    if ( !_ksc_paths ) {
+	_ksc_paths = new PltHashTable<KsString, Entry *>;
+	_ksc_pathNames = new PltHashTable<KsString, KscPathName *>;
+	if ( !_ksc_paths || !_ksc_pathNames ) {
+	    delete _ksc_paths;
+	    delete _ksc_pathNames;
+	    _ksc_paths = 0;
+	    _ksc_pathNames = 0;
+	    return;
+	}
+    }
+
+    Entry *e;
+    if ( _ksc_paths->query(key, e) ) {
+	PltAtomic::add(&e->refcount, 1);
+	_entry = e;
+	return;
+    }
+    e = new Entry(key, parser.getHostAndServer(), parser.getPathAndName());
+    if ( !e ) {
+	return;
+    }
+    if ( !e->internNames() || !_ksc_paths->add(key, e) ) {
+	e->releaseNames();
+	delete e;
+	return;
+    }
+    _entry = e;
+} // KscPathHandle::KscPathHandle
+
+
+// ----------------------------------------------------------------------------
+// Copying a handle just takes another reference to the same entry.
+//
+KscPathHandle::KscPathHandle(const KscPathHandle &other)
+: _entry(other._entry)
+{
+    if ( _entry ) {
+	PltAtomic::add(&_entry->refcount, 1);
+    }
+} // KscPathHandle::KscPathHandle
+
+
+// ----------------------------------------------------------------------------
+// Release the reference to the entry. Dropping the last reference removes
+// the path from the table. This has to be done with the lock held, so no
+// one else can find the entry in the meantime and take a new reference.
+//
+KscPathHandle::~KscPathHandle()
+{
+    if ( _entry ) {
+	PltMutexLock lock(_ksc_pathLock);
+	if ( PltAtomic::add(&_entry->refcount, -1) == 0 ) {
+	    Entry *dummy;
+	    _ksc_paths->remove(_entry->key, dummy);
+	    _entry->releaseNames();
+	    delete _entry;
+	}
+    }
+} // KscPathHandle::~KscPathHandle
+
+
+// ----------------------------------------------------------------------------
+//
+KscPathHandle &
+KscPathHandle::operator = (const KscPathHandle &other)
+{
+    if ( _entry != other._entry ) {
+	//
+	// Swap with a copy of the other handle, which then releases our
+	// old entry when it goes away.
+	//
+	KscPathHandle copy(other);
+	Entry *old = _entry;
+	_entry = copy._entry;
+	copy._entry = old;
+    }
+    return *this;
+} // KscPathHandle::operator =
+
+
+// ----------------------------------------------------------------------------
+// Selectors. Invalid handles return an empty host/server part and an
+// (invalid) empty path.
+//
+const KsString &
+KscPathHandle::getHostAndServer() const
+{
+    return _entry ? _entry->hostserver : _ksc_emptyHostAndServer;
+} // KscPathHandle::getHostAndServer
+
+
+const KscPath &
+KscPathHandle::getPathAndName() const
+{
+    return _entry ? _entry->path : _ksc_emptyPath;
+} // KscPathHandle::getPathAndName
+
+
+size_t
+KscPathHandle::countComponents() const
+{
+    return _entry ? _entry->path.countComponents() : 0;
+} // KscPathHandle::countComponents
+
+
+unsigned long
+KscPathHandle::hash() const
+{
+    return _entry ? _entry->hashValue : 0;
+} // KscPathHandle::hash
+
+
+// ----------------------------------------------------------------------------
+// Order paths by their host and server part first and then by the ids of
+// their components, so paths sharing a domain end up next to each other.
+// Invalid handles come first.
+//
+bool
+KscPathHandle::operator < (const KscPathHandle &other) const
+{
+    if ( !_entry || !other._entry ) {
+	return !_entry && other._entry;
+    }
+    if ( _entry == other._entry ) {
+	return false;
+    }
+    if ( _entry->hostserverName != other._entry->hostserverName ) {
+	return _entry->hostserverName->id < other._entry->hostserverName->id;
+    }
+
+    const KscPathComponent *c1 = _entry->components;
+    const KscPathComponent *c2 = other._entry->components;
+    size_t n = _entry->count < other._entry->count ?
+	_entry->count : other._entry->count;
+    for ( size_t idx = 0; idx < n; ++idx ) {
+	if ( c1[idx].id != c2[idx].id ) {
+	    return c1[idx].id < c2[idx].id;
+	}
+    }
+    return _entry->count < other._entry->count;
+} // KscPathHandle::operator <
+
+
+// ----------------------------------------------------------------------------
+// Same as KscPath::relTo(), but the components both paths have in common
+// are found by comparing their ids instead of their names. Like inCommon(),
+// we count the delimiters up to the first component which differs, while
+// the last component of a path never counts as common.
+//
+KsString
+KscPathHandle::relTo(const KscPathHandle &to, size_t maxDepth) const
+{
+    if ( !_entry ) {
+	return KsString();
+    }
+    const KscPath &path = _entry->path;
+    if ( !to._entry ) {
+	return path;
+    }
+
+    size_t to_count = to._entry->path.countComponents();
+    if ( path.countComponents() && to_count ) {
+        if ( maxDepth > KSC_MAX_REL_DEPTH ) {
+            maxDepth = KSC_MAX_REL_DEPTH;
+        }
+
+	const KscPathComponent *c1 = _entry->components;
+	const KscPathComponent *c2 = to._entry->components;
+	size_t n1 = _entry->count,
+	       n2 = to._entry->count;
+	size_t same = 0;
+	while ( (same < n1) && (same < n2) && (c1[same].id == c2[same].id) ) {
+	    ++same;
+	}
+	size_t delemiters = ((same < n1) && (same < n2)) ? same + 1 : same;
+	if ( delemiters > 1 ) {
+	    size_t common = delemiters - 1;
+	    size_t up = to_count - common - 1;
+	    if ( up <= maxDepth ) {
+		size_t last_common = c1[common].offset;
+		if ( path[last_common] == '/' ) {
+		    ++last_common;
+		}
+		return KsString(KscPath::praefixes[up],
+				(const char *) path + last_common);
+	    }
+	}
+    }
+    return path;
+} // KscPathHandle::relTo
+
+
+// ----------------------------------------------------------------------------
+// The tables of interned paths and names are private to this module, so
+// applications can't instantiate them in their own template files.
+//
+#if PLT_INSTANTIATE_TEMPLATES
+template class PltAssoc<KsString, KscPathHandle::Entry *>;
+template class PltAssoc<KsString, KscPathName *>;
+template class PltContainer<PltAssoc<KsString, KscPathHandle::Entry *> >;
+template class PltContainer<PltAssoc<KsString, KscPathName *> >;
+template class PltContainer_<PltAssoc<KsString, KscPathHandle::Entry *> >;
+template class PltContainer_<PltAssoc<KsString, KscPathName *> >;
+template class PltDictionary<KsString, KscPathHandle::Entry *>;
+template class PltDictionary<KsString, KscPathName *>;
+template class PltHashIterator<KsString, KscPathHandle::Entry *>;
+template class PltHashIterator<KsString, KscPathName *>;
+template class PltHashTable<KsString, KscPathHandle::Entry *>;
+template class PltHashTable<KsString, KscPathName *>;
+template class PltHashTable_<KsString, KscPathHandle::Entry *>;
+template class PltHashTable_<KsString, KscPathName *>;
+template class PltIterator<PltAssoc<KsString, KscPathHandle::Entry *> >;
+template class PltIterator<PltAssoc<KsString, KscPathName *> >;
+template class PltIterator_<PltAssoc<KsString, KscPathHandle::Entry *> >;
+template class PltIterator_<PltAssoc<KsString, KscPathName *> >;
+#endif
+
+
     
 /* End of ks/clntpath.cpp */
@@ -26,6 +26,7 @@
 
 #include "ks/commobject.h"
 #include "ks/client.h"
+#include "ks/valuecache.h"
 
 
 // ---------------------------------------------------------------------------
@@ -97,6 +98,7 @@ PLT_IMPL_RTTI1(KscDomain, KscCommObject);
 //
 KscCommObject::KscCommObject(const char *object_path)
     : path(object_path),
+      _path_handle(path),
       av_module(0),
       _last_result(KS_ERR_OK)
 {
@@ -107,12 +109,10 @@ KscCommObject::KscCommObject(const char *object_path)
 	// send requests to an ACPLT/KS server. If we can't get our
 	// hands on a server object, then findServer() will already
 	// have set the result code of this communication object, so
-	// we don't have to do this here ourselves.
+	// we don't have to do this here ourselves. Otherwise we now
+	// hold a reference to the server object.
 	//
         server = findServer();
-	if ( server ) {
-	    server->incRefcount();
-	}
     } else {
 	//
 	// If already the name was malformed, we don't even try to find
@@ -143,8 +143,9 @@ KscCommObject::~KscCommObject()
 
 // ---------------------------------------------------------------------------
 // Creates a new server object for this communication object and returns the
-// pointer to this server object. In case it fails, then _last_result will be
-// set accordingly to the error reason.
+// pointer to this server object, with a reference taken for this object. In
+// case it fails, then _last_result will be set accordingly to the error
+// reason.
 // NOTE: this function is only called *ONCE* from the constructor. If you
 // loose the game at this point, then you must throw away the communication
 // object. **No Risk, No Fun.**
@@ -154,13 +155,35 @@ KscCommObject::findServer()
 {
     KscServerBase *pServer;
     _last_result = KscClient::getClient()->
-        createServer(path.getHostAndServer(),
+        attachServer(path.getHostAndServer(),
                      KS_PROTOCOL_VERSION,
                      pServer);
     return pServer;
 } // KscCommObject::findServer
 
 
+// ---------------------------------------------------------------------------
+// Find out which A/V module requests are sent with. This mimics what the
+// server object does when being handed a null pointer, except that a
+// package containing this object can chime in.
+//
+const KscAvModule *
+KscCommObject::findAvModule(const KscAvModule *avm_package) const
+{
+    const KscAvModule *avm = getAvModule();
+
+    if ( avm ) {
+        return avm;
+    } else if ( avm_package ) {
+        return avm_package;
+    } else if ( server && (avm = server->getAvModule()) ) {
+        return avm;
+    } else {
+        return KscClient::getClient()->getAvModule();
+    }
+} // KscCommObject::findAvModule
+
+
 // ---------------------------------------------------------------------------
 // Query all the children of this domain object, which fit into the name mask
 // and type mask.
@@ -798,6 +821,19 @@ KscVariable::setEngProps(KsEngPropsHandle hep)
 //
 bool
 KscVariable::getUpdate() 
+{
+    return fetchUpdate(0);
+} // KscVariable::getUpdate
+
+
+//////////////////////////////////////////////////////////////////////
+// Query the variable using the A/V module it would be read with if it
+// were contained in a package using avm_package. So values read on
+// behalf of a package end up under the same key in the value cache
+// as the ones read by the package itself.
+//
+bool
+KscVariable::fetchUpdate(const KscAvModule *avm_package)
 {
     //
     // Just to make sure the caller is not trying (once) again to read
@@ -822,6 +858,7 @@ KscVariable::getUpdate()
         _last_result = KS_ERR_GENERIC;
         return false;
     }
+    const KscAvModule *avm = findAvModule(avm_package);
 
     //
     // Set up the service parameters. We ask only for exactly one variable,
@@ -837,7 +874,7 @@ KscVariable::getUpdate()
     // server object will handle the request accordingly to whatever kind
     // of ACPLT/KS server it is connected with.
     //
-    bool ok = myServer->getVar(av_module,
+    bool ok = myServer->getVar(avm,
                                params, 
                                result);
 
@@ -864,6 +901,15 @@ KscVariable::getUpdate()
                     curr_props = *(KsVarCurrProps *) pitem->item.getPtr(); 
                     fDirty = false;
 		    _last_result = KS_ERR_OK;
+                    //
+                    // Let others reading this variable from the cache
+                    // profit from the value, too.
+                    //
+                    KscValueCache *cache =
+                        KscClient::getClient()->getValueCache();
+                    if ( cache ) {
+                        cache->store(avm, getFullPath(), curr_props);
+                    }
                     return true;
                 } else {
 		    //
@@ -900,9 +946,57 @@ KscVariable::getUpdate()
     }
 
     return false;
+} // KscVariable::fetchUpdate
+
+
+//////////////////////////////////////////////////////////////////////
+// Read the value of this variable from the client's value cache if
+// it is fresh enough. Otherwise, read it from the server -- unless
+// somebody else is already doing so, in which case we just wait for
+// the value to arrive in the cache.
+//
+bool
+KscVariable::getUpdate(const PltTimeSpan &maxAge)
+{
+    return getCachedUpdate(maxAge, 0);
 } // KscVariable::getUpdate
 
 
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscVariable::getCachedUpdate(const PltTimeSpan &maxAge,
+                             const KscAvModule *avm_package)
+{
+    KscValueCache *cache = KscClient::getClient()->getValueCache();
+    if ( !cache || !hasValidPath() || !getServer() ) {
+        return fetchUpdate(avm_package);
+    }
+
+    const KscAvModule *avm = findAvModule(avm_package);
+    KsString key(getFullPath());
+    KsVarCurrProps props;
+    KscValueCache::Status status = cache->lookup(avm, key, maxAge, props);
+    if ( status == KscValueCache::BUSY ) {
+        status = cache->wait(avm, key, maxAge, props);
+    }
+    if ( status == KscValueCache::FRESH ) {
+        curr_props = props;
+        fDirty = false;
+        _last_result = KS_ERR_OK;
+        return true;
+    }
+
+    //
+    // It's our turn to fetch the value. If successful, fetchUpdate()
+    // has already stored it in the cache.
+    //
+    bool ok = fetchUpdate(avm_package);
+    cache->complete(avm, key, 0);
+    return ok;
+} // KscVariable::getCachedUpdate
+
+
 //////////////////////////////////////////////////////////////////////
 // Write the value (aka current properties) of this variable object
 // back into the communication object (variable) within the ACPLT/KS
@@ -970,6 +1064,15 @@ KscVariable::setUpdate()
             if ( result.results[0].result == KS_ERR_OK ) {
                 fDirty = false;
 		_last_result = KS_ERR_OK;
+                //
+                // The server might have changed the value on its way,
+                // so don't trust the cached one any more.
+                //
+                KscValueCache *cache =
+                    KscClient::getClient()->getValueCache();
+                if ( cache ) {
+                    cache->invalidate(getFullPath());
+                }
                 return true;
             } else {
 		//
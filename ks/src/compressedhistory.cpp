@@ -0,0 +1,751 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "ks/compressedhistory.h"
+#include "plt/log.h"
+
+#include <string.h>
+
+
+// ----------------------------------------------------------------------------
+// Allocate the ring of sealed blocks and the time stamps of the open block.
+// The value columns of the open block are allocated whenever a variable is
+// tracked.
+//
+KssCompressedHistory::KssCompressedHistory(const KsString &id,
+                                           size_t maxBlocks,
+                                           size_t blockSize,
+                                           KS_HIST_TYPE mode,
+                                           unsigned long period,
+                                           KsTime ctime,
+                                           KsString comment)
+    : KssSampledHistory(id, mode, period, ctime, comment),
+      _block_size(blockSize ? blockSize : KS_HISTBLOCK_SIZE),
+      _max_blocks(maxBlocks ? maxBlocks : 1),
+      _blocks(0),
+      _first_block(0),
+      _block_count(0),
+      _sealed(0),
+      _encoded_size(0),
+      _open_times(0),
+      _open_columns(0),
+      _open_count(0)
+{
+    _blocks = new Block[_max_blocks];
+    if ( _blocks ) {
+        for ( size_t i = 0; i < _max_blocks; ++i ) {
+            _blocks[i].seq = 0;
+            _blocks[i].count = 0;
+            _blocks[i].times = 0;
+            _blocks[i].times_size = 0;
+            _blocks[i].columns = 0;
+            _blocks[i].columns_size = 0;
+        }
+        _open_times = new PltTime[_block_size];
+    }
+} // KssCompressedHistory::KssCompressedHistory
+
+
+KssCompressedHistory::~KssCompressedHistory()
+{
+    stopSampling();
+    for ( size_t i = 0; i < _block_count; ++i ) {
+        releaseBlock(blockAt(i));
+    }
+    if ( _open_columns ) {
+        for ( size_t i = 0; i < _track_count; ++i ) {
+            delete [] _open_columns[i];
+        }
+        delete [] _open_columns;
+    }
+    delete [] _open_times;
+    delete [] _blocks;
+} // KssCompressedHistory::~KssCompressedHistory
+
+
+// ----------------------------------------------------------------------------
+//
+size_t
+KssCompressedHistory::getCount() const
+{
+    size_t count = _open_count;
+    for ( size_t i = 0; i < _block_count; ++i ) {
+        count += blockAt(i).count;
+    }
+    return count;
+} // KssCompressedHistory::getCount
+
+
+// ----------------------------------------------------------------------------
+// Allocate the open block's column for another variable. This is only
+// possible as long as there are no rows yet.
+//
+bool
+KssCompressedHistory::addColumn(const Track &track)
+{
+    if ( _open_count || _block_count || !_open_times ) {
+        return false;
+    }
+    double **columns = new double *[track.index + 1];
+    if ( !columns ) {
+        return false;
+    }
+    columns[track.index] = new double[_block_size];
+    if ( !columns[track.index] ) {
+        delete [] columns;
+        return false;
+    }
+    for ( size_t i = 0; i < track.index; ++i ) {
+        columns[i] = _open_columns[i];
+    }
+    delete [] _open_columns;
+    _open_columns = columns;
+    return true;
+} // KssCompressedHistory::addColumn
+
+
+void
+KssCompressedHistory::removeColumn(const Track &track)
+{
+    delete [] _open_columns[track.index];
+    _open_columns[track.index] = 0;
+} // KssCompressedHistory::removeColumn
+
+
+// ----------------------------------------------------------------------------
+// Append a new row to the open block and seal the block once it is full. As
+// with KssRingHistory, a time stamp lying before the one of the last row is
+// replaced by the latter, so the rows stay sorted by time.
+//
+void
+KssCompressedHistory::appendRow(const PltTime &t)
+{
+    if ( !_open_times ) {
+        return;
+    }
+    const PltTime *prev = 0;
+    if ( _open_count ) {
+        prev = &_open_times[_open_count - 1];
+    } else if ( _block_count ) {
+        prev = &blockAt(_block_count - 1).last;
+    }
+    _open_times[_open_count] = (prev && (t < *prev)) ? *prev : t;
+    for ( Track *track = _tracks; track; track = track->next ) {
+        _open_columns[track->index][_open_count] = track->last;
+    }
+    if ( ++_open_count >= _block_size ) {
+        if ( !seal() ) {
+            PltLog::Warning("KssCompressedHistory: out of memory, "
+                            "dropped a block of rows.");
+        }
+    }
+} // KssCompressedHistory::appendRow
+
+
+// ----------------------------------------------------------------------------
+// Compress the open block and add it to the ring of sealed blocks, throwing
+// away the oldest block if necessary. The open block is empty afterwards,
+// even if running out of memory; its sequence number is used up anyway.
+//
+bool
+KssCompressedHistory::seal()
+{
+    if ( !_open_count ) {
+        return true;
+    }
+    if ( _block_count == _max_blocks ) {
+        releaseBlock(blockAt(0));
+        _first_block = _first_block + 1 < _max_blocks ? _first_block + 1 : 0;
+        --_block_count;
+    }
+
+    Block &block = blockAt(_block_count);
+    size_t count = _open_count;
+    _open_count = 0;
+    block.seq = _sealed++;
+    block.count = count;
+    block.first = _open_times[0];
+    block.last = _open_times[count - 1];
+    block.columns = new char *[_track_count ? _track_count : 1];
+    block.columns_size = new size_t[_track_count ? _track_count : 1];
+    if ( !block.columns || !block.columns_size ) {
+        releaseBlock(block);
+        return false;
+    }
+    for ( size_t i = 0; i < _track_count; ++i ) {
+        block.columns[i] = 0;
+        block.columns_size[i] = 0;
+    }
+
+    KsHistEncoder times(KsHistEncoder::TIMES, _block_size);
+    for ( size_t r = 0; r < count; ++r ) {
+        if ( !times.addTime(_open_times[r]) ) {
+            releaseBlock(block);
+            return false;
+        }
+    }
+    block.times = times.detach(block.times_size);
+    if ( !block.times ) {
+        releaseBlock(block);
+        return false;
+    }
+    _encoded_size += block.times_size;
+
+    for ( size_t i = 0; i < _track_count; ++i ) {
+        KsHistEncoder values(KsHistEncoder::VALUES, _block_size);
+        if ( !values.addValues(_open_columns[i], count) ) {
+            releaseBlock(block);
+            return false;
+        }
+        block.columns[i] = values.detach(block.columns_size[i]);
+        if ( !block.columns[i] ) {
+            releaseBlock(block);
+            return false;
+        }
+        _encoded_size += block.columns_size[i];
+    }
+    ++_block_count;
+    return true;
+} // KssCompressedHistory::seal
+
+
+void
+KssCompressedHistory::releaseBlock(Block &block)
+{
+    if ( block.times ) {
+        _encoded_size -= block.times_size;
+        delete [] block.times;
+    }
+    if ( block.columns ) {
+        for ( size_t i = 0; i < _track_count; ++i ) {
+            if ( block.columns[i] ) {
+                _encoded_size -= block.columns_size[i];
+                delete [] block.columns[i];
+            }
+        }
+    }
+    delete [] block.columns;
+    delete [] block.columns_size;
+    block.count = 0;
+    block.times = 0;
+    block.times_size = 0;
+    block.columns = 0;
+    block.columns_size = 0;
+} // KssCompressedHistory::releaseBlock
+
+
+// ----------------------------------------------------------------------------
+// Find the logical index of a block by its sequence number. Blocks dropped
+// when running out of memory leave gaps in the sequence, hence the binary
+// search.
+//
+bool
+KssCompressedHistory::findBlock(size_t seq, size_t &i) const
+{
+    if ( seq == _sealed ) {
+        i = _block_count;
+        return true;
+    }
+    size_t lo = 0;
+    size_t hi = _block_count;
+    size_t oldest = _block_count ? blockAt(0).seq : _sealed;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( blockAt(mid).seq - oldest < seq - oldest ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    i = lo;
+    return (lo < _block_count) && (blockAt(lo).seq == seq);
+} // KssCompressedHistory::findBlock
+
+
+// ----------------------------------------------------------------------------
+// Find the blocks lo up to (but not including) hi overlapping the time range
+// selected, the open block counting as block _block_count.
+//
+void
+KssCompressedHistory::selectBlocks(const Selection &sel,
+                                   size_t &lo, size_t &hi) const
+{
+    lo = 0;
+    hi = _block_count + (_open_count ? 1 : 0);
+    if ( sel.selected ) {
+        while ( (lo < _block_count) && (blockAt(lo).last < sel.from) ) {
+            ++lo;
+        }
+        hi = lo;
+        while ( (hi < _block_count) && !(sel.to < blockAt(hi).first) ) {
+            ++hi;
+        }
+        if ( (hi == _block_count) && _open_count
+             && !(sel.to < _open_times[0]) ) {
+            ++hi;
+        }
+    }
+} // KssCompressedHistory::selectBlocks
+
+
+// ----------------------------------------------------------------------------
+// Decompress the time stamps or the values of a track of some consecutive
+// blocks into one array.
+//
+bool
+KssCompressedHistory::decodeTimes(size_t first, size_t last,
+                                  PltTime *dst) const
+{
+    for ( size_t i = first; i < last; ++i ) {
+        if ( i == _block_count ) {
+            for ( size_t r = 0; r < _open_count; ++r ) {
+                *dst++ = _open_times[r];
+            }
+            continue;
+        }
+        const Block &block = blockAt(i);
+        KsHistDecoder dec(block.times, block.times_size);
+        while ( dec.nextBlock() ) {
+            if ( !dec.decodeTimes(dst) ) {
+                return false;
+            }
+            dst += dec.getBlockCount();
+        }
+    }
+    return true;
+} // KssCompressedHistory::decodeTimes
+
+
+bool
+KssCompressedHistory::decodeValues(size_t column,
+                                   size_t first, size_t last,
+                                   double *dst) const
+{
+    for ( size_t i = first; i < last; ++i ) {
+        if ( i == _block_count ) {
+            memcpy(dst, _open_columns[column],
+                   _open_count * sizeof(double));
+            dst += _open_count;
+            continue;
+        }
+        const Block &block = blockAt(i);
+        KsHistDecoder dec(block.columns[column],
+                          block.columns_size[column]);
+        while ( dec.nextBlock() ) {
+            if ( !dec.decodeValues(dst) ) {
+                return false;
+            }
+            dst += dec.getBlockCount();
+        }
+    }
+    return true;
+} // KssCompressedHistory::decodeValues
+
+
+// ----------------------------------------------------------------------------
+// Binary searches on decompressed time stamps: lowerBound() returns the
+// first row at or after time t, upperBound() the first row after time t.
+//
+size_t
+KssCompressedHistory::lowerBound(const PltTime *times, size_t count,
+                                 const PltTime &t)
+{
+    size_t lo = 0;
+    size_t hi = count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( times[mid] < t ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+} // KssCompressedHistory::lowerBound
+
+
+size_t
+KssCompressedHistory::upperBound(const PltTime *times, size_t count,
+                                 const PltTime &t)
+{
+    size_t lo = 0;
+    size_t hi = count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( times[mid] <= t ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+} // KssCompressedHistory::upperBound
+
+
+// ----------------------------------------------------------------------------
+// Answer a GetHist request. Using the time stamps kept with every sealed
+// block, only the blocks overlapping the time range requested are
+// decompressed; the rows within the range are then found as with
+// KssRingHistory. At most max_entries rows (or buckets) are returned,
+// starting with the oldest one.
+//
+void
+KssCompressedHistory::getHist(const KsGetHistParams &params,
+                              KsGetHistSingleResult &result)
+{
+    Selection sel;
+    KS_RESULT res = getSelection(params, sel);
+    if ( res != KS_ERR_OK ) {
+        result.result = res;
+        return;
+    }
+
+    size_t lo, hi;
+    selectBlocks(sel, lo, hi);
+    size_t rows = 0;
+    for ( size_t i = lo; i < hi; ++i ) {
+        rows += rowsOf(i);
+    }
+
+    PltTime *times = new PltTime[rows ? rows : 1];
+    if ( !times || !decodeTimes(lo, hi, times) ) {
+        delete [] times;
+        result.result = KS_ERR_GENERIC;
+        return;
+    }
+    size_t first = 0;
+    size_t last = rows;
+    if ( sel.selected ) {
+        first = lowerBound(times, rows, sel.from);
+        last  = upperBound(times, rows, sel.to);
+        if ( last < first ) {
+            last = first;
+        }
+    }
+
+    KssHistoryAggregator agg;
+    size_t count = last - first;
+    if ( sel.ipm != KS_IPM_NONE ) {
+        res = agg.setup(sel.from, sel.to, sel.delta, params.max_entries,
+                        count);
+        if ( res != KS_ERR_OK ) {
+            delete [] times;
+            result.result = res;
+            return;
+        }
+        size_t buckets = agg.getBucketCount();
+        if ( buckets ) {
+            agg.setBucketRow(0, first);
+            for ( size_t b = 1; b < buckets; ++b ) {
+                agg.setBucketRow(b, lowerBound(times, rows,
+                                               agg.getBucketStart(b)));
+            }
+            agg.setBucketRow(buckets, last);
+        }
+    } else if ( count > params.max_entries ) {
+        count = params.max_entries;
+    }
+
+    size_t nitems = params.items.size();
+    KsArray<KsGetHistResultItem> items(nitems);
+    double *values = 0;
+    if ( items.size() != nitems ) {
+        delete [] times;
+        result.result = KS_ERR_GENERIC;
+        return;
+    }
+
+    for ( size_t i = 0; i < nitems; ++i ) {
+        const KsString &part = params.items[i].part_id;
+        KsGetHistResultItem &item = items[i];
+        if ( part == "t" ) {
+            if ( sel.ipm != KS_IPM_NONE ) {
+                item.value = agg.getTimes();
+            } else {
+                KsTimeVecValue *tv = new KsTimeVecValue(count);
+                if ( !tv || (tv->size() != count) ) {
+                    delete tv;
+                    item.result = KS_ERR_GENERIC;
+                    continue;
+                }
+                KsTime *dst = tv->getPtr();
+                for ( size_t r = 0; r < count; ++r ) {
+                    dst[r] = times[first + r];
+                }
+                item.value = KsValueHandle(tv, KsOsNew);
+            }
+        } else {
+            Track *track = findTrack(part);
+            if ( !track ) {
+                item.result = KS_ERR_BADPATH;
+                continue;
+            }
+            if ( !values ) {
+                values = new double[rows ? rows : 1];
+            }
+            if ( !values || !decodeValues(track->index, lo, hi, values) ) {
+                item.result = KS_ERR_GENERIC;
+                continue;
+            }
+            if ( sel.ipm != KS_IPM_NONE ) {
+                agg.reset();
+                for ( size_t b = 0; b < agg.getBucketCount(); ++b ) {
+                    agg.accumulate(b, values + agg.getBucketRow(b),
+                                   agg.getBucketSize(b));
+                }
+                item.value = agg.getValues(sel.ipm);
+            } else {
+                KsDoubleVecValue *dv = new KsDoubleVecValue(count);
+                if ( !dv || (dv->size() != count) ) {
+                    delete dv;
+                    item.result = KS_ERR_GENERIC;
+                    continue;
+                }
+                memcpy(dv->getPtr(), values + first, count * sizeof(double));
+                item.value = KsValueHandle(dv, KsOsNew);
+            }
+        }
+        item.result = item.value ? KS_ERR_OK : KS_ERR_GENERIC;
+    }
+    delete [] values;
+    delete [] times;
+
+    if ( sel.encoded ) {
+        encodeItems(items);
+    }
+    result.items = items;
+    result.result = KS_ERR_OK;
+} // KssCompressedHistory::getHist
+
+
+// ----------------------------------------------------------------------------
+// A cursor over the rows of a compressed history. It starts with block seq,
+// skipping the first skip rows of it. The block just read is kept
+// decompressed, as the rows are read block by block anyway.
+//
+class KssCompressedHistoryCursor
+    : public KssHistoryCursor
+{
+public:
+    KssCompressedHistoryCursor(const KssCompressedHistory &hist,
+                               size_t seq, size_t skip);
+    virtual ~KssCompressedHistoryCursor();
+
+    virtual bool readTimes(size_t row, size_t count, PltTime *dst);
+    virtual bool readValues(size_t column, size_t row, size_t count,
+                            double *dst);
+
+private:
+    bool load(bool time, size_t column, size_t row,
+              size_t &offset, size_t &avail);
+
+    const KssCompressedHistory &_hist;
+    size_t                      _seq;
+    size_t                      _skip;
+    size_t                      _block_seq;   // block visited last
+    size_t                      _block_row;   // its first row in the reply
+    PltTime                    *_times;
+    double                     *_values;
+    bool                        _cached;
+    bool                        _cached_time;
+    size_t                      _cached_seq;
+    size_t                      _cached_column;
+}; // class KssCompressedHistoryCursor
+
+
+KssCompressedHistoryCursor::KssCompressedHistoryCursor(
+    const KssCompressedHistory &hist, size_t seq, size_t skip)
+    : _hist(hist),
+      _seq(seq),
+      _skip(skip),
+      _block_seq(seq),
+      _block_row(0),
+      _times(0),
+      _values(0),
+      _cached(false),
+      _cached_time(false),
+      _cached_seq(0),
+      _cached_column(0)
+{
+} // KssCompressedHistoryCursor::KssCompressedHistoryCursor
+
+
+KssCompressedHistoryCursor::~KssCompressedHistoryCursor()
+{
+    delete [] _times;
+    delete [] _values;
+} // KssCompressedHistoryCursor::~KssCompressedHistoryCursor
+
+
+//
+// Make sure the block holding a row of the reply is decompressed. Returns
+// where the row is in the decompressed block and how many rows of the block
+// follow it (including the row itself).
+//
+bool
+KssCompressedHistoryCursor::load(bool time, size_t column, size_t row,
+                                 size_t &offset, size_t &avail)
+{
+    if ( row < _block_row ) {
+        _block_seq = _seq;
+        _block_row = 0;
+    }
+    size_t i, rows, skip;
+    for ( ;; ) {
+        if ( !_hist.findBlock(_block_seq, i) ) {
+            return false;
+        }
+        rows = _hist.rowsOf(i);
+        skip = (_block_seq == _seq) ? _skip : 0;
+        if ( rows < skip ) {
+            return false;
+        }
+        if ( row < _block_row + (rows - skip) ) {
+            break;
+        }
+        _block_row += rows - skip;
+        ++_block_seq;
+    }
+
+    if ( !_cached || (_cached_seq != _block_seq) || (_cached_time != time)
+         || (!time && (_cached_column != column)) ) {
+        _cached = false;
+        bool ok;
+        if ( time ) {
+            if ( !_times ) {
+                _times = new PltTime[_hist._block_size];
+            }
+            ok = _times && _hist.decodeTimes(i, i + 1, _times);
+        } else {
+            if ( !_values ) {
+                _values = new double[_hist._block_size];
+            }
+            ok = _values && _hist.decodeValues(column, i, i + 1, _values);
+        }
+        if ( !ok ) {
+            return false;
+        }
+        _cached = true;
+        _cached_time = time;
+        _cached_seq = _block_seq;
+        _cached_column = column;
+    }
+    offset = skip + (row - _block_row);
+    avail = rows - offset;
+    return true;
+} // KssCompressedHistoryCursor::load
+
+
+bool
+KssCompressedHistoryCursor::readTimes(size_t row, size_t count,
+                                      PltTime *dst)
+{
+    while ( count ) {
+        size_t offset, n;
+        if ( !load(true, 0, row, offset, n) ) {
+            return false;
+        }
+        if ( n > count ) {
+            n = count;
+        }
+        for ( size_t r = 0; r < n; ++r ) {
+            *dst++ = _times[offset + r];
+        }
+        row += n;
+        count -= n;
+    }
+    return true;
+} // KssCompressedHistoryCursor::readTimes
+
+
+bool
+KssCompressedHistoryCursor::readValues(size_t column, size_t row,
+                                       size_t count, double *dst)
+{
+    while ( count ) {
+        size_t offset, n;
+        if ( !load(false, column, row, offset, n) ) {
+            return false;
+        }
+        if ( n > count ) {
+            n = count;
+        }
+        memcpy(dst, _values + offset, n * sizeof(double));
+        dst += n;
+        row += n;
+        count -= n;
+    }
+    return true;
+} // KssCompressedHistoryCursor::readValues
+
+
+// ----------------------------------------------------------------------------
+// Open a cursor for raw replies; aggregated and encoded replies as well as
+// erroneous requests are left to getHist(). Only the first and the last
+// block overlapping the time range are decompressed here, to find where
+// the rows selected begin and end.
+//
+KssHistoryCursor *
+KssCompressedHistory::openCursor(const KsGetHistParams &params)
+{
+    Selection sel;
+    if ( (getSelection(params, sel) != KS_ERR_OK)
+         || (sel.ipm != KS_IPM_NONE) || sel.encoded ) {
+        return 0;
+    }
+
+    size_t lo, hi;
+    selectBlocks(sel, lo, hi);
+    size_t rows = 0;
+    for ( size_t i = lo; i < hi; ++i ) {
+        rows += rowsOf(i);
+    }
+    size_t skip = 0;
+    if ( sel.selected && (lo < hi) ) {
+        PltTime *times = new PltTime[_block_size];
+        if ( !times || !decodeTimes(lo, lo + 1, times) ) {
+            delete [] times;
+            return 0;
+        }
+        skip = lowerBound(times, rowsOf(lo), sel.from);
+        if ( (hi - 1 != lo) && !decodeTimes(hi - 1, hi, times) ) {
+            delete [] times;
+            return 0;
+        }
+        size_t tail = rowsOf(hi - 1)
+            - upperBound(times, rowsOf(hi - 1), sel.to);
+        delete [] times;
+        rows = (rows - tail > skip) ? rows - tail - skip : 0;
+    }
+    if ( rows > params.max_entries ) {
+        rows = params.max_entries;
+    }
+
+    size_t seq = (lo < _block_count) ? blockAt(lo).seq : _sealed;
+    KssCompressedHistoryCursor *cursor =
+        new KssCompressedHistoryCursor(*this, seq, skip);
+    if ( cursor && !initCursor(*cursor, params, rows) ) {
+        delete cursor;
+        cursor = 0;
+    }
+    return cursor;
+} // KssCompressedHistory::openCursor
+
+/* End of compressedhistory.cpp */
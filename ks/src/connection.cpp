@@ -27,6 +27,7 @@
  */
 
 #include "ks/connection.h"
+#include "ks/connectionmgr.h"
 
 
 #if !PLT_SYSTEM_NT
@@ -106,6 +107,18 @@ bool KssConnection::setPeerAddr(struct sockaddr_in *addr, int addrLen)
 } // KssConnection::setPeerAddr
 
 
+// ---------------------------------------------------------------------------
+// A connection has run out of its memory quota and is about to be dropped.
+// Let the connection manager know, so it can keep track of such events.
+//
+void KssConnection::quotaExceeded()
+{
+    if ( _manager ) {
+	_manager->connectionOverQuota(*this);
+    }
+} // KssConnection::quotaExceeded
+
+
 // ---------------------------------------------------------------------------
 // For this given connection, find out to what port the connection has been
 // bound. Of course, calling this method only makes sense, if it's using the
@@ -205,7 +218,8 @@ KssXDRConnection::KssXDRConnection(int fd, bool autoDestroyable,
 	                           unsigned long timeout,
 	                           ConnectionType type)
     : KssConnection(fd, autoDestroyable, timeout, type),
-      _cleanup_xdr_stream(true)
+      _cleanup_xdr_stream(true),
+      _reply_deferred(false)
 {
 } // KssXDRConnection::KssXDRConnection
 
@@ -268,6 +282,17 @@ KS_RESULT KssXDRConnection::finishRequestDeserialization(KsAvTicket &avt, bool)
 } // KssXDRConnection::finishRequestDeserialization
 
 
+// ---------------------------------------------------------------------------
+// By default, a streamed result is sent just like any other result.
+//
+void KssXDRConnection::sendStreamedReply(KsAvTicket &avt,
+					 KssStreamedResult *result)
+{
+    sendReply(avt, *result);
+    delete result;
+} // KssXDRConnection::sendStreamedReply
+
+
 // ---------------------------------------------------------------------------
 // Put a socket into non-blocking mode. This encapsulates differences between
 // various operating systems. Well, "NT" might be an operating system. But
@@ -107,7 +107,7 @@ void _PltDLinkedListNode::remove()
 KssConnectionManager::KssConnectionManager()
     : _is_ok(true),
       _connection_count(0), _serviceable_count(0),
-      _io_errors(0), _io_rx_errors(0), _io_tx_errors(0)
+      _io_errors(0), _io_rx_errors(0), _io_tx_errors(0), _quota_drops(0)
 #if PLT_CNX_MGR_USE_HT
       , _hash_table(0), _hash_table_size(0), _hash_table_mask(0)
 #endif
@@ -0,0 +1,436 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+
+#include "ks/epcache.h"
+
+//////////////////////////////////////////////////////////////////////
+
+KscEPCache::KscEPCache(const PltTimeSpan &ttl, size_t buckets)
+: _bucket_count(buckets ? buckets : 1),
+  _ttl(ttl)
+{
+    _buckets = new Entry *[_bucket_count];
+    if ( !_buckets ) {
+        _bucket_count = 0;
+    }
+    for ( size_t i = 0; i < _bucket_count; ++i ) {
+        _buckets[i] = 0;
+    }
+    resetStatistics();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+KscEPCache::~KscEPCache()
+{
+    clear();
+    delete [] _buckets;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscEPCache::setTTL(const PltTimeSpan &ttl)
+{
+    PltMutexLock lock(_mutex);
+    _ttl = ttl;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+PltTimeSpan
+KscEPCache::getTTL() const
+{
+    PltMutexLock lock(_mutex);
+    return _ttl;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscEPCache::isFresh(const Entry &entry, const PltTime &now) const
+{
+    return now <= entry.time + _ttl;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Does a name mask match more than a single name?
+//
+bool
+KscEPCache::isPattern(const KsString &mask)
+{
+    for ( size_t i = 0; i < mask.len(); ++i ) {
+        switch ( mask[i] ) {
+        case '*':
+        case '?':
+        case '[':
+        case '\\':
+            return true;
+        }
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Is path the domain itself or something below it (a child or part)?
+//
+bool
+KscEPCache::isBelow(const KsString &path, const KsString &domain)
+{
+    size_t len = domain.len();
+    if ( path.len() < len
+         || strncmp((const char *) path, (const char *) domain, len) ) {
+        return false;
+    }
+    return path.len() == len
+        || (len && domain[len - 1] == '/')
+        || path[len] == '/' || path[len] == '.';
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscEPCache::destroy(Entry *entry)
+{
+    delete [] entry->encoded;
+    delete [] entry->children;
+    delete [] entry->slots;
+    delete entry;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Serialize a GetEP reply just like KsGetEPResult::xdrEncode() does,
+// but remember where every object's engineered properties are, so
+// single objects can be picked from the reply later. We start with a
+// small buffer and retry with larger ones until the reply fits.
+//
+bool
+KscEPCache::encode(Entry &entry, const KsGetEPResult &result)
+{
+    size_t count = result.items.size();
+
+    entry.children = new Child[count ? count : 1];
+    entry.slot_count = 2 * count + 1;
+    entry.slots = new size_t[entry.slot_count];
+    if ( !entry.children || !entry.slots ) {
+        return false;
+    }
+
+    for ( u_int size = 1024; size <= (1 << 24); size *= 2 ) {
+        char *buffer = new char[size];
+        if ( !buffer ) {
+            return false;
+        }
+        XDR xdrs;
+        xdrmem_create(&xdrs, (caddr_t) buffer, size, XDR_ENCODE);
+
+        u_long items = count;
+        bool ok = result.KsResult::xdrEncode(&xdrs)
+            && ks_xdre_u_long(&xdrs, &items);
+        PltListIterator<KsEngPropsHandle> it(result.items);
+        for ( size_t i = 0; ok && it; ++it, ++i ) {
+            Child &child = entry.children[i];
+            child.name = (*it)->identifier;
+            child.type = (*it)->xdrTypeCode();
+            child.offset = xdr_getpos(&xdrs);
+            ok = (*it)->xdrEncode(&xdrs);
+            child.size = xdr_getpos(&xdrs) - child.offset;
+        }
+        u_int len = xdr_getpos(&xdrs);
+        xdr_destroy(&xdrs);
+
+        if ( ok ) {
+            entry.encoded = buffer;
+            entry.encoded_size = len;
+            entry.child_count = count;
+            //
+            // Index the objects by name. If a name appears twice, the
+            // first object wins.
+            //
+            size_t s;
+            for ( s = 0; s < entry.slot_count; ++s ) {
+                entry.slots[s] = 0;
+            }
+            for ( size_t c = 0; c < count; ++c ) {
+                size_t dummy;
+                if ( findChild(entry, entry.children[c].name, dummy) ) {
+                    continue;
+                }
+                s = entry.children[c].name.hash() % entry.slot_count;
+                while ( entry.slots[s] ) {
+                    s = (s + 1) % entry.slot_count;
+                }
+                entry.slots[s] = c + 1;
+            }
+            return true;
+        }
+        delete [] buffer;
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscEPCache::findChild(const Entry &entry, const KsString &name,
+                      size_t &child)
+{
+    size_t s = name.hash() % entry.slot_count;
+    while ( entry.slots[s] ) {
+        if ( entry.children[entry.slots[s] - 1].name == name ) {
+            child = entry.slots[s] - 1;
+            return true;
+        }
+        s = (s + 1) % entry.slot_count;
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Look up a GetEP reply. Expired replies are thrown away on the fly.
+//
+bool
+KscEPCache::lookup(const KscAvModule *avm,
+                   const KsGetEPParams &params,
+                   KsGetEPResult &result)
+{
+    PltMutexLock lock(_mutex);
+
+    if ( !_bucket_count ) {
+        ++_stats.misses;
+        return false;
+    }
+
+    PltTime now = PltTime::now();
+    Entry **link = &_buckets[params.path.hash() % _bucket_count];
+    while ( *link ) {
+        Entry *entry = *link;
+        if ( !isFresh(*entry, now) ) {
+            *link = entry->next;
+            destroy(entry);
+            continue;
+        }
+        if ( entry->avm == avm
+             && entry->type_mask == params.type_mask
+             && entry->scope_flags == params.scope_flags
+             && entry->path == params.path
+             && entry->name_mask == params.name_mask ) {
+            XDR xdrs;
+            xdrmem_create(&xdrs, (caddr_t) entry->encoded,
+                          entry->encoded_size, XDR_DECODE);
+            bool ok = result.xdrDecode(&xdrs);
+            xdr_destroy(&xdrs);
+            if ( ok ) {
+                ++_stats.hits;
+                return true;
+            }
+        }
+        link = &entry->next;
+    }
+
+    if ( !isPattern(params.name_mask)
+         && lookupChild(avm, params, result, now) ) {
+        ++_stats.child_hits;
+        return true;
+    }
+
+    ++_stats.misses;
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Answer the query for a single object from the listing of its domain.
+// If the object isn't listed, we can only tell that it doesn't exist
+// when the listing covered all the object types and scopes asked for.
+// Must be called with the mutex locked.
+//
+bool
+KscEPCache::lookupChild(const KscAvModule *avm,
+                        const KsGetEPParams &params,
+                        KsGetEPResult &result,
+                        const PltTime &now)
+{
+    const KS_EP_FLAGS scopes = KS_EPF_PARTS | KS_EPF_CHILDREN;
+
+    Entry *entry = _buckets[params.path.hash() % _bucket_count];
+    for ( ; entry; entry = entry->next ) {
+        if ( entry->avm != avm
+             || !isFresh(*entry, now)
+             || (entry->scope_flags & ~scopes)
+                    != (params.scope_flags & ~scopes)
+             || (entry->scope_flags & params.scope_flags & scopes)
+                    != (params.scope_flags & scopes)
+             || entry->path != params.path
+             || entry->name_mask != "*" ) {
+            continue;
+        }
+
+        size_t c;
+        if ( findChild(*entry, params.name_mask, c) ) {
+            result.result = KS_ERR_OK;
+            if ( !(entry->children[c].type & params.type_mask) ) {
+                return true;
+            }
+            XDR xdrs;
+            xdrmem_create(&xdrs,
+                          (caddr_t) entry->encoded + entry->children[c].offset,
+                          entry->children[c].size, XDR_DECODE);
+            KsEngProps *ep = KsEngProps::xdrNew(&xdrs);
+            xdr_destroy(&xdrs);
+            return ep
+                && result.items.addLast(KsEngPropsHandle(ep, KsOsNew));
+        }
+        if ( !(params.type_mask & ~entry->type_mask)
+             && entry->scope_flags == params.scope_flags ) {
+            result.result = KS_ERR_OK;
+            return true;
+        }
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Remember a successful GetEP reply, replacing an older one for the
+// same parameters. Expired replies in the same bucket are thrown away
+// while we're at it.
+//
+void
+KscEPCache::store(const KscAvModule *avm,
+                  const KsGetEPParams &params,
+                  const KsGetEPResult &result)
+{
+    if ( result.result != KS_ERR_OK ) {
+        return;
+    }
+
+    PltMutexLock lock(_mutex);
+
+    if ( !_bucket_count ) {
+        return;
+    }
+
+    PltTime now = PltTime::now();
+    Entry **bucket = &_buckets[params.path.hash() % _bucket_count];
+    Entry **link = bucket;
+    while ( *link ) {
+        Entry *entry = *link;
+        if ( !isFresh(*entry, now)
+             || (entry->avm == avm
+                 && entry->type_mask == params.type_mask
+                 && entry->scope_flags == params.scope_flags
+                 && entry->path == params.path
+                 && entry->name_mask == params.name_mask) ) {
+            *link = entry->next;
+            destroy(entry);
+        } else {
+            link = &entry->next;
+        }
+    }
+
+    Entry *entry = new Entry;
+    if ( !entry ) {
+        return;
+    }
+    entry->avm = avm;
+    entry->path = params.path;
+    entry->type_mask = params.type_mask;
+    entry->name_mask = params.name_mask;
+    entry->scope_flags = params.scope_flags;
+    entry->time = now;
+    entry->encoded = 0;
+    entry->encoded_size = 0;
+    entry->children = 0;
+    entry->child_count = 0;
+    entry->slots = 0;
+    entry->slot_count = 0;
+    if ( !encode(*entry, result) ) {
+        destroy(entry);
+        return;
+    }
+    entry->next = *bucket;
+    *bucket = entry;
+    ++_stats.stores;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscEPCache::invalidate(const KsString &path)
+{
+    PltMutexLock lock(_mutex);
+
+    for ( size_t i = 0; i < _bucket_count; ++i ) {
+        Entry **link = &_buckets[i];
+        while ( *link ) {
+            Entry *entry = *link;
+            if ( isBelow(entry->path, path) ) {
+                *link = entry->next;
+                destroy(entry);
+                ++_stats.invalidations;
+            } else {
+                link = &entry->next;
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscEPCache::clear()
+{
+    PltMutexLock lock(_mutex);
+
+    for ( size_t i = 0; i < _bucket_count; ++i ) {
+        while ( _buckets[i] ) {
+            Entry *entry = _buckets[i];
+            _buckets[i] = entry->next;
+            destroy(entry);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscEPCache::getStatistics(Statistics &stats) const
+{
+    PltMutexLock lock(_mutex);
+    stats = _stats;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscEPCache::resetStatistics()
+{
+    PltMutexLock lock(_mutex);
+    _stats.hits = 0;
+    _stats.child_hits = 0;
+    _stats.misses = 0;
+    _stats.stores = 0;
+    _stats.invalidations = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// EOF epcache.cpp
+//////////////////////////////////////////////////////////////////////
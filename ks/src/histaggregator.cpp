@@ -0,0 +1,274 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "ks/histaggregator.h"
+
+#include <math.h>
+
+
+// ----------------------------------------------------------------------------
+//
+KssHistoryAggregator::KssHistoryAggregator()
+    : _buckets(0),
+      _starts(0),
+      _rows(0),
+      _min(0),
+      _max(0),
+      _sum(0),
+      _last(0)
+{
+} // KssHistoryAggregator::KssHistoryAggregator
+
+
+KssHistoryAggregator::~KssHistoryAggregator()
+{
+    release();
+} // KssHistoryAggregator::~KssHistoryAggregator
+
+
+void
+KssHistoryAggregator::release()
+{
+    delete [] _starts;
+    delete [] _rows;
+    delete [] _min;
+    delete [] _max;
+    delete [] _sum;
+    delete [] _last;
+    _starts = 0;
+    _rows = 0;
+    _min = _max = _sum = _last = 0;
+    _buckets = 0;
+} // KssHistoryAggregator::release
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KssHistoryAggregator::isSupported(KS_INTERPOLATION_MODE mode)
+{
+    return (mode == KS_IPM_MIN) || (mode == KS_IPM_MAX)
+        || (mode == KS_IPM_LINEAR) || (mode == KS_IPM_HOLD);
+} // KssHistoryAggregator::isSupported
+
+
+// ----------------------------------------------------------------------------
+// The bucket boundaries are calculated in microseconds relative to the start
+// of the range, so they don't accumulate rounding errors. The number of
+// buckets is limited by the number of rows only if the client didn't ask
+// for a particular bucket width, as otherwise the buckets would end up
+// wider than requested.
+//
+KS_RESULT
+KssHistoryAggregator::setup(const PltTime &from, const PltTime &to,
+                            const PltTimeSpan &delta, size_t maxBuckets,
+                            size_t rows)
+{
+    release();
+    if ( !maxBuckets || (to < from) ) {
+        return KS_ERR_OK;
+    }
+
+    double range = (double) (to.tv_sec - from.tv_sec) * 1e6
+        + (double) (to.tv_usec - from.tv_usec);
+    double width = (double) delta.tv_sec * 1e6 + (double) delta.tv_usec;
+    size_t buckets = maxBuckets;
+    if ( width > 0.0 ) {
+        double n = ceil(range / width);
+        if ( n < (double) maxBuckets ) {
+            buckets = n >= 1.0 ? (size_t) n : 1;
+        }
+        if ( buckets > KSS_HISTORY_MAX_BUCKETS ) {
+            return KS_ERR_BADPARAM;
+        }
+    } else {
+        if ( buckets > rows ) {
+            buckets = rows;
+        }
+        if ( buckets > KSS_HISTORY_MAX_BUCKETS ) {
+            buckets = KSS_HISTORY_MAX_BUCKETS;
+        }
+        if ( !buckets ) {
+            return KS_ERR_OK;
+        }
+    }
+    width = range / (double) buckets;
+
+    _starts = new PltTime[buckets + 1];
+    _rows   = new size_t[buckets + 1];
+    _min    = new double[buckets];
+    _max    = new double[buckets];
+    _sum    = new double[buckets];
+    _last   = new double[buckets];
+    if ( !_starts || !_rows || !_min || !_max || !_sum || !_last ) {
+        release();
+        return KS_ERR_GENERIC;
+    }
+    _buckets = buckets;
+
+    for ( size_t b = 0; b < buckets; ++b ) {
+        double offset = floor(width * (double) b);
+        long secs = (long) (offset / 1e6);
+        _starts[b] = from + PltTimeSpan(secs,
+                                        (long) (offset - secs * 1e6));
+        _rows[b] = 0;
+    }
+    _starts[buckets] = to;
+    _rows[buckets] = 0;
+    reset();
+    return KS_ERR_OK;
+} // KssHistoryAggregator::setup
+
+
+// ----------------------------------------------------------------------------
+//
+void
+KssHistoryAggregator::reset()
+{
+    for ( size_t b = 0; b < _buckets; ++b ) {
+        _min[b] = HUGE_VAL;
+        _max[b] = -HUGE_VAL;
+        _sum[b] = 0.0;
+        _last[b] = 0.0;
+    }
+} // KssHistoryAggregator::reset
+
+
+// ----------------------------------------------------------------------------
+// The inner loop over a contiguous run of values. It keeps four independent
+// sets of accumulators, so the additions and comparisons don't depend on
+// each other and the compiler is free to use vector instructions.
+//
+void
+KssHistoryAggregator::accumulate(size_t b, const double *values,
+                                 size_t count)
+{
+    if ( !count ) {
+        return;
+    }
+    double mn0 = _min[b], mn1 = mn0, mn2 = mn0, mn3 = mn0;
+    double mx0 = _max[b], mx1 = mx0, mx2 = mx0, mx3 = mx0;
+    double s0 = _sum[b], s1 = 0.0, s2 = 0.0, s3 = 0.0;
+
+    size_t i = 0;
+    for ( ; i + 4 <= count; i += 4 ) {
+        double v0 = values[i];
+        double v1 = values[i + 1];
+        double v2 = values[i + 2];
+        double v3 = values[i + 3];
+        mn0 = v0 < mn0 ? v0 : mn0;
+        mn1 = v1 < mn1 ? v1 : mn1;
+        mn2 = v2 < mn2 ? v2 : mn2;
+        mn3 = v3 < mn3 ? v3 : mn3;
+        mx0 = v0 > mx0 ? v0 : mx0;
+        mx1 = v1 > mx1 ? v1 : mx1;
+        mx2 = v2 > mx2 ? v2 : mx2;
+        mx3 = v3 > mx3 ? v3 : mx3;
+        s0 += v0;
+        s1 += v1;
+        s2 += v2;
+        s3 += v3;
+    }
+    for ( ; i < count; ++i ) {
+        double v = values[i];
+        mn0 = v < mn0 ? v : mn0;
+        mx0 = v > mx0 ? v : mx0;
+        s0 += v;
+    }
+
+    mn0 = mn1 < mn0 ? mn1 : mn0;
+    mn2 = mn3 < mn2 ? mn3 : mn2;
+    mx0 = mx1 > mx0 ? mx1 : mx0;
+    mx2 = mx3 > mx2 ? mx3 : mx2;
+    _min[b]  = mn2 < mn0 ? mn2 : mn0;
+    _max[b]  = mx2 > mx0 ? mx2 : mx0;
+    _sum[b]  = (s0 + s1) + (s2 + s3);
+    _last[b] = values[count - 1];
+} // KssHistoryAggregator::accumulate
+
+
+// ----------------------------------------------------------------------------
+//
+size_t
+KssHistoryAggregator::getFilledCount() const
+{
+    size_t filled = 0;
+    for ( size_t b = 0; b < _buckets; ++b ) {
+        if ( _rows[b + 1] > _rows[b] ) {
+            ++filled;
+        }
+    }
+    return filled;
+} // KssHistoryAggregator::getFilledCount
+
+
+KsValueHandle
+KssHistoryAggregator::getTimes() const
+{
+    size_t filled = getFilledCount();
+    KsTimeVecValue *tv = new KsTimeVecValue(filled);
+    if ( !tv || (tv->size() != filled) ) {
+        delete tv;
+        return KsValueHandle();
+    }
+    KsTime *dst = tv->getPtr();
+    for ( size_t b = 0; b < _buckets; ++b ) {
+        if ( _rows[b + 1] > _rows[b] ) {
+            *dst++ = _starts[b];
+        }
+    }
+    return KsValueHandle(tv, KsOsNew);
+} // KssHistoryAggregator::getTimes
+
+
+KsValueHandle
+KssHistoryAggregator::getValues(KS_INTERPOLATION_MODE mode) const
+{
+    size_t filled = getFilledCount();
+    KsDoubleVecValue *dv = new KsDoubleVecValue(filled);
+    if ( !dv || (dv->size() != filled) ) {
+        delete dv;
+        return KsValueHandle();
+    }
+    double *dst = dv->getPtr();
+    for ( size_t b = 0; b < _buckets; ++b ) {
+        size_t n = _rows[b + 1] - _rows[b];
+        if ( !n ) {
+            continue;
+        }
+        switch ( mode ) {
+        case KS_IPM_MIN:
+            *dst++ = _min[b];
+            break;
+        case KS_IPM_MAX:
+            *dst++ = _max[b];
+            break;
+        case KS_IPM_LINEAR:
+            *dst++ = _sum[b] / (double) n;
+            break;
+        default:
+            *dst++ = _last[b];
+            break;
+        }
+    }
+    return KsValueHandle(dv, KsOsNew);
+} // KssHistoryAggregator::getValues
+
+/* End of histaggregator.cpp */
@@ -0,0 +1,798 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "ks/histcodec.h"
+
+#include <string.h>
+
+
+// ----------------------------------------------------------------------------
+// Some helpers for the headers (network byte order) and for the bit
+// fiddling.
+//
+static inline void
+putU32(char *p, unsigned long v)
+{
+    p[0] = (char) (v >> 24);
+    p[1] = (char) (v >> 16);
+    p[2] = (char) (v >> 8);
+    p[3] = (char) v;
+} // putU32
+
+
+static inline void
+putU64(char *p, PltUInt64 v)
+{
+    putU32(p, (unsigned long) (v >> 32));
+    putU32(p + 4, (unsigned long) (v & 0xFFFFFFFFUL));
+} // putU64
+
+
+static inline unsigned long
+getU32(const unsigned char *p)
+{
+    return ((unsigned long) p[0] << 24) | ((unsigned long) p[1] << 16)
+        | ((unsigned long) p[2] << 8) | (unsigned long) p[3];
+} // getU32
+
+
+static inline PltUInt64
+getU64(const unsigned char *p)
+{
+    return ((PltUInt64) getU32(p) << 32) | (PltUInt64) getU32(p + 4);
+} // getU64
+
+
+static inline PltUInt64
+doubleBits(double d)
+{
+    PltUInt64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+} // doubleBits
+
+
+static inline double
+bitsDouble(PltUInt64 bits)
+{
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+} // bitsDouble
+
+
+static inline PltUInt64
+timeMicros(const PltTime &t)
+{
+    if ( t.tv_sec < 0 ) {
+        return 0;
+    }
+    return (PltUInt64) t.tv_sec * 1000000 + (PltUInt64) t.tv_usec;
+} // timeMicros
+
+
+static inline unsigned int
+leadingZeros(PltUInt64 x)
+{
+#if PLT_COMPILER_GCC
+    return __builtin_clzll(x);
+#else
+    unsigned int n = 0;
+    while ( !(x & ((PltUInt64) 1 << 63)) ) {
+        x <<= 1;
+        ++n;
+    }
+    return n;
+#endif
+} // leadingZeros
+
+
+static inline unsigned int
+trailingZeros(PltUInt64 x)
+{
+#if PLT_COMPILER_GCC
+    return __builtin_ctzll(x);
+#else
+    unsigned int n = 0;
+    while ( !(x & 1) ) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+} // trailingZeros
+
+
+//
+// The buckets for the delta of delta of time stamps: a prefix of n one bits
+// (terminated by a zero bit for less than five ones) selects the number of
+// bits of the (two's complement) value following.
+//
+static const unsigned int dodBits[6] = { 0, 7, 9, 12, 32, 64 };
+
+static const unsigned int NO_WINDOW = 0xFF;
+
+
+// ----------------------------------------------------------------------------
+//
+KsHistEncoder::KsHistEncoder(Kind kind, size_t blockSize)
+    : _kind(kind),
+      _block_size(blockSize ? blockSize : 1),
+      _buf(0),
+      _size(0),
+      _alloc(0),
+      _free_bits(0),
+      _count(0),
+      _block_start(0),
+      _block_count(0),
+      _first(0),
+      _prev(0),
+      _prev_delta(0),
+      _prev_lead(NO_WINDOW),
+      _prev_trail(0),
+      _min(0.0),
+      _max(0.0)
+{
+} // KsHistEncoder::KsHistEncoder
+
+
+KsHistEncoder::~KsHistEncoder()
+{
+    delete [] _buf;
+} // KsHistEncoder::~KsHistEncoder
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KsHistEncoder::reserve(size_t bytes)
+{
+    if ( _size + bytes <= _alloc ) {
+        return true;
+    }
+    size_t alloc = _alloc ? 2 * _alloc : 256;
+    while ( alloc < _size + bytes ) {
+        alloc *= 2;
+    }
+    char *buf = new char[alloc];
+    if ( !buf ) {
+        return false;
+    }
+    if ( _size ) {
+        memcpy(buf, _buf, _size);
+    }
+    delete [] _buf;
+    _buf = buf;
+    _alloc = alloc;
+    return true;
+} // KsHistEncoder::reserve
+
+
+// ----------------------------------------------------------------------------
+// Append the n lowest bits of "bits", most significant bit first.
+//
+bool
+KsHistEncoder::putBits(PltUInt64 bits, unsigned int n)
+{
+    while ( n ) {
+        if ( !_free_bits ) {
+            if ( !reserve(1) ) {
+                return false;
+            }
+            _buf[_size++] = 0;
+            _free_bits = 8;
+        }
+        unsigned int take = n < _free_bits ? n : _free_bits;
+        unsigned int chunk =
+            (unsigned int) (bits >> (n - take)) & ((1U << take) - 1);
+        _buf[_size - 1] |= (char) (chunk << (_free_bits - take));
+        _free_bits -= take;
+        n -= take;
+    }
+    return true;
+} // KsHistEncoder::putBits
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KsHistEncoder::beginBlock()
+{
+    if ( !reserve(KS_HISTBLOCK_HEADER_SIZE) ) {
+        return false;
+    }
+    _block_start = _size;
+    memset(_buf + _size, 0, KS_HISTBLOCK_HEADER_SIZE);
+    _size += KS_HISTBLOCK_HEADER_SIZE;
+    _free_bits = 0;
+    _block_count = 0;
+    _prev_delta = 0;
+    _prev_lead = NO_WINDOW;
+    return true;
+} // KsHistEncoder::beginBlock
+
+
+void
+KsHistEncoder::endBlock()
+{
+    if ( _size == _block_start ) {
+        //
+        // No block has been started, which only happens for an empty
+        // column. Even then there's one (empty) block, so the kind of the
+        // column is known.
+        //
+        if ( !beginBlock() ) {
+            return;
+        }
+    }
+    char *hdr = _buf + _block_start;
+    hdr[0] = 'K';
+    hdr[1] = 'S';
+    hdr[2] = 'H';
+    hdr[3] = (char) _kind;
+    putU32(hdr + 4, _block_count);
+    putU32(hdr + 8, _size - _block_start - KS_HISTBLOCK_HEADER_SIZE);
+    if ( _kind == TIMES ) {
+        putU64(hdr + 12, _first);
+        putU64(hdr + 20, _prev);
+    } else {
+        putU64(hdr + 12, doubleBits(_min));
+        putU64(hdr + 20, doubleBits(_max));
+    }
+    _block_start = _size;
+    _block_count = 0;
+    _free_bits = 0;
+} // KsHistEncoder::endBlock
+
+
+// ----------------------------------------------------------------------------
+// Encode the next sample: the first sample of a block is stored as is, the
+// following ones relative to their predecessors.
+//
+bool
+KsHistEncoder::addSample(PltUInt64 sample)
+{
+    if ( !_block_count ) {
+        if ( !beginBlock() || !putBits(sample, 64) ) {
+            return false;
+        }
+        _first = sample;
+        if ( _kind == VALUES ) {
+            _min = _max = bitsDouble(sample);
+        }
+    } else if ( _kind == TIMES ) {
+        PltInt64 delta = (PltInt64) (sample - _prev);
+        PltInt64 dod = delta - _prev_delta;
+        _prev_delta = delta;
+        unsigned int bucket = 0;
+        if ( dod ) {
+            for ( bucket = 1; bucket < 5; ++bucket ) {
+                PltInt64 limit = (PltInt64) 1 << (dodBits[bucket] - 1);
+                if ( (dod >= -limit) && (dod < limit) ) {
+                    break;
+                }
+            }
+        }
+        //
+        // The prefix: "bucket" one bits, followed by a zero bit unless
+        // it's the last bucket.
+        //
+        bool ok = bucket < 5 ?
+            putBits(((1U << bucket) - 1) << 1, bucket + 1)
+            : putBits(0x1F, 5);
+        if ( !ok || !putBits((PltUInt64) dod, dodBits[bucket]) ) {
+            return false;
+        }
+    } else {
+        PltUInt64 x = sample ^ _prev;
+        if ( !x ) {
+            if ( !putBits(0, 1) ) {
+                return false;
+            }
+        } else {
+            unsigned int lead = leadingZeros(x);
+            unsigned int trail = trailingZeros(x);
+            if ( lead > 31 ) {
+                lead = 31;
+            }
+            if ( (_prev_lead != NO_WINDOW)
+                 && (lead >= _prev_lead) && (trail >= _prev_trail) ) {
+                //
+                // The meaningful bits fit into the previous window.
+                //
+                if ( !putBits(2, 2)
+                     || !putBits(x >> _prev_trail,
+                                 64 - _prev_lead - _prev_trail) ) {
+                    return false;
+                }
+            } else {
+                unsigned int len = 64 - lead - trail;
+                if ( !putBits(3, 2) || !putBits(lead, 5)
+                     || !putBits(len - 1, 6) || !putBits(x >> trail, len) ) {
+                    return false;
+                }
+                _prev_lead = lead;
+                _prev_trail = trail;
+            }
+        }
+        double v = bitsDouble(sample);
+        if ( v < _min ) {
+            _min = v;
+        }
+        if ( v > _max ) {
+            _max = v;
+        }
+    }
+
+    _prev = sample;
+    ++_count;
+    if ( ++_block_count >= _block_size ) {
+        endBlock();
+    }
+    return true;
+} // KsHistEncoder::addSample
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KsHistEncoder::addTime(const PltTime &t)
+{
+    return (_kind == TIMES) && addSample(timeMicros(t));
+} // KsHistEncoder::addTime
+
+
+bool
+KsHistEncoder::addValue(double v)
+{
+    return (_kind == VALUES) && addSample(doubleBits(v));
+} // KsHistEncoder::addValue
+
+
+bool
+KsHistEncoder::addTimes(const KsTime *t, size_t count)
+{
+    for ( size_t i = 0; i < count; ++i ) {
+        if ( !addTime(t[i]) ) {
+            return false;
+        }
+    }
+    return true;
+} // KsHistEncoder::addTimes
+
+
+bool
+KsHistEncoder::addValues(const double *v, size_t count)
+{
+    for ( size_t i = 0; i < count; ++i ) {
+        if ( !addValue(v[i]) ) {
+            return false;
+        }
+    }
+    return true;
+} // KsHistEncoder::addValues
+
+
+// ----------------------------------------------------------------------------
+//
+char *
+KsHistEncoder::detach(size_t &size)
+{
+    if ( _block_count || !_size ) {
+        endBlock();
+    }
+    char *buf = _buf;
+    size = _size;
+    _buf = 0;
+    _size = _alloc = 0;
+    _free_bits = 0;
+    _count = 0;
+    _block_start = 0;
+    _block_count = 0;
+    return buf;
+} // KsHistEncoder::detach
+
+
+KsValueHandle
+KsHistEncoder::getValue()
+{
+    size_t size;
+    char *buf = detach(size);
+    if ( !buf ) {
+        return KsValueHandle();
+    }
+    KsByteVecValue *bv = new KsByteVecValue(size, buf, PltOsArrayNew);
+    if ( !bv ) {
+        delete [] buf;
+        return KsValueHandle();
+    }
+    return KsValueHandle(bv, KsOsNew);
+} // KsHistEncoder::getValue
+
+
+// ----------------------------------------------------------------------------
+//
+KsValueHandle
+KsHistEncoder::encode(const KsValueHandle &value, size_t blockSize)
+{
+    if ( !value ) {
+        return value;
+    }
+    switch ( value->xdrTypeCode() ) {
+    case KS_VT_TIME_VEC: {
+        KsTimeVecValue *tv = (KsTimeVecValue *) value.getPtr();
+        KsHistEncoder enc(TIMES, blockSize);
+        if ( enc.addTimes(tv->getPtr(), tv->size()) ) {
+            KsValueHandle encoded(enc.getValue());
+            if ( encoded ) {
+                return encoded;
+            }
+        }
+        break;
+    }
+    case KS_VT_DOUBLE_VEC: {
+        KsDoubleVecValue *dv = (KsDoubleVecValue *) value.getPtr();
+        KsHistEncoder enc(VALUES, blockSize);
+        if ( enc.addValues(dv->getPtr(), dv->size()) ) {
+            KsValueHandle encoded(enc.getValue());
+            if ( encoded ) {
+                return encoded;
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    //
+    // Can't (or shouldn't) encode this one, so send it as it is.
+    //
+    return value;
+} // KsHistEncoder::encode
+
+
+// ----------------------------------------------------------------------------
+//
+KsHistDecoder::KsHistDecoder(const char *data, size_t size)
+    : _data((const unsigned char *) data),
+      _size(size),
+      _next(0),
+      _block(0),
+      _block_count(0),
+      _pos(0),
+      _bits(0),
+      _decoded(0),
+      _prev(0),
+      _prev_delta(0),
+      _prev_lead(NO_WINDOW),
+      _prev_trail(0)
+{
+} // KsHistDecoder::KsHistDecoder
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KsHistDecoder::check(KsHistEncoder::Kind &kind, size_t &count) const
+{
+    size_t offset = 0;
+    count = 0;
+    if ( !_size ) {
+        return false;
+    }
+    while ( offset < _size ) {
+        if ( _size - offset < KS_HISTBLOCK_HEADER_SIZE ) {
+            return false;
+        }
+        const unsigned char *hdr = _data + offset;
+        if ( (hdr[0] != 'K') || (hdr[1] != 'S') || (hdr[2] != 'H')
+             || ((hdr[3] != KsHistEncoder::TIMES)
+                 && (hdr[3] != KsHistEncoder::VALUES))
+             || (offset && (hdr[3] != kind)) ) {
+            return false;
+        }
+        kind = (KsHistEncoder::Kind) hdr[3];
+        size_t len = getU32(hdr + 8);
+        if ( len > _size - offset - KS_HISTBLOCK_HEADER_SIZE ) {
+            return false;
+        }
+        count += getU32(hdr + 4);
+        offset += KS_HISTBLOCK_HEADER_SIZE + len;
+    }
+    return true;
+} // KsHistDecoder::check
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KsHistDecoder::nextBlock()
+{
+    if ( (_next >= _size)
+         || (_size - _next < KS_HISTBLOCK_HEADER_SIZE) ) {
+        _block = 0;
+        return false;
+    }
+    const unsigned char *hdr = _data + _next;
+    size_t len = getU32(hdr + 8);
+    if ( (hdr[0] != 'K') || (hdr[1] != 'S') || (hdr[2] != 'H')
+         || (len > _size - _next - KS_HISTBLOCK_HEADER_SIZE) ) {
+        _block = 0;
+        return false;
+    }
+    _block = hdr;
+    _block_count = getU32(hdr + 4);
+    _pos = 0;
+    _bits = 8 * len;
+    _decoded = 0;
+    _prev_delta = 0;
+    _prev_lead = NO_WINDOW;
+    _next += KS_HISTBLOCK_HEADER_SIZE + len;
+    return true;
+} // KsHistDecoder::nextBlock
+
+
+PltTime
+KsHistDecoder::getBlockFirstTime() const
+{
+    PltUInt64 t = getU64(_block + 12);
+    return PltTime((long) (t / 1000000), (long) (t % 1000000));
+} // KsHistDecoder::getBlockFirstTime
+
+
+PltTime
+KsHistDecoder::getBlockLastTime() const
+{
+    PltUInt64 t = getU64(_block + 20);
+    return PltTime((long) (t / 1000000), (long) (t % 1000000));
+} // KsHistDecoder::getBlockLastTime
+
+
+double
+KsHistDecoder::getBlockMin() const
+{
+    return bitsDouble(getU64(_block + 12));
+} // KsHistDecoder::getBlockMin
+
+
+double
+KsHistDecoder::getBlockMax() const
+{
+    return bitsDouble(getU64(_block + 20));
+} // KsHistDecoder::getBlockMax
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KsHistDecoder::getBits(unsigned int n, PltUInt64 &bits)
+{
+    if ( n > _bits - _pos ) {
+        return false;
+    }
+    const unsigned char *payload = _block + KS_HISTBLOCK_HEADER_SIZE;
+    bits = 0;
+    while ( n ) {
+        unsigned int avail = 8 - (unsigned int) (_pos & 7);
+        unsigned int take = n < avail ? n : avail;
+        unsigned int chunk =
+            (payload[_pos >> 3] >> (avail - take)) & ((1U << take) - 1);
+        bits = (bits << take) | chunk;
+        _pos += take;
+        n -= take;
+    }
+    return true;
+} // KsHistDecoder::getBits
+
+
+// ----------------------------------------------------------------------------
+// The counterpart of KsHistEncoder::addSample().
+//
+bool
+KsHistDecoder::nextSample(PltUInt64 &sample)
+{
+    if ( !_block || (_decoded >= _block_count) ) {
+        return false;
+    }
+    PltUInt64 bits;
+    if ( !_decoded ) {
+        if ( !getBits(64, sample) ) {
+            return false;
+        }
+    } else if ( _block[3] == KsHistEncoder::TIMES ) {
+        unsigned int bucket = 0;
+        while ( bucket < 5 ) {
+            if ( !getBits(1, bits) ) {
+                return false;
+            }
+            if ( !bits ) {
+                break;
+            }
+            ++bucket;
+        }
+        unsigned int n = dodBits[bucket];
+        PltInt64 dod = 0;
+        if ( n ) {
+            if ( !getBits(n, bits) ) {
+                return false;
+            }
+            if ( (n < 64) && ((bits >> (n - 1)) & 1) ) {
+                bits |= ~(PltUInt64) 0 << n;
+            }
+            dod = (PltInt64) bits;
+        }
+        _prev_delta += dod;
+        sample = _prev + (PltUInt64) _prev_delta;
+    } else {
+        if ( !getBits(1, bits) ) {
+            return false;
+        }
+        if ( !bits ) {
+            sample = _prev;
+        } else {
+            if ( !getBits(1, bits) ) {
+                return false;
+            }
+            if ( bits ) {
+                PltUInt64 lead, len;
+                if ( !getBits(5, lead) || !getBits(6, len) ) {
+                    return false;
+                }
+                ++len;
+                if ( lead + len > 64 ) {
+                    return false;
+                }
+                _prev_lead = (unsigned int) lead;
+                _prev_trail = (unsigned int) (64 - lead - len);
+            } else if ( _prev_lead == NO_WINDOW ) {
+                return false;
+            }
+            if ( !getBits(64 - _prev_lead - _prev_trail, bits) ) {
+                return false;
+            }
+            sample = _prev ^ (bits << _prev_trail);
+        }
+    }
+    _prev = sample;
+    ++_decoded;
+    return true;
+} // KsHistDecoder::nextSample
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KsHistDecoder::decodeTimes(KsTime *dst)
+{
+    if ( !_block || (_block[3] != KsHistEncoder::TIMES) ) {
+        return false;
+    }
+    PltUInt64 t;
+    for ( size_t i = 0; i < _block_count; ++i ) {
+        if ( !nextSample(t) ) {
+            return false;
+        }
+        dst[i] = KsTime((long) (t / 1000000), (long) (t % 1000000));
+    }
+    return true;
+} // KsHistDecoder::decodeTimes
+
+
+bool
+KsHistDecoder::decodeTimes(PltTime *dst)
+{
+    if ( !_block || (_block[3] != KsHistEncoder::TIMES) ) {
+        return false;
+    }
+    PltUInt64 t;
+    for ( size_t i = 0; i < _block_count; ++i ) {
+        if ( !nextSample(t) ) {
+            return false;
+        }
+        dst[i] = PltTime((long) (t / 1000000), (long) (t % 1000000));
+    }
+    return true;
+} // KsHistDecoder::decodeTimes
+
+
+bool
+KsHistDecoder::decodeValues(double *dst)
+{
+    if ( !_block || (_block[3] != KsHistEncoder::VALUES) ) {
+        return false;
+    }
+    PltUInt64 v;
+    for ( size_t i = 0; i < _block_count; ++i ) {
+        if ( !nextSample(v) ) {
+            return false;
+        }
+        dst[i] = bitsDouble(v);
+    }
+    return true;
+} // KsHistDecoder::decodeValues
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KsHistDecoder::isEncoded(const KsValueHandle &value)
+{
+    if ( !value || (value->xdrTypeCode() != KS_VT_BYTE_VEC) ) {
+        return false;
+    }
+    KsByteVecValue *bv = (KsByteVecValue *) value.getPtr();
+    if ( bv->size() < KS_HISTBLOCK_HEADER_SIZE ) {
+        return false;
+    }
+    const char *p = bv->getPtr();
+    return (p[0] == 'K') && (p[1] == 'S') && (p[2] == 'H')
+        && ((p[3] == KsHistEncoder::TIMES)
+            || (p[3] == KsHistEncoder::VALUES));
+} // KsHistDecoder::isEncoded
+
+
+KsValueHandle
+KsHistDecoder::decode(const KsValueHandle &value)
+{
+    if ( !isEncoded(value) ) {
+        return value;
+    }
+    KsByteVecValue *bv = (KsByteVecValue *) value.getPtr();
+    KsHistDecoder dec(bv->getPtr(), bv->size());
+    KsHistEncoder::Kind kind;
+    size_t count;
+    if ( !dec.check(kind, count) ) {
+        return KsValueHandle();
+    }
+
+    if ( kind == KsHistEncoder::TIMES ) {
+        KsTimeVecValue *tv = new KsTimeVecValue(count);
+        if ( !tv || (tv->size() != count) ) {
+            delete tv;
+            return KsValueHandle();
+        }
+        KsTime *dst = tv->getPtr();
+        while ( dec.nextBlock() ) {
+            if ( !dec.decodeTimes(dst) ) {
+                delete tv;
+                return KsValueHandle();
+            }
+            dst += dec.getBlockCount();
+        }
+        return KsValueHandle(tv, KsOsNew);
+    } else {
+        KsDoubleVecValue *dv = new KsDoubleVecValue(count);
+        if ( !dv || (dv->size() != count) ) {
+            delete dv;
+            return KsValueHandle();
+        }
+        double *dst = dv->getPtr();
+        while ( dec.nextBlock() ) {
+            if ( !dec.decodeValues(dst) ) {
+                delete dv;
+                return KsValueHandle();
+            }
+            dst += dec.getBlockCount();
+        }
+        return KsValueHandle(dv, KsOsNew);
+    }
+} // KsHistDecoder::decode
+
+/* End of histcodec.cpp */
@@ -0,0 +1,262 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "ks/histcursor.h"
+
+
+// ----------------------------------------------------------------------------
+//
+KssHistoryCursor::KssHistoryCursor()
+    : _items(0),
+      _item_count(0),
+      _rows(0)
+{
+} // KssHistoryCursor::KssHistoryCursor
+
+
+KssHistoryCursor::~KssHistoryCursor()
+{
+    delete [] _items;
+} // KssHistoryCursor::~KssHistoryCursor
+
+
+// ----------------------------------------------------------------------------
+// Allocate the items of the reply; they are all errors until set otherwise.
+//
+bool
+KssHistoryCursor::setItemCount(size_t count)
+{
+    delete [] _items;
+    _items = count ? new Item[count] : 0;
+    if ( count && !_items ) {
+        _item_count = 0;
+        return false;
+    }
+    _item_count = count;
+    for ( size_t i = 0; i < count; ++i ) {
+        _items[i].result = KS_ERR_GENERIC;
+        _items[i].time = false;
+        _items[i].column = 0;
+    }
+    return true;
+} // KssHistoryCursor::setItemCount
+
+
+void
+KssHistoryCursor::setTimeItem(size_t item)
+{
+    _items[item].result = KS_ERR_OK;
+    _items[item].time = true;
+    _items[item].column = 0;
+} // KssHistoryCursor::setTimeItem
+
+
+void
+KssHistoryCursor::setValueItem(size_t item, size_t column)
+{
+    _items[item].result = KS_ERR_OK;
+    _items[item].time = false;
+    _items[item].column = column;
+} // KssHistoryCursor::setValueItem
+
+
+void
+KssHistoryCursor::setBadItem(size_t item, KS_RESULT result)
+{
+    _items[item].result = result;
+    _items[item].time = false;
+    _items[item].column = 0;
+} // KssHistoryCursor::setBadItem
+
+
+// ----------------------------------------------------------------------------
+//
+KssGetHistStreamResult::KssGetHistStreamResult(size_t paths)
+    : KssStreamedResult(KS_ERR_OK),
+      replies(paths),
+      _cursors(0),
+      _times(0),
+      _values(0),
+      _state(BEGIN),
+      _reply(0),
+      _item(0),
+      _row(0)
+{
+    if ( replies.size() != paths ) {
+        return;
+    }
+    _cursors = new KssHistoryCursor *[paths ? paths : 1];
+    if ( _cursors ) {
+        for ( size_t i = 0; i < paths; ++i ) {
+            _cursors[i] = 0;
+        }
+    }
+} // KssGetHistStreamResult::KssGetHistStreamResult
+
+
+KssGetHistStreamResult::~KssGetHistStreamResult()
+{
+    if ( _cursors ) {
+        for ( size_t i = 0; i < replies.size(); ++i ) {
+            delete _cursors[i];
+        }
+        delete [] _cursors;
+    }
+    delete [] _times;
+    delete [] _values;
+} // KssGetHistStreamResult::~KssGetHistStreamResult
+
+
+bool
+KssGetHistStreamResult::isValid() const
+{
+    return _cursors != 0;
+} // KssGetHistStreamResult::isValid
+
+
+void
+KssGetHistStreamResult::setCursor(size_t path, KssHistoryCursor *cursor)
+{
+    delete _cursors[path];
+    _cursors[path] = cursor;
+} // KssGetHistStreamResult::setCursor
+
+
+// ----------------------------------------------------------------------------
+// Serialize the next piece of the reply. Replies built as usual are
+// serialized as a whole, those taken from a cursor block by block. The
+// state tells where to go on the next time.
+//
+bool
+KssGetHistStreamResult::xdrEncodeNext(XDR *xdr, size_t budget, bool &done)
+{
+    size_t used = 0;
+    done = false;
+
+    if ( _state == BEGIN ) {
+        if ( !KsResult::xdrEncode(xdr) ) {
+            return false;
+        }
+        if ( result != KS_ERR_OK ) {
+            done = true;
+            return true;
+        }
+        u_long count = replies.size();
+        if ( !ks_xdre_u_long(xdr, &count) ) {
+            return false;
+        }
+        _reply = 0;
+        _state = REPLY;
+    }
+
+    for ( ; _reply < replies.size(); ++_reply, _state = REPLY ) {
+        KssHistoryCursor *cursor = _cursors[_reply];
+        if ( _state == REPLY ) {
+            if ( used >= budget ) {
+                return true;
+            }
+            if ( !cursor ) {
+                if ( !replies[_reply].xdrEncode(xdr) ) {
+                    return false;
+                }
+                used += 4;
+                continue;
+            }
+            enum_t res = KS_ERR_OK;
+            u_long count = cursor->getItemCount();
+            if ( !ks_xdre_enum(xdr, &res)
+                 || !ks_xdre_u_long(xdr, &count) ) {
+                return false;
+            }
+            used += 8;
+            _item = 0;
+            _state = ITEM;
+        }
+
+        for ( ; _item < cursor->getItemCount(); ++_item, _state = ITEM ) {
+            if ( _state == ITEM ) {
+                enum_t res = cursor->getItemResult(_item);
+                if ( !ks_xdre_enum(xdr, &res) ) {
+                    return false;
+                }
+                used += 4;
+                if ( res != KS_ERR_OK ) {
+                    continue;
+                }
+                enum_t type = cursor->isTimeItem(_item) ?
+                    KS_VT_TIME_VEC : KS_VT_DOUBLE_VEC;
+                u_long count = cursor->getRowCount();
+                if ( !ks_xdre_enum(xdr, &type)
+                     || !ks_xdre_u_long(xdr, &count) ) {
+                    return false;
+                }
+                used += 8;
+                _row = 0;
+                _state = ROWS;
+            }
+
+            size_t rows = cursor->getRowCount();
+            bool times = cursor->isTimeItem(_item);
+            while ( _row < rows ) {
+                if ( used >= budget ) {
+                    return true;
+                }
+                size_t n = rows - _row;
+                if ( n > KSS_HISTCURSOR_BLOCK ) {
+                    n = KSS_HISTCURSOR_BLOCK;
+                }
+                if ( times ) {
+                    if ( !_times ) {
+                        _times = new PltTime[KSS_HISTCURSOR_BLOCK];
+                    }
+                    if ( !_times || !cursor->readTimes(_row, n, _times) ) {
+                        return false;
+                    }
+                    for ( size_t r = 0; r < n; ++r ) {
+                        if ( !KsTime(_times[r]).xdrEncode(xdr) ) {
+                            return false;
+                        }
+                    }
+                } else {
+                    if ( !_values ) {
+                        _values = new double[KSS_HISTCURSOR_BLOCK];
+                    }
+                    if ( !_values
+                         || !cursor->readValues(cursor->getItemColumn(_item),
+                                                _row, n, _values) ) {
+                        return false;
+                    }
+                    for ( size_t r = 0; r < n; ++r ) {
+                        if ( !ks_xdre_double(xdr, &_values[r]) ) {
+                            return false;
+                        }
+                    }
+                }
+                used += 8 * n;
+                _row += n;
+            }
+        }
+    }
+
+    done = true;
+    return true;
+} // KssGetHistStreamResult::xdrEncodeNext
+
+/* End of histcursor.cpp */
@@ -23,6 +23,7 @@
 
 
 #include "ks/history.h"
+#include "ks/histcodec.h"
 
 
 /////////////////////////////////////////////////////////////////////////////
@@ -111,6 +112,14 @@ KscHistory::getParts(KsList<KsEngPropsHandle> &parts)
 
 bool 
 KscHistory::getHist(KsGetHistResult &result)
+{
+    return requestHist(result, encoding);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool 
+KscHistory::requestHist(KsGetHistResult &result, bool encode)
 {
     if( !hasValidPath() ) return false;
 
@@ -143,13 +152,72 @@ KscHistory::getHist(KsGetHistResult &result)
 
     PLT_ASSERT( i == sz );
 
-    // Request service
+    // Ask for a compressed reply by setting the KS_IPM_ENCODED flag
+    // of the time selector. The selector is copied, as it belongs to
+    // the user.
     //
+    if( encode && !encoding_refused ) {
+        KsGetHistParams eparams(params);
+        bool flagged = false;
+        for( i = 0; i < sz; ++i ) {
+            KsSelectorHandle &hsel = eparams.items[i].sel;
+            if( hsel && hsel->xdrTypeCode() == KS_HSELT_TIME ) {
+                KsTimeSel *tsel = 
+                    new KsTimeSel(*(const KsTimeSel *)hsel.getPtr());
+                if( !tsel ) break;
+                tsel->ip_mode |= KS_IPM_ENCODED;
+                hsel = KsSelectorHandle(tsel, KsOsNew);
+                flagged = hsel;
+                break;
+            }
+        }
+        if( flagged ) {
+            if( !requestHist(server, eparams, result, true) ) {
+                return false;
+            }
+            KS_RESULT res = replyResult(result);
+            if( res != KS_ERR_NOTIMPLEMENTED 
+                && res != KS_ERR_BADSELECTOR
+                && res != KS_ERR_BADPARAM
+                && res != KS_ERR_BADVALUE ) {
+                return _last_result == KS_ERR_OK;
+            }
+            // The server may not understand the flag -- older ones
+            // complain about the selector or about the parameters
+            // in general, depending on how picky they are. So ask
+            // again without it. Only if that works, the flag was to
+            // blame (and not, say, too many buckets asked for), so
+            // don't try again later.
+            //
+            bool ok = requestHist(server, params, result, false);
+            if( ok && replyResult(result) == KS_ERR_OK ) {
+                encoding_refused = true;
+            }
+            return ok;
+        }
+    }
+
+    return requestHist(server, params, result, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Request service and, if compressed parts have been asked for, decode
+// those in the reply.
+//
+bool
+KscHistory::requestHist(KscServerBase *server,
+                        const KsGetHistParams &params,
+                        KsGetHistResult &result,
+                        bool encoded)
+{
     bool ok = server->requestByOpcode(KS_GETHIST, av_module,
 				      params, result);
 
     if( ok ) {
         _last_result = result.result;
+        if( _last_result == KS_ERR_OK && encoded ) {
+            decodeResult(result);
+        }
     } else {
         _last_result = server->getLastResult();
     }
@@ -157,6 +225,269 @@ KscHistory::getHist(KsGetHistResult &result)
     return _last_result == KS_ERR_OK;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// A GetHist result which hands the items of the replies to a block handler
+// while they are decoded instead of building values. The replies only get
+// their result.
+//
+class KscHistBlockResult
+    : public KsGetHistResult
+{
+public:
+    KscHistBlockResult(KscHistBlockHandler &h);
+    ~KscHistBlockResult();
+
+    bool xdrDecode(XDR *xdr);
+
+private:
+    KscHistBlockResult(const KscHistBlockResult &); // forbidden
+    KscHistBlockResult &operator = (const KscHistBlockResult &); // forbidden
+
+    bool decodeItem(XDR *xdr, size_t item);
+    bool decodeEncoded(XDR *xdr, size_t item, size_t size);
+    bool reserve(size_t count);
+
+    KscHistBlockHandler &handler;
+    KsTime              *times;
+    double              *values;
+    size_t               alloc;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
+KscHistBlockResult::KscHistBlockResult(KscHistBlockHandler &h)
+    : KsGetHistResult(1),
+      handler(h),
+      times(0),
+      values(0),
+      alloc(0)
+{}
+
+/////////////////////////////////////////////////////////////////////////////
+
+KscHistBlockResult::~KscHistBlockResult()
+{
+    delete [] times;
+    delete [] values;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool
+KscHistBlockResult::reserve(size_t count)
+{
+    if( count <= alloc ) return true;
+
+    delete [] times;
+    delete [] values;
+    times = new KsTime[count];
+    values = new double[count];
+    if( !times || !values ) {
+        alloc = 0;
+        return false;
+    }
+    alloc = count;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+bool
+KscHistBlockResult::xdrDecode(XDR *xdr)
+{
+    PLT_PRECONDITION(xdr->x_op == XDR_DECODE);
+
+    if( !KsResult::xdrDecode(xdr) ) return false;
+    if( result != KS_ERR_OK ) return true;
+
+    u_long count;
+    if( !ks_xdrd_u_long(xdr, &count) 
+        || count != replies.size() ) {
+        return false;
+    }
+    for( size_t r = 0; r < count; ++r ) {
+        KsGetHistSingleResult &reply = replies[r];
+        if( !reply.KsResult::xdrDecode(xdr) ) return false;
+        if( reply.result != KS_ERR_OK ) continue;
+
+        u_long nitems;
+        if( !ks_xdrd_u_long(xdr, &nitems) ) return false;
+        for( size_t i = 0; i < nitems; ++i ) {
+            if( !decodeItem(xdr, i) ) return false;
+        }
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Decode an item: the result, the type of the vector and its size, then
+// the elements block by block.
+//
+bool
+KscHistBlockResult::decodeItem(XDR *xdr, size_t item)
+{
+    KsResult res;
+    if( !res.xdrDecode(xdr) ) return false;
+    if( res.result != KS_ERR_OK ) {
+        handler.beginItem(item, res.result, 0);
+        return true;
+    }
+
+    enum_t type;
+    u_long count;
+    if( !ks_xdrd_enum(xdr, &type) 
+        || !ks_xdrd_u_long(xdr, &count) ) {
+        return false;
+    }
+    if( type == KS_VT_BYTE_VEC ) {
+        return decodeEncoded(xdr, item, count);
+    }
+    if( type != KS_VT_TIME_VEC 
+        && type != KS_VT_DOUBLE_VEC 
+        && type != KS_VT_SINGLE_VEC 
+        && type != KS_VT_INT_VEC 
+        && type != KS_VT_UINT_VEC ) {
+        return false;
+    }
+    if( !reserve(KS_HISTBLOCK_SIZE) ) return false;
+
+    handler.beginItem(item, KS_ERR_OK, count);
+    size_t done = 0;
+    while( done < count ) {
+        size_t n = count - done;
+        if( n > alloc ) n = alloc;
+        for( size_t i = 0; i < n; ++i ) {
+            bool ok;
+            switch( type ) {
+            case KS_VT_TIME_VEC:
+                ok = times[i].xdrDecode(xdr);
+                break;
+            case KS_VT_DOUBLE_VEC:
+                ok = ks_xdrd_double(xdr, &values[i]);
+                break;
+            case KS_VT_SINGLE_VEC:
+                {
+                    float f;
+                    ok = ks_xdrd_float(xdr, &f);
+                    values[i] = f;
+                }
+                break;
+            case KS_VT_INT_VEC:
+                {
+                    long l;
+                    ok = ks_xdrd_long(xdr, &l);
+                    values[i] = l;
+                }
+                break;
+            default:
+                {
+                    u_long ul;
+                    ok = ks_xdrd_u_long(xdr, &ul);
+                    values[i] = ul;
+                }
+                break;
+            }
+            if( !ok ) return false;
+        }
+        if( type == KS_VT_TIME_VEC ) {
+            handler.timeBlock(item, times, n);
+        } else {
+            handler.valueBlock(item, values, n);
+        }
+        done += n;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Compressed columns are received as a whole, but decompressed block by
+// block.
+//
+bool
+KscHistBlockResult::decodeEncoded(XDR *xdr, size_t item, size_t size)
+{
+    char *data = new char[size ? size : 1];
+    if( !data ) return false;
+    if( !xdr_opaque(xdr, data, size) ) {
+        delete [] data;
+        return false;
+    }
+
+    KsHistDecoder dec(data, size);
+    KsHistEncoder::Kind kind;
+    size_t count;
+    if( !dec.check(kind, count) ) {
+        delete [] data;
+        return false;
+    }
+    handler.beginItem(item, KS_ERR_OK, count);
+    while( dec.nextBlock() ) {
+        size_t n = dec.getBlockCount();
+        if( !reserve(n) ) {
+            delete [] data;
+            return false;
+        }
+        if( kind == KsHistEncoder::TIMES ) {
+            if( !dec.decodeTimes(times) ) {
+                delete [] data;
+                return false;
+            }
+            handler.timeBlock(item, times, n);
+        } else {
+            if( !dec.decodeValues(values) ) {
+                delete [] data;
+                return false;
+            }
+            handler.valueBlock(item, values, n);
+        }
+    }
+    delete [] data;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Servers stream their reply block by block only for plain requests, so
+// compressed replies are not asked for here.
+//
+bool
+KscHistory::getHistBlocks(KscHistBlockHandler &handler)
+{
+    KscHistBlockResult result(handler);
+
+    return requestHist(result, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+KS_RESULT
+KscHistory::replyResult(const KsGetHistResult &result)
+{
+    return result.replies.size() == 1 ?
+        result.replies[0].result : result.result;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void
+KscHistory::decodeResult(KsGetHistResult &result)
+{
+    for( size_t r = 0; r < result.replies.size(); ++r ) {
+        KsGetHistSingleResult &reply = result.replies[r];
+        if( reply.result != KS_ERR_OK ) continue;
+        for( size_t i = 0; i < reply.items.size(); ++i ) {
+            KsGetHistResultItem &item = reply.items[i];
+            if( item.result == KS_ERR_OK 
+                && KsHistDecoder::isEncoded(item.value) ) {
+                item.value = KsHistDecoder::decode(item.value);
+                if( !item.value ) {
+                    item.result = KS_ERR_GENERIC;
+                }
+            }
+        }
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 bool 
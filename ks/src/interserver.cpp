@@ -35,6 +35,7 @@
 #if PLT_USE_BUFFERED_STREAMS
 
 #include "ks/interserver.h"
+#include "plt/thread.h"
 
 #if !PLT_SYSTEM_NT
 #include <unistd.h>
@@ -43,12 +44,296 @@
 #define DEBUG_STATES 0
 
 
+// ---------------------------------------------------------------------------
+// The pool starts out empty. Resolved server ports are trusted for a minute,
+// idle connections are kept for half a minute, and at most eight idle
+// connections are kept per server.
+//
+KssInterKsServerPool::Entry *KssInterKsServerPool::_entries = 0;
+unsigned long KssInterKsServerPool::_resolve_ttl = 60;
+unsigned long KssInterKsServerPool::_idle_timeout = 30;
+unsigned int KssInterKsServerPool::_max_idle = 8;
+
+//
+// Client event loops running in different threads share the pool, so all
+// access to it is serialized.
+//
+static PltMutex _kss_poolLock;
+
+
+// ---------------------------------------------------------------------------
+//
+void KssInterKsServerPool::setLimits(unsigned long resolveTtl,
+				     unsigned long idleTimeout,
+				     unsigned int maxIdle)
+{
+    PltMutexLock lock(_kss_poolLock);
+    _resolve_ttl  = resolveTtl;
+    _idle_timeout = idleTimeout;
+    _max_idle     = maxIdle;
+} // KssInterKsServerPool::setLimits
+
+
+// ---------------------------------------------------------------------------
+//
+void KssInterKsServerPool::getLimits(unsigned long &resolveTtl,
+				     unsigned long &idleTimeout,
+				     unsigned int &maxIdle)
+{
+    PltMutexLock lock(_kss_poolLock);
+    resolveTtl  = _resolve_ttl;
+    idleTimeout = _idle_timeout;
+    maxIdle     = _max_idle;
+} // KssInterKsServerPool::getLimits
+
+
+// ---------------------------------------------------------------------------
+// Throw away everything the pool knows about: close all idle connections and
+// forget the resolved ports.
+//
+void KssInterKsServerPool::flush()
+{
+    PltMutexLock lock(_kss_poolLock);
+    while ( _entries ) {
+	Entry *e = _entries;
+	_entries = e->next;
+	while ( e->idle ) {
+	    IdleConnection *ic = e->idle;
+	    e->idle = ic->next;
+	    dropConnection(ic->con);
+	    delete ic;
+	}
+	delete e;
+    }
+} // KssInterKsServerPool::flush
+
+
+// ---------------------------------------------------------------------------
+// Find the pool entry for a particular server, optionally creating a new one.
+// A gateway usually talks to a few dozen servers at most, so a plain list is
+// all we need. The caller must hold the pool lock.
+//
+KssInterKsServerPool::Entry *
+KssInterKsServerPool::find(const KsString &key, bool create)
+{
+    Entry *e;
+    for ( e = _entries; e; e = e->next ) {
+	if ( e->key == key ) {
+	    return e;
+	}
+    }
+    if ( !create ) {
+	return 0;
+    }
+    e = new Entry;
+    if ( e ) {
+	e->key = key;
+	e->resolved = false;
+	e->port = 0;
+	e->protocol_version = 0;
+	e->idle = 0;
+	e->idle_count = 0;
+	e->next = _entries;
+	_entries = e;
+    }
+    return e;
+} // KssInterKsServerPool::find
+
+
+// ---------------------------------------------------------------------------
+// Return where a server has been found recently, if we still trust this
+// information.
+//
+bool KssInterKsServerPool::lookupServer(const KsString &key,
+					struct in_addr &ip, u_short &port,
+					u_short &protocolVersion)
+{
+    PltMutexLock lock(_kss_poolLock);
+    Entry *e = find(key, false);
+    if ( !e || !e->resolved ) {
+	return false;
+    }
+    if ( e->resolved_until < PltTime::now() ) {
+	e->resolved = false;
+	return false;
+    }
+    ip = e->ip;
+    port = e->port;
+    protocolVersion = e->protocol_version;
+    return true;
+} // KssInterKsServerPool::lookupServer
+
+
+// ---------------------------------------------------------------------------
+//
+void KssInterKsServerPool::rememberServer(const KsString &key,
+					  struct in_addr ip, u_short port,
+					  u_short protocolVersion)
+{
+    PltMutexLock lock(_kss_poolLock);
+    if ( !_resolve_ttl ) {
+	return;
+    }
+    Entry *e = find(key, true);
+    if ( e ) {
+	e->resolved = true;
+	e->ip = ip;
+	e->port = port;
+	e->protocol_version = protocolVersion;
+	e->resolved_until = PltTime::now(_resolve_ttl);
+    }
+} // KssInterKsServerPool::rememberServer
+
+
+// ---------------------------------------------------------------------------
+// The server isn't where we thought it would be, so forget about it. The
+// idle connections are most probably stale too.
+//
+void KssInterKsServerPool::forgetServer(const KsString &key)
+{
+    PltMutexLock lock(_kss_poolLock);
+    Entry *e = find(key, false);
+    if ( e ) {
+	e->resolved = false;
+	while ( e->idle ) {
+	    IdleConnection *ic = e->idle;
+	    e->idle = ic->next;
+	    dropConnection(ic->con);
+	    delete ic;
+	}
+	e->idle_count = 0;
+    }
+} // KssInterKsServerPool::forgetServer
+
+
+// ---------------------------------------------------------------------------
+// Hand out an idle connection to a server. Connections which have been idle
+// for too long or which have been closed by the server in the meantime are
+// silently dropped.
+//
+KssXDRConnection *KssInterKsServerPool::checkOut(const KsString &key,
+						 u_short &protocolVersion)
+{
+    PltMutexLock lock(_kss_poolLock);
+    Entry *e = find(key, false);
+    if ( !e ) {
+	return 0;
+    }
+    PltTime now(PltTime::now());
+    while ( e->idle ) {
+	IdleConnection *ic = e->idle;
+	KssXDRConnection *con = ic->con;
+	bool usable = !(ic->idle_until < now) && isAlive(con);
+	e->idle = ic->next;
+	--e->idle_count;
+	delete ic;
+	if ( usable ) {
+	    protocolVersion = e->protocol_version;
+	    return con;
+	}
+	dropConnection(con);
+    }
+    return 0;
+} // KssInterKsServerPool::checkOut
+
+
+// ---------------------------------------------------------------------------
+// Take back a connection which isn't in use anymore. If the pool is already
+// full for this server, then the caller has to get rid of the connection.
+//
+bool KssInterKsServerPool::checkIn(const KsString &key,
+				   KssXDRConnection *con)
+{
+    PltMutexLock lock(_kss_poolLock);
+    if ( !_idle_timeout
+	 || (con->getState() != KssConnection::CNX_STATE_CONNECTED) ) {
+	return false;
+    }
+    Entry *e = find(key, true);
+    if ( !e || (e->idle_count >= _max_idle) ) {
+	return false;
+    }
+    IdleConnection *ic = new IdleConnection;
+    if ( !ic ) {
+	return false;
+    }
+    ic->con = con;
+    ic->idle_until = PltTime::now(_idle_timeout);
+    ic->next = e->idle;
+    e->idle = ic;
+    ++e->idle_count;
+    return true;
+} // KssInterKsServerPool::checkIn
+
+
+// ---------------------------------------------------------------------------
+//
+void KssInterKsServerPool::dropConnection(KssXDRConnection *con)
+{
+    con->shutdown();
+    delete con;
+} // KssInterKsServerPool::dropConnection
+
+
+// ---------------------------------------------------------------------------
+// Peek at an idle connection: if there is something to read then the server
+// either closed the connection or sent something we didn't ask for. In both
+// cases the connection can't be used anymore. The socket is non-blocking, so
+// this never waits.
+//
+bool KssInterKsServerPool::isAlive(KssXDRConnection *con)
+{
+    char dummy;
+    int received = recv(con->getFd(), &dummy, 1, MSG_PEEK);
+    if ( received >= 0 ) {
+	return false;
+    }
+#if PLT_SYSTEM_NT
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return (errno == EWOULDBLOCK) || (errno == EAGAIN);
+#endif
+} // KssInterKsServerPool::isAlive
+
+
+// ---------------------------------------------------------------------------
+// When an inter-server connection gets a connection from the pool, it still
+// reports the completed open through its async_attention() method, but from
+// within a timer event, so the caller of open() isn't called back before
+// open() returns. While the host name is being resolved in the background,
+// the same kind of timer event polls the resolver.
+//
+class KssInterKsServerOpenEvent : public KsTimerEvent {
+public:
+    KssInterKsServerOpenEvent(KssInterKsServerConnection &isc,
+			      const KsTime &at = KsTime::now())
+	: KsTimerEvent(at), _isc(isc) { }
+    virtual void trigger();
+private:
+    KssInterKsServerConnection &_isc;
+}; // class KssInterKsServerOpenEvent
+
+
+// ---------------------------------------------------------------------------
+//
+void KssInterKsServerOpenEvent::trigger()
+{
+    _isc._open_event = 0;
+    if ( _isc._sub_state == KssInterKsServerConnection::ISC_SUBSTATE_RESOLVING ) {
+	_isc.resolveStep();
+    } else {
+	_isc.pooledOpenCompleted();
+    }
+    delete this;
+} // KssInterKsServerOpenEvent::trigger
+
+
 // ---------------------------------------------------------------------------
 // Construct a new inter server connection object. This involves parsing the
 // given host and server names for optional port numbers.
 //
 KssInterKsServerConnection::KssInterKsServerConnection(
-    KsString host, KsString server)
+    KsString host, KsString server, KssInterKsServerContext *context)
     : _cln_con(0),
       _cln_con_once_closed(false),
       _state(ISC_STATE_CLOSED),
@@ -57,7 +342,10 @@ KssInterKsServerConnection::KssInterKsServerConnection(
       _host(host), _host_port(0),
       _server(server), _server_port(0),
       _connect_timeout(15), _call_timeout(30),
-      _protocol_version(0)
+      _protocol_version(0),
+      _from_cache(false),
+      _open_event(0),
+      _context(context)
 {
     const char *pColon;
 
@@ -94,6 +382,7 @@ KssInterKsServerConnection::KssInterKsServerConnection(
             _result = KS_ERR_MALFORMEDPATH;
         }
     }
+    _pool_key = host + "/" + server;
 } // KssInterKsServerConnection::KssInterKsServerConnection
 
 
@@ -102,7 +391,7 @@ KssInterKsServerConnection::KssInterKsServerConnection(
 //
 KssInterKsServerConnection::~KssInterKsServerConnection()
 {
-    closeConnection(); // just in case...
+    close(); // just in case...
 } // KssInterKsServerConnection::~KssInterKsServerConnection
 
 
@@ -118,6 +407,37 @@ u_long KssInterKsServerConnection::makeXid()
 } // KssInterKsServerConnection::makeXid
 
 
+// ---------------------------------------------------------------------------
+// Helpers: reach the connection manager and the timer queue of the context
+// we're running in.
+//
+KssConnectionManager *KssInterKsServerConnection::getConnectionManager() const
+{
+    if ( _context ) {
+	return _context->getConnectionManager();
+    }
+    return KsServerBase::getServerObject().getConnectionManager();
+} // KssInterKsServerConnection::getConnectionManager
+
+
+bool KssInterKsServerConnection::addTimerEvent(KsTimerEvent *event)
+{
+    if ( _context ) {
+	return _context->addTimerEvent(event);
+    }
+    return KsServerBase::getServerObject().addTimerEvent(event);
+} // KssInterKsServerConnection::addTimerEvent
+
+
+bool KssInterKsServerConnection::removeTimerEvent(KsTimerEvent *event)
+{
+    if ( _context ) {
+	return _context->removeTimerEvent(event);
+    }
+    return KsServerBase::getServerObject().removeTimerEvent(event);
+} // KssInterKsServerConnection::removeTimerEvent
+
+
 // ---------------------------------------------------------------------------
 // Helper: given a (internal) connection, we make ourselves the handle for
 // incomming attentions on this connection and put the connection under
@@ -127,8 +447,7 @@ void KssInterKsServerConnection::activateConnection()
 {
     if ( _cln_con ) {
 	_cln_con->setAttentionPartner(this);
-	KsServerBase::getServerObject().getConnectionManager()->
-	    addConnection(*_cln_con);
+	getConnectionManager()->addConnection(*_cln_con);
     }
 } // KssInterKsServerConnection::activateConnection
 
@@ -139,9 +458,13 @@ void KssInterKsServerConnection::activateConnection()
 //
 void KssInterKsServerConnection::closeConnection()
 {
+    if ( _open_event ) {
+	removeTimerEvent(_open_event);
+	delete _open_event;
+	_open_event = 0;
+    }
     if ( _cln_con ) {
-	KsServerBase::getServerObject().getConnectionManager()->
-	    removeConnection(*_cln_con);    
+	getConnectionManager()->removeConnection(*_cln_con);    
 	_cln_con->shutdown();
 	delete _cln_con;
 	_cln_con = 0;
@@ -163,48 +486,99 @@ bool KssInterKsServerConnection::open()
 	_result = KS_ERR_OK;
 	return false; // Already open or busy. Close first.
     }
+    if ( !_host.len() ) {
+	_result = KS_ERR_HOSTUNKNOWN;
+	return false;
+    }
+    _from_cache = false;
     //
-    // Now try to resolve the given hostname, which can be either a DNS
-    // name or a dotted address. Unfortunately, we can't currently do a
-    // async DNS resolver request.
+    // Perhaps there is still a warm connection to the server in the pool.
+    // Then we're done at once, we only need to tell our user a little bit
+    // later.
     //
-    // Clean up first and zero out the internet address.
+    _cln_con = KssInterKsServerPool::checkOut(_pool_key, _protocol_version);
+    if ( _cln_con ) {
+	_open_event = new KssInterKsServerOpenEvent(*this);
+	if ( _open_event
+	     && addTimerEvent(_open_event) ) {
+	    _sub_state = ISC_SUBSTATE_CONNECTING_SERVER;
+	    _result = KS_ERR_OK;
+	    _state = ISC_STATE_BUSY;
+	    activateConnection();
+	    return true;
+	}
+	delete _open_event;
+	_open_event = 0;
+	KssInterKsServerPool::dropConnection(_cln_con);
+	_cln_con = 0;
+    }
+    //
+    // If we know where the server lives, then we don't need to resolve
+    // the host name and to ask the portmapper and the manager again.
     //
     memset(&_host_addr, 0, sizeof(_host_addr));
-    if ( !_host.len() ) {
+    u_short port;
+    if ( !_server_port
+	 && KssInterKsServerPool::lookupServer(_pool_key, _host_addr.sin_addr,
+					       port, _protocol_version) ) {
+	_host_addr.sin_family = AF_INET;
+	_from_cache = true;
+	return openServerConnection(port);
+    }
+    //
+    // Now try to resolve the given hostname, which can be either a DNS
+    // name or a dotted address. Dotted addresses and names resolved
+    // recently are known at once. Otherwise the name is resolved in the
+    // background and we poll the resolver from a timer event until the
+    // addresses are known, so the server doesn't stall meanwhile.
+    //
+    KsHostAddresses addrs;
+    switch ( KsHostResolver::lookup(_host, addrs) ) {
+    case KsHostResolver::RESOLVED:
+	return hostResolved(addrs);
+    case KsHostResolver::PENDING:
+	_resolve_until = PltTime::now();
+	_resolve_until.tv_sec += _connect_timeout;
+	_open_event = new KssInterKsServerOpenEvent(*this,
+	    KsTime::now(0, 20000));
+	if ( _open_event
+	     && addTimerEvent(_open_event) ) {
+	    _sub_state = ISC_SUBSTATE_RESOLVING;
+	    _result = KS_ERR_OK;
+	    _state = ISC_STATE_BUSY;
+	    return true;
+	}
+	delete _open_event;
+	_open_event = 0;
+	_result = KS_ERR_GENERIC;
+	return false;
+    default:
+	//
+	// The name lookup failed. So we can't do anything more...
+	//
 	_result = KS_ERR_HOSTUNKNOWN;
 	return false;
     }
-    
-    struct in_addr ip, ip_none, ip_any;
-    ip.s_addr = inet_addr(_host);
-    ip_none.s_addr = INADDR_NONE;
-    ip_any.s_addr = INADDR_ANY;
+} // KssInterKsServerConnection::open
 
-    if ( (memcmp(&ip, &ip_none, sizeof(ip)) == 0)
-	 || (memcmp(&ip, &ip_any, sizeof(ip)) == 0) ) {
-	//
-	// This was no valid dotted address. So try to resolve it as a DNS
-	// name. Let's see...
-	//
-	struct hostent *he = gethostbyname((const char *) _host);
-	if ( !he ) {
-	    //
-	    // The name lockup failed. So we can't do anything more...
-	    //
-	    _result = KS_ERR_HOSTUNKNOWN;
-	    return false;
-	}
-	ip = *(struct in_addr *)(he->h_addr_list[0]);
-	if ( (memcmp(&ip, &_old_ip, sizeof(ip)) == 0)
-	     && he->h_addr_list[1] ) {
-	    ip = *(struct in_addr *)(he->h_addr_list[1]);
-	}
+
+// ---------------------------------------------------------------------------
+// We now know the addresses of the host, so start contacting the server.
+// Our transports speak IPv4 only, so a host with only IPv6 addresses is as
+// good as unknown.
+//
+bool KssInterKsServerConnection::hostResolved(const KsHostAddresses &addrs)
+{
+    struct in_addr ip;
+    if ( !addrs.pickIPv4(ip, _old_ip) ) {
+	_result = KS_ERR_HOSTUNKNOWN;
+	return false;
     }
     //
     // Okay. We've got the IP address.
     //
     _old_ip = ip;
+    memset(&_host_addr, 0, sizeof(_host_addr));
     _host_addr.sin_family = AF_INET; // preset some things...
     _host_addr.sin_addr = ip;
     //
@@ -224,7 +598,48 @@ bool KssInterKsServerConnection::open()
 	return openManagerConnection(_host_port, IPPROTO_TCP);
     }
     return openPortmapperConnection();
-} // KssInterKsServerConnection::open
+} // KssInterKsServerConnection::hostResolved
+
+
+// ---------------------------------------------------------------------------
+// Ask the resolver again whether it knows the host by now. If it's still
+// busy, come back later, unless we've already waited longer than we would
+// wait for a connection.
+//
+void KssInterKsServerConnection::resolveStep()
+{
+    KsHostAddresses addrs;
+    switch ( KsHostResolver::lookup(_host, addrs) ) {
+    case KsHostResolver::RESOLVED:
+	_sub_state = ISC_SUBSTATE_NONE;
+	if ( hostResolved(addrs) ) {
+	    return;
+	}
+	break;
+    case KsHostResolver::PENDING:
+	if ( PltTime::now() < _resolve_until ) {
+	    _open_event = new KssInterKsServerOpenEvent(*this,
+		KsTime::now(0, 20000));
+	    if ( _open_event
+		 && addTimerEvent(_open_event) ) {
+		return;
+	    }
+	    delete _open_event;
+	    _open_event = 0;
+	}
+	_result = KS_ERR_HOSTUNKNOWN;
+	break;
+    default:
+	_result = KS_ERR_HOSTUNKNOWN;
+	break;
+    }
+    //
+    // No luck, so tell the user that the open failed.
+    //
+    _sub_state = ISC_SUBSTATE_NONE;
+    closeConnection();
+    async_attention(ISC_OP_OPEN);
+} // KssInterKsServerConnection::resolveStep
 
 
 // ---------------------------------------------------------------------------
@@ -233,10 +648,50 @@ bool KssInterKsServerConnection::open()
 //
 void KssInterKsServerConnection::close()
 {
+    if ( _cln_con && (_state == ISC_STATE_OPEN) ) {
+	//
+	// The connection is established and not in use, so keep it warm
+	// for the next one wanting to talk to the same server.
+	//
+	getConnectionManager()->removeConnection(*_cln_con);
+	_cln_con->setAttentionPartner(0);
+	if ( KssInterKsServerPool::checkIn(_pool_key, _cln_con) ) {
+	    _cln_con = 0;
+	}
+    }
     closeConnection();
 } // KssInterKsServerConnection::close
 
 
+// ---------------------------------------------------------------------------
+// A connection taken from the pool is now ready for use, so tell the user of
+// this inter-server connection.
+//
+void KssInterKsServerConnection::pooledOpenCompleted()
+{
+    _state = ISC_STATE_OPEN;
+    _result = KS_ERR_OK;
+    async_attention(ISC_OP_OPEN);
+} // KssInterKsServerConnection::pooledOpenCompleted
+
+
+// ---------------------------------------------------------------------------
+// The server wasn't found at the port we remembered, so forget about it and
+// take the long way through the portmapper and the manager.
+//
+bool KssInterKsServerConnection::reopenWithoutCache()
+{
+    KssInterKsServerPool::forgetServer(_pool_key);
+    _from_cache = false;
+    closeConnection();
+    _protocol_version = KS_PROTOCOL_VERSION;
+    if ( _host_port ) {
+	return openManagerConnection(_host_port, IPPROTO_TCP);
+    }
+    return openPortmapperConnection();
+} // KssInterKsServerConnection::reopenWithoutCache
+
+
 // ---------------------------------------------------------------------------
 // Return the XDR stream for this connection or 0 if no XDR stream is
 // currently allocated to this interserver connection.
@@ -303,8 +758,7 @@ bool KssInterKsServerConnection::endSend()
 
     _cln_con->sendRequest();
     _cln_con->setTimeout(_call_timeout);
-    if ( !KsServerBase::getServerObject().getConnectionManager()->
-	 trackConnection(*_cln_con) ) {
+    if ( !getConnectionManager()->trackConnection(*_cln_con) ) {
 	_result = KS_ERR_GENERIC;
 	return false;
     }
@@ -372,8 +826,7 @@ bool KssInterKsServerConnection::endReceive()
 	_result = KS_ERR_OK;
 	return false;
     }
-    KsServerBase::getServerObject().getConnectionManager()->
-	resetConnection(*_cln_con);
+    getConnectionManager()->resetConnection(*_cln_con);
     _result = KS_ERR_OK;
     return true;
 } // KssInterKsServerConnection::endReceive
@@ -615,6 +1068,8 @@ bool KssInterKsServerConnection::attention(KssConnection &con)
     switch ( _sub_state ) {
     case ISC_SUBSTATE_NONE:
 	cout << "(NONE)"; break;
+    case ISC_SUBSTATE_RESOLVING:
+	cout << "(RESOLVING)"; break;
     case ISC_SUBSTATE_CONNECTING_PMAP:
 	cout << "(PMAP)"; break;
     case ISC_SUBSTATE_CONNECTING_MANAGER:
@@ -654,6 +1109,18 @@ bool KssInterKsServerConnection::attention(KssConnection &con)
 	 || (state == KssConnection::CNX_STATE_READY_FAILED)
 	 || (state == KssConnection::CNX_STATE_DEAD) ) {
 	//
+	// If we tried a server port we remembered from an earlier open, the
+	// server has probably moved in the meantime. So try again and ask
+	// the portmapper and the manager.
+	//
+	if ( (_sub_state == ISC_SUBSTATE_CONNECTING_SERVER)
+	     && (state == KssConnection::CNX_STATE_CONN_FAILED)
+	     && _from_cache ) {
+	    if ( reopenWithoutCache() ) {
+		return false; // never "reactivate" the old connection.
+	    }
+	}
+	//
 	// The macro state of the connection is now "closed". We use the
 	// substate to determine the exact error result we want to show the
 	// user of this connection. Also notify the user that there was a
@@ -844,8 +1311,12 @@ bool KssInterKsServerConnection::attention(KssConnection &con)
 #endif
 		    //
 		    // Phew. Now we can try to connect to the server as
-		    // the caller of the open() method once wanted...
+		    // the caller of the open() method once wanted... and
+		    // remember where it lives for the next time.
 		    //
+		    KssInterKsServerPool::rememberServer(
+			_pool_key, _host_addr.sin_addr,
+			serverresult.port, _protocol_version);
 		    if ( !openServerConnection(serverresult.port) ) {
 			break;
 		    }
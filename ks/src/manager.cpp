@@ -159,12 +159,19 @@ public:
               u_short p,
               u_long ttl,
               KsTime exp);
+    virtual ~KsmServer();
+    void dropGetServerReply()
+        { delete [] getserver_reply; getserver_reply = 0; }
+
     KsServerDesc desc;
     u_short port;
     KsTime expires_at;
     u_long time_to_live; // seconds
     bool living;
     KsmExpireServerEvent *pevent;
+    KsmServer *next_version; // same server, next lower protocol version
+    char *getserver_reply;   // canned GETSERVER reply datagram or 0
+    u_int getserver_reply_len;
 
     PLT_DECL_RTTI;
 };
@@ -269,8 +276,18 @@ KsmServer::KsmServer(const KsServerDesc & d,
   expires_at(exp),
   time_to_live(ttl),
   living(true),
-  pevent(0)
+  pevent(0),
+  next_version(0),
+  getserver_reply(0),
+  getserver_reply_len(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+
+KsmServer::~KsmServer()
 {
+    dropGetServerReply();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -281,6 +298,9 @@ KsmServer::KsmServer(const KsServerDesc & d,
 KsManager::KsManager(int port)
 : KsSimpleServer(port),
   _udp_transport(0),
+#if PLT_USE_BUFFERED_STREAMS
+  _udp_dispatcher(*this),
+#endif
   _registered(false),
   _servers_domain("servers"),
   _manager_port(0)
@@ -661,7 +681,7 @@ KsManager::startServer()
                 }
             }
 #else
-            _udp_transport->setAttentionPartner(&_attention_dispatcher);
+            _udp_transport->setAttentionPartner(&_udp_dispatcher);
             if ( _cnx_manager->addConnection(*_udp_transport) ) {
                 _is_ok = true;
             } else {
@@ -803,19 +823,6 @@ KsManager::registerServer(KsAvTicket & /*ticket*/,
     // calculate expiration time:
     KsTime expire_at = KsTime::now(params.time_to_live);
     
-    // create expiration event:
-    KsmExpireServerEvent * pevent =
-        new KsmExpireServerEvent(*this,expire_at);
-    if (! pevent) {
-        result.result = KS_ERR_GENERIC; return;
-    }
-
-    // queue it
-    if (! addTimerEvent(PltPtrComparable<KsmExpireServerEvent>(pevent)) ) {
-        delete pevent;
-        result.result = KS_ERR_GENERIC; return;
-    }
-
     // lookup server:
     KsmServer *pserver;
     PltKeyPtr<KsServerDesc> pdesc (&params.server);
@@ -825,8 +832,28 @@ KsManager::registerServer(KsAvTicket & /*ticket*/,
         //
         pserver->port = params.port;
         pserver->expires_at = expire_at;
+        pserver->time_to_live = params.time_to_live;
         pserver->living = true;
-        pserver->pevent->pserver = 0; // inactivate old event
+        pserver->dropGetServerReply();
+        //
+        // The expiration event stays queued: when it triggers, it
+        // notices the new expiration time and reschedules itself. We
+        // only need to requeue it if the server now expires earlier.
+        //
+        KsmExpireServerEvent *pevent = pserver->pevent;
+        PLT_ASSERT(pevent);
+        if (expire_at < pevent->triggersAt()) {
+            removeTimerEvent(pevent);
+            pevent->expireAt(expire_at);
+            if (! addTimerEvent(pevent)) {
+                delete pevent;
+                pserver->pevent = 0;
+                removeServer(pserver);
+                result.result = KS_ERR_GENERIC; return;
+            }
+        }
+        result.result = KS_ERR_OK;
+        return;
     } else {
         //
         // Unknown server:
@@ -848,6 +875,15 @@ KsManager::registerServer(KsAvTicket & /*ticket*/,
             result.result = KS_ERR_GENERIC; return;
         }
         //
+        // ...make it known to the name index...
+        //
+        if (! indexServer(pserver)) {
+            KsmServer *pdummy;
+            _server_table.remove(pdesc, pdummy);
+            delete pserver;
+            result.result = KS_ERR_GENERIC; return;
+        }
+        //
         // ... finally create /servers/... subdomains
         //
         KssCommObjectHandle hs(_servers_domain.getChildById(pdesc->name));
@@ -870,19 +906,38 @@ KsManager::registerServer(KsAvTicket & /*ticket*/,
         KssCommObjectHandle hv;
         if (   ! hv.bindTo(pserver, KsOsNew) 
             || ! ps->addChild(hv)) {
+            //
+            // The handle is going to delete the server object, so
+            // make sure it doesn't linger in the tables.
+            //
+            KsmServer *pdummy;
+            unindexServer(pserver);
+            _server_table.remove(pdesc, pdummy);
             if (fresh) {
                 _servers_domain.removeChild(pdesc->name);
-                result.result = KS_ERR_GENERIC;
-                return;
             }
+            result.result = KS_ERR_GENERIC;
+            return;
         }
     }
     //
-    // Success: event created and queued, serverobj resides in the tables.
-    // Now connect registration object and event
+    // The server object resides in the tables. Now create the event
+    // which will take care of its expiration. This event accompanies
+    // the server object for its whole life, so re-registrations don't
+    // need to allocate new events.
     //
+    KsmExpireServerEvent * pevent =
+        new KsmExpireServerEvent(*this, expire_at, pserver);
+    if (! pevent) {
+        removeServer(pserver);
+        result.result = KS_ERR_GENERIC; return;
+    }
+    if (! addTimerEvent(pevent)) {
+        delete pevent;
+        removeServer(pserver);
+        result.result = KS_ERR_GENERIC; return;
+    }
     pserver->pevent = pevent;
-    pevent->pserver = pserver;
     result.result = KS_ERR_OK;
     return;
 }
@@ -922,12 +977,98 @@ KsManager::unregisterServer(KsAvTicket & /*ticket*/,
 }
 
 //////////////////////////////////////////////////////////////////////
+// The server index maps the name of a server to its registration with the
+// highest protocol version. All registrations with the same name are
+// chained through KsmServer::next_version in descending order of their
+// protocol versions, so the best match for a GETSERVER request is always
+// found at the head of the chain.
+//
+
+bool
+KsManager::indexServer(KsmServer *pserver)
+{
+    KsmServer *phead;
+    if (! _server_index.query(pserver->desc.name, phead)) {
+        //
+        // The first version of this server.
+        //
+        pserver->next_version = 0;
+        return _server_index.add(pserver->desc.name, pserver);
+    }
+    if (phead->desc.protocol_version < pserver->desc.protocol_version) {
+        //
+        // The new registration becomes the head of the chain.
+        //
+        KsmServer *pold;
+        bool valid;
+        if (! _server_index.update(pserver->desc.name, pserver,
+                                   pold, valid)) {
+            return false;
+        }
+        pserver->next_version = phead;
+        return true;
+    }
+    //
+    // Otherwise find its place further down the chain.
+    //
+    KsmServer *p = phead;
+    while (p->next_version 
+           && p->next_version->desc.protocol_version
+              > pserver->desc.protocol_version) {
+        p = p->next_version;
+    }
+    pserver->next_version = p->next_version;
+    p->next_version = pserver;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KsManager::unindexServer(KsmServer *pserver)
+{
+    KsmServer *phead;
+    if (! _server_index.query(pserver->desc.name, phead)) {
+        PLT_ASSERT(false);
+        return;
+    }
+    if (phead == pserver) {
+        if (pserver->next_version) {
+            KsmServer *pold;
+            bool valid;
+            _server_index.update(pserver->desc.name, pserver->next_version,
+                                 pold, valid);
+        } else {
+            _server_index.remove(pserver->desc.name, phead);
+        }
+    } else {
+        KsmServer *p = phead;
+        while (p->next_version && p->next_version != pserver) {
+            p = p->next_version;
+        }
+        PLT_ASSERT(p->next_version == pserver);
+        p->next_version = pserver->next_version;
+    }
+    pserver->next_version = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Find the registration with the highest protocol version which is at
+// least the requested one.
+//
+
+KsmServer *
+KsManager::findServer(const KsServerDesc &desc) const
+{
+    KsmServer *phead;
+    if (_server_index.query(desc.name, phead)
+        && phead->desc.protocol_version >= desc.protocol_version) {
+        return phead;
+    }
+    return 0;
+}
 
-///////////////////////////
-// work around DEC CXX bug:
-typedef PltHashIterator<PltKeyPtr<KsServerDesc>, KsmServer *> 
-KsmServerDescIterator;
-///////////////////////////
+//////////////////////////////////////////////////////////////////////
 
 void
 KsManager::getServer(KsAvTicket & /*ticket*/,
@@ -955,24 +1096,7 @@ KsManager::getServer(KsAvTicket & /*ticket*/,
     //
     // find best match
     //
-    KsmServer *pbest = 0;
-    u_long best_version = 0;
-
-    for (KsmServerDescIterator it(_server_table);
-         it;
-         ++it) {
-        const KsServerDesc & desc = it->a_value->desc; // current
-        if (desc.protocol_version >= reqdesc.protocol_version
-            && desc.name == reqdesc.name ) {
-                // this is a match
-                if (best_version < desc.protocol_version) {
-                    //  remember: this is the best match so far
-                    best_version = desc.protocol_version;
-                    pbest = it->a_value;
-                } // best match
-            } // match
-    } // iteration
-    
+    KsmServer *pbest = findServer(reqdesc);
     if (pbest) {
         // success
         // fill result structure
@@ -986,6 +1110,106 @@ KsManager::getServer(KsAvTicket & /*ticket*/,
     }
 }
 
+//////////////////////////////////////////////////////////////////////
+#if PLT_USE_BUFFERED_STREAMS
+
+bool
+KsManager::KsmUDPAttentionDispatcher::attention(KssConnection &conn)
+{
+    //
+    // We're only the attention partner of the UDP transport, so we know
+    // what kind of connection we're dealing with.
+    //
+    if (!_manager.quickGetServer((KssUDPXDRConnection &) conn)) {
+        _manager.dispatchTransport((KssXDRConnection &) conn);
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Answers a GETSERVER request from the canned reply of the server
+// asked for. Returns false without having touched the request if
+// anything doesn't fit, that is: other services, A/V tickets other
+// than NONE (or a NONE ticket handled by a custom ticket class),
+// queries for the manager itself and unknown servers, which all go
+// through the usual dispatcher instead.
+//
+
+bool
+KsManager::quickGetServer(KssUDPXDRConnection &con)
+{
+    if (con.getServiceId() != KS_GETSERVER) {
+        return false;
+    }
+#if !PLT_SERVER_TRUNC_ONLY
+    if (KsAvTicket::isAvTicketTypeRegistered(KS_AUTH_NONE)) {
+        return false;
+    }
+#endif
+    XDR *xdr = con.getDeserializingXdr();
+    u_int pos = XDR_GETPOS(xdr);
+    enum_t auth;
+    KsServerDesc desc;
+    KsmServer *pserver = 0;
+    if (xdr_enum(xdr, &auth)
+        && auth == KS_AUTH_NONE
+        && desc.xdrDecode(xdr)
+        && desc.protocol_version >= 1
+        && desc.name != getServerName()) {
+        pserver = findServer(desc);
+    }
+    if (!pserver
+        || (!pserver->getserver_reply && !encodeGetServerReply(pserver))) {
+        XDR_SETPOS(xdr, pos);
+        return false;
+    }
+    con.sendEncodedReply(pserver->getserver_reply,
+                         pserver->getserver_reply_len);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Encodes the complete GETSERVER reply datagram for a server: RPC
+// header with a zero transaction ID, NONE ticket and result. The
+// datagram is cached until the registration changes.
+//
+
+bool
+KsManager::encodeGetServerReply(KsmServer *p)
+{
+    KsRpcHeader header;
+    header._xid = 0;
+    header.acceptCall();
+    KsAvNoneTicket ticket(KS_ERR_OK, KS_AC_NONE);
+    KsGetServerResult result;
+    result.server      = p->desc;
+    result.port        = p->port;
+    result.expires_at  = p->expires_at;
+    result.living      = p->living;
+    result.result      = KS_ERR_OK;
+
+    char buffer[1024];
+    XDR xdr;
+    xdrmem_create(&xdr, (caddr_t) buffer, sizeof(buffer), XDR_ENCODE);
+    bool ok = header.xdrEncode(&xdr)
+        && ticket.xdrEncode(&xdr)
+        && result.xdrEncode(&xdr)
+        && ticket.xdrEncodeTrailer(&xdr);
+    u_int len = XDR_GETPOS(&xdr);
+    xdr_destroy(&xdr);
+    if (!ok) {
+        return false;
+    }
+    p->getserver_reply = new char[len];
+    if (!p->getserver_reply) {
+        return false;
+    }
+    memcpy(p->getserver_reply, buffer, len);
+    p->getserver_reply_len = len;
+    return true;
+}
+
+#endif
 //////////////////////////////////////////////////////////////////////
 
 PLT_IMPL_RTTI1(KsmExpireServerEvent, KsEvent);
@@ -1001,6 +1225,17 @@ KsmExpireServerEvent::trigger()
                  << pserver->desc.protocol_version << ") ");
         PLT_ASSERT(pserver->pevent == this);
         //
+        // Has the server re-registered in the meantime? Then just
+        // move on to its new expiration time.
+        //
+        if (KsTime::now() < pserver->expires_at) {
+            PLT_DMSG_ADD("refreshed");
+            PLT_DMSG_END;
+            _trigger_at = pserver->expires_at;
+            _manager.addTimerEvent(this);
+            return;
+        }
+        //
         // Is the server living?
         //
         if (pserver->living) {
@@ -1008,6 +1243,7 @@ KsmExpireServerEvent::trigger()
             // Mark it dead...
             //
             pserver->living = false;
+            pserver->dropGetServerReply();
             PLT_DMSG_ADD("dying");
             PLT_DMSG_END;
             //
@@ -1021,6 +1257,7 @@ KsmExpireServerEvent::trigger()
             //
             PLT_DMSG_ADD("being removed.");
             PLT_DMSG_END;
+            pserver->pevent = 0; // we're not queued anymore
             _manager.removeServer(pserver);
             delete this;
         }
@@ -1160,10 +1397,16 @@ KsManager::removeServer(KsmServer * pserver)
 #endif
     _server_table.remove(pdesc, pdummy);
     PLT_ASSERT(removed && pdummy == pserver);
+    unindexServer(pserver);
     //
-    // ... and inactivate the associated event.
+    // ... and get rid of the associated event, unless it is the
+    // event itself which is removing the server.
     //
-    pserver->pevent->pserver = 0;
+    if (pserver->pevent) {
+        removeTimerEvent(pserver->pevent);
+        delete pserver->pevent;
+        pserver->pevent = 0;
+    }
     //
     // Then remove associated /servers/... entries
     // from the tree. This deletes the entry through
@@ -26,6 +26,189 @@
 
 #include "ks/package.h"
 #include "ks/client.h"
+#include "ks/valuecache.h"
+
+#include <plt/thread.h>
+
+//
+// Guess for the encoded size of a value to write, as we don't want to
+// encode it just to find out how large it is.
+//
+static const size_t KSC_CHUNK_VALUE_ESTIMATE = 32;
+
+
+//////////////////////////////////////////////////////////////////////
+// class KscEncodedGetVarParams
+//   GetVar parameters which can be serialized once in advance, so a
+//   prepared package doesn't need to encode the same paths again on
+//   every update. Until encode() has been called, they are serialized
+//   as usual.
+//
+class KscEncodedGetVarParams
+: public KsGetVarParams
+{
+public:
+    KscEncodedGetVarParams(size_t num_ids);
+    ~KscEncodedGetVarParams();
+
+    bool encode();
+    bool xdrEncode(XDR *) const;
+
+private:
+    KscEncodedGetVarParams(const KscEncodedGetVarParams &); // forbidden
+    KscEncodedGetVarParams & operator = (const KscEncodedGetVarParams &); // forbidden
+
+    char  *_encoded;
+    u_int  _encoded_size;
+}; // class KscEncodedGetVarParams
+
+
+//////////////////////////////////////////////////////////////////////
+// class _KscPackageBase::Request
+//   A GetVar, SetVar or ExgData request for a chunk of the variables of
+//   one bucket, that is, for a single ACPLT/KS server and A/V module. As
+//   the ONC/RPC client side is blocking, the requests for the servers of
+//   a package are carried out by a pool of threads, so they are all on
+//   the wire at the same time. Only the service call itself is done in
+//   such a thread: the parameters are filled in by build() and the
+//   results are copied back by finish(), both from the thread which owns
+//   the package and its variables.
+//
+//   Until a request is built, it only knows which variables it covers,
+//   and release() throws the parameters and results away again. So only
+//   the chunks actually under way take up memory. The requests of a
+//   prepared package are built once and kept.
+//
+class _KscPackageBase::Request
+{
+public:
+    Request(KscServerBase *server, const KscAvModule *avm);
+    virtual ~Request() {}
+
+    bool isValid() const { return _valid; }
+    KscServerBase *getServer() const { return _server; }
+
+    virtual bool build() = 0;
+    virtual void release() = 0;
+    void issue();
+    virtual bool finish(KS_RESULT &lastResult) = 0;
+
+    Request *next;        // next request of the package
+    Request *next_issue;  // next request for the same server
+    Request *next_done;   // next request waiting for a thread or done
+    RequestBatch *batch;  // the requests issued together with this one
+    bool     is_head;     // first request for its server
+    bool     keep;        // don't release (prepared package)
+
+protected:
+    virtual bool request() = 0;
+
+    bool               _valid;
+    KscServerBase     *_server;
+    const KscAvModule *_avm;
+    bool               _ok;
+    KS_RESULT          _server_result;
+
+private:
+    Request(const Request &); // forbidden
+    Request & operator = (const Request &); // forbidden
+}; // class _KscPackageBase::Request
+
+
+class _KscPackageBase::GetVarRequest
+: public _KscPackageBase::Request
+{
+public:
+    GetVarRequest(KscServerBase *server, const KscAvModule *avm,
+                  const PltArray< KscSortVarPtr > &vars,
+                  size_t first, size_t count);
+    virtual ~GetVarRequest();
+
+    virtual bool build();
+    virtual void release();
+    virtual bool finish(KS_RESULT &lastResult);
+
+    bool encode() { return _params->encode(); }
+
+protected:
+    virtual bool request();
+
+    PltArray< KscSortVarPtr > _bucket_vars;
+    size_t                    _first;
+    size_t                    _count;
+    PltArray< KscSortVarPtr > _vars;
+    KscEncodedGetVarParams   *_params;
+    KsGetVarResult           *_result;
+}; // class _KscPackageBase::GetVarRequest
+
+
+class _KscPackageBase::SetVarRequest
+: public _KscPackageBase::Request
+{
+public:
+    SetVarRequest(KscServerBase *server, const KscAvModule *avm,
+                  const PltArray< KscSortVarPtr > &vars,
+                  size_t first, size_t count);
+    virtual ~SetVarRequest();
+
+    virtual bool build();
+    virtual void release();
+    virtual bool finish(KS_RESULT &lastResult);
+
+protected:
+    virtual bool request();
+
+    PltArray< KscSortVarPtr > _bucket_vars;
+    size_t                    _first;
+    size_t                    _count;
+    PltArray< KscSortVarPtr > _vars;
+    KsSetVarParams           *_params;
+    KsSetVarResult           *_result;
+}; // class _KscPackageBase::SetVarRequest
+
+
+class _KscPackageBase::ExgDataRequest
+: public _KscPackageBase::Request
+{
+public:
+    ExgDataRequest(KscServerBase *server, const KscAvModule *avm,
+                   const PltArray< KscSortVarPtr > &getVars,
+                   size_t getFirst, size_t getCount,
+                   const PltArray< KscSortVarPtr > &setVars,
+                   size_t setFirst, size_t setCount);
+    virtual ~ExgDataRequest();
+
+    virtual bool build();
+    virtual void release();
+    virtual bool finish(KS_RESULT &lastResult);
+
+protected:
+    virtual bool request();
+
+    PltArray< KscSortVarPtr > _bucket_get_vars;
+    size_t                    _get_first;
+    size_t                    _get_count;
+    PltArray< KscSortVarPtr > _bucket_set_vars;
+    size_t                    _set_first;
+    size_t                    _set_count;
+    PltArray< KscSortVarPtr > _get_vars;
+    PltArray< KscSortVarPtr > _set_vars;
+    KsExgDataParams          *_params;
+    KsExgDataResult          *_result;
+}; // class _KscPackageBase::ExgDataRequest
+
+
+//////////////////////////////////////////////////////////////////////
+// The requests handed to the thread pool at once by a package. Threads
+// put the requests they have carried out on the done list.
+//
+struct _KscPackageBase::RequestBatch
+{
+    RequestBatch() : done(0), pending(0) {}
+
+    Request *done;     // carried out, but not finished yet
+    size_t   pending;  // handed to the pool and not finished yet
+}; // struct _KscPackageBase::RequestBatch
 
 
 // ----------------------------------------------------------------------------
@@ -94,17 +277,26 @@ KscExchangePackage::debugPrint(ostream &os, bool printAll) const
 // down into individual requests, one for each server referenced. In addition,
 // A/V modules are handled properly too.
 //
+unsigned long KscPackage::_last_generation = 0;
+
+
 KscPackage::KscPackage()
 : num_vars(0),
   num_pkgs(0),
   av_module(0),
   _is_dirty(false),
-  _last_result(-1)
+  _last_result(-1),
+  _prepared(false),
+  _plan(0),
+  _plan_generation(0),
+  _generation(0)
 {} // KscPackage::KscPackage
 
 
 KscPackage::~KscPackage()
-{} // KscPackage::~KscPackage
+{
+    deleteRequests(_plan);
+} // KscPackage::~KscPackage
 
 
 // ----------------------------------------------------------------------------
@@ -131,6 +323,7 @@ KscPackage::add(KscVariableHandle var)
             //
             _is_dirty = true;
             num_vars++;
+            touch();
         }
         
         return ok;
@@ -153,6 +346,7 @@ KscPackage::add(KscPackageHandle pkg)
         if ( ok ) {
             num_pkgs++;
             _is_dirty = true;
+            touch();
         }
 
         return ok;
@@ -174,6 +368,7 @@ KscPackage::remove(KscVariableHandle var)
         if ( ok ) {
             num_vars--;
             _is_dirty = true;
+            touch();
         }
         
         return ok;
@@ -194,6 +389,7 @@ KscPackage::remove(KscPackageHandle pkg)
         if ( ok ) {
             num_pkgs--;
             _is_dirty = true;
+            touch();
         }
         
         return ok;
@@ -253,6 +449,22 @@ KscPackage::newSubpackageIterator() const
 bool
 KscPackage::getUpdate() 
 {
+    if ( _prepared ) {
+        //
+        // Reuse the requests set up before, unless the package has
+        // changed in the meantime.
+        //
+        if ( !_plan || (_plan_generation != getGeneration()) ) {
+            if ( !compile() ) {
+                _last_result = KS_ERR_GENERIC;
+                return false;
+            }
+        }
+        _last_result = KS_ERR_OK;
+        _is_dirty = false;
+        return issueRequests(_plan, _last_result);
+    }
+
     KscSorter sorter(*this);
 
     if ( !sorter.isValid() ) {
@@ -298,101 +510,287 @@ KscPackage::getUpdate()
     _last_result = KS_ERR_OK;
     _is_dirty = false;
 
+    Request *requests = 0;
+    Request **tail = &requests;
+
     while ( *pit ) {
         KscBucketHandle curr_bucket = **pit;
-        ok &= getSimpleUpdate(curr_bucket);
+        if ( !appendGetVarRequests(tail, curr_bucket) ) {
+            _last_result = KS_ERR_GENERIC;
+            ok = false;
+        }
         ++(*pit);
     }
 
     delete pit; // Throw the iterator away...
 
+    //
+    // Now talk to all the servers at once and wait until all of them
+    // have answered (or failed).
+    //
+    ok &= issueRequests(requests, _last_result);
+    deleteRequests(requests);
+
     return ok;    
 } // KscPackage::getUpdate
 
 
 //////////////////////////////////////////////////////////////////////
-// Handle the GetVar request for a single ACPLT/KS server and with
-// a single A/V module. This helping method is called from getUpdate()
-// for every single ACPLT/KS server we have to deal with in a package.
-// If we get into trouble, we'll set the last result accordingly and
-// return a "false".
+// Retrieve the values of the variables, but take them from the value
+// cache where possible. The variables missing from the cache are
+// collected in a package of their own, which mirrors the subpackages
+// (and thus the A/V modules) of this one, so they are read from their
+// servers all at once. Variables which are just being fetched by some-
+// one else are waited for only after our own fetches have completed,
+// otherwise a variable contained twice in this package would wait for
+// itself.
 //
 bool
-KscPackage::getSimpleUpdate(KscBucketHandle bucket)
+KscPackage::getUpdate(const PltTimeSpan &maxAge)
 {
-    // 
-    // Create the data structures for the service request.
-    //
-    size_t num_vars = bucket->size();
-    KsGetVarParams params(num_vars);
-    KsGetVarResult result;
+    KscValueCache *cache = KscClient::getClient()->getValueCache();
+    if ( !cache ) {
+        return getUpdate();
+    }
 
-    PltArray< KscSortVarPtr > sorted_vars = 
-        bucket->getSortedVars();
+    KscPackage fetch;
+    KscPackage busy;
+    bool ok = collectMisses(*cache, maxAge, 0, fetch, busy);
 
-    if ( (params.identifiers.size() != num_vars)
-         || (sorted_vars.size() != num_vars) )
-        {
-            //
-            // We failed to allocate memory, so we fail with the well known
-            // "generic" error.
-            //
-            _last_result = KS_ERR_GENERIC;
+    _last_result = KS_ERR_OK;
+    _is_dirty = false;
+
+    if ( fetch.sizeVariables(true) ) {
+        //
+        // The values read successfully have already been stored in the
+        // cache when they were copied back into the variables.
+        //
+        ok &= fetch.getUpdate();
+        _last_result = fetch.getLastResult();
+        fetch.completeMisses(*cache, 0);
+    }
+
+    ok &= busy.waitForBusy(maxAge, 0);
+
+    return ok;
+} // KscPackage::getUpdate
+
+
+//////////////////////////////////////////////////////////////////////
+// Look up the variables of this package and its subpackages in the
+// cache. Fresh values are copied into the variables right away, the
+// others end up in the fetch or busy package. Both mirror the A/V
+// modules of this package, so the variables are read with the same
+// A/V modules (and thus end up under the same keys in the cache) as
+// if they were read by this package directly.
+//
+bool
+KscPackage::collectMisses(KscValueCache &cache, const PltTimeSpan &maxAge,
+                          const KscAvModule *avm_default,
+                          KscPackage &fetch, KscPackage &busy)
+{
+    bool ok = true;
+    KsVarCurrProps props;
+
+    if ( av_module ) {
+        avm_default = av_module;
+    }
+    fetch.setAvModule(av_module);
+    busy.setAvModule(av_module);
+
+    PltListIterator<KscVariableHandle> vit(vars);
+    while ( vit ) {
+        const KscAvModule *avm = (*vit)->findAvModule(avm_default);
+        switch ( cache.lookup(avm, (*vit)->getFullPath(), maxAge, props) ) {
+        case KscValueCache::FRESH:
+            ok &= copyCachedProps(**vit, props);
+            break;
+        case KscValueCache::FETCH:
+            ok &= fetch.add(*vit);
+            break;
+        default:
+            ok &= busy.add(*vit);
+            break;
+        }
+        ++vit;
+    }
+
+    PltListIterator<KscPackageHandle> pit(pkgs);
+    while ( pit ) {
+        KscPackageHandle sub_fetch(new KscPackage, KsOsNew);
+        KscPackageHandle sub_busy(new KscPackage, KsOsNew);
+        if ( !sub_fetch || !sub_busy ) {
             return false;
+        }
+        ok &= (*pit)->collectMisses(cache, maxAge, avm_default,
+                                    *sub_fetch, *sub_busy);
+        if ( sub_fetch->sizeVariables(true) ) {
+            ok &= fetch.add(sub_fetch);
+        }
+        if ( sub_busy->sizeVariables(true) ) {
+            ok &= busy.add(sub_busy);
+        }
+        ++pit;
     }
 
-    //
-    // Copy data into the service parameters (that is, the names of
-    // the variables to query). Once again, bail out if we fail here.
-    //
-    if ( !fillGetVarParams(sorted_vars, params.identifiers) ) {
+    return ok;
+} // KscPackage::collectMisses
+
+
+//////////////////////////////////////////////////////////////////////
+// Tell the cache that the variables collected for fetching by
+// collectMisses() have been read (or not).
+//
+void
+KscPackage::completeMisses(KscValueCache &cache,
+                           const KscAvModule *avm_default) const
+{
+    if ( av_module ) {
+        avm_default = av_module;
+    }
+
+    PltListIterator<KscVariableHandle> vit(vars);
+    while ( vit ) {
+        cache.complete((*vit)->findAvModule(avm_default),
+                       (*vit)->getFullPath(), 0);
+        ++vit;
+    }
+
+    PltListIterator<KscPackageHandle> pit(pkgs);
+    while ( pit ) {
+        (*pit)->completeMisses(cache, avm_default);
+        ++pit;
+    }
+} // KscPackage::completeMisses
+
+
+//////////////////////////////////////////////////////////////////////
+// Read the variables collected by collectMisses() which were being
+// fetched by someone else. We do so only after our own fetches have
+// completed, otherwise a variable contained twice in this package
+// would wait for itself.
+//
+bool
+KscPackage::waitForBusy(const PltTimeSpan &maxAge,
+                        const KscAvModule *avm_default)
+{
+    bool ok = true;
+
+    if ( av_module ) {
+        avm_default = av_module;
+    }
+
+    PltListIterator<KscVariableHandle> vit(vars);
+    while ( vit ) {
+        ok &= (*vit)->getCachedUpdate(maxAge, avm_default);
+        ++vit;
+    }
+
+    PltListIterator<KscPackageHandle> pit(pkgs);
+    while ( pit ) {
+        ok &= (*pit)->waitForBusy(maxAge, avm_default);
+        ++pit;
+    }
+
+    return ok;
+} // KscPackage::waitForBusy
+
+
+//////////////////////////////////////////////////////////////////////
+// Switch the package into prepared mode. The requests are set up right
+// now, so we can tell whether this works at all.
+//
+bool
+KscPackage::prepare()
+{
+    _prepared = true;
+    if ( !compile() ) {
         _last_result = KS_ERR_GENERIC;
         return false;
     }
+    return true;
+} // KscPackage::prepare
 
-    //
-    // Now query the ACPLT/KS server with the help of the server object. The
-    // server object will handle the request accordingly to whatever kind
-    // of ACPLT/KS server it is connected with. The information about which
-    // server object to use as well as which A/V negotiator used for the
-    // communication is contained in the bucket objects.
-    //
-    bool ok = bucket->getServer()->getVar(bucket->getAvModule(),
-                                          params,
-                                          result);
 
-    if ( !ok ) {
-	//
-        // The exgData service request failed on the communication level.
-	// In this case, the server object supplies more precise information
-	// about the cause of the failure. At the level of this package
-	// object we just indicate a communication level failure but
-	// distribute the real error reason from the server object to the
-	// variable objects.
-	//
-        _last_result = KS_ERR_NETWORKERROR;
-	distributeErrorResult(bucket->getServer()->getLastResult(),
-			      sorted_vars);
+void
+KscPackage::unprepare()
+{
+    _prepared = false;
+    deleteRequests(_plan);
+    _plan = 0;
+} // KscPackage::unprepare
+
+
+//////////////////////////////////////////////////////////////////////
+// Sort the variables and set up the GetVar requests of a prepared
+// package, just like getUpdate() does every time for packages which
+// haven't been prepared. The parameters are encoded right away.
+//
+bool
+KscPackage::compile()
+{
+    deleteRequests(_plan);
+    _plan = 0;
+
+    KscSorter sorter(*this);
+    if ( !sorter.isValid() ) {
+        PLT_DMSG("KscPackage::compile(): failed to sort variables" << endl);
+        return false;
+    }
+    PltIterator<KscBucketHandle> *pit =
+        sorter.newBucketIterator();
+    if ( !pit ) {
         return false;
     }
 
-    //
-    // Only set the last result, if the ACPLT/KS server reported an error
-    // on the request level. Otherwise don't touch here the last result,
-    // as other functions will set it when an error occours. In every case
-    // we propagate the error code down to the individual variable objects.
-    //
-    if ( result.result != KS_ERR_OK ) {
-        _last_result = KS_ERR_NETWORKERROR;
-	distributeErrorResult(result.result, sorted_vars);
+    Request *requests = 0;
+    Request **tail = &requests;
+    bool ok = true;
+
+    while ( ok && *pit ) {
+        ok = appendGetVarRequests(tail, **pit);
+        ++(*pit);
+    }
+
+    delete pit;
+
+    for ( Request *req = requests; ok && req; req = req->next ) {
+        req->keep = true;
+        ok = req->build()
+             && static_cast<GetVarRequest *>(req)->encode();
+    }
+
+    if ( !ok ) {
+        deleteRequests(requests);
         return false;
     }
+    _plan = requests;
+    _plan_generation = getGeneration();
+    return true;
+} // KscPackage::compile
 
-    //
-    // Copy back the service results...
-    //
-    return copyGetVarResults(sorted_vars, result.items);
-} // KscPackage::getSimpleUpdate
+
+//////////////////////////////////////////////////////////////////////
+// Return the newest generation of this package and its subpackages.
+// As every change to a package gives it a generation newer than all
+// others, the newest generation changes whenever the package or any
+// of its subpackages changes.
+//
+unsigned long
+KscPackage::getGeneration() const
+{
+    unsigned long generation = _generation;
+
+    PltListIterator<KscPackageHandle> it(pkgs);
+    while ( it ) {
+        unsigned long sub = (*it)->getGeneration();
+        if ( sub > generation ) {
+            generation = sub;
+        }
+        ++it;
+    }
+    return generation;
+} // KscPackage::getGeneration
 
 
 //////////////////////////////////////////////////////////////////////
@@ -450,99 +848,27 @@ KscPackage::setUpdate(bool force)
     _last_result = KS_ERR_OK;
     _is_dirty = false;
 
+    Request *requests = 0;
+    Request **tail = &requests;
+
     while ( *pit ) {
         KscBucketHandle curr_bucket = **pit;
-        ok &= setSimpleUpdate(curr_bucket);
+        if ( !appendSetVarRequests(tail, curr_bucket) ) {
+            _last_result = KS_ERR_GENERIC;
+            ok = false;
+        }
         ++(*pit);
     }
 
     delete pit; // Throw the iterator away...
 
+    ok &= issueRequests(requests, _last_result);
+    deleteRequests(requests);
+
     return ok;
 } // KscPackage::setUpdate
 
 
-//////////////////////////////////////////////////////////////////////
-// Handle the SetVar request for a single ACPLT/KS server and with
-// a single A/V module.
-//
-bool
-KscPackage::setSimpleUpdate(KscBucketHandle bucket)
-{
-    // 
-    // Create the data structures for the service request.
-    //
-    size_t num_vars = bucket->size();
-    KsSetVarParams params(num_vars);
-    KsSetVarResult result(num_vars);
-
-    PltArray< KscSortVarPtr > sorted_vars = 
-        bucket->getSortedVars();
-
-    if ( (params.items.size() != num_vars) ||
-	 (result.results.size() != num_vars) ||
-	 (sorted_vars.size() != num_vars) ) {
-        //
-        // We failed to allocate memory, so we fail with the well known
-        // "generic" error.
-        //
-        _last_result = KS_ERR_GENERIC;
-        return false;
-    }
-
-    //
-    // Copy data into the service parameters (that is, the names and
-    // values of the variables to query). Once again, bail out if we
-    // fail here.
-    //
-    if ( !fillSetVarParams(sorted_vars, params.items) ) {
-        _last_result = KS_ERR_GENERIC;
-        return false;
-    }
-
-    //
-    // Now query the ACPLT/KS server with the help of the server object. The
-    // server object will handle the request accordingly to whatever kind
-    // of ACPLT/KS server it is connected with. The information about which
-    // server object to use as well as which A/V negotiator used for the
-    // communication is contained in the bucket objects.
-    //
-    bool ok = bucket->getServer()->setVar(bucket->getAvModule(),
-					  params,
-					  result);
-
-    if ( !ok ) {
-	//
-        // The exgData service request failed on the communication level.
-	// In this case, the server object supplies more precise information
-	// about the cause of the failure and we distribute the error
-	// information down to the individual variable objects once again.
-	//
-        _last_result = KS_ERR_NETWORKERROR;
-	distributeErrorResult(bucket->getServer()->getLastResult(),
-			      sorted_vars);
-        return false;
-    }
-
-    //
-    // Only set the last result, if the ACPLT/KS server reported an error
-    // on the request level. Otherwise don't touch here the last result,
-    // as other functions will set it when an error occours. In every case
-    // we propagate the error code down to the individual variable objects.
-    //
-    if ( result.result != KS_ERR_OK ) {
-        _last_result = KS_ERR_NETWORKERROR;
-	distributeErrorResult(result.result, sorted_vars);
-        return false;
-    }
-
-    //
-    // Copy back the service results...
-    //
-    return copySetVarResults(sorted_vars, result.results);
-} // KscPackage::setSimpleUpdate
-
-
 //////////////////////////////////////////////////////////////////////
 // class KscPackage::DeepIterator
 //////////////////////////////////////////////////////////////////////
@@ -876,10 +1202,16 @@ KscExchangePackage::mergeSorters(KscSorter &get_sorter,
     // the request down into several requests, one for each
     // server. Hey markusj, you did an excellent job!
     //
+    Request *requests = 0;
+    Request **tail = &requests;
+
     while ( !get_sorter.isEmpty() ) {
         KscBucketHandle curr_get(get_sorter.removeFirst());
         KscBucketHandle curr_set(set_sorter.removeMatchingBucket(curr_get));
-        ok &= doSimpleExchange(curr_get, curr_set);
+        if ( !appendExgDataRequests(tail, curr_get, curr_set) ) {
+            _last_result = KS_ERR_GENERIC;
+            ok = false;
+        }
     }
 
     //
@@ -889,150 +1221,903 @@ KscExchangePackage::mergeSorters(KscSorter &get_sorter,
     KscBucketHandle dummy_get;
     while ( !set_sorter.isEmpty() ) {
         KscBucketHandle curr_set(set_sorter.removeFirst());
-        ok &= doSimpleExchange(dummy_get, curr_set);
+        if ( !appendExgDataRequests(tail, dummy_get, curr_set) ) {
+            _last_result = KS_ERR_GENERIC;
+            ok = false;
+        }
     }
 
+    //
+    // All the data exchange requests go out at the same time.
+    //
+    ok &= issueRequests(requests, _last_result);
+    deleteRequests(requests);
+
     return ok;
 } // KscExchangePackage::mergeSorters
 
+    
+//////////////////////////////////////////////////////////////////////
+// class _KscPackageBase
+//////////////////////////////////////////////////////////////////////
+
+KscEncodedGetVarParams::KscEncodedGetVarParams(size_t num_ids)
+: KsGetVarParams(num_ids),
+  _encoded(0),
+  _encoded_size(0)
+{
+}
+
+
+KscEncodedGetVarParams::~KscEncodedGetVarParams()
+{
+    delete [] _encoded;
+}
+
 
 //////////////////////////////////////////////////////////////////////
-// Carry out a data exchange operation for exactly one ACPLT/KS server
-// using exactly one A/V negotiatior module.
-//
-// This function only touches the last result, if there was an error.
+// Serialize the paths once. We know exactly how large the XDR
+// representation will be: a count followed by the paths, every one
+// with its length and padded to a multiple of four.
 //
 bool
-KscExchangePackage::doSimpleExchange(
-    KscBucketHandle get_bucket,
-    KscBucketHandle set_bucket)
+KscEncodedGetVarParams::encode()
 {
-    //
-    // There are no buckets left. Oops...
-    //
-    if ( !get_bucket && !set_bucket ) {
-	_last_result = KS_ERR_GENERIC;
-	return false;
-    }
-
-    PltArray< KscSortVarPtr > set_vars, get_vars;
-    size_t get_size, set_size;
-    KscServerBase *server = 0;
-    const KscAvModule *avm = 0;
-
-    //
-    // If we have variables to retrieve during the data exchange, then
-    // set up the parameters accordingly.
-    //
-    if ( get_bucket ) {
-        get_size = get_bucket->size();
-        get_vars = get_bucket->getSortedVars();
-        server = get_bucket->getServer();
-        avm = get_bucket->getAvModule();
-    } else {
-        get_size = 0;
+    u_int size = 4;
+    for ( size_t i = 0; i < identifiers.size(); ++i ) {
+        size += 4 + ((identifiers[i].len() + 3) & ~3);
     }
 
-    //
-    // Same for the variables to set.
-    //
-    if ( set_bucket ) {
-        set_size = set_bucket->size();
-        set_vars = set_bucket->getSortedVars();
-        server = set_bucket->getServer();
-        avm = set_bucket->getAvModule();
-    } else {
-        set_size = 0;
+    char *buffer = new char[size];
+    if ( !buffer ) {
+        return false;
     }
-    
-    KsExgDataParams params(set_size, get_size);
-    KsExgDataResult res(set_size, get_size);
-
-    if ( (params.set_vars.size() != set_size) ||
-	 (params.get_vars.size() != get_size) ||
-	 (res.results.size() != set_size) ||
-	 (res.items.size() != get_size) ||
-	 (get_vars.size() != get_size) ||
-	 (set_vars.size() != set_size) ) {
-	_last_result = KS_ERR_GENERIC;
+    XDR xdrs;
+    xdrmem_create(&xdrs, (caddr_t) buffer, size, XDR_ENCODE);
+    bool ok = KsGetVarParams::xdrEncode(&xdrs);
+    u_int len = xdr_getpos(&xdrs);
+    xdr_destroy(&xdrs);
+    if ( !ok ) {
+        delete [] buffer;
         return false;
     }
+    delete [] _encoded;
+    _encoded      = buffer;
+    _encoded_size = len;
+    return true;
+} // KscEncodedGetVarParams::encode
 
-    //
-    // Copy data into the service parameters. Note: here it is
-    // perfectly okay to use "&&" when carrying out setting the
-    // parameters. Both functions return false if they fail due
-    // to memory constraints or the like, so a boolean shortcut
-    // is fine. At other places this might not what we want, so
-    // be careful!
-    //
-    bool ok = fillGetVarParams(get_vars, params.get_vars) &&
-              fillSetVarParams(set_vars, params.set_vars);
 
-    if ( !ok ) {
-        _last_result = KS_ERR_GENERIC;
-	return false;
+bool
+KscEncodedGetVarParams::xdrEncode(XDR *xdr) const
+{
+    if ( _encoded ) {
+        return XDR_PUTBYTES(xdr, _encoded, _encoded_size) ? true : false;
     }
+    return KsGetVarParams::xdrEncode(xdr);
+} // KscEncodedGetVarParams::xdrEncode
 
-    //
-    // Now exchange the date with the ACPLT/KS server with the help of
-    // the server object. The server object will handle the request
-    // accordingly to whatever kind of ACPLT/KS server it is connected
-    // with.
-    //
-    ok = server->exgData(avm, params, res);
 
-#if PLT_DEBUG
-    if ( ok && res.result != KS_ERR_OK ) {
-        PLT_DMSG("exchange data error code : " << res.result << endl);
+//////////////////////////////////////////////////////////////////////
+
+_KscPackageBase::Request::Request(KscServerBase *server,
+                                  const KscAvModule *avm)
+: next(0),
+  next_issue(0),
+  next_done(0),
+  batch(0),
+  is_head(false),
+  keep(false),
+  _valid(false),
+  _server(server),
+  _avm(avm),
+  _ok(false),
+  _server_result(KS_ERR_OK)
+{
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Carry out the service request. If it fails on the communication
+// level, the server object supplies more precise information about the
+// cause of the failure, so we remember it while we're still in the
+// thread which talked to the server.
+//
+void
+_KscPackageBase::Request::issue()
+{
+    _ok = request();
+    _server_result = _ok ? KS_ERR_OK : _server->getLastResult();
+} // _KscPackageBase::Request::issue
+
+
+//////////////////////////////////////////////////////////////////////
+// A GetVar request for a chunk of the variables of a single ACPLT/KS
+// server and A/V module.
+//
+_KscPackageBase::GetVarRequest::GetVarRequest(
+    KscServerBase *server, const KscAvModule *avm,
+    const PltArray< KscSortVarPtr > &vars,
+    size_t first, size_t count)
+: Request(server, avm),
+  _bucket_vars(vars),
+  _first(first),
+  _count(count),
+  _params(0),
+  _result(0)
+{
+} // _KscPackageBase::GetVarRequest::GetVarRequest
+
+
+_KscPackageBase::GetVarRequest::~GetVarRequest()
+{
+    delete _params;
+    delete _result;
+} // _KscPackageBase::GetVarRequest::~GetVarRequest
+
+
+bool
+_KscPackageBase::GetVarRequest::build()
+{
+    if ( _valid ) {
+        return true;
     }
-#endif
+    //
+    // If we failed to allocate memory or to copy the names of the
+    // variables into the service parameters, the request stays invalid.
+    //
+    _params = new KscEncodedGetVarParams(_count);
+    _result = new KsGetVarResult;
+    _valid = _params && _result
+             && sliceVars(_bucket_vars, _first, _count, _vars)
+             && (_params->identifiers.size() == _count)
+             && fillGetVarParams(_vars, _params->identifiers);
+    if ( !_valid ) {
+        release();
+    }
+    return _valid;
+} // _KscPackageBase::GetVarRequest::build
 
-    if ( !ok ) {
+
+void
+_KscPackageBase::GetVarRequest::release()
+{
+    delete _params;
+    _params = 0;
+    delete _result;
+    _result = 0;
+    _vars = PltArray< KscSortVarPtr >();
+    _valid = false;
+} // _KscPackageBase::GetVarRequest::release
+
+
+bool
+_KscPackageBase::GetVarRequest::request()
+{
+    return _server->getVar(_avm, *_params, *_result);
+} // _KscPackageBase::GetVarRequest::request
+
+
+bool
+_KscPackageBase::GetVarRequest::finish(KS_RESULT &lastResult)
+{
+    if ( !_ok ) {
 	//
-        // The exgData service request failed on the communication level.
-	// In this case, the server object supplies more precise information
-	// about the cause of the failure.
+        // The GetVar service request failed on the communication level.
+	// At the level of the package object we just indicate a
+	// communication level failure but distribute the real error
+	// reason from the server object to the variable objects.
 	//
-        _last_result = KS_ERR_NETWORKERROR;
-	distributeErrorResult(server->getLastResult(),
-			      set_vars);
-	distributeErrorResult(server->getLastResult(),
-			      get_vars);
+        lastResult = KS_ERR_NETWORKERROR;
+	distributeErrorResult(_server_result, _vars);
         return false;
     }
 
     //
     // Only set the last result, if the ACPLT/KS server reported an error
     // on the request level. Otherwise don't touch here the last result,
-    // as other functions will set it when an error occours. Once again,
-    // propagate the error down to the individual variable objects.
+    // as other functions will set it when an error occours. In every case
+    // we propagate the error code down to the individual variable objects.
+    //
+    if ( _result->result != KS_ERR_OK ) {
+        lastResult = KS_ERR_NETWORKERROR;
+	distributeErrorResult(_result->result, _vars);
+        return false;
+    }
+
+    //
+    // Copy back the service results...
+    //
+    return copyGetVarResults(_avm, _vars, _result->items);
+} // _KscPackageBase::GetVarRequest::finish
+
+
+//////////////////////////////////////////////////////////////////////
+// A SetVar request for a chunk of the variables of a single ACPLT/KS
+// server and A/V module.
+//
+_KscPackageBase::SetVarRequest::SetVarRequest(
+    KscServerBase *server, const KscAvModule *avm,
+    const PltArray< KscSortVarPtr > &vars,
+    size_t first, size_t count)
+: Request(server, avm),
+  _bucket_vars(vars),
+  _first(first),
+  _count(count),
+  _params(0),
+  _result(0)
+{
+} // _KscPackageBase::SetVarRequest::SetVarRequest
+
+
+_KscPackageBase::SetVarRequest::~SetVarRequest()
+{
+    delete _params;
+    delete _result;
+} // _KscPackageBase::SetVarRequest::~SetVarRequest
+
+
+bool
+_KscPackageBase::SetVarRequest::build()
+{
+    if ( _valid ) {
+        return true;
+    }
+    _params = new KsSetVarParams(_count);
+    _result = new KsSetVarResult(_count);
+    _valid = _params && _result
+             && sliceVars(_bucket_vars, _first, _count, _vars)
+             && (_params->items.size() == _count)
+             && (_result->results.size() == _count)
+             && fillSetVarParams(_vars, _params->items);
+    if ( !_valid ) {
+        release();
+    }
+    return _valid;
+} // _KscPackageBase::SetVarRequest::build
+
+
+void
+_KscPackageBase::SetVarRequest::release()
+{
+    delete _params;
+    _params = 0;
+    delete _result;
+    _result = 0;
+    _vars = PltArray< KscSortVarPtr >();
+    _valid = false;
+} // _KscPackageBase::SetVarRequest::release
+
+
+bool
+_KscPackageBase::SetVarRequest::request()
+{
+    return _server->setVar(_avm, *_params, *_result);
+} // _KscPackageBase::SetVarRequest::request
+
+
+bool
+_KscPackageBase::SetVarRequest::finish(KS_RESULT &lastResult)
+{
+    if ( !_ok ) {
+        lastResult = KS_ERR_NETWORKERROR;
+	distributeErrorResult(_server_result, _vars);
+        return false;
+    }
+
+    if ( _result->result != KS_ERR_OK ) {
+        lastResult = KS_ERR_NETWORKERROR;
+	distributeErrorResult(_result->result, _vars);
+        return false;
+    }
+
+    return copySetVarResults(_vars, _result->results);
+} // _KscPackageBase::SetVarRequest::finish
+
+
+//////////////////////////////////////////////////////////////////////
+// A data exchange operation for exactly one ACPLT/KS server using
+// exactly one A/V negotiatior module, covering a chunk of the
+// variables to read and a chunk of those to write.
+//
+_KscPackageBase::ExgDataRequest::ExgDataRequest(
+    KscServerBase *server, const KscAvModule *avm,
+    const PltArray< KscSortVarPtr > &getVars,
+    size_t getFirst, size_t getCount,
+    const PltArray< KscSortVarPtr > &setVars,
+    size_t setFirst, size_t setCount)
+: Request(server, avm),
+  _bucket_get_vars(getVars),
+  _get_first(getFirst),
+  _get_count(getCount),
+  _bucket_set_vars(setVars),
+  _set_first(setFirst),
+  _set_count(setCount),
+  _params(0),
+  _result(0)
+{
+} // _KscPackageBase::ExgDataRequest::ExgDataRequest
+
+
+_KscPackageBase::ExgDataRequest::~ExgDataRequest()
+{
+    delete _params;
+    delete _result;
+} // _KscPackageBase::ExgDataRequest::~ExgDataRequest
+
+
+bool
+_KscPackageBase::ExgDataRequest::build()
+{
+    if ( _valid ) {
+        return true;
+    }
+    _params = new KsExgDataParams(_set_count, _get_count);
+    _result = new KsExgDataResult(_set_count, _get_count);
+    if ( !_params || !_result ||
+         !sliceVars(_bucket_get_vars, _get_first, _get_count, _get_vars) ||
+         !sliceVars(_bucket_set_vars, _set_first, _set_count, _set_vars) ||
+         (_params->set_vars.size() != _set_count) ||
+	 (_params->get_vars.size() != _get_count) ||
+	 (_result->results.size() != _set_count) ||
+	 (_result->items.size() != _get_count) ) {
+        release();
+        return false;
+    }
+
+    //
+    // Copy data into the service parameters. Note: here it is
+    // perfectly okay to use "&&" when carrying out setting the
+    // parameters. Both functions return false if they fail due
+    // to memory constraints or the like, so a boolean shortcut
+    // is fine.
     //
-    if ( res.result != KS_ERR_OK ) {
-        _last_result = KS_ERR_NETWORKERROR;
-	distributeErrorResult(res.result, set_vars);
-	distributeErrorResult(res.result, get_vars);
+    _valid = fillGetVarParams(_get_vars, _params->get_vars) &&
+             fillSetVarParams(_set_vars, _params->set_vars);
+    if ( !_valid ) {
+        release();
+    }
+    return _valid;
+} // _KscPackageBase::ExgDataRequest::build
+
+
+void
+_KscPackageBase::ExgDataRequest::release()
+{
+    delete _params;
+    _params = 0;
+    delete _result;
+    _result = 0;
+    _get_vars = PltArray< KscSortVarPtr >();
+    _set_vars = PltArray< KscSortVarPtr >();
+    _valid = false;
+} // _KscPackageBase::ExgDataRequest::release
+
+
+bool
+_KscPackageBase::ExgDataRequest::request()
+{
+    bool ok = _server->exgData(_avm, *_params, *_result);
+
+#if PLT_DEBUG
+    if ( ok && _result->result != KS_ERR_OK ) {
+        PLT_DMSG("exchange data error code : " << _result->result << endl);
+    }
+#endif
+    return ok;
+} // _KscPackageBase::ExgDataRequest::request
+
+
+bool
+_KscPackageBase::ExgDataRequest::finish(KS_RESULT &lastResult)
+{
+    if ( !_ok ) {
+        lastResult = KS_ERR_NETWORKERROR;
+	distributeErrorResult(_server_result, _set_vars);
+	distributeErrorResult(_server_result, _get_vars);
+        return false;
+    }
+
+    if ( _result->result != KS_ERR_OK ) {
+        lastResult = KS_ERR_NETWORKERROR;
+	distributeErrorResult(_result->result, _set_vars);
+	distributeErrorResult(_result->result, _get_vars);
         return false;
     }
 
     //
-    // Copy back the results from the data exchange operation. This will
-    // not touch the last result, but instead deliver only the flag
-    // indicating success or failure for particular variables. Note that
+    // Copy back the results from the data exchange operation. Note that
     // we can't use here the shortcutted "&&" operator, as this would
     // prefent us from retrieving both the "getVars" and the "setVars" if
     // we could not retrieve the value for at least one of the "getVars"
     // variables -- and this would be the wrong behaviour!
     //
-    ok = copyGetVarResults(get_vars, res.items);
-    ok &= copySetVarResults(set_vars, res.results);
+    bool ok = copyGetVarResults(_avm, _get_vars, _result->items);
+    ok &= copySetVarResults(_set_vars, _result->results);
     return ok;
-} // KscExchangePackage::doSimpleExchange
+} // _KscPackageBase::ExgDataRequest::finish
+
 
-    
 //////////////////////////////////////////////////////////////////////
-// class _KscPackageBase
+// The pool of threads carrying out requests, shared by all packages.
+// Threads are started as requests come in, up to a limit, and then
+// stay around waiting for more until the program ends. So updating a
+// package doesn't start a thread per server every time. A thread takes
+// the requests waiting in the queue one after another and puts every
+// request it has carried out on the done list of the request's batch.
+//
+static const size_t KSC_MAX_REQUEST_THREADS = 32;
+
+static PltMutex     _ksc_requestLock;
+static PltCondition _ksc_requestChanged;
+
+static _KscPackageBase::Request  *_ksc_requestQueue = 0;
+static _KscPackageBase::Request **_ksc_requestQueueTail = &_ksc_requestQueue;
+static size_t                     _ksc_requestsQueued = 0;
+static size_t                     _ksc_requestThreads = 0;
+static size_t                     _ksc_idleRequestThreads = 0;
+static bool                       _ksc_stopRequestThreads = false;
+
+
+class KscRequestThread
+: public PltThread
+{
+public:
+    KscRequestThread() : _next(0) {}
+
+    static bool queue(_KscPackageBase::Request *req,
+                      _KscPackageBase::RequestBatch &batch);
+    static _KscPackageBase::Request *
+        waitForDone(_KscPackageBase::RequestBatch &batch);
+    static void stopAll();
+
+protected:
+    virtual void run();
+
+private:
+    static KscRequestThread *_threads;
+
+    KscRequestThread *_next;
+}; // class KscRequestThread
+
+
+KscRequestThread *KscRequestThread::_threads = 0;
+
+
+//////////////////////////////////////////////////////////////////////
+// The threads of the pool are stopped when the program ends, before
+// the lock and the condition they are waiting on go away. Static
+// objects are destroyed in the reverse order of their definition.
+//
+class KscRequestThreadStopper
+{
+public:
+    ~KscRequestThreadStopper() { KscRequestThread::stopAll(); }
+}; // class KscRequestThreadStopper
+
+static KscRequestThreadStopper _ksc_requestThreadStopper;
+
+
 //////////////////////////////////////////////////////////////////////
+// Hand a request to the pool. If all threads are busy and no new one
+// can be started, the caller has to carry out the request itself.
+//
+bool
+KscRequestThread::queue(_KscPackageBase::Request *req,
+                        _KscPackageBase::RequestBatch &batch)
+{
+    PltMutexLock lock(_ksc_requestLock);
+
+    if ( _ksc_requestsQueued >= _ksc_idleRequestThreads ) {
+        if ( _ksc_requestThreads >= KSC_MAX_REQUEST_THREADS ) {
+            return false;
+        }
+        KscRequestThread *thread = new KscRequestThread;
+        if ( !thread || !thread->start() ) {
+            delete thread;
+            return false;
+        }
+        thread->_next = _threads;
+        _threads = thread;
+        ++_ksc_requestThreads;
+        ++_ksc_idleRequestThreads;
+    }
+
+    req->batch = &batch;
+    req->next_done = 0;
+    *_ksc_requestQueueTail = req;
+    _ksc_requestQueueTail = &req->next_done;
+    ++_ksc_requestsQueued;
+    ++batch.pending;
+    _ksc_requestChanged.broadcast();
+    return true;
+} // KscRequestThread::queue
+
+
+//////////////////////////////////////////////////////////////////////
+// Wait until one of the requests of a batch has been carried out.
+//
+_KscPackageBase::Request *
+KscRequestThread::waitForDone(_KscPackageBase::RequestBatch &batch)
+{
+    PltMutexLock lock(_ksc_requestLock);
+
+    while ( !batch.done ) {
+        _ksc_requestChanged.wait(_ksc_requestLock);
+    }
+    _KscPackageBase::Request *req = batch.done;
+    batch.done = req->next_done;
+    --batch.pending;
+    return req;
+} // KscRequestThread::waitForDone
+
+
+void
+KscRequestThread::stopAll()
+{
+    KscRequestThread *threads;
+    {
+        PltMutexLock lock(_ksc_requestLock);
+        _ksc_stopRequestThreads = true;
+        _ksc_requestChanged.broadcast();
+        threads = _threads;
+        _threads = 0;
+    }
+    while ( threads ) {
+        KscRequestThread *thread = threads;
+        threads = thread->_next;
+        thread->join();
+        delete thread;
+    }
+} // KscRequestThread::stopAll
+
+
+void
+KscRequestThread::run()
+{
+    _ksc_requestLock.lock();
+    for ( ;; ) {
+        while ( !_ksc_requestQueue && !_ksc_stopRequestThreads ) {
+            _ksc_requestChanged.wait(_ksc_requestLock);
+        }
+        if ( _ksc_stopRequestThreads ) {
+            break;
+        }
+        _KscPackageBase::Request *req = _ksc_requestQueue;
+        _ksc_requestQueue = req->next_done;
+        if ( !_ksc_requestQueue ) {
+            _ksc_requestQueueTail = &_ksc_requestQueue;
+        }
+        --_ksc_requestsQueued;
+        --_ksc_idleRequestThreads;
+        _ksc_requestLock.unlock();
+
+        req->issue();
+
+        _ksc_requestLock.lock();
+        req->next_done = req->batch->done;
+        req->batch->done = req;
+        ++_ksc_idleRequestThreads;
+        _ksc_requestChanged.broadcast();
+    }
+    _ksc_requestLock.unlock();
+} // KscRequestThread::run
+
+
+//////////////////////////////////////////////////////////////////////
+// Append a new request to a list of requests. Fails, if there wasn't
+// enough memory left for the request.
+//
+bool
+_KscPackageBase::appendRequest(Request **&tail, Request *request)
+{
+    if ( !request ) {
+        return false;
+    }
+    *tail = request;
+    tail = &request->next;
+    return true;
+} // _KscPackageBase::appendRequest
+
+
+//////////////////////////////////////////////////////////////////////
+// Append the requests for the variables of a bucket, split into chunks
+// as necessary. Taking the variables out of the bucket empties it.
+//
+bool
+_KscPackageBase::appendGetVarRequests(Request **&tail,
+                                      KscBucketHandle bucket)
+{
+    size_t num_vars = bucket->size();
+    PltArray< KscSortVarPtr > vars = bucket->getSortedVars();
+    if ( vars.size() != num_vars ) {
+        return false;
+    }
+
+    size_t first = 0;
+    do {
+        ChunkBudget budget;
+        size_t count = chunkLength(vars, first, false, budget);
+        if ( !appendRequest(tail,
+                            new GetVarRequest(bucket->getServer(),
+                                              bucket->getAvModule(),
+                                              vars, first, count)) ) {
+            return false;
+        }
+        first += count;
+    } while ( first < num_vars );
+    return true;
+} // _KscPackageBase::appendGetVarRequests
+
+
+bool
+_KscPackageBase::appendSetVarRequests(Request **&tail,
+                                      KscBucketHandle bucket)
+{
+    size_t num_vars = bucket->size();
+    PltArray< KscSortVarPtr > vars = bucket->getSortedVars();
+    if ( vars.size() != num_vars ) {
+        return false;
+    }
+
+    size_t first = 0;
+    do {
+        ChunkBudget budget;
+        size_t count = chunkLength(vars, first, true, budget);
+        if ( !appendRequest(tail,
+                            new SetVarRequest(bucket->getServer(),
+                                              bucket->getAvModule(),
+                                              vars, first, count)) ) {
+            return false;
+        }
+        first += count;
+    } while ( first < num_vars );
+    return true;
+} // _KscPackageBase::appendSetVarRequests
+
+
+//////////////////////////////////////////////////////////////////////
+// Every data exchange chunk first takes as many of the variables to
+// write as fit and then fills up with variables to read. Either bucket
+// may be missing, but not both of them.
+//
+bool
+_KscPackageBase::appendExgDataRequests(Request **&tail,
+                                       KscBucketHandle getBucket,
+                                       KscBucketHandle setBucket)
+{
+    if ( !getBucket && !setBucket ) {
+        //
+        // There are no buckets left. Oops...
+        //
+        return false;
+    }
+    KscBucketHandle bucket = setBucket ? setBucket : getBucket;
+
+    PltArray< KscSortVarPtr > get_vars, set_vars;
+    size_t get_size = 0,
+           set_size = 0;
+    if ( getBucket ) {
+        get_size = getBucket->size();
+        get_vars = getBucket->getSortedVars();
+    }
+    if ( setBucket ) {
+        set_size = setBucket->size();
+        set_vars = setBucket->getSortedVars();
+    }
+    if ( (get_vars.size() != get_size) || (set_vars.size() != set_size) ) {
+        return false;
+    }
+
+    size_t get_first = 0,
+           set_first = 0;
+    do {
+        ChunkBudget budget;
+        size_t set_count = chunkLength(set_vars, set_first, true, budget);
+        size_t get_count = chunkLength(get_vars, get_first, false, budget);
+        if ( !appendRequest(tail,
+                            new ExgDataRequest(bucket->getServer(),
+                                               bucket->getAvModule(),
+                                               get_vars,
+                                               get_first, get_count,
+                                               set_vars,
+                                               set_first, set_count)) ) {
+            return false;
+        }
+        get_first += get_count;
+        set_first += set_count;
+    } while ( (get_first < get_size) || (set_first < set_size) );
+    return true;
+} // _KscPackageBase::appendExgDataRequests
+
+
+//////////////////////////////////////////////////////////////////////
+// A new chunk gets the limits set for the client.
+//
+_KscPackageBase::ChunkBudget::ChunkBudget()
+: empty(true)
+{
+    KscClient::getClient()->getChunkLimits(items, bytes);
+    if ( !items ) {
+        items = (size_t) -1;
+    }
+    if ( !bytes ) {
+        bytes = (size_t) -1;
+    }
+} // _KscPackageBase::ChunkBudget::ChunkBudget
+
+
+//////////////////////////////////////////////////////////////////////
+// Return how many of the variables starting with vars[first] still fit
+// into a chunk and take them from the budget. The size of a variable's
+// parameters is estimated from its (absolute) path plus a guess for
+// the value when writing. An empty chunk always takes at least one
+// variable, so we get on even if a single one exceeds the limits.
+//
+size_t
+_KscPackageBase::chunkLength(const PltArray< KscSortVarPtr > &vars,
+                             size_t first, bool withValues,
+                             ChunkBudget &budget)
+{
+    size_t count = 0;
+
+    while ( first + count < vars.size() ) {
+        size_t bytes = 4 + ((vars[first + count]->getPathAndName().len()
+                             + 3) & ~3);
+        if ( withValues ) {
+            bytes += KSC_CHUNK_VALUE_ESTIMATE;
+        }
+        if ( !budget.empty
+             && ((budget.items == 0) || (budget.bytes < bytes)) ) {
+            break;
+        }
+        budget.empty = false;
+        budget.items = budget.items ? budget.items - 1 : 0;
+        budget.bytes = budget.bytes > bytes ? budget.bytes - bytes : 0;
+        ++count;
+    }
+    return count;
+} // _KscPackageBase::chunkLength
+
+
+//////////////////////////////////////////////////////////////////////
+// Copy count variables starting with vars[first] into a new array.
+//
+bool
+_KscPackageBase::sliceVars(const PltArray< KscSortVarPtr > &vars,
+                           size_t first, size_t count,
+                           PltArray< KscSortVarPtr > &slice)
+{
+    PltArray< KscSortVarPtr > chunk(count);
+    if ( chunk.size() != count ) {
+        return false;
+    }
+    for ( size_t i = 0; i < count; ++i ) {
+        chunk[i] = vars[first + i];
+    }
+    slice = chunk;
+    return true;
+} // _KscPackageBase::sliceVars
+
+
+//////////////////////////////////////////////////////////////////////
+// Issue the requests of a package to all the ACPLT/KS servers involved
+// at the same time, so the package takes about as long as the slowest
+// server and not as long as all servers together. A server object can
+// only carry out one request at a time, so the requests for the same
+// server are chained and issued one after another.
+//
+// Every request is built just before it is handed to the thread pool.
+// Once it has been carried out, its results are copied back and it is
+// released, and then the next request for the same server is built.
+// So at most one request per server takes up memory at any time. If
+// the pool runs out of threads, the calling thread carries out the
+// request itself.
+//
+// The results are copied back in the order the replies come in, so the
+// last result is the last error encountered.
+//
+bool
+_KscPackageBase::issueRequests(Request *requests, KS_RESULT &lastResult)
+{
+    Request *req;
+
+    //
+    // Chain up the requests by server.
+    //
+    for ( req = requests; req; req = req->next ) {
+        req->next_issue = 0;
+        req->is_head = false;
+    }
+    for ( req = requests; req; req = req->next ) {
+        Request *head;
+        for ( head = requests; head != req; head = head->next ) {
+            if ( head->is_head && (head->getServer() == req->getServer()) ) {
+                break;
+            }
+        }
+        if ( head == req ) {
+            req->is_head = true;
+        } else {
+            while ( head->next_issue ) {
+                head = head->next_issue;
+            }
+            head->next_issue = req;
+        }
+    }
+
+    bool ok = true;
+    RequestBatch batch;
+    for ( req = requests; req; req = req->next ) {
+        if ( req->is_head ) {
+            ok &= startChain(req, batch, lastResult);
+        }
+    }
+    while ( batch.pending ) {
+        req = KscRequestThread::waitForDone(batch);
+        Request *following = req->next_issue;
+        ok &= finishRequest(req, lastResult);
+        ok &= startChain(following, batch, lastResult);
+    }
+    return ok;
+} // _KscPackageBase::issueRequests
+
+
+//////////////////////////////////////////////////////////////////////
+// Build the next request of a chain and hand it to the thread pool.
+// Requests which can't be built are finished right away, and so are
+// those the calling thread has to carry out itself.
+//
+bool
+_KscPackageBase::startChain(Request *req, RequestBatch &batch,
+                            KS_RESULT &lastResult)
+{
+    bool ok = true;
+    for ( ; req; req = req->next_issue ) {
+        if ( req->build() ) {
+            if ( KscRequestThread::queue(req, batch) ) {
+                break;
+            }
+            req->issue();
+        }
+        ok &= finishRequest(req, lastResult);
+    }
+    return ok;
+} // _KscPackageBase::startChain
+
+
+//////////////////////////////////////////////////////////////////////
+// Copy back the results of a request and throw away its parameters and
+// results, unless they are kept for the next time.
+//
+bool
+_KscPackageBase::finishRequest(Request *req, KS_RESULT &lastResult)
+{
+    if ( !req->isValid() ) {
+        lastResult = KS_ERR_GENERIC;
+        return false;
+    }
+    bool ok = req->finish(lastResult);
+    if ( !req->keep ) {
+        req->release();
+    }
+    return ok;
+} // _KscPackageBase::finishRequest
+
+
+void
+_KscPackageBase::deleteRequests(Request *requests)
+{
+    while ( requests ) {
+        Request *req = requests;
+        requests = req->next;
+        delete req;
+    }
+} // _KscPackageBase::deleteRequests
+
+
+//////////////////////////////////////////////////////////////////////
+
 
 bool 
 _KscPackageBase::fillGetVarParams(const PltArray< KscSortVarPtr > &sorted_vars,
@@ -1077,6 +2162,7 @@ _KscPackageBase::distributeErrorResult(
 //
 bool 
 _KscPackageBase::copyGetVarResults(
+    const KscAvModule *avm,
     const PltArray< KscSortVarPtr > &sorted_vars,
     const KsArray<KsGetVarItemResult> &res)
 {
@@ -1090,6 +2176,7 @@ _KscPackageBase::copyGetVarResults(
     bool ok = true; // be optimistic...
     size_t count = 0,
            to_copy = res.size();
+    KscValueCache *cache = KscClient::getClient()->getValueCache();
 
     while ( count < to_copy ) {
         if ( res[count].result == KS_ERR_OK ) {
@@ -1117,6 +2204,9 @@ _KscPackageBase::copyGetVarResults(
                 ok &= sorted_vars[count]->setCurrProps(*cp);
                 sorted_vars[count]->fDirty = false;
                 sorted_vars[count]->_last_result = KS_ERR_OK;
+                if ( cache ) {
+                    cache->store(avm, sorted_vars[count]->getFullPath(), *cp);
+                }
             } else {
 		//
                 // Ooops. The handle was unbound, so we didn't get back
@@ -1162,8 +2252,8 @@ _KscPackageBase::fillSetVarParams(
 
     for(size_t count = 1; count < to_copy; count++) { 
         items[count].path_and_name = 
-            sorted_vars[count]->getPathAndName().relTo(
-                sorted_vars[count-1]->getPathAndName());
+            sorted_vars[count]->getPathHandle().relTo(
+                sorted_vars[count-1]->getPathHandle());
         items[count].curr_props =
             sorted_vars[count]->getCurrPropsHandle();
     }
@@ -1188,6 +2278,7 @@ _KscPackageBase::copySetVarResults(
 
     bool ok = true; // Be optimistic once again...
     size_t size = sorted_vars.size();
+    KscValueCache *cache = KscClient::getClient()->getValueCache();
 
     for ( size_t count = 0; count < size; count++ ) {
         sorted_vars[count]->_last_result = res[count].result;
@@ -1195,8 +2286,12 @@ _KscPackageBase::copySetVarResults(
 	    //
 	    // Because the variable could be written successfully to
 	    // the ACPLT/KS server, we can now reset the dirty flag.
+	    // The value cached for it (if any) is outdated now.
 	    //
             sorted_vars[count]->fDirty = false;
+            if ( cache ) {
+                cache->invalidate(sorted_vars[count]->getFullPath());
+            }
         } else {
 	    //
 	    // Setting a new value for this particular variable failed,
@@ -1210,6 +2305,20 @@ _KscPackageBase::copySetVarResults(
 } // _KscPackageBase::copySetVarResults
 
 
+//////////////////////////////////////////////////////////////////////
+// Hand a value taken from the value cache to a variable, just as if
+// it had been read from the server.
+//
+bool
+_KscPackageBase::copyCachedProps(KscVariable &var, KsVarCurrProps &props)
+{
+    bool ok = var.setCurrProps(props);
+    var.fDirty = false;
+    var._last_result = KS_ERR_OK;
+    return ok;
+} // _KscPackageBase::copyCachedProps
+
+
 //////////////////////////////////////////////////////////////////////
 
 //#include <iostream.h>
@@ -1234,8 +2343,8 @@ _KscPackageBase::optimizePaths(
 
     for(size_t count = 1; count < to_copy; count++) {
         paths[count] = 
-            sorted_vars[count]->getPathAndName().relTo(
-                sorted_vars[count-1]->getPathAndName());
+            sorted_vars[count]->getPathHandle().relTo(
+                sorted_vars[count-1]->getPathHandle());
 #if PLT_DEBUG_VERBOSE
         cout << setw(35) << sorted_vars[count]->getPathAndName()
              << setw(35) << paths[count]
@@ -0,0 +1,1007 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * proxyserver.cpp -- an ACPLT/KS server mounting the namespaces of other
+ *                    ACPLT/KS servers.
+ */
+
+#include "ks/proxyserver.h"
+
+#if PLT_USE_BUFFERED_STREAMS
+
+#include "ks/path.h"
+#include "ks/conversions.h"
+#include "ks/connectionmgr.h"
+#include "plt/log.h"
+
+
+// ---------------------------------------------------------------------------
+// Some failures of inter-server connections don't leave an error code
+// behind. Make sure that clients always see some kind of error then.
+//
+static inline KS_RESULT
+proxyError(KS_RESULT error)
+{
+    return error != KS_ERR_OK ? error : KS_ERR_GENERIC;
+} // proxyError
+
+
+// ---------------------------------------------------------------------------
+//
+KssProxyForward::~KssProxyForward()
+{
+    delete params;
+    delete [] indices;
+} // KssProxyForward::~KssProxyForward
+
+
+// ---------------------------------------------------------------------------
+// The dispatcher holds the first item of each request, so the request can
+// not be completed before the dispatcher has worked through all of it.
+//
+KssProxyRequest::KssProxyRequest(KssTransport &transport, KsResult *result)
+    : _transport(transport),
+      _result(result),
+      _outstanding(1)
+{
+} // KssProxyRequest::KssProxyRequest
+
+
+KssProxyRequest::~KssProxyRequest()
+{
+    delete _result;
+} // KssProxyRequest::~KssProxyRequest
+
+
+// ---------------------------------------------------------------------------
+// The dispatcher is done with the request. If everything could be answered
+// at once, then send the reply using the client's own ticket. Otherwise put
+// the client connection on hold: it will be tracked again by the connection
+// manager as soon as the reply has been sent from itemDone().
+//
+void KssProxyRequest::release(KsAvTicket &ticket)
+{
+    if ( --_outstanding == 0 ) {
+	_transport.sendReply(ticket, *_result);
+	delete this;
+    } else {
+	_transport.deferReply();
+    }
+} // KssProxyRequest::release
+
+
+// ---------------------------------------------------------------------------
+// Another item has been completed. After the last one, the reply can be sent
+// at last. Deferred replies are only possible with the A/V NONE scheme, so
+// our own NONE ticket will do.
+//
+void KssProxyRequest::itemDone()
+{
+    if ( --_outstanding ) {
+	return;
+    }
+    _transport.sendReply(_ticket, *_result);
+    KsServerBase::getServerObject().getConnectionManager()->
+	trackConnection(_transport);
+    delete this;
+} // KssProxyRequest::itemDone
+
+
+// ---------------------------------------------------------------------------
+//
+KssProxyChannel::KssProxyChannel(KssProxyMount &mount,
+				 const KsString &host, const KsString &server)
+    : KssInterKsServerConnection(host, server),
+      _reads(0),
+      _forward(0),
+      _mount(mount)
+{
+} // KssProxyChannel::KssProxyChannel
+
+
+void KssProxyChannel::async_attention(KssInterKsServerConnectionOperations op)
+{
+    _mount.channelAttention(*this, op);
+} // KssProxyChannel::async_attention
+
+
+// ---------------------------------------------------------------------------
+// Create a new mount. The local path is expected in its encoded form, as is
+// the remote path, which must not end with a slash (except for the root).
+//
+KssProxyMount::KssProxyMount(KsProxyServer &server,
+			     const KsString &localPath,
+			     const KsString &host, const KsString &serverName,
+			     const KsString &remotePath)
+    : _next(0),
+      _server(server),
+      _local_path(localPath),
+      _host(host),
+      _server_name(serverName),
+      _remote_path(remotePath),
+      _channels(0),
+      _channel_count(0),
+      _queued_reads(0),
+      _last_queued_read(0),
+      _queued_read_count(0),
+      _queued_forwards(0),
+      _last_queued_forward(0)
+{
+    _channels = new KssProxyChannel *[server.getMaxChannels()];
+    if ( _channels ) {
+	_channel_count = server.getMaxChannels();
+	for ( unsigned int i = 0; i < _channel_count; ++i ) {
+	    _channels[i] = 0;
+	}
+    }
+} // KssProxyMount::KssProxyMount
+
+
+KssProxyMount::~KssProxyMount()
+{
+    shutdown();
+    delete [] _channels;
+    flushCache();
+} // KssProxyMount::~KssProxyMount
+
+
+// ---------------------------------------------------------------------------
+// Map a local path (in its encoded form) onto the corresponding path on the
+// remote server. Returns false if the path is not below this mount.
+//
+bool KssProxyMount::mapPath(const KsString &localPath,
+			    KsString &remotePath) const
+{
+    size_t len = _local_path.len();
+    if ( (localPath.len() < len)
+	 || (strncmp(localPath, _local_path, len) != 0) ) {
+	return false;
+    }
+    const char *rest = (const char *) localPath + len;
+    if ( *rest && (*rest != '/') ) {
+	return false; // just a sibling with a longer name
+    }
+    if ( !*rest ) {
+	remotePath = _remote_path;
+    } else if ( _remote_path == "/" ) {
+	remotePath = KsString(rest);
+    } else {
+	remotePath = KsString(_remote_path, rest);
+    }
+    return true;
+} // KssProxyMount::mapPath
+
+
+// ---------------------------------------------------------------------------
+// Look for an up-to-date value of a remote variable in the cache. Expired
+// values are thrown away on the fly.
+//
+bool KssProxyMount::lookup(const KsString &path, KsGetVarItemResult &item)
+{
+    KssProxyCacheEntry *entry;
+    if ( !_cache.query(path, entry) ) {
+	return false;
+    }
+    if ( entry->expires_at < PltTime::now() ) {
+	_cache.remove(path, entry);
+	delete entry;
+	return false;
+    }
+    item = entry->item;
+    return true;
+} // KssProxyMount::lookup
+
+
+// ---------------------------------------------------------------------------
+// Queue a read of a remote variable for the item "index" of a client
+// request. If the same variable is already being read, just wait for that
+// read to complete. Without a request, the read only refreshes the cache.
+// The read goes downstream with the next kick().
+//
+void KssProxyMount::read(const KsString &path,
+			 KssProxyRequest *request, size_t index)
+{
+    KssProxyRead *read;
+    if ( !_reads.query(path, read) ) {
+	read = new KssProxyRead(path);
+	if ( !read || !_reads.add(path, read) ) {
+	    delete read;
+	    read = 0;
+	} else {
+	    if ( _last_queued_read ) {
+		_last_queued_read->next = read;
+	    } else {
+		_queued_reads = read;
+	    }
+	    _last_queued_read = read;
+	    ++_queued_read_count;
+	}
+    }
+    if ( request ) {
+	KssProxyRead::Waiter *waiter = read ? new KssProxyRead::Waiter : 0;
+	if ( !waiter ) {
+	    ((KsGetVarResult *) request->getResult())->items[index].result =
+		KS_ERR_GENERIC;
+	    request->itemDone();
+	    return;
+	}
+	waiter->request = request;
+	waiter->index   = index;
+	waiter->next    = read->waiters;
+	read->waiters   = waiter;
+    }
+} // KssProxyMount::read
+
+
+// ---------------------------------------------------------------------------
+// Queue a SetVar or GetEP request for the remote server. Like reads, it goes
+// downstream with the next kick().
+//
+void KssProxyMount::forward(KssProxyForward *fwd)
+{
+    fwd->next = 0;
+    if ( _last_queued_forward ) {
+	_last_queued_forward->next = fwd;
+    } else {
+	_queued_forwards = fwd;
+    }
+    _last_queued_forward = fwd;
+} // KssProxyMount::forward
+
+
+// ---------------------------------------------------------------------------
+// Hand out queued work to idle channels. Closed channels are opened on
+// demand, but only one at a time, so a server which can't be reached isn't
+// hammered with connection attempts. Channels stay open after their calls,
+// keeping the connections to the remote server warm.
+//
+void KssProxyMount::kick()
+{
+    if ( !_queued_reads && !_queued_forwards ) {
+	return;
+    }
+    if ( !_channel_count ) {
+	failQueued(KS_ERR_GENERIC);
+	return;
+    }
+
+    bool opening = false;
+    unsigned int i;
+    for ( i = 0; i < _channel_count; ++i ) {
+	KssProxyChannel *channel = _channels[i];
+	if ( channel
+	     && (channel->getState() ==
+		 KssInterKsServerConnection::ISC_STATE_BUSY)
+	     && !channel->_reads && !channel->_forward ) {
+	    opening = true;
+	}
+    }
+
+    for ( i = 0;
+	  (i < _channel_count) && (_queued_reads || _queued_forwards);
+	  ++i ) {
+	KssProxyChannel *channel = _channels[i];
+	if ( !channel ) {
+	    if ( opening ) {
+		continue;
+	    }
+	    channel = new KssProxyChannel(*this, _host, _server_name);
+	    if ( !channel ) {
+		failQueued(KS_ERR_GENERIC);
+		return;
+	    }
+	    _channels[i] = channel;
+	}
+	switch ( channel->getState() ) {
+	case KssInterKsServerConnection::ISC_STATE_OPEN:
+	    if ( !channel->_reads && !channel->_forward ) {
+		startCall(*channel);
+	    }
+	    break;
+	case KssInterKsServerConnection::ISC_STATE_CLOSED:
+	    if ( !opening ) {
+		if ( !channel->open() ) {
+		    failQueued(proxyError(channel->getLastResult()));
+		    return;
+		}
+		opening = true;
+	    }
+	    break;
+	default:
+	    break;
+	}
+    }
+} // KssProxyMount::kick
+
+
+// ---------------------------------------------------------------------------
+// Start the next downstream call on an open and idle channel. Forwarded
+// requests go first, as they are usually waited for by a single client,
+// then as many of the queued reads as fit into one GetVar call.
+//
+bool KssProxyMount::startCall(KssProxyChannel &channel)
+{
+    if ( _queued_forwards ) {
+	KssProxyForward *fwd = _queued_forwards;
+	_queued_forwards = fwd->next;
+	if ( !_queued_forwards ) {
+	    _last_queued_forward = 0;
+	}
+	fwd->next = 0;
+	channel._forward = fwd;
+	if ( !channel.send(fwd->service, *fwd->params) ) {
+	    channel._forward = 0;
+	    forwardDone(fwd, 0, proxyError(channel.getLastResult()));
+	    return false;
+	}
+	return true;
+    }
+
+    size_t count = _queued_read_count;
+    if ( count > _server.getMaxBatch() ) {
+	count = _server.getMaxBatch();
+    }
+    KssProxyRead *reads = _queued_reads;
+    KssProxyRead *last  = reads;
+    for ( size_t i = 1; i < count; ++i ) {
+	last = last->next;
+    }
+    _queued_reads = last->next;
+    last->next = 0;
+    if ( !_queued_reads ) {
+	_last_queued_read = 0;
+    }
+    _queued_read_count -= count;
+
+    KsGetVarParams params(count);
+    if ( params.identifiers.size() != count ) {
+	readsDone(reads, 0, KS_ERR_GENERIC);
+	return false;
+    }
+    size_t idx = 0;
+    for ( KssProxyRead *read = reads; read; read = read->next ) {
+	params.identifiers[idx++] = read->path;
+    }
+    channel._reads = reads;
+    if ( !channel.send(KS_GETVAR, params) ) {
+	channel._reads = 0;
+	readsDone(reads, 0, proxyError(channel.getLastResult()));
+	return false;
+    }
+    return true;
+} // KssProxyMount::startCall
+
+
+// ---------------------------------------------------------------------------
+// One of the channels needs attention: either it has been opened (or failed
+// to do so), or the reply to its call has arrived (or the call failed). Note
+// that we must check for errors before receiving anything, as receiving
+// resets the result of the last operation.
+//
+void KssProxyMount::channelAttention(KssProxyChannel &channel,
+				     KssInterKsServerConnection::
+				     KssInterKsServerConnectionOperations op)
+{
+    KS_RESULT error = KS_ERR_OK;
+    if ( channel.getState() != KssInterKsServerConnection::ISC_STATE_OPEN ) {
+	error = proxyError(channel.getLastResult());
+    }
+    bool hadWork = channel._reads || channel._forward;
+
+    if ( (op == KssInterKsServerConnection::ISC_OP_CALL)
+	 || (error != KS_ERR_OK) ) {
+	if ( channel._reads ) {
+	    KssProxyRead *reads = channel._reads;
+	    channel._reads = 0;
+	    KS_RESULT res = error;
+	    KsGetVarResult reply;
+	    if ( res == KS_ERR_OK ) {
+		if ( !channel.receive(reply) ) {
+		    res = proxyError(channel.getLastResult());
+		} else {
+		    res = reply.result;
+		}
+	    }
+	    readsDone(reads, res == KS_ERR_OK ? &reply : 0, res);
+	} else if ( channel._forward ) {
+	    KssProxyForward *fwd = channel._forward;
+	    channel._forward = 0;
+	    KS_RESULT res = error;
+	    if ( fwd->service == KS_SETVAR ) {
+		KsSetVarResult reply(0);
+		if ( (res == KS_ERR_OK) && !channel.receive(reply) ) {
+		    res = proxyError(channel.getLastResult());
+		}
+		forwardDone(fwd, res == KS_ERR_OK ? &reply : 0, res);
+	    } else {
+		//
+		// GetEP replies are received directly into the client's
+		// reply, as they need no further translation.
+		//
+		if ( (res == KS_ERR_OK)
+		     && !channel.receive(*fwd->request->getResult()) ) {
+		    res = proxyError(channel.getLastResult());
+		}
+		forwardDone(fwd, 0, res);
+	    }
+	}
+    }
+
+    if ( (error != KS_ERR_OK) && !hadWork ) {
+	//
+	// The channel could not be opened. If there's no other channel
+	// which could take over, then the remote server is unreachable
+	// for now, so don't let the clients wait any longer.
+	//
+	bool usable = false;
+	for ( unsigned int i = 0; i < _channel_count; ++i ) {
+	    if ( _channels[i] && (_channels[i] != &channel)
+		 && (_channels[i]->getState() !=
+		     KssInterKsServerConnection::ISC_STATE_CLOSED) ) {
+		usable = true;
+		break;
+	    }
+	}
+	if ( !usable ) {
+	    failQueued(error);
+	}
+    }
+    kick();
+} // KssProxyMount::channelAttention
+
+
+// ---------------------------------------------------------------------------
+// A batch of reads has been completed. Successfully read values are cached,
+// then all waiting client requests get their share of the reply.
+//
+void KssProxyMount::readsDone(KssProxyRead *reads, KsGetVarResult *result,
+			      KS_RESULT error)
+{
+    unsigned long ttl = _server.getCacheTtl();
+    PltTime expiresAt = PltTime::now(ttl / 1000, (ttl % 1000) * 1000);
+    size_t idx = 0;
+
+    while ( reads ) {
+	KssProxyRead *read = reads;
+	reads = read->next;
+	KssProxyRead *dummy;
+	_reads.remove(read->path, dummy);
+
+	KsGetVarItemResult item;
+	if ( !result ) {
+	    item.result = error;
+	} else if ( idx < result->items.size() ) {
+	    item = result->items[idx];
+	} else {
+	    item.result = KS_ERR_GENERIC;
+	}
+	++idx;
+
+	if ( ttl && (item.result == KS_ERR_OK) ) {
+	    KssProxyCacheEntry *entry;
+	    if ( !_cache.query(read->path, entry) ) {
+		if ( _cache.size() >= _server.getCacheMaxEntries() ) {
+		    flushCache();
+		}
+		entry = new KssProxyCacheEntry;
+		if ( entry && !_cache.add(read->path, entry) ) {
+		    delete entry;
+		    entry = 0;
+		}
+	    }
+	    if ( entry ) {
+		entry->item = item;
+		entry->expires_at = expiresAt;
+	    }
+	}
+
+	while ( read->waiters ) {
+	    KssProxyRead::Waiter *waiter = read->waiters;
+	    read->waiters = waiter->next;
+	    ((KsGetVarResult *) waiter->request->getResult())->
+		items[waiter->index] = item;
+	    waiter->request->itemDone();
+	    delete waiter;
+	}
+	delete read;
+    }
+} // KssProxyMount::readsDone
+
+
+// ---------------------------------------------------------------------------
+// A forwarded request has been completed. The results of a SetVar are put
+// back at the positions of the items in the client's request, and the
+// cached values of the variables written are thrown away.
+//
+void KssProxyMount::forwardDone(KssProxyForward *fwd, KsResult *result,
+				KS_RESULT error)
+{
+    KssProxyRequest *request = fwd->request;
+
+    if ( fwd->service == KS_SETVAR ) {
+	KsSetVarParams *params = (KsSetVarParams *) fwd->params;
+	KsSetVarResult *reply  = (KsSetVarResult *) result;
+	KsSetVarResult *out    = (KsSetVarResult *) request->getResult();
+	if ( reply && (reply->result != KS_ERR_OK) ) {
+	    error = reply->result;
+	    reply = 0;
+	}
+	for ( size_t j = 0; j < params->items.size(); ++j ) {
+	    KsResult &res = out->results[fwd->indices[j]];
+	    if ( reply && (j < reply->results.size()) ) {
+		res = reply->results[j];
+	    } else {
+		res.result = proxyError(error);
+	    }
+	    KssProxyCacheEntry *entry;
+	    if ( _cache.remove(params->items[j].path_and_name, entry) ) {
+		delete entry;
+	    }
+	}
+    } else if ( error != KS_ERR_OK ) {
+	KsGetEPResult *out = (KsGetEPResult *) request->getResult();
+	while ( !out->items.isEmpty() ) {
+	    out->items.removeFirst();
+	}
+	out->result = error;
+    }
+
+    delete fwd;
+    request->itemDone();
+} // KssProxyMount::forwardDone
+
+
+// ---------------------------------------------------------------------------
+// Fail all work which hasn't been handed out to a channel yet.
+//
+void KssProxyMount::failQueued(KS_RESULT error)
+{
+    while ( _queued_forwards ) {
+	KssProxyForward *fwd = _queued_forwards;
+	_queued_forwards = fwd->next;
+	forwardDone(fwd, 0, error);
+    }
+    _last_queued_forward = 0;
+
+    KssProxyRead *reads = _queued_reads;
+    _queued_reads = 0;
+    _last_queued_read = 0;
+    _queued_read_count = 0;
+    readsDone(reads, 0, error);
+} // KssProxyMount::failQueued
+
+
+// ---------------------------------------------------------------------------
+// Throw away all cached values.
+//
+void KssProxyMount::flushCache()
+{
+    PltHashIterator<KsString, KssProxyCacheEntry *> it(_cache);
+    while ( it ) {
+	delete it->a_value;
+	++it;
+    }
+    _cache.reset();
+} // KssProxyMount::flushCache
+
+
+// ---------------------------------------------------------------------------
+// Fail all queued and running work and close all channels, so no client is
+// left waiting for an answer.
+//
+void KssProxyMount::shutdown()
+{
+    failQueued(KS_ERR_NOREMOTE);
+    for ( unsigned int i = 0; i < _channel_count; ++i ) {
+	KssProxyChannel *channel = _channels[i];
+	if ( !channel ) {
+	    continue;
+	}
+	_channels[i] = 0;
+	if ( channel->_reads ) {
+	    readsDone(channel->_reads, 0, KS_ERR_NOREMOTE);
+	    channel->_reads = 0;
+	}
+	if ( channel->_forward ) {
+	    forwardDone(channel->_forward, 0, KS_ERR_NOREMOTE);
+	    channel->_forward = 0;
+	}
+	delete channel;
+    }
+} // KssProxyMount::shutdown
+
+
+// ---------------------------------------------------------------------------
+//
+KsProxyServer::KsProxyServer(int port)
+    : KsSimpleServer(port),
+      _mounts(0),
+      _cache_ttl(1000),        // values are good for one second...
+      _cache_max_entries(4096), // ...and there are not too many of them
+      _max_channels(4),
+      _max_batch(64)
+{
+} // KsProxyServer::KsProxyServer
+
+
+KsProxyServer::~KsProxyServer()
+{
+    while ( _mounts ) {
+	KssProxyMount *mount = _mounts;
+	_mounts = mount->_next;
+	delete mount;
+    }
+} // KsProxyServer::~KsProxyServer
+
+
+// ---------------------------------------------------------------------------
+// Mount a remote server. The mount point also shows up as an ordinary domain
+// in the local namespace, so clients can browse into it.
+//
+bool KsProxyServer::mount(const KsPath &dompath, const KsString &id,
+			  const KsString &host, const KsString &server,
+			  const KsString &remote)
+{
+    PLT_PRECONDITION(dompath.isValid() && dompath.isAbsolute());
+
+    PltString prefix = dompath;
+    KsString local(prefix == "/" ? "" : (const char *) prefix, "/");
+    local = KsString(local, ksStringToPercent(id));
+
+    KsString remotePath(remote);
+    size_t len = remotePath.len();
+    if ( len == 0 ) {
+	remotePath = KsString("/");
+    } else if ( (len > 1) && (remotePath[len - 1] == '/') ) {
+	remotePath = KsString(remotePath.substr(0, len - 1));
+    }
+
+    if ( !addDomain(dompath, id,
+		    KsString(PltString(host, "/"), server)) ) {
+	return false;
+    }
+    KssProxyMount *mount = new KssProxyMount(*this, local, host, server,
+					     remotePath);
+    if ( !mount ) {
+	removeCommObject(dompath, id);
+	return false;
+    }
+    mount->_next = _mounts;
+    _mounts = mount;
+    return true;
+} // KsProxyServer::mount
+
+
+// ---------------------------------------------------------------------------
+// Find the mount a (resolved, thus decoded) path is below of, and return the
+// path on the remote server in its encoded form.
+//
+KssProxyMount *KsProxyServer::findMount(const KsPath &path,
+					KsString &remote) const
+{
+    KsString local(ksPathToPercent(KsString(PltString(path))));
+    for ( KssProxyMount *mount = _mounts; mount; mount = mount->_next ) {
+	if ( mount->mapPath(local, remote) ) {
+	    return mount;
+	}
+    }
+    return 0;
+} // KsProxyServer::findMount
+
+
+// ---------------------------------------------------------------------------
+// Send the work collected while dispatching a request downstream. Doing this
+// only after the whole request has been worked through lets reads of the
+// same client request go into the same downstream call.
+//
+void KsProxyServer::kickMounts()
+{
+    for ( KssProxyMount *mount = _mounts; mount; mount = mount->_next ) {
+	mount->kick();
+    }
+} // KsProxyServer::kickMounts
+
+
+// ---------------------------------------------------------------------------
+//
+void KsProxyServer::stopServer()
+{
+    for ( KssProxyMount *mount = _mounts; mount; mount = mount->_next ) {
+	mount->shutdown();
+    }
+    KsSimpleServer::stopServer();
+} // KsProxyServer::stopServer
+
+
+// ---------------------------------------------------------------------------
+// Take over the GetVar, SetVar and GetEP services as soon as there are any
+// mounts. Everything else is handled as usual.
+//
+void KsProxyServer::dispatch(u_long serviceId,
+			     KssTransport &transport,
+			     XDR *xdrIn,
+			     KsAvTicket &ticket)
+{
+    if ( !_mounts ) {
+	KsSimpleServer::dispatch(serviceId, transport, xdrIn, ticket);
+	return;
+    }
+    bool canDefer = transport.canDeferReply()
+	            && (ticket.xdrTypeCode() == KS_AUTH_NONE);
+    bool decodedOk = true;
+
+    switch ( serviceId ) {
+    case KS_GETVAR:
+	{
+	    KsGetVarParams params(xdrIn, decodedOk);
+	    transport.finishRequestDeserialization(ticket, decodedOk);
+	    if ( decodedOk ) {
+		proxyGetVar(transport, ticket, params, canDefer);
+	    } else {
+		transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+	    }
+	}
+	break;
+
+    case KS_SETVAR:
+	{
+	    KsSetVarParams params(xdrIn, decodedOk);
+	    transport.finishRequestDeserialization(ticket, decodedOk);
+	    if ( decodedOk ) {
+		proxySetVar(transport, ticket, params, canDefer);
+	    } else {
+		transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+	    }
+	}
+	break;
+
+    case KS_GETEP:
+	{
+	    KsGetEPParams params(xdrIn, decodedOk);
+	    transport.finishRequestDeserialization(ticket, decodedOk);
+	    if ( decodedOk ) {
+		proxyGetEP(transport, ticket, params, canDefer);
+	    } else {
+		transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+	    }
+	}
+	break;
+
+    default:
+	KsSimpleServer::dispatch(serviceId, transport, xdrIn, ticket);
+    }
+} // KsProxyServer::dispatch
+
+
+// ---------------------------------------------------------------------------
+// Read variables: local ones are read directly, remote ones are taken from
+// the cache if possible, otherwise a read is queued at their mount.
+//
+void KsProxyServer::proxyGetVar(KssTransport &transport, KsAvTicket &ticket,
+				const KsGetVarParams &params, bool canDefer)
+{
+    size_t reqsz = params.identifiers.size();
+    PltArray<KsPath> paths(reqsz);
+    PltArray<KS_RESULT> pathres(reqsz);
+    KsGetVarResult *result = new KsGetVarResult(reqsz);
+    KssProxyRequest *request = result ?
+	new KssProxyRequest(transport, result) : 0;
+
+    if ( !request
+	 || (result->items.size() != reqsz)
+	 || (paths.size() != reqsz)
+	 || (pathres.size() != reqsz) ) {
+	if ( request ) {
+	    delete request;
+	} else {
+	    delete result;
+	}
+	transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+	return;
+    }
+
+    KsPath::resolvePaths(params.identifiers, paths, pathres);
+    for ( size_t i = 0; i < reqsz; ++i ) {
+	KsGetVarItemResult &item = result->items[i];
+	if ( pathres[i] != KS_ERR_OK ) {
+	    item.result = pathres[i];
+	    continue;
+	}
+	KsString remote;
+	KssProxyMount *mount = findMount(paths[i], remote);
+	if ( !mount ) {
+	    getVarItem(ticket, paths[i], item);
+	} else if ( !ticket.canReadVar(KsString(PltString(paths[i]))) ) {
+	    item.result = KS_ERR_NOACCESS;
+	} else if ( !mount->lookup(remote, item) ) {
+	    if ( canDefer ) {
+		request->addItem();
+		mount->read(remote, request, i);
+	    } else {
+		mount->read(remote, 0, 0);
+		item.result = KS_ERR_NOREMOTE;
+	    }
+	}
+    }
+    result->result = KS_ERR_OK;
+
+    kickMounts();
+    request->release(ticket);
+} // KsProxyServer::proxyGetVar
+
+
+// ---------------------------------------------------------------------------
+// Write variables: local ones are written directly, remote ones are collected
+// into one SetVar request per mount.
+//
+void KsProxyServer::proxySetVar(KssTransport &transport, KsAvTicket &ticket,
+				const KsSetVarParams &params, bool canDefer)
+{
+    size_t reqsz = params.items.size();
+    PltArray<KsString> ids(reqsz);
+    PltArray<KsPath> paths(reqsz);
+    PltArray<KS_RESULT> pathres(reqsz);
+    PltArray<KssProxyMount *> mounts(reqsz);
+    PltArray<KsString> remotes(reqsz);
+    KsSetVarResult *result = new KsSetVarResult(reqsz);
+    KssProxyRequest *request = result ?
+	new KssProxyRequest(transport, result) : 0;
+
+    if ( !request
+	 || (result->results.size() != reqsz)
+	 || (ids.size() != reqsz)
+	 || (paths.size() != reqsz)
+	 || (pathres.size() != reqsz)
+	 || (mounts.size() != reqsz)
+	 || (remotes.size() != reqsz) ) {
+	if ( request ) {
+	    delete request;
+	} else {
+	    delete result;
+	}
+	transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+	return;
+    }
+
+    size_t i;
+    for ( i = 0; i < reqsz; ++i ) {
+	ids[i] = params.items[i].path_and_name;
+    }
+    KsPath::resolvePaths(ids, paths, pathres);
+    for ( i = 0; i < reqsz; ++i ) {
+	mounts[i] = 0;
+	if ( pathres[i] != KS_ERR_OK ) {
+	    result->results[i].result = pathres[i];
+	    continue;
+	}
+	KssProxyMount *mount = findMount(paths[i], remotes[i]);
+	if ( !mount ) {
+	    setVarItem(ticket, paths[i], params.items[i].curr_props,
+		       result->results[i]);
+	} else if ( !ticket.canWriteVar(KsString(PltString(paths[i]))) ) {
+	    result->results[i].result = KS_ERR_NOACCESS;
+	} else if ( !canDefer ) {
+	    result->results[i].result = KS_ERR_NOREMOTE;
+	} else {
+	    mounts[i] = mount;
+	}
+    }
+    result->result = KS_ERR_OK;
+
+    for ( KssProxyMount *mount = _mounts; mount; mount = mount->_next ) {
+	size_t count = 0;
+	for ( i = 0; i < reqsz; ++i ) {
+	    if ( mounts[i] == mount ) {
+		++count;
+	    }
+	}
+	if ( !count ) {
+	    continue;
+	}
+	KssProxyForward *fwd = new KssProxyForward(request, KS_SETVAR);
+	KsSetVarParams *fwdParams = fwd ? new KsSetVarParams(count) : 0;
+	size_t *indices = fwdParams ? new size_t[count] : 0;
+	if ( fwd ) {
+	    fwd->params  = fwdParams;
+	    fwd->indices = indices;
+	}
+	if ( !indices || (fwdParams->items.size() != count) ) {
+	    delete fwd;
+	    for ( i = 0; i < reqsz; ++i ) {
+		if ( mounts[i] == mount ) {
+		    result->results[i].result = KS_ERR_GENERIC;
+		}
+	    }
+	    continue;
+	}
+	size_t j = 0;
+	for ( i = 0; i < reqsz; ++i ) {
+	    if ( mounts[i] == mount ) {
+		fwdParams->items[j].path_and_name = remotes[i];
+		fwdParams->items[j].curr_props = params.items[i].curr_props;
+		indices[j++] = i;
+	    }
+	}
+	request->addItem();
+	mount->forward(fwd);
+    }
+
+    kickMounts();
+    request->release(ticket);
+} // KsProxyServer::proxySetVar
+
+
+// ---------------------------------------------------------------------------
+// Engineered properties below a mount come straight from the remote server.
+// The identifiers returned are relative, so the reply can be passed on as is.
+//
+void KsProxyServer::proxyGetEP(KssTransport &transport, KsAvTicket &ticket,
+			       const KsGetEPParams &params, bool canDefer)
+{
+    KsPath path(params.path);
+    KsString remote;
+    KssProxyMount *mount = 0;
+    if ( path.isValid() && path.isAbsolute()
+	 && (path.decodePercents() == KS_ERR_OK) ) {
+	mount = findMount(path, remote);
+    }
+
+    if ( !mount || !canDefer || !ticket.isVisible(KsString(path)) ) {
+	KsGetEPResult result;
+	if ( !mount ) {
+	    getEP(ticket, params, result);
+	} else if ( !ticket.isVisible(KsString(path)) ) {
+	    result.result = KS_ERR_NOACCESS;
+	} else {
+	    result.result = KS_ERR_NOREMOTE;
+	}
+	transport.sendReply(ticket, result);
+	return;
+    }
+
+    KsGetEPResult *result = new KsGetEPResult;
+    KssProxyRequest *request = result ?
+	new KssProxyRequest(transport, result) : 0;
+    KssProxyForward *fwd = request ?
+	new KssProxyForward(request, KS_GETEP) : 0;
+    KsGetEPParams *fwdParams = fwd ? new KsGetEPParams(params) : 0;
+    if ( !fwdParams ) {
+	delete fwd;
+	if ( request ) {
+	    delete request;
+	} else {
+	    delete result;
+	}
+	transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+	return;
+    }
+    fwdParams->path = remote;
+    fwd->params = fwdParams;
+
+    request->addItem();
+    mount->forward(fwd);
+    mount->kick();
+    request->release(ticket);
+} // KsProxyServer::proxyGetEP
+
+#endif /* PLT_USE_BUFFERED_STREAMS */
+
+/* End of proxyserver.cpp */
@@ -0,0 +1,339 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "ks/resolver.h"
+
+#include <string.h>
+
+
+// ---------------------------------------------------------------------------
+//
+KsHostAddresses::KsHostAddresses()
+    : count(0)
+#if PLT_USE_GETADDRINFO
+      , count6(0)
+#endif
+{
+} // KsHostAddresses::KsHostAddresses
+
+
+bool KsHostAddresses::pickIPv4(struct in_addr &ip,
+			       const struct in_addr &avoid) const
+{
+    if ( !count ) {
+	return false;
+    }
+    if ( (count > 1) && (ipv4[0].s_addr == avoid.s_addr) ) {
+	ip = ipv4[1];
+    } else {
+	ip = ipv4[0];
+    }
+    return true;
+} // KsHostAddresses::pickIPv4
+
+
+// ---------------------------------------------------------------------------
+// A thread resolving a single host name. It only touches its cache entry
+// while holding the resolver's lock.
+//
+class KsResolverThread : public PltThread {
+public:
+    KsResolverThread(KsHostResolver::Entry *entry)
+	: _entry(entry), _host(entry->host) { }
+protected:
+    virtual void run();
+private:
+    KsHostResolver::Entry *_entry;
+    KsString               _host;
+}; // class KsResolverThread
+
+
+void KsResolverThread::run()
+{
+    KsHostAddresses addrs;
+    bool ok = KsHostResolver::resolveNow(_host, addrs);
+
+    PltMutexLock lock(KsHostResolver::_lock);
+    KsHostResolver::finish(_entry, ok, addrs);
+} // KsResolverThread::run
+
+
+// ---------------------------------------------------------------------------
+// Addresses are trusted for five minutes, unknown hosts are remembered for
+// half a minute.
+//
+KsHostResolver::Entry *KsHostResolver::_entries = 0;
+unsigned long KsHostResolver::_ttl = 300;
+unsigned long KsHostResolver::_negative_ttl = 30;
+PltMutex KsHostResolver::_lock;
+PltCondition KsHostResolver::_resolved;
+
+#if !PLT_USE_GETADDRINFO
+//
+// gethostbyname() returns a pointer to static data.
+//
+static PltMutex ks_hostentLock;
+#endif
+
+
+// ---------------------------------------------------------------------------
+//
+void KsHostResolver::setLimits(unsigned long ttl, unsigned long negativeTtl)
+{
+    PltMutexLock lock(_lock);
+    _ttl          = ttl;
+    _negative_ttl = negativeTtl;
+} // KsHostResolver::setLimits
+
+
+void KsHostResolver::getLimits(unsigned long &ttl,
+			       unsigned long &negativeTtl)
+{
+    PltMutexLock lock(_lock);
+    ttl         = _ttl;
+    negativeTtl = _negative_ttl;
+} // KsHostResolver::getLimits
+
+
+// ---------------------------------------------------------------------------
+// Forget everything. Lookups still running are waited for, but outside the
+// lock, as they need it to finish.
+//
+void KsHostResolver::flush()
+{
+    Entry *entries;
+    {
+	PltMutexLock lock(_lock);
+	entries = _entries;
+	_entries = 0;
+    }
+    while ( entries ) {
+	Entry *e = entries;
+	entries = e->next;
+	if ( e->thread ) {
+	    e->thread->join();
+	    delete e->thread;
+	}
+	delete e;
+    }
+} // KsHostResolver::flush
+
+
+// ---------------------------------------------------------------------------
+// Find the cache entry for a host, creating a new one if necessary. New
+// entries are expired right from the start, so they get resolved on first
+// use. Must be called with the lock held.
+//
+KsHostResolver::Entry *KsHostResolver::find(const KsString &host)
+{
+    Entry *e;
+    for ( e = _entries; e; e = e->next ) {
+	if ( e->host == host ) {
+	    return e;
+	}
+    }
+    e = new Entry;
+    if ( e ) {
+	e->host = host;
+	e->status = FAILED;
+	e->valid_until = PltTime(0, 0);
+	e->thread = 0;
+	e->next = _entries;
+	_entries = e;
+    }
+    return e;
+} // KsHostResolver::find
+
+
+// ---------------------------------------------------------------------------
+// Store the outcome of a lookup and wake up everyone waiting for it. Must be
+// called with the lock held.
+//
+void KsHostResolver::finish(Entry *entry, bool ok,
+			    const KsHostAddresses &addrs)
+{
+    entry->status = ok ? RESOLVED : FAILED;
+    entry->addrs = addrs;
+    entry->valid_until = PltTime::now();
+    entry->valid_until.tv_sec += ok ? _ttl : _negative_ttl;
+    _resolved.broadcast();
+} // KsHostResolver::finish
+
+
+// ---------------------------------------------------------------------------
+// Return the state of a cache entry. Once a lookup has finished, its thread
+// is done, too, and can be cleaned up. Must be called with the lock held.
+//
+KsHostResolver::Status KsHostResolver::check(Entry *entry,
+					     KsHostAddresses &addrs)
+{
+    if ( entry->status == PENDING ) {
+	return PENDING;
+    }
+    if ( entry->thread ) {
+	entry->thread->join();
+	delete entry->thread;
+	entry->thread = 0;
+    }
+    addrs = entry->addrs;
+    return entry->status;
+} // KsHostResolver::check
+
+
+// ---------------------------------------------------------------------------
+// Look up a host name in the cache and start resolving it in the background
+// if we don't know about it (any more). Must be called with the lock held.
+//
+KsHostResolver::Status KsHostResolver::lookupLocked(const KsString &host,
+						    KsHostAddresses &addrs)
+{
+    Entry *e = find(host);
+    if ( !e ) {
+	return resolveNow(host, addrs) ? RESOLVED : FAILED;
+    }
+    Status status = check(e, addrs);
+    if ( (status == PENDING) || (PltTime::now() <= e->valid_until) ) {
+	return status;
+    }
+
+    e->status = PENDING;
+    e->thread = new KsResolverThread(e);
+    if ( e->thread && e->thread->start() ) {
+	return PENDING;
+    }
+    //
+    // No thread for us, so we have to do the work ourselves and block.
+    //
+    delete e->thread;
+    e->thread = 0;
+    KsHostAddresses found;
+    finish(e, resolveNow(host, found), found);
+    return check(e, addrs);
+} // KsHostResolver::lookupLocked
+
+
+// ---------------------------------------------------------------------------
+//
+KsHostResolver::Status KsHostResolver::lookup(const KsString &host,
+					      KsHostAddresses &addrs)
+{
+    if ( isNumeric(host, addrs) ) {
+	return RESOLVED;
+    }
+    PltMutexLock lock(_lock);
+    return lookupLocked(host, addrs);
+} // KsHostResolver::lookup
+
+
+// ---------------------------------------------------------------------------
+// Resolve a host name and wait for the outcome. Other threads asking for the
+// same host meanwhile wait for the same lookup.
+//
+bool KsHostResolver::resolve(const KsString &host, KsHostAddresses &addrs)
+{
+    if ( isNumeric(host, addrs) ) {
+	return true;
+    }
+    PltMutexLock lock(_lock);
+    Status status;
+    while ( (status = lookupLocked(host, addrs)) == PENDING ) {
+	if ( !_resolved.wait(_lock) ) {
+	    break;
+	}
+    }
+    return status == RESOLVED;
+} // KsHostResolver::resolve
+
+
+// ---------------------------------------------------------------------------
+// Dotted IPv4 addresses don't need a resolver. "0.0.0.0" doesn't count as
+// an address.
+//
+bool KsHostResolver::isNumeric(const KsString &host, KsHostAddresses &addrs)
+{
+    if ( !host.len() ) {
+	return false;
+    }
+    struct in_addr ip;
+    ip.s_addr = inet_addr((const char *) host);
+    if ( (ip.s_addr == INADDR_NONE) || (ip.s_addr == INADDR_ANY) ) {
+	return false;
+    }
+    addrs = KsHostAddresses();
+    addrs.ipv4[0] = ip;
+    addrs.count = 1;
+    return true;
+} // KsHostResolver::isNumeric
+
+
+// ---------------------------------------------------------------------------
+// Ask the system resolver. This blocks, so it is usually done by a resolver
+// thread.
+//
+bool KsHostResolver::resolveNow(const KsString &host, KsHostAddresses &addrs)
+{
+    addrs = KsHostAddresses();
+    if ( !host.len() ) {
+	return false;
+    }
+
+#if PLT_USE_GETADDRINFO
+    struct addrinfo hints;
+    struct addrinfo *res = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if ( getaddrinfo((const char *) host, 0, &hints, &res) != 0 ) {
+	return false;
+    }
+    for ( struct addrinfo *ai = res; ai; ai = ai->ai_next ) {
+	if ( (ai->ai_family == AF_INET)
+	     && (addrs.count < KsHostAddresses::MAX_ADDRESSES) ) {
+	    struct in_addr ip = ((struct sockaddr_in *) ai->ai_addr)->sin_addr;
+	    if ( ip.s_addr != INADDR_ANY ) {
+		addrs.ipv4[addrs.count++] = ip;
+	    }
+	} else if ( (ai->ai_family == AF_INET6)
+		    && (addrs.count6 < KsHostAddresses::MAX_ADDRESSES) ) {
+	    addrs.ipv6[addrs.count6++] =
+		((struct sockaddr_in6 *) ai->ai_addr)->sin6_addr;
+	}
+    }
+    freeaddrinfo(res);
+    return addrs.count || addrs.count6;
+#else
+    PltMutexLock lock(ks_hostentLock);
+    struct hostent *he = gethostbyname((const char *) host);
+    if ( !he || (he->h_addrtype != AF_INET) ) {
+	return false;
+    }
+    for ( char **a = he->h_addr_list;
+	  *a && (addrs.count < KsHostAddresses::MAX_ADDRESSES); ++a ) {
+	memcpy(&addrs.ipv4[addrs.count], *a, sizeof(struct in_addr));
+	if ( addrs.ipv4[addrs.count].s_addr != INADDR_ANY ) {
+	    ++addrs.count;
+	}
+    }
+    return addrs.count != 0;
+#endif
+} // KsHostResolver::resolveNow
+
+/* End of resolver.cpp */
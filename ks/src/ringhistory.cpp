@@ -0,0 +1,451 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "ks/ringhistory.h"
+
+#include <string.h>
+
+
+// ----------------------------------------------------------------------------
+// Allocate the time stamp column. The value columns are allocated whenever
+// a variable is tracked.
+//
+KssRingHistory::KssRingHistory(const KsString &id,
+                               size_t capacity,
+                               KS_HIST_TYPE mode,
+                               unsigned long period,
+                               KsTime ctime,
+                               KsString comment)
+    : KssSampledHistory(id, mode, period, ctime, comment),
+      _times(0),
+      _columns(0),
+      _capacity(0),
+      _first(0),
+      _count(0),
+      _appended(0)
+{
+    if ( capacity ) {
+        _times = new PltTime[capacity];
+        if ( _times ) {
+            _capacity = capacity;
+        }
+    }
+} // KssRingHistory::KssRingHistory
+
+
+KssRingHistory::~KssRingHistory()
+{
+    stopSampling();
+    for ( size_t i = 0; i < _track_count; ++i ) {
+        delete [] _columns[i];
+    }
+    delete [] _columns;
+    delete [] _times;
+} // KssRingHistory::~KssRingHistory
+
+
+// ----------------------------------------------------------------------------
+// Allocate the column for another variable. This is only possible as long
+// as there are no rows yet.
+//
+bool
+KssRingHistory::addColumn(const Track &track)
+{
+    if ( _count || !_capacity ) {
+        return false;
+    }
+    double **columns = new double *[track.index + 1];
+    if ( !columns ) {
+        return false;
+    }
+    columns[track.index] = new double[_capacity];
+    if ( !columns[track.index] ) {
+        delete [] columns;
+        return false;
+    }
+    for ( size_t i = 0; i < track.index; ++i ) {
+        columns[i] = _columns[i];
+    }
+    delete [] _columns;
+    _columns = columns;
+    return true;
+} // KssRingHistory::addColumn
+
+
+void
+KssRingHistory::removeColumn(const Track &track)
+{
+    delete [] _columns[track.index];
+    _columns[track.index] = 0;
+} // KssRingHistory::removeColumn
+
+
+// ----------------------------------------------------------------------------
+// Append a new row, overwriting the oldest one if the ring is full. The rows
+// must stay sorted by time, so a time stamp lying before the one of the last
+// row (think of the clock being set back) is replaced by the latter.
+//
+void
+KssRingHistory::appendRow(const PltTime &t)
+{
+    if ( !_capacity ) {
+        return;
+    }
+    size_t pos;
+    if ( _count < _capacity ) {
+        pos = physical(_count);
+        ++_count;
+    } else {
+        pos = _first;
+        _first = physical(1);
+    }
+    if ( (_count > 1) && (t < timeAt(_count - 2)) ) {
+        _times[pos] = timeAt(_count - 2);
+    } else {
+        _times[pos] = t;
+    }
+    for ( Track *track = _tracks; track; track = track->next ) {
+        _columns[track->index][pos] = track->last;
+    }
+    ++_appended;
+} // KssRingHistory::appendRow
+
+
+// ----------------------------------------------------------------------------
+// Binary searches on the time column: lowerBound() returns the first row at
+// or after time t, upperBound() the first row after time t.
+//
+size_t
+KssRingHistory::lowerBound(const PltTime &t) const
+{
+    size_t lo = 0;
+    size_t hi = _count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( timeAt(mid) < t ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+} // KssRingHistory::lowerBound
+
+
+size_t
+KssRingHistory::upperBound(const PltTime &t) const
+{
+    size_t lo = 0;
+    size_t hi = _count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( timeAt(mid) <= t ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+} // KssRingHistory::upperBound
+
+
+// ----------------------------------------------------------------------------
+// Find the rows first up to (but not including) last within the time range
+// selected; without a time selector, these are all rows.
+//
+void
+KssRingHistory::selectRows(const Selection &sel,
+                           size_t &first, size_t &last) const
+{
+    first = 0;
+    last = _count;
+    if ( sel.selected ) {
+        first = lowerBound(sel.from);
+        last  = upperBound(sel.to);
+        if ( last < first ) {
+            last = first;
+        }
+    }
+} // KssRingHistory::selectRows
+
+
+// ----------------------------------------------------------------------------
+// Tell the aggregator which rows fall into which bucket. The rows first up
+// to (but not including) last are those within the time range.
+//
+void
+KssRingHistory::selectBuckets(KssHistoryAggregator &agg,
+                              size_t first, size_t last) const
+{
+    size_t buckets = agg.getBucketCount();
+    if ( !buckets ) {
+        return;
+    }
+    agg.setBucketRow(0, first);
+    for ( size_t b = 1; b < buckets; ++b ) {
+        agg.setBucketRow(b, lowerBound(agg.getBucketStart(b)));
+    }
+    agg.setBucketRow(buckets, last);
+} // KssRingHistory::selectBuckets
+
+
+// ----------------------------------------------------------------------------
+// Feed a column into the aggregator, bucket by bucket. As with copying, the
+// rows of a bucket may wrap around the end of the ring.
+//
+void
+KssRingHistory::accumulate(KssHistoryAggregator &agg,
+                           const Track &track) const
+{
+    const double *column = _columns[track.index];
+    agg.reset();
+    for ( size_t b = 0; b < agg.getBucketCount(); ++b ) {
+        size_t count = agg.getBucketSize(b);
+        if ( !count ) {
+            continue;
+        }
+        size_t pos = physical(agg.getBucketRow(b));
+        size_t head = _capacity - pos;
+        if ( head > count ) {
+            head = count;
+        }
+        agg.accumulate(b, column + pos, head);
+        if ( count > head ) {
+            agg.accumulate(b, column, count - head);
+        }
+    }
+} // KssRingHistory::accumulate
+
+
+// ----------------------------------------------------------------------------
+// Copy some rows of a column. As the rows may wrap around the end of the
+// ring, this takes (at most) two blocks.
+//
+void
+KssRingHistory::copyTimes(size_t first, size_t count, KsTime *dst) const
+{
+    for ( size_t i = 0; i < count; ++i ) {
+        dst[i] = timeAt(first + i);
+    }
+} // KssRingHistory::copyTimes
+
+
+void
+KssRingHistory::copyValues(size_t column, size_t first, size_t count,
+                           double *dst) const
+{
+    if ( !count ) {
+        return;
+    }
+    size_t pos = physical(first);
+    size_t head = _capacity - pos;
+    if ( head > count ) {
+        head = count;
+    }
+    memcpy(dst, _columns[column] + pos, head * sizeof(double));
+    if ( count > head ) {
+        memcpy(dst + head, _columns[column],
+               (count - head) * sizeof(double));
+    }
+} // KssRingHistory::copyValues
+
+
+// ----------------------------------------------------------------------------
+// Answer a GetHist request: the time part is returned as a vector of time
+// stamps, every other part as a vector of doubles, all for the same rows.
+// Without a time selector, all rows are returned. In any case, no more than
+// max_entries rows (or buckets) are returned, starting with the oldest one.
+//
+void
+KssRingHistory::getHist(const KsGetHistParams &params,
+                        KsGetHistSingleResult &result)
+{
+    Selection sel;
+    KS_RESULT res = getSelection(params, sel);
+    if ( res != KS_ERR_OK ) {
+        result.result = res;
+        return;
+    }
+
+    size_t first, last;
+    selectRows(sel, first, last);
+
+    KssHistoryAggregator agg;
+    size_t count = last - first;
+    if ( sel.ipm != KS_IPM_NONE ) {
+        res = agg.setup(sel.from, sel.to, sel.delta, params.max_entries,
+                        count);
+        if ( res != KS_ERR_OK ) {
+            result.result = res;
+            return;
+        }
+        selectBuckets(agg, first, last);
+    } else if ( count > params.max_entries ) {
+        count = params.max_entries;
+    }
+
+    size_t nitems = params.items.size();
+    KsArray<KsGetHistResultItem> items(nitems);
+    if ( items.size() != nitems ) {
+        result.result = KS_ERR_GENERIC;
+        return;
+    }
+
+    for ( size_t i = 0; i < nitems; ++i ) {
+        const KsString &part = params.items[i].part_id;
+        KsGetHistResultItem &item = items[i];
+        if ( part == "t" ) {
+            if ( sel.ipm != KS_IPM_NONE ) {
+                item.value = agg.getTimes();
+            } else {
+                KsTimeVecValue *tv = new KsTimeVecValue(count);
+                if ( !tv || (tv->size() != count) ) {
+                    delete tv;
+                    item.result = KS_ERR_GENERIC;
+                    continue;
+                }
+                copyTimes(first, count, tv->getPtr());
+                item.value = KsValueHandle(tv, KsOsNew);
+            }
+        } else {
+            Track *track = findTrack(part);
+            if ( !track ) {
+                item.result = KS_ERR_BADPATH;
+                continue;
+            }
+            if ( sel.ipm != KS_IPM_NONE ) {
+                accumulate(agg, *track);
+                item.value = agg.getValues(sel.ipm);
+            } else {
+                KsDoubleVecValue *dv = new KsDoubleVecValue(count);
+                if ( !dv || (dv->size() != count) ) {
+                    delete dv;
+                    item.result = KS_ERR_GENERIC;
+                    continue;
+                }
+                copyValues(track->index, first, count, dv->getPtr());
+                item.value = KsValueHandle(dv, KsOsNew);
+            }
+        }
+        item.result = item.value ? KS_ERR_OK : KS_ERR_GENERIC;
+    }
+
+    if ( sel.encoded ) {
+        encodeItems(items);
+    }
+    result.items = items;
+    result.result = KS_ERR_OK;
+} // KssRingHistory::getHist
+
+
+// ----------------------------------------------------------------------------
+// A cursor over the rows of a ring history. It refers to the rows by their
+// sequence number, so rows appended meanwhile don't get into its way; rows
+// overwritten meanwhile can't be read any more, though.
+//
+class KssRingHistoryCursor
+    : public KssHistoryCursor
+{
+public:
+    KssRingHistoryCursor(const KssRingHistory &ring, size_t seq)
+        : _ring(ring), _seq(seq) { }
+
+    virtual bool readTimes(size_t row, size_t count, PltTime *dst);
+    virtual bool readValues(size_t column, size_t row, size_t count,
+                            double *dst);
+
+private:
+    bool locate(size_t row, size_t count, size_t &first) const;
+
+    const KssRingHistory &_ring;
+    size_t                _seq;   // sequence number of the first row
+}; // class KssRingHistoryCursor
+
+
+//
+// Map rows of the reply onto the rows currently in the ring. As sequence
+// numbers may wrap around, the distance to the oldest row is all that
+// counts.
+//
+bool
+KssRingHistoryCursor::locate(size_t row, size_t count, size_t &first) const
+{
+    first = (_seq + row) - (_ring._appended - _ring._count);
+    return (first < _ring._count) && (count <= _ring._count - first);
+} // KssRingHistoryCursor::locate
+
+
+bool
+KssRingHistoryCursor::readTimes(size_t row, size_t count, PltTime *dst)
+{
+    size_t first;
+    if ( !locate(row, count, first) ) {
+        return false;
+    }
+    for ( size_t i = 0; i < count; ++i ) {
+        dst[i] = _ring.timeAt(first + i);
+    }
+    return true;
+} // KssRingHistoryCursor::readTimes
+
+
+bool
+KssRingHistoryCursor::readValues(size_t column, size_t row, size_t count,
+                                 double *dst)
+{
+    size_t first;
+    if ( !locate(row, count, first) ) {
+        return false;
+    }
+    _ring.copyValues(column, first, count, dst);
+    return true;
+} // KssRingHistoryCursor::readValues
+
+
+// ----------------------------------------------------------------------------
+// Open a cursor for raw replies. Aggregated and encoded replies are small
+// enough to be built by getHist(), so are erroneous requests.
+//
+KssHistoryCursor *
+KssRingHistory::openCursor(const KsGetHistParams &params)
+{
+    Selection sel;
+    if ( (getSelection(params, sel) != KS_ERR_OK)
+         || (sel.ipm != KS_IPM_NONE) || sel.encoded ) {
+        return 0;
+    }
+
+    size_t first, last;
+    selectRows(sel, first, last);
+    size_t count = last - first;
+    if ( count > params.max_entries ) {
+        count = params.max_entries;
+    }
+
+    KssRingHistoryCursor *cursor =
+        new KssRingHistoryCursor(*this, (_appended - _count) + first);
+    if ( cursor && !initCursor(*cursor, params, count) ) {
+        delete cursor;
+        cursor = 0;
+    }
+    return cursor;
+} // KssRingHistory::openCursor
+
+/* End of ringhistory.cpp */
@@ -0,0 +1,352 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "ks/sampledhistory.h"
+#include "ks/svrbase.h"
+#include "ks/histcodec.h"
+
+
+// ----------------------------------------------------------------------------
+// The timer event driving the sampling of a history. It reschedules itself
+// relative to its last trigger time, so the sample times don't drift even if
+// the server is busy at times.
+//
+class KssSampledHistorySampleEvent
+    : public KsTimerEvent
+{
+public:
+    KssSampledHistorySampleEvent(KssSampledHistory &history);
+
+    virtual void trigger();
+
+private:
+    KssSampledHistory &_history;
+}; // class KssSampledHistorySampleEvent
+
+
+KssSampledHistorySampleEvent::KssSampledHistorySampleEvent(
+    KssSampledHistory &history)
+    : KsTimerEvent(KsTime::now(history.getPeriod() / 1000,
+                               (history.getPeriod() % 1000) * 1000)),
+      _history(history)
+{
+} // KssSampledHistorySampleEvent::KssSampledHistorySampleEvent
+
+
+void
+KssSampledHistorySampleEvent::trigger()
+{
+    _history.sample(_trigger_at);
+
+    unsigned long period = _history.getPeriod();
+    PltTimeSpan span(period / 1000, (period % 1000) * 1000);
+    _trigger_at = _trigger_at + span;
+    KsTime now(KsTime::now());
+    if ( _trigger_at < now ) {
+        //
+        // We're lagging behind by more than a period, so skip the
+        // samples we've missed.
+        //
+        _trigger_at = now + span;
+    }
+    KsServerBase::getServerObject().addTimerEvent(this);
+} // KssSampledHistorySampleEvent::trigger
+
+
+// ----------------------------------------------------------------------------
+//
+KssSampledHistory::KssSampledHistory(const KsString &id,
+                                     KS_HIST_TYPE mode,
+                                     unsigned long period,
+                                     KsTime ctime,
+                                     KsString comment)
+    : KssHistoryDomain(id,
+                       KS_HT_TABLE | (mode & (KS_HT_TIME_DRIVEN |
+                                              KS_HT_CHANGE_DRIVEN)),
+                       KS_IPM_NONE,
+                       KS_IPM_MIN | KS_IPM_MAX | KS_IPM_LINEAR | KS_IPM_HOLD,
+                       ctime, comment),
+      _tracks(0),
+      _track_count(0),
+      _period(period ? period : 1),
+      _recorded(false),
+      _event(0)
+{
+    addPart("t", KS_VT_TIME, "time stamps");
+} // KssSampledHistory::KssSampledHistory
+
+
+KssSampledHistory::~KssSampledHistory()
+{
+    stopSampling();
+    while ( _tracks ) {
+        Track *track = _tracks;
+        _tracks = track->next;
+        delete track;
+    }
+} // KssSampledHistory::~KssSampledHistory
+
+
+// ----------------------------------------------------------------------------
+// Add another variable to be recorded. The new track is appended to the end
+// of the track list, so the parts appear in the order they were added.
+//
+bool
+KssSampledHistory::trackVariable(const KsString &part,
+                                 const KssCommObjectHandle &var,
+                                 const KsString &comment)
+{
+    if ( !var || (var->typeCode() != KS_OT_VARIABLE)
+         || (part == "t") || findTrack(part) ) {
+        return false;
+    }
+    Track *track = new Track;
+    if ( !track ) {
+        return false;
+    }
+    track->next  = 0;
+    track->index = _track_count;
+    track->part  = part;
+    track->var   = var;
+    track->last  = 0.0;
+    if ( !addColumn(*track) ) {
+        delete track;
+        return false;
+    }
+    if ( !addPart(part, KS_VT_DOUBLE, comment) ) {
+        removeColumn(*track);
+        delete track;
+        return false;
+    }
+    Track **pp = &_tracks;
+    while ( *pp ) {
+        pp = &(*pp)->next;
+    }
+    *pp = track;
+    ++_track_count;
+    return true;
+} // KssSampledHistory::trackVariable
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+KssSampledHistory::startSampling()
+{
+    if ( _event ) {
+        return true;
+    }
+    _event = new KssSampledHistorySampleEvent(*this);
+    if ( !_event ) {
+        return false;
+    }
+    if ( !KsServerBase::getServerObject().addTimerEvent(_event) ) {
+        delete _event;
+        _event = 0;
+        return false;
+    }
+    return true;
+} // KssSampledHistory::startSampling
+
+
+void
+KssSampledHistory::stopSampling()
+{
+    if ( _event ) {
+        KsServerBase::getServerObject().removeTimerEvent(_event);
+        delete _event;
+        _event = 0;
+    }
+} // KssSampledHistory::stopSampling
+
+
+// ----------------------------------------------------------------------------
+// Take a sample if the history is time-driven or if the value of any of the
+// tracked variables has changed since the last sample.
+//
+bool
+KssSampledHistory::sample(const KsTime &t)
+{
+    if ( (getType() & KS_HT_CHANGE_DRIVEN) && _recorded ) {
+        bool changed = false;
+        for ( Track *track = _tracks; track; track = track->next ) {
+            double value;
+            if ( getNumber(track->var, value) && (value != track->last) ) {
+                changed = true;
+                break;
+            }
+        }
+        if ( !changed ) {
+            return false;
+        }
+    }
+    record(t);
+    return true;
+} // KssSampledHistory::sample
+
+
+// ----------------------------------------------------------------------------
+// Append a new row. If a variable has no numeric value at the moment, its
+// last value is held.
+//
+void
+KssSampledHistory::record(const KsTime &t)
+{
+    for ( Track *track = _tracks; track; track = track->next ) {
+        double value;
+        if ( getNumber(track->var, value) ) {
+            track->last = value;
+        }
+    }
+    appendRow(t);
+    _recorded = true;
+} // KssSampledHistory::record
+
+
+// ----------------------------------------------------------------------------
+//
+KssSampledHistory::Track *
+KssSampledHistory::findTrack(const KsString &part) const
+{
+    for ( Track *track = _tracks; track; track = track->next ) {
+        if ( track->part == part ) {
+            return track;
+        }
+    }
+    return 0;
+} // KssSampledHistory::findTrack
+
+
+// ----------------------------------------------------------------------------
+//
+KS_RESULT
+KssSampledHistory::getSelection(const KsGetHistParams &params,
+                                Selection &selection) const
+{
+    selection.selected = false;
+    selection.ipm = KS_IPM_NONE;
+    selection.encoded = false;
+    for ( size_t i = 0; i < params.items.size(); ++i ) {
+        const KsGetHistItem &item = params.items[i];
+        if ( !item.sel || (item.sel->xdrTypeCode() == KS_HSELT_NONE) ) {
+            continue;
+        }
+        if ( (item.part_id != "t")
+             || (item.sel->xdrTypeCode() != KS_HSELT_TIME) ) {
+            return KS_ERR_BADSELECTOR;
+        }
+        const KsTimeSel *sel = (const KsTimeSel *) item.sel.getPtr();
+        KS_INTERPOLATION_MODE ipm = sel->ip_mode & ~KS_IPM_ENCODED;
+        if ( (ipm != KS_IPM_NONE) && (ipm != KS_IPM_DEFAULT) ) {
+            if ( !KssHistoryAggregator::isSupported(ipm) ) {
+                return KS_ERR_NOTIMPLEMENTED;
+            }
+            selection.ipm = ipm;
+        }
+        selection.encoded = (sel->ip_mode & KS_IPM_ENCODED) != 0;
+        selection.delta = sel->delta;
+        PltTime now(PltTime::now());
+        selection.from = sel->from.isAbsolute() ?
+            (PltTime) sel->from : now + (PltTimeSpan) sel->from;
+        selection.to = sel->to.isAbsolute() ?
+            (PltTime) sel->to : now + (PltTimeSpan) sel->to;
+        selection.selected = true;
+    }
+    return KS_ERR_OK;
+} // KssSampledHistory::getSelection
+
+
+// ----------------------------------------------------------------------------
+//
+void
+KssSampledHistory::encodeItems(KsArray<KsGetHistResultItem> &items)
+{
+    for ( size_t i = 0; i < items.size(); ++i ) {
+        if ( items[i].result == KS_ERR_OK ) {
+            items[i].value = KsHistEncoder::encode(items[i].value);
+        }
+    }
+} // KssSampledHistory::encodeItems
+
+
+// ----------------------------------------------------------------------------
+// The items of a cursor follow the parts requested: the time stamps or the
+// column of a track.
+//
+bool
+KssSampledHistory::initCursor(KssHistoryCursor &cursor,
+                              const KsGetHistParams &params,
+                              size_t rows) const
+{
+    size_t nitems = params.items.size();
+    if ( !cursor.setItemCount(nitems) ) {
+        return false;
+    }
+    for ( size_t i = 0; i < nitems; ++i ) {
+        const KsString &part = params.items[i].part_id;
+        if ( part == "t" ) {
+            cursor.setTimeItem(i);
+        } else {
+            Track *track = findTrack(part);
+            if ( track ) {
+                cursor.setValueItem(i, track->index);
+            } else {
+                cursor.setBadItem(i, KS_ERR_BADPATH);
+            }
+        }
+    }
+    cursor.setRowCount(rows);
+    return true;
+} // KssSampledHistory::initCursor
+
+
+// ----------------------------------------------------------------------------
+// Return the current value of a variable as a double, if it is numeric.
+//
+bool
+KssSampledHistory::getNumber(const KssCommObjectHandle &var, double &value)
+{
+    KsValueHandle hv(((KssVariable *) var.getPtr())->getValue());
+    if ( !hv ) {
+        return false;
+    }
+    switch ( hv->xdrTypeCode() ) {
+    case KS_VT_BOOL:
+        value = (bool) *((KsBoolValue *) hv.getPtr()) ? 1.0 : 0.0;
+        break;
+    case KS_VT_INT:
+        value = (long) *((KsIntValue *) hv.getPtr());
+        break;
+    case KS_VT_UINT:
+        value = (unsigned long) *((KsUIntValue *) hv.getPtr());
+        break;
+    case KS_VT_SINGLE:
+        value = (float) *((KsSingleValue *) hv.getPtr());
+        break;
+    case KS_VT_DOUBLE:
+        value = (double) *((KsDoubleValue *) hv.getPtr());
+        break;
+    default:
+        return false;
+    }
+    return true;
+} // KssSampledHistory::getNumber
+
+/* End of sampledhistory.cpp */
@@ -28,6 +28,7 @@
 #include "plt/log.h"
 
 #include "ks/svrsimpleobjects.h"
+#include "ks/histcursor.h"
 
 
 #if PLT_USE_BUFFERED_STREAMS
@@ -50,6 +51,7 @@ public:
 	DLAS_IO_ERROR_COUNT,
 	DLAS_IO_RX_ERROR_COUNT,
 	DLAS_IO_TX_ERROR_COUNT,
+	DLAS_QUOTA_DROP_COUNT,
 	DLAS_POOL_SIZE,
 	DLAS_POOL_USED,
 	DLAS_THIS_IS_THE_END
@@ -59,6 +61,7 @@ public:
     
     virtual KsValueHandle getValue() const;
     virtual KsTime        getTime() const;
+    virtual KsCurrPropsHandle getCurrProps() const;
 
 protected:
     StatisticType _stat_type;
@@ -77,6 +80,7 @@ static struct {
     { "io_error_count", "number of generic I/O errors during communication", "" },
     { "io_rx_error_count", "number of receiving errors during communication", "" },
     { "io_tx_error_count", "number of sending errors during communication", "" },
+    { "transport_quota_drops", "number of transports dropped for exceeding their memory quota", "" },
     { "transport_pool_size", "size of memory pool for transports", "bytes" },
     { "transport_pool_used", "memory used for active transports", "bytes" }
 }; // _statisticsVariables
@@ -127,6 +131,11 @@ KsValueHandle KssIoStatisticsVariable::getValue() const
 	    KsServerBase::getServerObject().getConnectionManager()->
 	        getIoTxErrorCount());
 	break;
+    case DLAS_QUOTA_DROP_COUNT:
+	pVal = new KsIntValue(
+	    KsServerBase::getServerObject().getConnectionManager()->
+	        getQuotaDropCount());
+	break;
     case DLAS_POOL_SIZE:
 	{
 	    u_int total, freepool;
@@ -158,6 +167,16 @@ KsTime KssIoStatisticsVariable::getTime() const
 } // KssIoStatisticsVariable::getTime
 
 
+// ---------------------------------------------------------------------------
+// The values change behind our back, so never serve them from the current
+// properties cached by KssSimpleVariable.
+//
+KsCurrPropsHandle KssIoStatisticsVariable::getCurrProps() const
+{
+    return KssVariable::getCurrProps();
+} // KssIoStatisticsVariable::getCurrProps
+
+
 // ---------------------------------------------------------------------------
 // Set up the statistical variables below the /vendor
 // domain. Currently, we only populate the C++ Communication Library
@@ -329,6 +348,81 @@ KsSimpleServer::setVar(KsAvTicket &ticket,
 } // KsSimpleServer::setVar
 
 
+// ---------------------------------------------------------------------------
+// An ACPLT/KS client requests to read histories. Every history addressed gets
+// the same selectors and has to fill in its own reply.
+//
+void
+KsSimpleServer::getHist(KsAvTicket &ticket,
+                        const KsGetHistParams &params,
+                        KsGetHistResult &result)
+{
+    result.result = getHistories(ticket, params, result.replies.getPtr(), 0);
+} // KsSimpleServer::getHist
+
+
+// ---------------------------------------------------------------------------
+// Same as getHist(), but histories able to hand out their rows using a
+// cursor don't have to build their replies in memory.
+//
+void
+KsSimpleServer::getHistStreamed(KsAvTicket &ticket,
+                                const KsGetHistParams &params,
+                                KssGetHistStreamResult &result)
+{
+    result.result = getHistories(ticket, params,
+                                 result.replies.getPtr(), &result);
+} // KsSimpleServer::getHistStreamed
+
+
+KS_RESULT
+KsSimpleServer::getHistories(KsAvTicket &ticket,
+                             const KsGetHistParams &params,
+                             KsGetHistSingleResult *replies,
+                             KssGetHistStreamResult *stream)
+{
+    size_t reqsz = params.paths.size();
+    PltArray<KsPath> paths(reqsz);
+    PltArray<KS_RESULT> pathres(reqsz);
+
+    if (    (paths.size() == reqsz)
+         && (pathres.size() == reqsz) ) {
+        KsPath::resolvePaths(params.paths, paths, pathres);
+        for ( size_t i = 0; i < reqsz; ++i ) {
+            KsGetHistSingleResult &single = replies[i];
+            if ( pathres[i] != KS_ERR_OK ) {
+                single.result = pathres[i];
+                continue;
+            }
+            if ( !ticket.canReadVar(KsString(PltString(paths[i]))) ) {
+                single.result = KS_ERR_NOACCESS;
+                continue;
+            }
+            KssCommObjectHandle hobj(_root_domain.getChildByPath(paths[i]));
+            if ( !hobj ) {
+                single.result = KS_ERR_BADPATH;
+            } else if ( hobj->typeCode() == KS_OT_HISTORY ) {
+                KssHistory *hist = (KssHistory *) hobj.getPtr();
+                KssHistoryCursor *cursor =
+                    stream ? hist->openCursor(params) : 0;
+                if ( cursor ) {
+                    cursor->hold(hobj);
+                    stream->setCursor(i, cursor);
+                    single.result = KS_ERR_OK;
+                } else {
+                    hist->getHist(params, single);
+                }
+            } else {
+                single.result = KS_ERR_BADOBJTYPE;
+            }
+        }
+        return KS_ERR_OK;
+    } else {
+        return KS_ERR_GENERIC;
+    }
+} // KsSimpleServer::getHistories
+
+
 // ---------------------------------------------------------------------------
 // Retrieve the value for exactly one variable. This assumes that it does not
 // matter whether one or several variables should be read and performance
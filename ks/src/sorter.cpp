@@ -129,17 +129,7 @@ const KscAvModule *
 KscSorter::findAvModule(const KscVariable *var,
                         const KscAvModule *avm_package)
 {
-    const KscAvModule *temp = var->getAvModule();
-
-    if( temp ) {
-        return temp;
-    } else if( avm_package ) {
-        return avm_package;
-    } else if( (temp = var->getServer()->getAvModule()) ) {
-        return temp;
-    } else {
-        return KscClient::getClient()->getAvModule();
-    }
+    return var->findAvModule(avm_package);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -48,6 +48,7 @@
 #endif
 
 #include "ks/svrbase.h"
+#include "ks/histcursor.h"
 #include "plt/log.h"
 
 #if PLT_DEBUG
@@ -139,12 +140,14 @@ void KsGarbageTimerEvent::trigger()
 // ---------------------------------------------------------------------------
 // This class implements the KssConnectionAttentionInterface and relays all
 // calls for attention to the transport dispatcher of the current ACPLT/KS
-// server object.
+// server object. If the service request has been put on hold, the connection
+// must not be reactivated until the reply has been sent.
 //
 bool KsServerBase::KssAttentionXDRDispatcher::attention(KssConnection &conn)
 {
-    KsServerBase::getServerObject().dispatchTransport((KssXDRConnection &)conn);
-    return true;
+    KssXDRConnection &xcon = (KssXDRConnection &) conn;
+    KsServerBase::getServerObject().dispatchTransport(xcon);
+    return !xcon.takeDeferredReply();
 } // KsServerBase::KssAttentionXDRDispatcher::attention
 
 #endif
@@ -177,6 +180,11 @@ KsServerBase::KsServerBase()
       _shutdown_flag(0),
       _send_buffer_size(16384),
       _receive_buffer_size(16384)
+#if PLT_USE_BUFFERED_STREAMS
+      ,
+      _send_quota(4096 * 1024),   // 4M per reply...
+      _receive_quota(1024 * 1024) // ...and 1M per request
+#endif
 {
     PLT_PRECONDITION( the_server == 0 );
     the_server = this;
@@ -588,6 +596,46 @@ KsServerBase::dispatch(u_long serviceId,
         }
         break;
 
+    case KS_GETHIST:
+        {
+            KsGetHistParams params(xdrIn, decodedOk);
+	    transport.finishRequestDeserialization(ticket, decodedOk);
+            if ( decodedOk ) {
+                // execute service function
+                if ( transport.canStreamReply() ) {
+                    //
+                    // Large histories are streamed, so the reply is
+                    // serialized while it is sent. The transport takes
+                    // over the result.
+                    //
+                    KssGetHistStreamResult *result =
+                        new KssGetHistStreamResult(params.paths.size());
+                    if ( result && result->isValid() ) {
+                        getHistStreamed(ticket, params, *result);
+                        transport.sendStreamedReply(ticket, result);
+                    } else {
+                        // allocation failed
+                        delete result;
+                        transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+                    }
+                    break;
+                }
+                KsGetHistResult result(params.paths.size());
+                if ( result.replies.size() == params.paths.size() ) {
+                    getHist(ticket, params, result);
+                    // send back result
+                    transport.sendReply(ticket, result);
+                } else {
+                    // allocation failed
+                    transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+                }
+            } else {
+                // not properly decoded
+                transport.sendErrorReply(ticket, KS_ERR_GENERIC);
+            }
+        }
+        break;
+
 #endif
     default:
         // 
@@ -642,6 +690,34 @@ KsServerBase::exgData(KsAvTicket &,
 {
     result.result = KS_ERR_NOTIMPLEMENTED;
 } // KsServerBase::exgData
+
+
+void 
+KsServerBase::getHist(KsAvTicket &,
+                      const KsGetHistParams &,
+                      KsGetHistResult & result) 
+{
+    result.result = KS_ERR_NOTIMPLEMENTED;
+} // KsServerBase::getHist
+
+
+void
+KsServerBase::getHistStreamed(KsAvTicket &ticket,
+                              const KsGetHistParams &params,
+                              KssGetHistStreamResult &result)
+{
+    size_t count = params.paths.size();
+    KsGetHistResult plain(count);
+    if ( plain.replies.size() != count ) {
+        result.result = KS_ERR_GENERIC;
+        return;
+    }
+    getHist(ticket, params, plain);
+    result.result = plain.result;
+    for ( size_t i = 0; i < count; ++i ) {
+        result.replies[i] = plain.replies[i];
+    }
+} // KsServerBase::getHistStreamed
 #endif
 
 
@@ -1034,8 +1110,10 @@ KsServerBase::startServer()
 					       _send_buffer_size,
 					       _receive_buffer_size);
 #else
-		_tcp_transport = new KssListenTCPXDRConnection(
-		    sock, 60/* secs */);
+		KssListenTCPXDRConnection *listener =
+		    new KssListenTCPXDRConnection(sock, 60/* secs */);
+		listener->setQuotas(_receive_quota, _send_quota);
+		_tcp_transport = listener;
 #endif
 	    }
 	}
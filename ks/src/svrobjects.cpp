@@ -42,6 +42,7 @@ PLT_IMPL_RTTI0(KssChildrenService);
 PLT_IMPL_RTTI0(KssCommObject);
 PLT_IMPL_RTTI2(KssDomain, KssCommObject, KssChildrenService);
 PLT_IMPL_RTTI2(KssVariable, KssCommObject, KssCurrPropsService);
+PLT_IMPL_RTTI1(KssEncodedVarCurrProps, KsVarCurrProps);
 PLT_IMPL_RTTI3(KssLink, KssCommObject, KssChildrenService, KssCurrPropsService);
 PLT_IMPL_RTTI2(KssHistory, KssCommObject, KssChildrenService);
 
@@ -379,6 +380,94 @@ KssVariable::getCurrProps() const
 } // KssVariable::getCurrProps
 
 
+// ----------------------------------------------------------------------------
+// Create current properties and serialize them at once. As we don't know in
+// advance how large the XDR representation will be, we start with a small
+// buffer and retry with larger ones until the encoding fits or the upper
+// limit is reached. In the latter case we simply don't cache anything.
+//
+KssEncodedVarCurrProps::KssEncodedVarCurrProps(KsValueHandle v,
+                                               const KsTime &t,
+                                               KS_STATE s,
+                                               u_int maxEncodedSize)
+    : KsVarCurrProps(v, t, s),
+      _encoded(0), _encoded_size(0)
+{
+    u_int size;
+    for ( size = 128; size <= maxEncodedSize; size *= 2 ) {
+        char *buffer = new char[size];
+        if ( !buffer ) {
+            return;
+        }
+        XDR xdrs;
+        xdrmem_create(&xdrs, (caddr_t) buffer, size, XDR_ENCODE);
+        bool ok = KsVarCurrProps::xdrEncodeVariant(&xdrs);
+        u_int len = xdr_getpos(&xdrs);
+        xdr_destroy(&xdrs);
+        if ( ok ) {
+            _encoded      = buffer;
+            _encoded_size = len;
+            return;
+        }
+        delete [] buffer;
+    }
+} // KssEncodedVarCurrProps::KssEncodedVarCurrProps
+
+
+KssEncodedVarCurrProps::~KssEncodedVarCurrProps()
+{
+    if ( _encoded ) {
+        delete [] _encoded;
+    }
+} // KssEncodedVarCurrProps::~KssEncodedVarCurrProps
+
+
+// ----------------------------------------------------------------------------
+// Copy the pre-encoded properties into the stream. The XDR representation
+// always comes in multiples of four bytes, so no padding is necessary.
+//
+bool
+KssEncodedVarCurrProps::xdrEncodeVariant(XDR *xdr) const
+{
+    if ( _encoded ) {
+        return XDR_PUTBYTES(xdr, _encoded, _encoded_size) ? true : false;
+    }
+    return KsVarCurrProps::xdrEncodeVariant(xdr);
+} // KssEncodedVarCurrProps::xdrEncodeVariant
+
+
+// ----------------------------------------------------------------------------
+// Values larger than this are not worth the copy, and would otherwise tie up
+// too much memory in the caches.
+//
+u_int KssCurrPropsCache::_max_encoded_size = 16384;
+
+
+// ----------------------------------------------------------------------------
+// Return the cached current properties of a variable, or create and encode
+// them if there are none yet (or they have been invalidated in the mean-
+// time). Like KssVariable::getCurrProps() we return an unbound handle if the
+// variable has no value.
+//
+KsCurrPropsHandle
+KssCurrPropsCache::getCurrProps(const KssVariable &var) const
+{
+    if ( !_hprops ) {
+        KsValueHandle vh(var.getValue());
+        if ( !vh ) {
+            return KsCurrPropsHandle();
+        }
+        KsCurrPropsHandle hprops(new KssEncodedVarCurrProps(vh,
+                                                            var.getTime(),
+                                                            var.getState(),
+                                                            _max_encoded_size),
+                                 KsOsNew);
+        _hprops = hprops;
+    }
+    return _hprops;
+} // KssCurrPropsCache::getCurrProps
+
+
 // ----------------------------------------------------------------------------
 // Set a variable's new value. This just sets the value, but *not* the time-
 // stamp nor state. This is just a convenience function in case no handle is
@@ -243,6 +243,7 @@ KssSimpleVariable::setValue(const KsValueHandle &h)
 {
     if (isWriteable()) {
         _value = h;
+        _curr_props.invalidate();
         return KS_ERR_OK;
     } else {
         return KS_ERR_NOACCESS;
@@ -256,6 +257,7 @@ KssSimpleVariable::setTime(const KsTime &t)
 {
     if (isWriteable()) {
         _time = t;
+        _curr_props.invalidate();
         return KS_ERR_OK;
     } else {
         return KS_ERR_NOACCESS;
@@ -269,6 +271,7 @@ KssSimpleVariable::setState(KS_STATE st)
 {
     if (isWriteable()) {
         _state =  st;
+        _curr_props.invalidate();
         return KS_ERR_OK;
     } else {
         return KS_ERR_NOACCESS;
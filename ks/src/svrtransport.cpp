@@ -185,6 +185,17 @@ void KssTransport::sendReply(KsAvTicket &avt, KsResult &result)
 } // KssTransport::sendReply
 
 
+// ---------------------------------------------------------------------------
+// Send back a streamed result. This transport doesn't support streaming, so
+// the result is just serialized in one go.
+//
+void KssTransport::sendStreamedReply(KsAvTicket &avt, KssStreamedResult *result)
+{
+    sendReply(avt, *result);
+    delete result;
+} // KssTransport::sendStreamedReply
+
+
 // ---------------------------------------------------------------------------
 // Ask for the client's IP address. This then can be used to write it into the
 // AV ticket which then might want to reject the connection.
@@ -253,4 +264,20 @@ void KssTransport::personaNonGrata()
 
 #endif /* !PLT_USE_BUFFERED_STREAMS */
 
+
+// ---------------------------------------------------------------------------
+// Serialize a streamed result in one go for transports which can't stream.
+//
+bool KssStreamedResult::xdrEncode(XDR *xdr) const
+{
+    KssStreamedResult *self = (KssStreamedResult *) this;
+    bool done = false;
+    while ( !done ) {
+	if ( !self->xdrEncodeNext(xdr, (size_t) -1, done) ) {
+	    return false;
+	}
+    }
+    return true;
+} // KssStreamedResult::xdrEncode
+
 /* End of svrtransport.cpp */
@@ -0,0 +1,437 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+//////////////////////////////////////////////////////////////////////
+
+#include "ks/valuecache.h"
+
+//////////////////////////////////////////////////////////////////////
+
+KscValueCache::KscValueCache(size_t buckets,
+                             size_t maxEntries,
+                             const PltTimeSpan &maxAge)
+: _bucket_count(buckets ? buckets : 1),
+  _oldest(0),
+  _newest(0),
+  _value_count(0),
+  _max_entries(maxEntries),
+  _max_age(maxAge)
+{
+    _buckets = new Entry *[_bucket_count];
+    if ( !_buckets ) {
+        _bucket_count = 0;
+    }
+    for ( size_t i = 0; i < _bucket_count; ++i ) {
+        _buckets[i] = 0;
+    }
+    resetStatistics();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+KscValueCache::~KscValueCache()
+{
+    clear();
+    delete [] _buckets;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscValueCache::setLimits(size_t maxEntries, const PltTimeSpan &maxAge)
+{
+    PltMutexLock lock(_mutex);
+    _max_entries = maxEntries;
+    _max_age = maxAge;
+    trim();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscValueCache::getLimits(size_t &maxEntries, PltTimeSpan &maxAge) const
+{
+    PltMutexLock lock(_mutex);
+    maxEntries = _max_entries;
+    maxAge = _max_age;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Find the entry for a variable read with a particular A/V module.
+// Like the other helpers below, this must be called with the mutex
+// locked.
+//
+KscValueCache::Entry *
+KscValueCache::find(const KscAvModule *avm, const KsString &key)
+{
+    if( !_bucket_count ) {
+        return 0;
+    }
+    Entry *entry;
+    for( entry = _buckets[key.hash() % _bucket_count];
+         entry;
+         entry = entry->next ) {
+        if( entry->avm == avm && entry->key == key ) {
+            return entry;
+        }
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+KscValueCache::Entry *
+KscValueCache::create(const KscAvModule *avm, const KsString &key)
+{
+    if( !_bucket_count ) {
+        return 0;
+    }
+    Entry *entry = new Entry;
+    if( entry ) {
+        Entry **bucket = &_buckets[key.hash() % _bucket_count];
+        entry->avm = avm;
+        entry->key = key;
+        entry->older = 0;
+        entry->newer = 0;
+        entry->encoded = 0;
+        entry->encoded_size = 0;
+        entry->fetching = false;
+        entry->next = *bucket;
+        *bucket = entry;
+    }
+    return entry;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Unlink an entry from its bucket and get rid of it.
+//
+void
+KscValueCache::remove(Entry *entry)
+{
+    Entry **link = &_buckets[entry->key.hash() % _bucket_count];
+    while( *link != entry ) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    setValue(*entry, 0);
+    delete entry;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Drop the oldest values until we're within our limits again. As the
+// values are kept in the order they were stored in, the expired ones
+// are all found at the old end. Entries being fetched just lose their
+// value, for their fetchers will complete them later on.
+//
+void
+KscValueCache::trim()
+{
+    PltTime now(PltTime::now());
+    while( _oldest
+           && (_value_count > _max_entries
+               || _oldest->time + _max_age < now) ) {
+        Entry *entry = _oldest;
+        if( entry->fetching ) {
+            setValue(*entry, 0);
+        } else {
+            remove(entry);
+        }
+        ++_stats.evictions;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscValueCache::isFresh(const Entry &entry, const PltTimeSpan &maxAge) const
+{
+    PltTime now(PltTime::now());
+    return entry.encoded
+        && (now <= entry.time + maxAge)
+        && (now <= entry.time + _max_age);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+bool
+KscValueCache::decode(const Entry &entry, KsVarCurrProps &props) const
+{
+    XDR xdrs;
+    xdrmem_create(&xdrs, (caddr_t) entry.encoded, entry.encoded_size,
+                  XDR_DECODE);
+    bool ok = props.xdrDecode(&xdrs);
+    xdr_destroy(&xdrs);
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Replace the value of an entry. As we don't know in advance how large
+// the XDR representation will be, we start with a small buffer and
+// retry with larger ones until the encoding fits. If that doesn't work
+// out, the entry is left without a value. Entries with a value are
+// kept in the list of values, the one stored last being the newest.
+//
+void
+KscValueCache::setValue(Entry &entry, const KsVarCurrProps *props)
+{
+    if( entry.encoded ) {
+        if( entry.older ) {
+            entry.older->newer = entry.newer;
+        } else {
+            _oldest = entry.newer;
+        }
+        if( entry.newer ) {
+            entry.newer->older = entry.older;
+        } else {
+            _newest = entry.older;
+        }
+        entry.older = 0;
+        entry.newer = 0;
+        --_value_count;
+
+        delete [] entry.encoded;
+        entry.encoded = 0;
+        entry.encoded_size = 0;
+    }
+
+    if( !props ) {
+        return;
+    }
+    for( u_int size = 128; size <= (1 << 24); size *= 2 ) {
+        char *buffer = new char[size];
+        if( !buffer ) {
+            return;
+        }
+        XDR xdrs;
+        xdrmem_create(&xdrs, (caddr_t) buffer, size, XDR_ENCODE);
+        bool ok = props->xdrEncode(&xdrs);
+        u_int len = xdr_getpos(&xdrs);
+        xdr_destroy(&xdrs);
+        if( ok ) {
+            entry.encoded = buffer;
+            entry.encoded_size = len;
+            entry.time = PltTime::now();
+            entry.older = _newest;
+            if( _newest ) {
+                _newest->newer = &entry;
+            } else {
+                _oldest = &entry;
+            }
+            _newest = &entry;
+            ++_value_count;
+            ++_stats.stores;
+            return;
+        }
+        delete [] buffer;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Look up the value of a variable which must not be older than maxAge.
+// If it isn't in the cache and nobody is fetching it yet, the caller
+// has to do so.
+//
+KscValueCache::Status
+KscValueCache::lookup(const KscAvModule *avm, const KsString &key,
+                      const PltTimeSpan &maxAge, KsVarCurrProps &props)
+{
+    PltMutexLock lock(_mutex);
+
+    trim();
+    Entry *entry = find(avm, key);
+    if( !entry ) {
+        entry = create(avm, key);
+    }
+    if( !entry ) {
+        //
+        // Out of memory, so we can't coordinate the fetch. Just go
+        // ahead.
+        //
+        ++_stats.misses;
+        return FETCH;
+    }
+    if( isFresh(*entry, maxAge) && decode(*entry, props) ) {
+        ++_stats.hits;
+        return FRESH;
+    }
+    if( entry->fetching ) {
+        return BUSY;
+    }
+    entry->fetching = true;
+    ++_stats.misses;
+    return FETCH;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Wait until whoever fetches the value of a variable is done. If the
+// fetch failed, or the value is too old for us, it's our turn now.
+// The entry may go away while we're waiting, so look it up afresh
+// every time we wake up.
+//
+KscValueCache::Status
+KscValueCache::wait(const KscAvModule *avm, const KsString &key,
+                    const PltTimeSpan &maxAge, KsVarCurrProps &props)
+{
+    PltMutexLock lock(_mutex);
+
+    Entry *entry;
+    while( (entry = find(avm, key)) && entry->fetching ) {
+        if( !_fetched.wait(_mutex) ) {
+            break;
+        }
+    }
+    if( !entry ) {
+        entry = create(avm, key);
+        if( !entry ) {
+            ++_stats.misses;
+            return FETCH;
+        }
+    }
+    if( isFresh(*entry, maxAge) && decode(*entry, props) ) {
+        ++_stats.coalesced;
+        return FRESH;
+    }
+    entry->fetching = true;
+    ++_stats.misses;
+    return FETCH;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscValueCache::complete(const KscAvModule *avm, const KsString &key,
+                        const KsVarCurrProps *props)
+{
+    PltMutexLock lock(_mutex);
+
+    Entry *entry = find(avm, key);
+    if( !entry && props ) {
+        entry = create(avm, key);
+    }
+    if( entry ) {
+        if( props ) {
+            setValue(*entry, props);
+        }
+        entry->fetching = false;
+        if( !entry->encoded ) {
+            remove(entry);
+        }
+    }
+    trim();
+    _fetched.broadcast();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscValueCache::store(const KscAvModule *avm, const KsString &key,
+                     const KsVarCurrProps &props)
+{
+    PltMutexLock lock(_mutex);
+
+    Entry *entry = find(avm, key);
+    if( !entry ) {
+        entry = create(avm, key);
+    }
+    if( entry ) {
+        setValue(*entry, &props);
+        if( !entry->encoded && !entry->fetching ) {
+            remove(entry);
+        }
+    }
+    trim();
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscValueCache::invalidate(const KsString &key)
+{
+    PltMutexLock lock(_mutex);
+
+    if( !_bucket_count ) {
+        return;
+    }
+    Entry *entry = _buckets[key.hash() % _bucket_count];
+    while( entry ) {
+        Entry *next = entry->next;
+        if( entry->key == key ) {
+            if( entry->encoded ) {
+                ++_stats.invalidations;
+            }
+            if( entry->fetching ) {
+                setValue(*entry, 0);
+            } else {
+                remove(entry);
+            }
+        }
+        entry = next;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Throw away all values. Entries being fetched are kept, as their
+// fetchers will complete them later on.
+//
+void
+KscValueCache::clear()
+{
+    PltMutexLock lock(_mutex);
+
+    for( size_t i = 0; i < _bucket_count; ++i ) {
+        Entry *entry = _buckets[i];
+        while( entry ) {
+            Entry *next = entry->next;
+            if( entry->fetching ) {
+                setValue(*entry, 0);
+            } else {
+                remove(entry);
+            }
+            entry = next;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscValueCache::getStatistics(Statistics &stats) const
+{
+    PltMutexLock lock(_mutex);
+    stats = _stats;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void
+KscValueCache::resetStatistics()
+{
+    PltMutexLock lock(_mutex);
+    _stats.hits = 0;
+    _stats.misses = 0;
+    _stats.coalesced = 0;
+    _stats.stores = 0;
+    _stats.invalidations = 0;
+    _stats.evictions = 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+// EOF valuecache.cpp
+//////////////////////////////////////////////////////////////////////
@@ -117,6 +117,20 @@ KscTypedVar::getUpdate()
 
 //////////////////////////////////////////////////////////////////////
 
+bool
+KscTypedVar::getUpdate(const PltTimeSpan &maxAge) 
+{
+    bool ok = KscVariable::getUpdate(maxAge);
+
+    if(ok) {
+        ok &= checkType();
+    }
+
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////
+
 bool
 KscTypedVar::setCurrProps(KsVarCurrProps &cp) 
 {
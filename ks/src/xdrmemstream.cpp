@@ -33,6 +33,7 @@
 #if PLT_USE_BUFFERED_STREAMS
 
 #include "ks/xdrmemstream.h"
+#include "plt/thread.h"
 #include <stdlib.h>
 
 #if PLT_SYSTEM_NT
@@ -66,6 +67,10 @@
 #include <unistd.h>
 #include <errno.h>
 
+#if PLT_USE_WRITEV && !PLT_USE_XTI
+#include <sys/uio.h>
+#endif
+
 #if PLT_SYSTEM_OPENVMS
 #include <string.h>
 #endif
@@ -77,10 +82,20 @@
 #endif
 
 /* ---------------------------------------------------------------------------
- * Some constants which control default settings of the fragment (pool)
+ * Some constants which control default settings of the fragment (pool).
+ * Fragments come in FRAGMENTCLASSES size classes, each one twice as large
+ * as the one before. The smallest class is the configured fragment size
+ * divided by FRAGMENTCLASSDIVISOR, but not less than MINFRAGMENTSIZE.
  */
 #define MINFRAGMENTSIZE 256
 #define DEFAULTFRAGMENTSIZE 8192
+#define FRAGMENTCLASSES 8
+#define FRAGMENTCLASSDIVISOR 8
+
+/* ---------------------------------------------------------------------------
+ * At most this many fragments are handed to a single writev().
+ */
+#define MAXIOVECS 16
 
 /* ---------------------------------------------------------------------------
  * The information contained in a XDR memory stream is split up and
@@ -90,6 +105,7 @@
 typedef struct MemoryStreamFragmentTag {
     struct MemoryStreamFragmentTag *next;  /* next fragment in chain           */
     u_int                           used;  /* # of bytes used in this fragment */
+    u_int                      sizeclass;  /* size class of this fragment      */
     double                          dummy; /* -- just for alignment --         */
 } MemoryStreamFragment;
 
@@ -106,54 +122,254 @@ typedef struct {
     MemoryStreamFragment *first;   /* points to first fragment in chain   */
     MemoryStreamFragment *current; /* points to current fragment in chain */
     u_int                 fragment_count; /* # of allocated fragments     */
+    u_int                 capacity; /* total size of all fragments        */
     u_int                 length;
+    u_int                 limit;    /* max. capacity or 0 for unlimited   */
+    bool_t                overlimit; /* limit was hit since last clear    */
 } MemoryStreamInfo;
 
 
+/* ---------------------------------------------------------------------------
+ * Free fragments are kept in simple lists per size class, one set shared by
+ * all threads and one set private to each thread. Each thread recycles
+ * fragments through its private lists without any locking. If such a list
+ * grows beyond its limit (THREADCACHEFRAGMENTS for the smallest class, and
+ * less for the larger ones), then half of it is spilled into the shared
+ * pool, and a thread running out of fragments refills its private list
+ * from the shared pool in batches.
+ */
+#define THREADCACHEFRAGMENTS 16
+#define THREADCACHELIMIT(c) \
+    ((THREADCACHEFRAGMENTS >> (c)) > 2 ? (THREADCACHEFRAGMENTS >> (c)) : 2)
+
+typedef struct {
+    MemoryStreamFragment *list;  /* singly linked list of free fragments */
+    u_int                 count; /* # of fragments in this list          */
+} MemoryStreamFragmentList;
+
+typedef struct MemoryStreamThreadPoolTag {
+    struct MemoryStreamThreadPoolTag *next;   /* next thread pool in registry */
+    MemoryStreamFragmentList          cached[FRAGMENTCLASSES];
+                                              /* fragments cached by thread   */
+    volatile unsigned long            allocated; /* fragments handed out...   */
+    volatile unsigned long            released;  /* ...and given back         */
+} MemoryStreamThreadPool;
+
+
 /* ---------------------------------------------------------------------------
  * The following variables hold some module-wide information about the
  * free fragments, fragment size (thus configurable at run-time), memory
  * usage and other unimportant things. You should only set them *BEFORE*
  * creating the first XDR dynamic stream, or you�ll be in deep trouble, pal.
+ * The shared pool and the registry of thread pools are protected by the
+ * pool lock, while the fragment counts are maintained using atomic
+ * operations. Quota and watermark are kept in units of the smallest
+ * fragment size class, so a fragment of class c accounts for 2^c units.
  */
 static u_int MemStreamBufferSize      = DEFAULTFRAGMENTSIZE;
-static MemoryStreamFragment *FreeList = 0;
-static u_int FragmentCount            = 0; /* total number = used + free */
-static u_int FreeFragmentCount        = 0; /* number of free fragments   */
+static u_int MemStreamClassSize       = DEFAULTFRAGMENTSIZE
+                                        / FRAGMENTCLASSDIVISOR;
+static PltMutex PoolLock;
+static MemoryStreamFragmentList SharedPool[FRAGMENTCLASSES];
+static MemoryStreamThreadPool *ThreadPools = 0;
+static volatile long FragmentCount    = 0; /* total number = used + free */
+static volatile long FragmentUnits    = 0; /* same, but in units         */
 static u_int FragmentQuota            = (u_int) -1;
 static u_int FragmentWatermark        = 0;
 static u_int FreePercentage           = 50;
 
+static PLT_THREAD_LOCAL MemoryStreamThreadPool *MyThreadPool = 0;
+
+#define FRAGMENTHEADERBYTES \
+    (sizeof(MemoryStreamFragment) - sizeof(double))
+#define FRAGMENTSIZE(c)  (MemStreamClassSize << (c))
+#define FRAGMENTBYTES(c) (FRAGMENTHEADERBYTES + FRAGMENTSIZE(c))
+#define FRAGMENTUNITS(c) (1u << (c))
+
+
+/* ---------------------------------------------------------------------------
+ * Move up to count fragments from the head of one free list to another one.
+ */
+static void MoveFragments(MemoryStreamFragmentList *from,
+                          MemoryStreamFragmentList *to, u_int count)
+{
+    MemoryStreamFragment *fragment;
+
+    for ( ; count && from->list; --count ) {
+	fragment       = from->list;
+	from->list     = fragment->next;
+	--from->count;
+	fragment->next = to->list;
+	to->list       = fragment;
+	++to->count;
+    }
+} /* MoveFragments */
+
+
+/* ---------------------------------------------------------------------------
+ * Sum up the memory held by a set of free lists, in bytes.
+ */
+static u_int FreeListBytes(MemoryStreamFragmentList *lists)
+{
+    u_int bytes = 0;
+    u_int c;
+
+    for ( c = 0; c < FRAGMENTCLASSES; ++c ) {
+	bytes += lists[c].count * FRAGMENTBYTES(c);
+    }
+    return bytes;
+} /* FreeListBytes */
+
+
+/* ---------------------------------------------------------------------------
+ * Give the fragments cached by the current thread back to the shared pool
+ * and forget about the thread. This happens automatically when a thread
+ * terminates (at least with POSIX threads), but can also be called
+ * explicitly by threads which are about to end their life.
+ */
+void xdrmemstream_thread_exit()
+{
+    MemoryStreamThreadPool *pool = MyThreadPool;
+    MemoryStreamThreadPool **pp;
+    u_int                   c;
+
+    if ( !pool ) {
+	return;
+    }
+    MyThreadPool = 0;
+
+    PltMutexLock lock(PoolLock);
+    for ( c = 0; c < FRAGMENTCLASSES; ++c ) {
+	MoveFragments(&pool->cached[c], &SharedPool[c], pool->cached[c].count);
+    }
+    for ( pp = &ThreadPools; *pp; pp = &(*pp)->next ) {
+	if ( *pp == pool ) {
+	    *pp = pool->next;
+	    break;
+	}
+    }
+    free(pool);
+} /* xdrmemstream_thread_exit */
+
+
+#if PLT_USE_THREADS && !PLT_SYSTEM_NT
+static pthread_key_t  ThreadPoolKey;
+static pthread_once_t ThreadPoolOnce = PTHREAD_ONCE_INIT;
+
+static void ThreadPoolDestructor(void *)
+{
+    xdrmemstream_thread_exit();
+} /* ThreadPoolDestructor */
+
+static void ThreadPoolMakeKey()
+{
+    pthread_key_create(&ThreadPoolKey, ThreadPoolDestructor);
+} /* ThreadPoolMakeKey */
+#endif
+
+
+/* ---------------------------------------------------------------------------
+ * Return the fragment pool of the current thread, creating and registering
+ * it on first use. Returns a null pointer if we're running out of memory.
+ */
+static MemoryStreamThreadPool *GetThreadPool()
+{
+    MemoryStreamThreadPool *pool = MyThreadPool;
+    u_int                   c;
+
+    if ( pool ) {
+	return pool;
+    }
+    pool = (MemoryStreamThreadPool *) malloc(sizeof(MemoryStreamThreadPool));
+    if ( !pool ) {
+	return 0;
+    }
+    for ( c = 0; c < FRAGMENTCLASSES; ++c ) {
+	pool->cached[c].list  = 0;
+	pool->cached[c].count = 0;
+    }
+    pool->allocated = 0;
+    pool->released  = 0;
+    {
+	PltMutexLock lock(PoolLock);
+	pool->next  = ThreadPools;
+	ThreadPools = pool;
+    }
+    MyThreadPool = pool;
+#if PLT_USE_THREADS && !PLT_SYSTEM_NT
+    pthread_once(&ThreadPoolOnce, ThreadPoolMakeKey);
+    pthread_setspecific(ThreadPoolKey, pool);
+#endif
+    return pool;
+} /* GetThreadPool */
+
 
 /* ---------------------------------------------------------------------------
  * Return memory (fragment) usage information. The information returned is
- * in bytes.
+ * in bytes. The free pool includes the fragments cached by all threads.
  */
 void xdrmemstream_getusage(u_int *total, u_int *freepool)
 {
     if ( total ) {
-        *total = FragmentCount * (MemStreamBufferSize + 
-                                  sizeof(MemoryStreamFragment) -
-                                  sizeof(double));
+        *total = (u_int) FragmentUnits * MemStreamClassSize
+                 + (u_int) FragmentCount * FRAGMENTHEADERBYTES;
     }
     if ( freepool ) {
-        *freepool = FreeFragmentCount * (MemStreamBufferSize +
-                                         sizeof(MemoryStreamFragment) -
-                                         sizeof(double));
+	MemoryStreamThreadPool *pool;
+	u_int                   bytes;
+
+	PltMutexLock lock(PoolLock);
+	bytes = FreeListBytes(SharedPool);
+	for ( pool = ThreadPools; pool; pool = pool->next ) {
+	    bytes += FreeListBytes(pool->cached);
+	}
+        *freepool = bytes;
     }
 } /* xdrmemstream_getusage */
 
 
+/* ---------------------------------------------------------------------------
+ * Return per-thread usage information, similar to xdrmemstream_get_fragments:
+ * if desc is not null, up to *thread_count descriptions are filled in. On
+ * return, *thread_count is set to the number of threads currently owning a
+ * fragment pool. The figures of other threads are only snapshots, as they
+ * are changing while we're looking at them.
+ */
+void xdrmemstream_getthreadusage(xdrmemstream_thread_usage *desc,
+                                 unsigned long *thread_count)
+{
+    MemoryStreamThreadPool *pool;
+    unsigned long           count = 0;
+    unsigned long           avail_count = desc ? *thread_count : 0;
+
+    PltMutexLock lock(PoolLock);
+    for ( pool = ThreadPools; pool; pool = pool->next, ++count ) {
+	if ( count < avail_count ) {
+	    desc[count].current   = (pool == MyThreadPool);
+	    desc[count].freepool  = FreeListBytes(pool->cached);
+	    desc[count].allocated = pool->allocated;
+	    desc[count].released  = pool->released;
+	}
+    }
+    *thread_count = count;
+} /* xdrmemstream_getthreadusage */
+
+
 /* ---------------------------------------------------------------------------
  * Set the size of memory fragments, the watermark and the percentage of
  * fragments to free for each freegarbage() step. The watermark indicates the
  * amount of fragments which aren�t free. While fragmentsize is in bytes, the
  * watermark is in fragments and the freepercentage is in percent (100 = 100%)
  * quota is the maximum of fragments that can be allocated at any time.
+ * As fragments now come in different sizes, quota and watermark are measured
+ * in fragments of fragmentsize bytes, and fragmentsize determines the size
+ * classes.
  */
 bool_t xdrmemstream_controlusage(u_int fragmentsize, u_int quota,
 	                         u_int watermark, u_int freepercentage)
 {
+    u_int classsize, units;
+
     /*
      * Make sure that the fragment size can not be changed after the first
      * fragments have been allocated.
@@ -165,9 +381,19 @@ bool_t xdrmemstream_controlusage(u_int fragmentsize, u_int quota,
     if ( fragmentsize < MINFRAGMENTSIZE ) {
 	fragmentsize = MINFRAGMENTSIZE;
     }
+    classsize = fragmentsize / FRAGMENTCLASSDIVISOR;
+    if ( classsize < MINFRAGMENTSIZE ) {
+	classsize = MINFRAGMENTSIZE;
+    }
+    classsize = (classsize + 7) & ~7; /* keep everything nicely aligned */
+    units = fragmentsize / classsize;
+
     MemStreamBufferSize = fragmentsize;
-    FragmentQuota       = quota;
-    FragmentWatermark   = watermark;
+    MemStreamClassSize  = classsize;
+    FragmentQuota       = (quota > ((u_int) -1) / units) ?
+	                      (u_int) -1 : quota * units;
+    FragmentWatermark   = (watermark > ((u_int) -1) / units) ?
+	                      (u_int) -1 : watermark * units;
     FreePercentage      = freepercentage;
     return true;
 } /* xdrmemstream_controlusage */
@@ -175,19 +401,58 @@ bool_t xdrmemstream_controlusage(u_int fragmentsize, u_int quota,
 
 /* ---------------------------------------------------------------------------
  * Allocate a new fragment and add it at the end of the list of fragments
- * of a XDR stream. The read/write pointer etc. is updated too.
+ * of a XDR stream. The read/write pointer etc. is updated too. The first
+ * fragment of a stream is taken from the smallest size class, and every
+ * following fragment from the next larger one. This way, the fragment
+ * size grows with the message: small replies don't waste memory, while
+ * large ones don't end up in long chains of small fragments.
  */
 static MemoryStreamFragment *AllocateMemoryStreamFragment(XDR *xdrs)
 {
-    MemoryStreamFragment *fragment;
+    MemoryStreamInfo       *info = (MemoryStreamInfo *) xdrs->x_base;
+    MemoryStreamFragment   *fragment;
+    MemoryStreamThreadPool *pool = GetThreadPool();
+    u_int                   c = 0;
 
-    if ( FreeList ) {
+    if ( !pool ) {
+	return 0;
+    }
+    if ( info->current ) {
+	c = info->current->sizeclass + 1;
+	if ( c >= FRAGMENTCLASSES ) {
+	    c = FRAGMENTCLASSES - 1;
+	}
+    }
+    if ( info->limit ) {
+	/*
+	 * The stream is limited in size, so fall back to smaller fragments
+	 * when getting close to the limit, and refuse to grow any further
+	 * if even the smallest one won't fit.
+	 */
+	while ( c && (info->capacity + FRAGMENTSIZE(c) > info->limit) ) {
+	    --c;
+	}
+	if ( info->capacity + FRAGMENTSIZE(c) > info->limit ) {
+	    info->overlimit = TRUE;
+	    return 0;
+	}
+    }
+    if ( !pool->cached[c].list ) {
+	/*
+	 * Our own cache is empty, but other threads might have left some
+	 * fragments in the shared pool. Grab a batch of them.
+	 */
+	PltMutexLock lock(PoolLock);
+	MoveFragments(&SharedPool[c], &pool->cached[c],
+		      THREADCACHELIMIT(c) / 2);
+    }
+    if ( pool->cached[c].list ) {
 	/*
 	 * There are still old fragments around, so we're recycling them.
 	 */
-	fragment = FreeList;
-	FreeList = FreeList->next;
-        --FreeFragmentCount;
+	fragment             = pool->cached[c].list;
+	pool->cached[c].list = fragment->next;
+        --pool->cached[c].count;
     } else {
 	/*
 	 * We don't have a fragment at hand, so we must allocate a new one.
@@ -199,70 +464,120 @@ static MemoryStreamFragment *AllocateMemoryStreamFragment(XDR *xdrs)
 	 * beginning with this memory cell.
 	 * But first check for our quotas...
 	 */
-	if ( FragmentCount >= FragmentQuota ) {
+	if ( (u_int) PltAtomic::add(&FragmentUnits, FRAGMENTUNITS(c))
+	         > FragmentQuota ) {
+	    PltAtomic::add(&FragmentUnits, -(long) FRAGMENTUNITS(c));
 	    return 0;
 	}
-	fragment = (MemoryStreamFragment *)
-	               malloc(sizeof(MemoryStreamFragment) - sizeof(double)
-			   + MemStreamBufferSize);
-        ++FragmentCount;
-    }
-    if ( fragment ) {
-	/*
-	 * If we got a fragment, then we'll add it at the end of the
-	 * fragment list for this stream. In addition, the read/write
-	 * pointer and the length information is updated.
-	 */
-	if ( ((MemoryStreamInfo *) xdrs->x_base)->current ) {
-	    ((MemoryStreamInfo *) xdrs->x_base)->current->next = fragment;
+	fragment = (MemoryStreamFragment *) malloc(FRAGMENTBYTES(c));
+	if ( !fragment ) {
+	    PltAtomic::add(&FragmentUnits, -(long) FRAGMENTUNITS(c));
+	    return 0;
 	}
-	((MemoryStreamInfo *) xdrs->x_base)->current = fragment;
-	xdrs->x_private = (caddr_t) &(fragment->dummy);
-	xdrs->x_handy   = MemStreamBufferSize;
-	fragment->next  = 0;
-	fragment->used  = MemStreamBufferSize; /* this is only a forecast !! */
-        /*
-         * Update the statistics too...
-         */
-        ++((MemoryStreamInfo *) xdrs->x_base)->fragment_count;
+	fragment->sizeclass = c;
+	PltAtomic::add(&FragmentCount, 1);
+    }
+    ++pool->allocated;
+    /*
+     * As we got a fragment, we'll add it at the end of the
+     * fragment list for this stream. In addition, the read/write
+     * pointer and the length information is updated.
+     */
+    if ( info->current ) {
+	info->current->next = fragment;
     }
+    info->current   = fragment;
+    xdrs->x_private = (caddr_t) &(fragment->dummy);
+    xdrs->x_handy   = FRAGMENTSIZE(c);
+    fragment->next  = 0;
+    fragment->used  = FRAGMENTSIZE(c); /* this is only a forecast !! */
+    /*
+     * Update the statistics too...
+     */
+    ++info->fragment_count;
+    info->capacity += FRAGMENTSIZE(c);
     return fragment;
 } /* AllocateMemoryStreamFragment */
 
 
 /* ---------------------------------------------------------------------------
  * Free a fragment. Usually this will only result in the fragment
- * being put to the head of the free fragment list.
+ * being put to the head of the free fragment list of the current thread.
+ * If that list gets too long, we're spilling half of it into the shared
+ * pool, so other threads can pick them up.
  */
 static void FreeMemoryStreamFragment(MemoryStreamFragment *fragment)
 {
-    if ( fragment ) {
-	fragment->next = FreeList;
-	FreeList       = fragment;
-        ++FreeFragmentCount;
+    MemoryStreamThreadPool *pool;
+    u_int                   c;
+
+    if ( !fragment ) {
+	return;
+    }
+    c = fragment->sizeclass;
+    pool = GetThreadPool();
+    if ( !pool ) {
+	/*
+	 * We can't even get a cache for this thread, so hand the fragment
+	 * directly over to the shared pool.
+	 */
+	PltMutexLock lock(PoolLock);
+	fragment->next     = SharedPool[c].list;
+	SharedPool[c].list = fragment;
+	++SharedPool[c].count;
+	return;
+    }
+    fragment->next       = pool->cached[c].list;
+    pool->cached[c].list = fragment;
+    ++pool->cached[c].count;
+    ++pool->released;
+    if ( pool->cached[c].count > THREADCACHELIMIT(c) ) {
+	PltMutexLock lock(PoolLock);
+	MoveFragments(&pool->cached[c], &SharedPool[c],
+		      THREADCACHELIMIT(c) / 2);
     }
 } /* FreeMemoryStreamFragment */
 
 
 /* ---------------------------------------------------------------------------
  * Free up left-over free fragments which are currently lurking around in the
- * free list.
+ * shared pool. The fragments cached by the calling thread are handed over to
+ * the shared pool first, so they can be collected too. Caches of other threads
+ * are left alone, but they're limited to THREADCACHEFRAGMENTS anyway. We're
+ * freeing the large fragments first, but never more than the requested
+ * amount, so the free pool doesn't fall below the watermark.
  */
 void xdrmemstream_freegarbage()
 {
-    if ( FreeFragmentCount > FragmentWatermark ) {
+    MemoryStreamThreadPool *pool = MyThreadPool;
+    u_int                   freeUnits = 0;
+    int                     c;
+
+    PltMutexLock lock(PoolLock);
+    for ( c = 0; c < FRAGMENTCLASSES; ++c ) {
+	if ( pool ) {
+	    MoveFragments(&pool->cached[c], &SharedPool[c],
+			  pool->cached[c].count);
+	}
+	freeUnits += SharedPool[c].count * FRAGMENTUNITS(c);
+    }
+    if ( freeUnits > FragmentWatermark ) {
 	MemoryStreamFragment *fragment;
-	u_int toFree = ((FreeFragmentCount - FragmentWatermark)
+	u_int toFree = ((freeUnits - FragmentWatermark)
 		          * FreePercentage) / 100;
 	if ( toFree == 0 ) {
-	    toFree = FreeFragmentCount - FragmentWatermark;
+	    toFree = freeUnits - FragmentWatermark;
 	}
-	for ( ; toFree; --toFree ) {
-	    fragment = FreeList;
-	    FreeList = fragment->next;
-	    free(fragment);
-	    --FreeFragmentCount;
-	    --FragmentCount;
+	for ( c = FRAGMENTCLASSES - 1; c >= 0; --c ) {
+	    while ( SharedPool[c].list && (FRAGMENTUNITS(c) <= toFree) ) {
+		fragment           = SharedPool[c].list;
+		SharedPool[c].list = fragment->next;
+		free(fragment);
+		--SharedPool[c].count;
+		toFree -= FRAGMENTUNITS(c);
+		PltAtomic::add(&FragmentCount, -1);
+		PltAtomic::add(&FragmentUnits, -(long) FRAGMENTUNITS(c));
+	    }
     	}
     }
 } /* xdrmemstream_freegarbage */
@@ -313,6 +628,16 @@ static bool_t AdvanceToNextFragment(XDR *xdrs)
 #define PLT_CONST
 #endif
 
+/*
+ * libtirpc dropped the const from the x_getpostn() signature, which
+ * the glibc ONC/RPC still has.
+ */
+#if PLT_SYSTEM_LINUX && !defined(_TIRPC_XDR_H)
+#define PLT_CONST_GETPOS const
+#else
+#define PLT_CONST_GETPOS
+#endif
+
 
 
 #ifdef PLT_RUNTIME_GLIBC
@@ -331,7 +656,7 @@ static bool_t MemStreamGetLong(XDR *xdrs, long *lp);
 static bool_t MemStreamPutLong(XDR *xdrs, PLT_CONST long *lp);
 static bool_t MemStreamGetBytes(XDR *xdrs, caddr_t addr, u_int len);
 static bool_t MemStreamPutBytes(XDR *xdrs, PLT_CONST caddr_t caddr, u_int len);
-static u_int  MemStreamGetPos(PLT_CONST XDR *xdrs);
+static u_int  MemStreamGetPos(PLT_CONST_GETPOS XDR *xdrs);
 static bool_t MemStreamSetPos(XDR *xdrs, u_int pos);
 static XDR_INLINE_PTR MemStreamInline(XDR *xdrs, int len);
 static void   MemStreamDestroy(XDR *xdrs);
@@ -400,7 +725,7 @@ static
     FUNC(bool_t,(XDR*,PLT_CONST long*)) MemStreamPutLong,   /* store a 32 bit integer in host order         */
     FUNC(bool_t,(XDR*,caddr_t,u_int)) MemStreamGetBytes,  /* retrieve some octets (multiple of 4)         */
     FUNC(bool_t,(XDR*,PLT_CONST char *,u_int)) MemStreamPutBytes,  /* store some octets (multiple of 4)            */
-    FUNC(u_int,(PLT_CONST XDR*)) MemStreamGetPos,    /* */
+    FUNC(u_int,(PLT_CONST_GETPOS XDR*)) MemStreamGetPos,    /* */
     FUNC(bool_t,(XDR*,u_int)) MemStreamSetPos,    /* */
     FUNC(XDR_INLINE_PTR,(XDR*,PLT_MEMSTREAMINLINE_LEN)) MemStreamInline,    /* get some space in the buffer for fast access */
     FUNC(void,(XDR*)) MemStreamDestroy    /* clean up the mess                            */
@@ -447,6 +772,9 @@ bool_t xdrmemstream_create(XDR *xdrs)
      */
     info->current        = 0;
     info->fragment_count = 0;
+    info->capacity       = 0;
+    info->limit          = 0;
+    info->overlimit      = FALSE;
     xdrs->x_base         = (caddr_t) info;    
     xdrs->x_op           = XDR_ENCODE;
     xdrs->x_ops          = &memstream_operations;
@@ -487,8 +815,8 @@ void xdrmemstream_clear(XDR *xdrs)
 
     xdrs->x_op      = XDR_ENCODE;
     xdrs->x_private = (caddr_t) &(fragment->dummy);
-    xdrs->x_handy   = MemStreamBufferSize;
-    fragment->used  = MemStreamBufferSize; /* this is only a forecast !! */
+    xdrs->x_handy   = FRAGMENTSIZE(fragment->sizeclass);
+    fragment->used  = xdrs->x_handy; /* this is only a forecast !! */
 
     fragment = fragment->next;
     while ( fragment ) {
@@ -498,9 +826,36 @@ void xdrmemstream_clear(XDR *xdrs)
     }
     ((MemoryStreamInfo *) xdrs->x_base)->first->next = 0;
     ((MemoryStreamInfo *) xdrs->x_base)->fragment_count = 1;
+    ((MemoryStreamInfo *) xdrs->x_base)->capacity = xdrs->x_handy;
+    ((MemoryStreamInfo *) xdrs->x_base)->overlimit = FALSE;
 } /* xdrmemstream_clear */
 
 
+/* ---------------------------------------------------------------------------
+ * Limit the amount of memory a XDR memory stream may occupy. Once the
+ * fragments of the stream add up to the limit, further attempts to put
+ * data into the stream fail as if the fragment pool had been exhausted.
+ * A limit of zero means that the stream can grow until the pool quota
+ * is reached. The limit is only checked when the stream needs another
+ * fragment, so lowering it doesn't shrink a stream already grown larger.
+ */
+void xdrmemstream_set_limit(XDR *xdrs, u_int limit)
+{
+    ((MemoryStreamInfo *) xdrs->x_base)->limit = limit;
+} /* xdrmemstream_set_limit */
+
+
+/* ---------------------------------------------------------------------------
+ * Indicates whether the stream has run into its limit since it has been
+ * cleared the last time. This way the caller can tell an oversized
+ * message apart from an exhausted fragment pool.
+ */
+bool_t xdrmemstream_over_limit(XDR *xdrs)
+{
+    return ((MemoryStreamInfo *) xdrs->x_base)->overlimit;
+} /* xdrmemstream_over_limit */
+
+
 /* ---------------------------------------------------------------------------
  * Rewind a XDR memory stream and change the operation mode.
  */
@@ -518,8 +873,7 @@ void xdrmemstream_rewind(XDR *xdrs, enum xdr_op op)
          * do this only if the stream was in XDR_ENCODE mode.
 	 */
 	info->current->used -= xdrs->x_handy;
-	info->length = info->fragment_count * MemStreamBufferSize -
-		          xdrs->x_handy;
+	info->length = info->capacity - xdrs->x_handy;
     }
     /*
      * Reset the read/write pointer to the beginning of the first
@@ -625,7 +979,7 @@ static XDR_INLINE_PTR MemStreamInline(XDR *xdrs, int len)
     }
     if ( len <= (int)(xdrs->x_handy) ) {
 	XDR_INLINE_PTR space = (XDR_INLINE_PTR) xdrs->x_private;
-	xdrs->x_private += len;
+	xdrs->x_private = (char *) xdrs->x_private + len;
 	xdrs->x_handy   -= len;
 	return space;
     } else {
@@ -653,13 +1007,13 @@ static bool_t MemStreamGetLong(XDR *xdrs, long *lp)
     }
     /*
      * The private pointer points now in every case to a 32 bit int
-     * in the stream fragment. It is important to use the IXDR_GET_LONG
-     * macro here to retrieve the 32 bit int as this macro is the only
-     * way to do it platform-independent.
+     * in the stream fragment. Don't use the IXDR_GET_LONG macro here:
+     * some RPC libraries on 64 bit platforms step through the buffer
+     * using the size of the pointer type handed in, so with a long *
+     * we would read 64 bits at once.
      */
-    long *ppp = (long *) xdrs->x_private;
-    *lp = IXDR_GET_LONG(ppp);
-    xdrs->x_private = (caddr_t) ppp;
+    *lp = (long) (int) ntohl(*((u_int *) xdrs->x_private));
+    xdrs->x_private = (char *) xdrs->x_private + 4;
     xdrs->x_handy -= 4;
 
     return TRUE;
@@ -685,17 +1039,11 @@ static bool_t MemStreamPutLong(XDR *xdrs, PLT_CONST long *lp)
 	}
     }
     /*
-     * It is important to use the IXDR_PUT_LONG macro here to store
-     * the 32 bit int as this macro is the only way to do it platform-
-     * independent. The only gotch to watch out for is that you must
-     * stuff a long * into it, regardless of the platform you're on.
-     * The macro will take care on 64 bit platforms to cast that pointer
-     * to a suitable pointer type in order to access a 32 bit integer
-     * quantity.
+     * Store the 32 bit int in network order. See MemStreamGetLong()
+     * for why we don't use the IXDR_PUT_LONG macro here.
      */
-    long *ppp = (long *) xdrs->x_private;
-    IXDR_PUT_LONG(ppp, *lp);
-    xdrs->x_private = (caddr_t) ppp;
+    *((u_int *) xdrs->x_private) = htonl((u_int) *lp);
+    xdrs->x_private = (char *) xdrs->x_private + 4;
     xdrs->x_handy -= 4;
 
     return TRUE;
@@ -725,7 +1073,7 @@ static bool_t MemStreamGetBytes(XDR *xdrs, caddr_t addr, u_int len)
 	    count = len;
 	}
 	memcpy(addr, xdrs->x_private, count);
-	xdrs->x_private += count;
+	xdrs->x_private = (char *) xdrs->x_private + count;
 	xdrs->x_handy   -= count;
 	addr            += count;
 	len             -= count;
@@ -759,7 +1107,7 @@ static bool_t MemStreamPutBytes(XDR *xdrs, PLT_CONST caddr_t caddr, u_int len)
 	    count = len;
 	}
 	memcpy(xdrs->x_private, addr, count);
-	xdrs->x_private += count;
+	xdrs->x_private = (char *) xdrs->x_private + count;
 	xdrs->x_handy   -= count;
 	addr            += count;
 	len             -= count;
@@ -771,7 +1119,7 @@ static bool_t MemStreamPutBytes(XDR *xdrs, PLT_CONST caddr_t caddr, u_int len)
 /* ---------------------------------------------------------------------------
  * Yet to be implemented...
  */
-static u_int  MemStreamGetPos(PLT_CONST XDR *)
+static u_int  MemStreamGetPos(PLT_CONST_GETPOS XDR *)
 {
     return 0;
 } /* MemStreamGetPos */
@@ -888,7 +1236,7 @@ bool_t xdrmemstream_read_from_fd(XDR *xdrs, int fd, int *max, int *err)
 	    return FALSE;
 	}
 
-	xdrs->x_private += count_read;
+	xdrs->x_private = (char *) xdrs->x_private + count_read;
 	xdrs->x_handy   -= count_read;
 	*max            -= count_read;
         /*
@@ -937,7 +1285,7 @@ bool_t xdrmemstream_write_to_fd(XDR *xdrs, int fd, int *max, int *err)
         return FALSE;
     }
     while ( *max != 0 ) {
-	int count, count_written;
+	int count, count_written, left;
 	/*
 	 * If we have used up the current fragment, then we'll need to allocate
 	 * a fresh one to fill it up too.
@@ -959,7 +1307,34 @@ bool_t xdrmemstream_write_to_fd(XDR *xdrs, int fd, int *max, int *err)
 	if ( *max <= count ) {
 	    count = *max;
 	}
-#if !PLT_USE_XTI
+#if PLT_USE_WRITEV && !PLT_USE_XTI
+	/*
+	 * Better yet, gather the following fragments, too, so a telegramme
+	 * spanning several fragments doesn't cost a system call for each one.
+	 */
+	struct iovec iov[MAXIOVECS];
+	MemoryStreamFragment *fragment =
+	    ((MemoryStreamInfo *) xdrs->x_base)->current;
+	int iovcnt = 1;
+
+	iov[0].iov_base = xdrs->x_private;
+	iov[0].iov_len  = count;
+	while ( (count < *max) && (iovcnt < MAXIOVECS)
+		&& fragment->next && fragment->next->used ) {
+	    int chunk;
+
+	    fragment = fragment->next;
+	    chunk = fragment->used;
+	    if ( *max - count < chunk ) {
+		chunk = *max - count;
+	    }
+	    iov[iovcnt].iov_base = (caddr_t) &(fragment->dummy);
+	    iov[iovcnt].iov_len  = chunk;
+	    ++iovcnt;
+	    count += chunk;
+	}
+	count_written = writev(fd, iov, iovcnt);
+#elif !PLT_USE_XTI
         count_written = write(fd, xdrs->x_private, count);
 #else
 	count_written = t_snd(fd, xdrs->x_private, count, 0);
@@ -1045,9 +1420,17 @@ bool_t xdrmemstream_write_to_fd(XDR *xdrs, int fd, int *max, int *err)
 #ifdef CNXDEBUG
 	    cout << "*** " << fd << ": sent " << count_written << " bytes" << endl;
 #endif
-	xdrs->x_private += count_written;
-	xdrs->x_handy   -= count_written;
-	*max            -= count_written;
+	*max -= count_written;
+	/*
+	 * Skip the fragments which have gone out completely.
+	 */
+	left = count_written;
+	while ( left > (int) xdrs->x_handy ) {
+	    left -= xdrs->x_handy;
+	    AdvanceToNextFragment(xdrs);
+	}
+	xdrs->x_private = (char *) xdrs->x_private + left;
+	xdrs->x_handy   -= left;
         /*
          * If we couldn't write enough data yet, then we will return with
          * no error as the next write might deliver that data.
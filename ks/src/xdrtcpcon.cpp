@@ -74,7 +74,8 @@
 //
 KssListenTCPXDRConnection::KssListenTCPXDRConnection(int fd, 
                                                      unsigned long timeout)
-    : KssXDRConnection(fd, false, timeout, CNX_TYPE_SERVER)
+    : KssXDRConnection(fd, false, timeout, CNX_TYPE_SERVER),
+      _receive_quota(0), _send_quota(0)
 {
     _cleanup_xdr_stream = false; /* this one doesnt have a XDR stream!! */
     if ( !makeNonblocking() ) {
@@ -153,9 +154,9 @@ KssConnection::ConnectionIoMode KssListenTCPXDRConnection::receive()
 	//
 	return CNX_IO_READABLE;
     } else {
-	KssConnection *con = new KssTCPXDRConnection(newfd, _timeout, 
-		                                     saddr, saddr_len,
-		                                     _cnx_type);
+	KssTCPXDRConnection *con = new KssTCPXDRConnection(newfd, _timeout, 
+		                                           saddr, saddr_len,
+		                                           _cnx_type);
         if ( !con ) {
 #if PLT_SYSTEM_NT
 	    closesocket(newfd);
@@ -164,6 +165,7 @@ KssConnection::ConnectionIoMode KssListenTCPXDRConnection::receive()
 #endif
 	    return CNX_IO_READABLE;
 	}
+	con->setQuotas(_receive_quota, _send_quota);
 	con->setAttentionPartner(getAttentionPartner());
 	ConnectionIoMode ioMode = con->getIoMode();
 	if ( ioMode == CNX_IO_DEAD ) {
@@ -216,7 +218,10 @@ KssTCPXDRConnection::KssTCPXDRConnection(int fd, unsigned long timeout,
 	                                 struct sockaddr_in &clientAddr,
                                          int clientAddrLen,
 					 ConnectionType type)
-    : KssXDRConnection(fd, true, timeout, type)
+    : KssXDRConnection(fd, true, timeout, type),
+      _record_len(0), _receive_quota(0), _send_quota(0),
+      _fragment_size(KSS_STREAM_FRAGMENT_SIZE),
+      _stream(0), _stream_trailer_len(0)
 {
     //
     // First, create the necessary xdr dynamic memory stream. Then make the
@@ -292,6 +297,12 @@ KssTCPXDRConnection::KssTCPXDRConnection(int fd, unsigned long timeout,
 } // KssTCPXDRConnection::KssTCPXDRConnection
 
 
+KssTCPXDRConnection::~KssTCPXDRConnection()
+{
+    dropStream();
+} // KssTCPXDRConnection::~KssTCPXDRConnection
+
+
 // ---------------------------------------------------------------------------
 // Indicate the i/o mode this TCP connection is currently in. This way the
 // connection manager can make sure that this connection feels well. The i/o
@@ -380,10 +391,12 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::getIoMode() const
 // After a reply has been serialized into the underlaying XDR dynamic memory
 // stream, this helper function puts the connection into the sending state.
 //
-KssConnection::ConnectionIoMode KssTCPXDRConnection::enterSendingState()
+KssConnection::ConnectionIoMode KssTCPXDRConnection::enterSendingState(
+    bool lastFragment)
 {
     int len;
     
+    xdrmemstream_set_limit(&_xdrs, 0);
     xdrmemstream_rewind(&_xdrs, XDR_DECODE);
     xdrmemstream_get_length(&_xdrs, &len);
     _state          = CNX_STATE_SENDING;
@@ -397,12 +410,58 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::enterSendingState()
     _fragment_state = FRAGMENT_BODY;
     _remaining_len  = len;
     XDR_INLINE_PTR ppp = xdr_inline(&_xdrs, 4);
-    IXDR_PUT_LONG(ppp, (len - 4) | 0x80000000ul);
+    IXDR_PUT_LONG(ppp, (len - 4) | (lastFragment ? 0x80000000ul : 0));
     xdrmemstream_rewind(&_xdrs, XDR_DECODE);
     return getIoMode();
 } // KssTCPXDRConnection::enterSendingState
 
 
+// ---------------------------------------------------------------------------
+// Prepares the underlaying XDR dynamic memory stream for serializing a reply,
+// which must not grow beyond the send quota.
+//
+void KssTCPXDRConnection::beginReply()
+{
+    xdrmemstream_clear(&_xdrs);
+    xdrmemstream_set_limit(&_xdrs, _send_quota);
+} // KssTCPXDRConnection::beginReply
+
+
+// ---------------------------------------------------------------------------
+// Serializing a reply failed. If this happened because the reply exceeded
+// the send quota, then the connection gets dropped. Otherwise we just reset
+// it, as usual.
+//
+void KssTCPXDRConnection::replyFailed()
+{
+    bool overQuota = xdrmemstream_over_limit(&_xdrs) ? true : false;
+    xdrmemstream_set_limit(&_xdrs, 0);
+    if ( overQuota ) {
+	dropOverQuota();
+    } else {
+	reset();
+    }
+} // KssTCPXDRConnection::replyFailed
+
+
+// ---------------------------------------------------------------------------
+// The connection has exceeded one of its quotas, so we're getting rid of it
+// and of the memory it occupies. Client connections only enter the failed
+// state, as they are not allowed to kill themselves.
+//
+KssConnection::ConnectionIoMode KssTCPXDRConnection::dropOverQuota()
+{
+    quotaExceeded();
+    xdrmemstream_clear(&_xdrs);
+    if ( _cnx_type == CNX_TYPE_CLIENT ) {
+	_state = CNX_STATE_READY_FAILED;
+    } else {
+	_state = CNX_STATE_DEAD;
+    }
+    return getIoMode();
+} // KssTCPXDRConnection::dropOverQuota
+
+
 // ---------------------------------------------------------------------------
 // Answer the usual ping request. Just fill in the simple answer and send it
 // down the pipe.
@@ -412,14 +471,14 @@ void KssTCPXDRConnection::sendPingReply()
     if ( _state == CNX_STATE_DEAD ) {
     	return;
     }
-    xdrmemstream_clear(&_xdrs);
+    beginReply();
     _rpc_header.acceptCall();
     u_long dummy = 0x80000000ul;       // Make sure theres room for the
     if ( xdr_u_long(&_xdrs, &dummy) && // fragment header well fix later...
          _rpc_header.xdrEncode(&_xdrs) ) {
     	_state = CNX_STATE_SENDING;
     } else {
-    	reset();
+    	replyFailed();
 	return;
     }
     enterSendingState();
@@ -432,7 +491,7 @@ void KssTCPXDRConnection::sendErrorReply(KsAvTicket &avt, KS_RESULT error)
 {
     if ( _state != CNX_STATE_DEAD ) {
     	u_long e = error == KS_ERR_OK ? KS_ERR_GENERIC : error;
-    	xdrmemstream_clear(&_xdrs);
+    	beginReply();
 	_rpc_header.acceptCall();
 	u_long dummy = 0x80000000ul;       // Make sure theres room for the
 	if ( xdr_u_long(&_xdrs, &dummy) && // fragment header well fix later...
@@ -442,7 +501,7 @@ void KssTCPXDRConnection::sendErrorReply(KsAvTicket &avt, KS_RESULT error)
 	     avt.xdrEncodeTrailer(&_xdrs) ) {
     	    enterSendingState();
 	} else {
-    	    reset();
+    	    replyFailed();
 	}
     }    
 } // KssTCPXDRConnection::sendErrorReply
@@ -453,7 +512,7 @@ void KssTCPXDRConnection::sendErrorReply(KsAvTicket &avt, KS_RESULT error)
 void KssTCPXDRConnection::sendReply(KsAvTicket &avt, KsResult &result)
 {
     if ( _state != CNX_STATE_DEAD ) {
-    	xdrmemstream_clear(&_xdrs);
+    	beginReply();
 	_rpc_header.acceptCall();
 	u_long dummy = 0x80000000ul;     // Make sure theres room for the
 	if ( xdr_u_long(&_xdrs, &dummy)  // fragment header well fix later...
@@ -463,12 +522,109 @@ void KssTCPXDRConnection::sendReply(KsAvTicket &avt, KsResult &result)
 	     && avt.xdrEncodeTrailer(&_xdrs) ) {
     	    enterSendingState();
 	} else {
-    	    reset();
+    	    replyFailed();
 	}
     }    
 } // KssTCPXDRConnection::sendReply
 
 
+// ---------------------------------------------------------------------------
+// Send back a streamed reply. The first fragment holds the RPC and A/V
+// headers and the first piece of the result, the following fragments are
+// serialized by send() whenever the previous one has gone out. As the A/V
+// ticket doesn't live that long, its trailer is serialized right now and
+// appended to the last fragment later.
+//
+void KssTCPXDRConnection::sendStreamedReply(KsAvTicket &avt,
+					    KssStreamedResult *result)
+{
+    if ( (_state == CNX_STATE_DEAD) || _stream ) {
+	delete result;
+	return;
+    }
+    XDR trailer;
+    xdrmem_create(&trailer, _stream_trailer, sizeof(_stream_trailer),
+		  XDR_ENCODE);
+    bool ok = avt.xdrEncodeTrailer(&trailer) ? true : false;
+    _stream_trailer_len = xdr_getpos(&trailer);
+    xdr_destroy(&trailer);
+    if ( !ok ) {
+	//
+	// The trailer is too large to be kept aside, so there's no other
+	// way than sending the reply in one go.
+	//
+	sendReply(avt, *result);
+	delete result;
+	return;
+    }
+
+    _stream = result;
+    beginReply();
+    _rpc_header.acceptCall();
+    u_long dummy = 0x80000000ul; // room for the fragment header
+    if ( xdr_u_long(&_xdrs, &dummy)
+	 && _rpc_header.xdrEncode(&_xdrs)
+	 && avt.xdrEncode(&_xdrs)
+	 && encodeStreamFragment() ) {
+	enterSendingState(_stream == 0);
+    } else {
+	dropStream();
+	replyFailed();
+    }
+} // KssTCPXDRConnection::sendStreamedReply
+
+
+// ---------------------------------------------------------------------------
+// Serialize the next piece of a streamed reply into the (empty but for the
+// fragment header) XDR stream. When the result is complete, the A/V trailer
+// is appended and the result gets deleted.
+//
+bool KssTCPXDRConnection::encodeStreamFragment()
+{
+    bool done = false;
+    if ( !_stream->xdrEncodeNext(&_xdrs, _fragment_size, done) ) {
+	return false;
+    }
+    if ( done ) {
+	if ( _stream_trailer_len
+	     && !XDR_PUTBYTES(&_xdrs, _stream_trailer, _stream_trailer_len) ) {
+	    return false;
+	}
+	dropStream();
+    }
+    return true;
+} // KssTCPXDRConnection::encodeStreamFragment
+
+
+// ---------------------------------------------------------------------------
+// The previous fragment of a streamed reply has been sent, so serialize the
+// next one. If this fails, the client has already got part of the reply
+// and there's no way to tell it that something went wrong, so the connection
+// is killed.
+//
+KssConnection::ConnectionIoMode KssTCPXDRConnection::nextStreamFragment()
+{
+    xdrmemstream_clear(&_xdrs);
+    xdrmemstream_set_limit(&_xdrs, _send_quota);
+    u_long dummy = 0x80000000ul; // room for the fragment header
+    if ( xdr_u_long(&_xdrs, &dummy) && encodeStreamFragment() ) {
+	return enterSendingState(_stream == 0);
+    }
+    dropStream();
+    xdrmemstream_set_limit(&_xdrs, 0);
+    xdrmemstream_clear(&_xdrs);
+    _state = CNX_STATE_DEAD;
+    return (ConnectionIoMode)(getIoMode() | CNX_IO_HAD_TX_ERROR);
+} // KssTCPXDRConnection::nextStreamFragment
+
+
+void KssTCPXDRConnection::dropStream()
+{
+    delete _stream;
+    _stream = 0;
+} // KssTCPXDRConnection::dropStream
+
+
 
 bool KssTCPXDRConnection::beginRequest(u_long xid,
 				       u_long prog_number, u_long prog_version,
@@ -675,6 +831,15 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::receive()
 	    u_long l  = IXDR_GET_LONG(ppp);
 	    _last_fragment = l & 0x80000000ul ? true : false;
 	    _remaining_len = l & 0x7FFFFFFFul;
+	    //
+	    // Before we buffer anything, make sure that the telegramme
+	    // doesn't grow beyond our receive quota. Otherwise a single
+	    // client could eat up all fragments for itself.
+	    //
+	    _record_len += _remaining_len;
+	    if ( _receive_quota && (_record_len > _receive_quota) ) {
+		return dropOverQuota();
+	    }
 	    if ( _remaining_len ) {
 		_fragment_state = FRAGMENT_BODY;
 	    } else if ( !_last_fragment ) {
@@ -718,8 +883,13 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::receive()
 	    //
 	    _remaining_len = rlen;
 	    if ( (err == ENOMEM) && (_cnx_type == CNX_TYPE_SERVER) ) {
-	    	// TODO!!!
-		return reset(); // flush all incomming data...
+		//
+		// We can't just flush the data received so far, as the
+		// rest of the telegramme would then be taken for the next
+		// one. So drop the connection as if it had exceeded its
+		// quota.
+		//
+		return dropOverQuota();
 	    } else {
 		if ( _cnx_type == CNX_TYPE_CLIENT ) {
 		    _state = CNX_STATE_READY_FAILED;
@@ -785,7 +955,8 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::receive()
 // ---------------------------------------------------------------------------
 // Send back a RPC telegramme to a client. Please note a peculiarity here:
 // we're always sending back the answer as *one* telegramme fragment, which
-// is just fine. Another note: we can also send a request to another server,
+// is just fine -- except for streamed replies, which are sent fragment by
+// fragment. Another note: we can also send a request to another server,
 // so we need to make sure that the automata does work the right way(tm).
 //
 KssConnection::ConnectionIoMode KssTCPXDRConnection::send()
@@ -885,7 +1056,13 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::send()
 	    _fragment_state = FRAGMENT_HEADER;
 	    _remaining_len  = 4;
 	    _ptr            = _fragment_header;
+	    _record_len     = 0;
 	    xdrmemstream_clear(&_xdrs);
+	} else if ( _stream ) {
+	    //
+	    // There's more of a streamed reply to come.
+	    //
+	    return nextStreamFragment();
 	} else {
 	    //
 	    // Enter the IDLE state for a server side connection.
@@ -944,6 +1121,7 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::timedOut()
     _fragment_state = FRAGMENT_HEADER;
     _remaining_len  = 4;
     _ptr            = _fragment_header;
+    _record_len     = 0;
     return getIoMode();
 } // KssTCPXDRConnection::timedOut
 
@@ -960,6 +1138,12 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::reset()
 	//
     	return CNX_IO_DEAD;
     }
+    //
+    // A streamed reply can't be continued once it has been interrupted, and
+    // the client can't make any sense of what it has already got.
+    //
+    bool streaming = _stream != 0;
+    dropStream();
  
     switch ( _state ) {
     case CNX_STATE_SENDING:
@@ -982,7 +1166,7 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::reset()
 	    // other state, it will just enter zombie state, so it can be
 	    // either killed completely manually or automatically.
 	    //
-	    if ( _state == CNX_STATE_SENDING ) {
+	    if ( (_state == CNX_STATE_SENDING) && !streaming ) {
 		_state = CNX_STATE_IDLE;
 	    } else {
 		_state = CNX_STATE_DEAD;
@@ -1012,6 +1196,7 @@ KssConnection::ConnectionIoMode KssTCPXDRConnection::reset()
     _fragment_state = FRAGMENT_HEADER;
     _remaining_len  = 4;
     _ptr            = _fragment_header;
+    _record_len     = 0;
     return getIoMode();
 } // KssTCPXDRConnection::reset
 
@@ -525,7 +525,7 @@ void KssUDPXDRConnection::sendPingReply()
 	_rpc_header.acceptCall();
 	if ( _rpc_header.xdrEncode(&_xdrs) ) {
 	    _tosend = (int) XDR_GETPOS(&_xdrs);
-	    memcpy(_sendbuffer, _recvbuffer, _buffer_size);
+	    memcpy(_sendbuffer, _recvbuffer, _tosend);
 	    _time_passed = 0;
     	    _state = CNX_STATE_SENDING;
 	} else {
@@ -549,7 +549,7 @@ void KssUDPXDRConnection::sendErrorReply(KsAvTicket &avt, KS_RESULT error)
 	     xdr_u_long(&_xdrs, &e) &&
 	     avt.xdrEncodeTrailer(&_xdrs) ) {
 	    _tosend = (int) XDR_GETPOS(&_xdrs);
-	    memcpy(_sendbuffer, _recvbuffer, _buffer_size);
+	    memcpy(_sendbuffer, _recvbuffer, _tosend);
 	    _time_passed = 0;
     	    _state = CNX_STATE_SENDING;
 	} else {
@@ -572,7 +572,7 @@ void KssUDPXDRConnection::sendReply(KsAvTicket &avt, KsResult &result)
 	     result.xdrEncode(&_xdrs) &&
 	     avt.xdrEncodeTrailer(&_xdrs) ) {
 	    _tosend = (int) XDR_GETPOS(&_xdrs);
-	    memcpy(_sendbuffer, _recvbuffer, _buffer_size);
+	    memcpy(_sendbuffer, _recvbuffer, _tosend);
 	    _time_passed = 0;
     	    _state = CNX_STATE_SENDING;
 	} else {
@@ -582,6 +582,35 @@ void KssUDPXDRConnection::sendReply(KsAvTicket &avt, KsResult &result)
 } // KssUDPXDRConnection::sendReply
 
 
+// ---------------------------------------------------------------------------
+// Send a canned reply: the caller has encoded the whole datagram in advance
+// (usually with a zero transaction ID), so we just copy it and fill in the
+// transaction ID of the request we're answering.
+//
+void KssUDPXDRConnection::sendEncodedReply(const char *reply, u_int len)
+{
+    if ( _state != CNX_STATE_DEAD ) {
+    	if ( (len < 4) || (len > _buffer_size) ) {
+	    reset();
+	    return;
+	}
+	memcpy(_sendbuffer, reply, len);
+	XDR xdrs;
+	u_long xid = _rpc_header._xid;
+	xdrmem_create(&xdrs, (caddr_t) _sendbuffer, 4, XDR_ENCODE);
+	bool ok = xdr_u_long(&xdrs, &xid) != 0;
+	xdr_destroy(&xdrs);
+	if ( !ok ) {
+	    reset();
+	    return;
+	}
+	_tosend = len;
+	_time_passed = 0;
+    	_state = CNX_STATE_SENDING;
+    }
+} // KssUDPXDRConnection::sendEncodedReply
+
+
 // ---------------------------------------------------------------------------
 //
 void KssUDPXDRConnection::personaNonGrata()
@@ -617,7 +646,7 @@ void KssUDPXDRConnection::sendRequest()
 {
     if ( _state != CNX_STATE_DEAD ) {
 	_tosend = (int) XDR_GETPOS(&_xdrs);
-	memcpy(_sendbuffer, _recvbuffer, _buffer_size);
+	memcpy(_sendbuffer, _recvbuffer, _tosend);
 	_time_passed = 0;
     	_state = CNX_STATE_SENDING;
     }
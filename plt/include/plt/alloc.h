@@ -24,45 +24,86 @@
 
 #include "plt/debug.h"
 
-// private class
+//////////////////////////////////////////////////////////////////////
+// Usage statistics of the slab allocator, either for a single size
+// class or summed up over all size classes.
+//////////////////////////////////////////////////////////////////////
+
+struct PltSlabUsage
+{
+    size_t objsize;   // object size of this size class (0 for the total)
+    size_t slabs;     // number of slabs carved so far
+    size_t bytes;     // memory held in slabs
+    size_t allocs;    // objects handed out
+    size_t frees;     // objects given back
+    size_t magazines; // full magazines parked in the global depot
+};
+
+//////////////////////////////////////////////////////////////////////
+// Thread-safe size-class slab allocator. Small objects are carved from
+// slabs and recycled through per-thread magazines (a free list of up to
+// MAGAZINE_SIZE objects). When a thread's cache of a size class runs
+// full, one magazine is handed over to a lock-free global depot, and a
+// thread running dry first tries to fetch a magazine from the depot
+// before carving a new slab. Thus the common case never touches shared
+// state. Slab memory is never returned to the operating system, it is
+// only recycled.
+//
+// Objects larger than MAX_OBJ_SIZE are forwarded to ::operator new. As
+// objects carry no header, the size has to be passed to free() again.
+//
+// Statistics are collected per thread and published to the global
+// counters whenever a thread exchanges magazines with the depot, so
+// they lag behind a little bit.
+//////////////////////////////////////////////////////////////////////
 
-class PltAllocator_base
+class PltSlabAllocator
 {
-    class node
-        {
-        public:
-            void * obj;
-            node * next;
-            node() : obj(0), next(0) { }
-        };
-    node * objlist;
-    static node * nodelist;
-    static size_t icount;
-protected:
-    PltAllocator_base() : objlist(0) { ++icount; }
-    ~PltAllocator_base();
+public:
+    enum {
+        GRANULE       = 16,    // size classes are multiples of this
+        CLASS_COUNT   = 16,    // number of size classes
+        MAX_OBJ_SIZE  = GRANULE * CLASS_COUNT,
+        MAGAZINE_SIZE = 32,    // objects per magazine
+        SLAB_SIZE     = 16384  // bytes carved at once
+    };
+
+    static void * alloc(size_t size);
+    static void free(void * ptr, size_t size);
+
+    // Gives back all objects cached by the calling thread to the depot.
+    // This happens automatically on thread exit where supported (POSIX
+    // threads), otherwise threads should call it before terminating.
+    static void flushThreadCache();
+
+    static size_t getClassCount() { return CLASS_COUNT; }
+    static bool getUsage(size_t sizeclass, PltSlabUsage & usage);
+    static void getTotalUsage(PltSlabUsage & usage);
 
-    PltAllocator_base(const PltAllocator_base &); // forbidden
-    PltAllocator_base & operator = (const PltAllocator_base &); // forbidden
+private:
+    PltSlabAllocator(); // forbidden
 
-    void * do_alloc(size_t size);
-    void do_free(void * ptr);
+    static size_t sizeClass(size_t size)
+        { return (size + GRANULE - 1) / GRANULE - 1; }
 };
 
 //////////////////////////////////////////////////////////////////////
+// PltAllocator<T> hands out memory for objects of type T. It is used by
+// the class-specific operator new/delete of frequently allocated small
+// objects and forwards to the slab allocator. Instances are stateless,
+// so they can be shared among threads.
 //////////////////////////////////////////////////////////////////////
     
 template <class T>
 class PltAllocator
-: private PltAllocator_base
 {
 public:
-    PltAllocator() : PltAllocator_base() { }
+    PltAllocator() { }
     PltAllocator(const PltAllocator<T> &); // forbidden
     PltAllocator<T> & operator = (const PltAllocator<T> &); // forbidden
 
-    void * alloc() { return do_alloc(sizeof (T)); }
-    void free(void *ptr) { do_free(ptr); }
+    void * alloc() { return PltSlabAllocator::alloc(sizeof (T)); }
+    void free(void *ptr) { PltSlabAllocator::free(ptr, sizeof (T)); }
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -23,6 +23,11 @@
 
 #include "plt/debug.h"
 
+//////////////////////////////////////////////////////////////////////
+// Orders pointers by the objects they point to. Equality, however, means
+// the very same object, so removing a pointer from a container (say, a
+// priority queue) never takes out another object which just compares
+// equal.
 //////////////////////////////////////////////////////////////////////
 
 template <class T>
@@ -127,7 +132,7 @@ template <class T>
 inline bool 
 PltPtrComparable<T>::operator ==  ( PltPtrComparable<T> t2) 
 {
-    return *_p == *t2._p;
+    return _p == t2._p;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -136,7 +141,7 @@ template <class T>
 inline bool 
 PltPtrComparable<T>::operator !=  ( PltPtrComparable<T> t2) 
 {
-    return *_p != *t2._p;
+    return _p != t2._p;
 }
 
 //////////////////////////////////////////////////////////////////////
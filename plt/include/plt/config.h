@@ -387,14 +387,89 @@ enum { false=0, true=1 };
 #endif
 
 /*
- * Set maximum pool block count. Every block (fragment) is 4k in size.
- * This pool block maximum is just a simple insurance against clients
- * gone mad and sending and sending data without stopping.
+ * Set maximum pool block count. Every block is 4k in size; the actual
+ * fragments of the XDR memory streams come in several size classes but
+ * are accounted for in multiples of this block size. This pool block
+ * maximum is just a simple insurance against clients gone mad and
+ * sending and sending data without stopping.
  */
 #ifndef PLT_POOL_BLOCK_COUNT
 #define PLT_POOL_BLOCK_COUNT 2048
 #endif
 
+/* --------------------------------------------------------------------------
+ * Enable/disable thread-safety of the shared memory pools (the slab
+ * allocator behind PltAllocator and the XDR memory stream fragments).
+ * This needs thread-local storage and atomic operations from the compiler,
+ * so we only switch it on for compilers we know to support them. If
+ * disabled, the pools fall back to the old single-threaded behaviour.
+ */
+#ifndef PLT_USE_THREADS
+#if (PLT_COMPILER_GCC >= 0x40007) || (PLT_COMPILER_MSVC >= 1400)
+#if PLT_SYSTEM_LINUX || PLT_SYSTEM_FREEBSD || PLT_SYSTEM_SOLARIS || PLT_SYSTEM_NT
+#define PLT_USE_THREADS 1
+#endif
+#endif
+#endif
+
+#ifndef PLT_USE_THREADS
+#define PLT_USE_THREADS 0
+#endif
+
+/* --------------------------------------------------------------------------
+ * Enable/disable use of memory-mapped files (mmap() and friends), as used by
+ * the on-disk history archives. Only available on the Unix platforms.
+ */
+#ifndef PLT_USE_MMAP
+#if PLT_SYSTEM_LINUX || PLT_SYSTEM_FREEBSD || PLT_SYSTEM_SOLARIS || PLT_SYSTEM_HPUX || PLT_SYSTEM_IRIX
+#define PLT_USE_MMAP 1
+#endif
+#endif
+
+#ifndef PLT_USE_MMAP
+#define PLT_USE_MMAP 0
+#endif
+
+/* --------------------------------------------------------------------------
+ * Enable/disable use of getaddrinfo() for resolving host names. It is
+ * thread-safe and knows about IPv6 addresses. Elsewhere we fall back to
+ * gethostbyname().
+ */
+#ifndef PLT_USE_GETADDRINFO
+#if PLT_SYSTEM_LINUX || PLT_SYSTEM_FREEBSD || PLT_SYSTEM_SOLARIS || (PLT_SYSTEM_NT && PLT_USE_WINSOCK2)
+#define PLT_USE_GETADDRINFO 1
+#endif
+#endif
+
+#ifndef PLT_USE_GETADDRINFO
+#define PLT_USE_GETADDRINFO 0
+#endif
+
+/* --------------------------------------------------------------------------
+ * Enable/disable use of writev() for sending buffered XDR streams, so all
+ * fragments of a telegramme go out with a single system call.
+ */
+#ifndef PLT_USE_WRITEV
+#if PLT_SYSTEM_LINUX || PLT_SYSTEM_FREEBSD || PLT_SYSTEM_SOLARIS || PLT_SYSTEM_HPUX || PLT_SYSTEM_IRIX
+#define PLT_USE_WRITEV 1
+#endif
+#endif
+
+#ifndef PLT_USE_WRITEV
+#define PLT_USE_WRITEV 0
+#endif
+
+/* --------------------------------------------------------------------------
+ * Integer types with exactly 64 bits.
+ */
+#if PLT_COMPILER_MSVC
+typedef unsigned __int64 PltUInt64;
+typedef __int64 PltInt64;
+#else
+typedef unsigned long long PltUInt64;
+typedef long long PltInt64;
+#endif
+
 /* --------------------------------------------------------------------------
  * Enable or disable use of (now) depreciated header files. If this define
  * has not been set and if we are compiling using certain newer compilers,
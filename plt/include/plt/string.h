@@ -99,7 +99,7 @@ public: // read: private ;-)
     public:
         char * s;
         size_t len;
-        int refcount;
+        volatile long refcount;   // changed atomically
         srep() : s(0), len(0), refcount(1) { }
 
         void * operator new(size_t);
@@ -0,0 +1,486 @@
+/* -*-plt-c++-*- */
+#ifndef PLT_THREAD_INCLUDED
+#define PLT_THREAD_INCLUDED
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * plt/thread.h provides the few synchronization primitives the memory
+ * pools need: a mutex, thread-local storage and some atomic operations.
+ * It also has a condition variable and a minimal thread class for running
+ * blocking work in the background. When PLT_USE_THREADS is disabled,
+ * everything degrades to plain single-threaded code.
+ */
+
+#include "plt/debug.h"
+
+#if PLT_USE_THREADS
+#if PLT_SYSTEM_NT
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// PLT_THREAD_LOCAL marks a static POD variable as having one instance
+// per thread.
+//////////////////////////////////////////////////////////////////////
+
+#if PLT_USE_THREADS
+#if PLT_COMPILER_MSVC
+#define PLT_THREAD_LOCAL __declspec(thread)
+#else
+#define PLT_THREAD_LOCAL __thread
+#endif
+#else
+#define PLT_THREAD_LOCAL
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// A plain (non-recursive) mutex.
+//////////////////////////////////////////////////////////////////////
+
+class PltMutex
+{
+public:
+    PltMutex();
+    ~PltMutex();
+
+    void lock();
+    void unlock();
+
+private:
+    PltMutex(const PltMutex &); // forbidden
+    PltMutex & operator = (const PltMutex &); // forbidden
+
+    friend class PltCondition;
+
+#if PLT_USE_THREADS
+#if PLT_SYSTEM_NT
+    CRITICAL_SECTION _cs;
+#else
+    pthread_mutex_t _mutex;
+#endif
+#endif
+};
+
+//////////////////////////////////////////////////////////////////////
+// Locks a mutex for the lifetime of the lock object.
+//////////////////////////////////////////////////////////////////////
+
+class PltMutexLock
+{
+public:
+    PltMutexLock(PltMutex &m) : _m(m) { _m.lock(); }
+    ~PltMutexLock() { _m.unlock(); }
+
+private:
+    PltMutexLock(const PltMutexLock &); // forbidden
+    PltMutexLock & operator = (const PltMutexLock &); // forbidden
+
+    PltMutex &_m;
+};
+
+//////////////////////////////////////////////////////////////////////
+// A condition variable. wait() must be called with the mutex locked; it
+// returns false without waiting when PLT_USE_THREADS is disabled, as
+// nobody else could ever signal the condition then.
+//////////////////////////////////////////////////////////////////////
+
+class PltCondition
+{
+public:
+    PltCondition();
+    ~PltCondition();
+
+    bool wait(PltMutex &m);
+    void broadcast();
+
+private:
+    PltCondition(const PltCondition &); // forbidden
+    PltCondition & operator = (const PltCondition &); // forbidden
+
+#if PLT_USE_THREADS
+#if PLT_SYSTEM_NT
+    CONDITION_VARIABLE _cv;
+#else
+    pthread_cond_t _cond;
+#endif
+#endif
+};
+
+//////////////////////////////////////////////////////////////////////
+// A thread running the run() method of a derived class. start() returns
+// false if the thread could not be created -- which is always the case
+// when PLT_USE_THREADS is disabled -- so the caller then has to do the
+// work itself. A thread which has been started must be joined before
+// the object is destroyed.
+//////////////////////////////////////////////////////////////////////
+
+class PltThread
+{
+public:
+    PltThread();
+    virtual ~PltThread();
+
+    bool start();
+    void join();
+    bool isRunning() const { return _running; }
+
+protected:
+    virtual void run() = 0;
+
+private:
+    PltThread(const PltThread &); // forbidden
+    PltThread & operator = (const PltThread &); // forbidden
+
+#if PLT_USE_THREADS
+#if PLT_SYSTEM_NT
+    static DWORD WINAPI entry(LPVOID arg);
+
+    HANDLE _thread;
+#else
+    static void * entry(void *arg);
+
+    pthread_t _thread;
+#endif
+#endif
+    bool _running;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Atomic operations. Apart from the plain pointer loads and stores, all
+// operations are full memory barriers. The 64 bit
+// variants are used for tagged pointers on the lock-free stacks, so they
+// must be atomic even on 32 bit platforms.
+//////////////////////////////////////////////////////////////////////
+
+class PltAtomic
+{
+public:
+    static long add(volatile long *p, long delta);
+    static void * exchange(void * volatile *p, void *v);
+    static void * loadPtr(void * volatile *p);
+    static void storePtr(void * volatile *p, void *v);
+    static PltUInt64 load64(volatile PltUInt64 *p);
+    static bool compareAndSwap64(volatile PltUInt64 *p,
+                                 PltUInt64 expected, PltUInt64 desired);
+};
+
+//////////////////////////////////////////////////////////////////////
+// An intrusive lock-free LIFO. The link to the next node is kept in the
+// LinkIndex-th pointer of each node. A tag is packed together with the
+// top-of-stack pointer to defeat the ABA problem, so nodes may be popped
+// and pushed again concurrently. Nodes must never be returned to the
+// operating system while the stack is in use, as a concurrent pop might
+// still read the link of a node which has already been taken.
+//
+// The class has no constructors on purpose: static instances are zero-
+// initialized (that is, empty) before any dynamic initialization runs,
+// so they can be used from other static constructors.
+//////////////////////////////////////////////////////////////////////
+
+template <size_t LinkIndex>
+class PltLockFreeStack
+{
+public:
+    void push(void *node) { pushChain(node, node); }
+    void pushChain(void *first, void *last);
+    void * pop();
+    void * popAll();
+    bool isEmpty() { return getPtr(PltAtomic::load64(&_head)) == 0; }
+
+    static void * volatile & link(void *node)
+        { return ((void * volatile *) node)[LinkIndex]; }
+
+private:
+    static PltUInt64 makeHead(void *p, PltUInt64 tag);
+    static void * getPtr(PltUInt64 head);
+    static PltUInt64 getTag(PltUInt64 head);
+
+    volatile PltUInt64 _head;
+};
+
+//////////////////////////////////////////////////////////////////////
+// INLINE IMPLEMENTATION
+//////////////////////////////////////////////////////////////////////
+
+#if PLT_USE_THREADS && PLT_SYSTEM_NT
+
+inline PltMutex::PltMutex() { InitializeCriticalSection(&_cs); }
+inline PltMutex::~PltMutex() { DeleteCriticalSection(&_cs); }
+inline void PltMutex::lock() { EnterCriticalSection(&_cs); }
+inline void PltMutex::unlock() { LeaveCriticalSection(&_cs); }
+
+inline PltCondition::PltCondition() { InitializeConditionVariable(&_cv); }
+inline PltCondition::~PltCondition() { }
+inline bool PltCondition::wait(PltMutex &m)
+    { return SleepConditionVariableCS(&_cv, &m._cs, INFINITE) != 0; }
+inline void PltCondition::broadcast() { WakeAllConditionVariable(&_cv); }
+
+#elif PLT_USE_THREADS
+
+inline PltMutex::PltMutex() { pthread_mutex_init(&_mutex, 0); }
+inline PltMutex::~PltMutex() { pthread_mutex_destroy(&_mutex); }
+inline void PltMutex::lock() { pthread_mutex_lock(&_mutex); }
+inline void PltMutex::unlock() { pthread_mutex_unlock(&_mutex); }
+
+inline PltCondition::PltCondition() { pthread_cond_init(&_cond, 0); }
+inline PltCondition::~PltCondition() { pthread_cond_destroy(&_cond); }
+inline bool PltCondition::wait(PltMutex &m)
+    { return pthread_cond_wait(&_cond, &m._mutex) == 0; }
+inline void PltCondition::broadcast() { pthread_cond_broadcast(&_cond); }
+
+#else
+
+inline PltMutex::PltMutex() { }
+inline PltMutex::~PltMutex() { }
+inline void PltMutex::lock() { }
+inline void PltMutex::unlock() { }
+
+inline PltCondition::PltCondition() { }
+inline PltCondition::~PltCondition() { }
+inline bool PltCondition::wait(PltMutex &) { return false; }
+inline void PltCondition::broadcast() { }
+
+#endif
+
+//////////////////////////////////////////////////////////////////////
+
+#if PLT_USE_THREADS && PLT_COMPILER_MSVC
+
+inline long
+PltAtomic::add(volatile long *p, long delta)
+{
+    return InterlockedExchangeAdd(p, delta) + delta;
+}
+
+inline void *
+PltAtomic::exchange(void * volatile *p, void *v)
+{
+    return InterlockedExchangePointer(p, v);
+}
+
+inline void *
+PltAtomic::loadPtr(void * volatile *p)
+{
+    return *p; // volatile accesses have acquire/release semantics
+}
+
+inline void
+PltAtomic::storePtr(void * volatile *p, void *v)
+{
+    *p = v;
+}
+
+inline PltUInt64
+PltAtomic::load64(volatile PltUInt64 *p)
+{
+    return (PltUInt64) InterlockedCompareExchange64(
+        (volatile LONGLONG *) p, 0, 0);
+}
+
+inline bool
+PltAtomic::compareAndSwap64(volatile PltUInt64 *p,
+                            PltUInt64 expected, PltUInt64 desired)
+{
+    return (PltUInt64) InterlockedCompareExchange64(
+        (volatile LONGLONG *) p, (LONGLONG) desired, (LONGLONG) expected)
+        == expected;
+}
+
+#elif PLT_USE_THREADS
+
+inline long
+PltAtomic::add(volatile long *p, long delta)
+{
+    return __atomic_add_fetch(p, delta, __ATOMIC_SEQ_CST);
+}
+
+inline void *
+PltAtomic::exchange(void * volatile *p, void *v)
+{
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+inline void *
+PltAtomic::loadPtr(void * volatile *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+inline void
+PltAtomic::storePtr(void * volatile *p, void *v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+inline PltUInt64
+PltAtomic::load64(volatile PltUInt64 *p)
+{
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+inline bool
+PltAtomic::compareAndSwap64(volatile PltUInt64 *p,
+                            PltUInt64 expected, PltUInt64 desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#else
+
+inline long
+PltAtomic::add(volatile long *p, long delta)
+{
+    return *p += delta;
+}
+
+inline void *
+PltAtomic::exchange(void * volatile *p, void *v)
+{
+    void *old = *p;
+    *p = v;
+    return old;
+}
+
+inline void *
+PltAtomic::loadPtr(void * volatile *p)
+{
+    return *p;
+}
+
+inline void
+PltAtomic::storePtr(void * volatile *p, void *v)
+{
+    *p = v;
+}
+
+inline PltUInt64
+PltAtomic::load64(volatile PltUInt64 *p)
+{
+    return *p;
+}
+
+inline bool
+PltAtomic::compareAndSwap64(volatile PltUInt64 *p,
+                            PltUInt64 expected, PltUInt64 desired)
+{
+    if ( *p != expected ) {
+        return false;
+    }
+    *p = desired;
+    return true;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////
+// On 64 bit platforms user space addresses fit into 48 bits, leaving the
+// upper 16 bits for the tag; on 32 bit platforms the tag gets the upper
+// half of the 64 bit head.
+
+template <size_t LinkIndex>
+inline PltUInt64
+PltLockFreeStack<LinkIndex>::makeHead(void *p, PltUInt64 tag)
+{
+    if ( sizeof(void *) > 4 ) {
+        return ((PltUInt64) (size_t) p & 0x0000FFFFFFFFFFFFULL)
+               | (tag << 48);
+    }
+    return (PltUInt64) (size_t) p | (tag << 32);
+}
+
+template <size_t LinkIndex>
+inline void *
+PltLockFreeStack<LinkIndex>::getPtr(PltUInt64 head)
+{
+    if ( sizeof(void *) > 4 ) {
+        return (void *) (size_t) (head & 0x0000FFFFFFFFFFFFULL);
+    }
+    return (void *) (size_t) (head & 0xFFFFFFFFULL);
+}
+
+template <size_t LinkIndex>
+inline PltUInt64
+PltLockFreeStack<LinkIndex>::getTag(PltUInt64 head)
+{
+    return head >> (sizeof(void *) > 4 ? 48 : 32);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Pushes a chain of nodes already linked from first to last.
+
+template <size_t LinkIndex>
+inline void
+PltLockFreeStack<LinkIndex>::pushChain(void *first, void *last)
+{
+    PltUInt64 old;
+    do {
+        old = PltAtomic::load64(&_head);
+        PltAtomic::storePtr(&link(last), getPtr(old));
+    } while ( !PltAtomic::compareAndSwap64(&_head, old,
+                                           makeHead(first, getTag(old) + 1)) );
+}
+
+template <size_t LinkIndex>
+inline void *
+PltLockFreeStack<LinkIndex>::pop()
+{
+    for ( ;; ) {
+        PltUInt64 old = PltAtomic::load64(&_head);
+        void *top = getPtr(old);
+        if ( !top ) {
+            return 0;
+        }
+        //
+        // The link might be stale if someone else popped the node in the
+        // meantime, but then the tag has changed and the CAS fails.
+        //
+        void *next = PltAtomic::loadPtr(&link(top));
+        if ( PltAtomic::compareAndSwap64(&_head, old,
+                                         makeHead(next, getTag(old) + 1)) ) {
+            return top;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Takes all nodes at once and returns them as a chain.
+
+template <size_t LinkIndex>
+inline void *
+PltLockFreeStack<LinkIndex>::popAll()
+{
+    PltUInt64 old;
+    do {
+        old = PltAtomic::load64(&_head);
+        if ( !getPtr(old) ) {
+            return 0;
+        }
+    } while ( !PltAtomic::compareAndSwap64(&_head, old,
+                                           makeHead(0, getTag(old) + 1)) );
+    return getPtr(old);
+}
+
+#endif // PLT_THREAD_INCLUDED
+
+/* End of plt/thread.h */
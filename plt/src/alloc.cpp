@@ -22,91 +22,304 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "plt/alloc.h"
+#include "plt/thread.h"
 
+#include <stdlib.h>
+
+//////////////////////////////////////////////////////////////////////
+// Free objects are linked through their first pointer. The first object
+// of a magazine additionally links to the next magazine in the depot
+// through its second pointer -- objects are at least GRANULE bytes in
+// size, so there is always room for both links.
 //////////////////////////////////////////////////////////////////////
 
-PltAllocator_base::node * 
-PltAllocator_base::nodelist = 0;
+#define PLT_SLAB_NEXT(obj) (((void **) (obj))[0])
+
+// ----------------------------------------------------------------------------
+// Per-thread cache of one size class.
+//
+struct PltSlabCache
+{
+    void * objects;   // free objects
+    size_t count;     // number of objects in the free list
+    long   allocs;    // statistics not yet published
+    long   frees;
+};
+
+// ----------------------------------------------------------------------------
+// Global depot of one size class. Like the caches, the depots are plain
+// data which is zero-initialized before any static constructor runs.
+//
+struct PltSlabDepot
+{
+    PltLockFreeStack<1> magazines; // full magazines
+    PltLockFreeStack<0> orphans;   // loose objects left by exiting threads
+    volatile long nmagazines;
+    volatile long slabs;
+    volatile long allocs;
+    volatile long frees;
+};
+
+static PLT_THREAD_LOCAL PltSlabCache
+slab_caches[PltSlabAllocator::CLASS_COUNT];
+
+static PltSlabDepot
+slab_depots[PltSlabAllocator::CLASS_COUNT];
+
+
+// ----------------------------------------------------------------------------
+// Make sure that the objects cached by a thread get back into the depot
+// when the thread terminates. For the time being only POSIX threads offer
+// a convenient hook for this.
+//
+#if PLT_USE_THREADS && !PLT_SYSTEM_NT
+
+static pthread_key_t   slab_key;
+static pthread_once_t  slab_once = PTHREAD_ONCE_INIT;
+static PLT_THREAD_LOCAL bool slab_registered;
+
+static void
+slab_thread_exit(void *)
+{
+    PltSlabAllocator::flushThreadCache();
+} // slab_thread_exit
+
+static void
+slab_make_key()
+{
+    pthread_key_create(&slab_key, slab_thread_exit);
+} // slab_make_key
+
+static inline void
+slab_register_thread()
+{
+    if ( !slab_registered ) {
+        slab_registered = true;
+        pthread_once(&slab_once, slab_make_key);
+        pthread_setspecific(slab_key, &slab_registered);
+    }
+} // slab_register_thread
+
+#else
+
+static inline void
+slab_register_thread()
+{
+} // slab_register_thread
+
+#endif
+
+
+// ----------------------------------------------------------------------------
+// Publish the statistics collected by this thread so far.
+//
+static void
+slab_publish(PltSlabDepot &depot, PltSlabCache &cache)
+{
+    if ( cache.allocs ) {
+        PltAtomic::add(&depot.allocs, cache.allocs);
+        cache.allocs = 0;
+    }
+    if ( cache.frees ) {
+        PltAtomic::add(&depot.frees, cache.frees);
+        cache.frees = 0;
+    }
+} // slab_publish
+
+
+// ----------------------------------------------------------------------------
+// Hand the first MAGAZINE_SIZE objects of a thread cache over to the depot.
+//
+static void
+slab_spill(PltSlabDepot &depot, PltSlabCache &cache)
+{
+    void * first = cache.objects;
+    void * last = first;
+    for ( size_t i = 1; i < PltSlabAllocator::MAGAZINE_SIZE; ++i ) {
+        last = PLT_SLAB_NEXT(last);
+    }
+    cache.objects = PLT_SLAB_NEXT(last);
+    cache.count -= PltSlabAllocator::MAGAZINE_SIZE;
+    PLT_SLAB_NEXT(last) = 0;
 
-size_t
-PltAllocator_base::icount = 0;
+    depot.magazines.push(first);
+    PltAtomic::add(&depot.nmagazines, 1);
+    slab_publish(depot, cache);
+} // slab_spill
 
 
 // ----------------------------------------------------------------------------
+// Refill an empty thread cache: first try to get a full magazine from the
+// depot, then objects left behind by terminated threads, and as a last
+// resort carve a new slab. Returns false if we're out of memory.
 //
-PltAllocator_base::~PltAllocator_base() 
+static bool
+slab_refill(size_t cls, PltSlabDepot &depot, PltSlabCache &cache)
 {
-    while (objlist) {
-        node * p = objlist;
-        objlist = objlist->next;
-#if 0 || PLT_DEBUG_PEDANTIC
-	cerr << "Freeing 0x" << hex << (unsigned long) p->obj << endl;
-#endif	
-        ::operator delete(p->obj);
-        delete p;
-    }
-    if ((--icount)==0) {
-        // last instance
-        while (nodelist) {
-            node * p = nodelist;
-            nodelist = nodelist->next;
-            delete p;
+    slab_register_thread();
+    slab_publish(depot, cache);
+
+    void * p = depot.magazines.pop();
+    if ( p ) {
+        PltAtomic::add(&depot.nmagazines, -1);
+        cache.objects = p;
+        cache.count = PltSlabAllocator::MAGAZINE_SIZE;
+        return true;
+    }
+
+    p = depot.orphans.popAll();
+    if ( p ) {
+        cache.objects = p;
+        cache.count = 0;
+        for ( ; p; p = PLT_SLAB_NEXT(p) ) {
+            ++cache.count;
         }
+        return true;
     }
-} // PltAllocator_base::~PltAllocator_base
-    
+
+    char * slab = (char *) malloc(PltSlabAllocator::SLAB_SIZE);
+    if ( !slab ) {
+        return false;
+    }
+    PltAtomic::add(&depot.slabs, 1);
+
+    //
+    // Chain all objects of the new slab. The thread keeps one magazine
+    // plus the odd objects, the remaining full magazines go to the depot.
+    //
+    size_t objsize = (cls + 1) * PltSlabAllocator::GRANULE;
+    size_t n = PltSlabAllocator::SLAB_SIZE / objsize;
+    size_t keep = PltSlabAllocator::MAGAZINE_SIZE
+                  + n % PltSlabAllocator::MAGAZINE_SIZE;
+
+    for ( size_t i = 0; i < n - 1; ++i ) {
+        PLT_SLAB_NEXT(slab + i * objsize) = slab + (i + 1) * objsize;
+    }
+    PLT_SLAB_NEXT(slab + (n - 1) * objsize) = 0;
+
+    cache.objects = slab;
+    cache.count = n;
+    while ( cache.count > keep ) {
+        slab_spill(depot, cache);
+    }
+    return true;
+} // slab_refill
+
 
 // ----------------------------------------------------------------------------
 //
 void *
-PltAllocator_base::do_alloc(size_t size) 
+PltSlabAllocator::alloc(size_t size) 
 {
-    if (objlist) {
-        // remove node from objlist
-        node * p = objlist;
-        objlist = objlist->next;
-        
-        // remember object space pointer
-        void * retval = p->obj;
-        
-        // add node to nodelist
-        p->next  = nodelist;
-        nodelist = p;
-#if 0 || PLT_DEBUG_PEDANTIC
-	cerr << "Reusing 0x" << hex << (unsigned long) retval << endl;
-#endif	
-        return retval;
-    } else {
-	void * retval = ::operator new(size);
-#if PLT_DEBUG_PEDANTIC
-	cerr << "Allocating 0x" << hex << (unsigned long) retval << endl;
-#endif	
-        return retval;
-    }
-} // PltAllocator_base::do_alloc
+    if ( size == 0 ) {
+        size = 1;
+    }
+    if ( size > MAX_OBJ_SIZE ) {
+        return ::operator new(size);
+    }
+
+    size_t cls = sizeClass(size);
+    PltSlabCache &cache = slab_caches[cls];
+    if ( !cache.objects
+         && !slab_refill(cls, slab_depots[cls], cache) ) {
+        return 0;
+    }
+
+    void * retval = cache.objects;
+    cache.objects = PLT_SLAB_NEXT(retval);
+    --cache.count;
+    ++cache.allocs;
+    return retval;
+} // PltSlabAllocator::alloc
 
             
 // ----------------------------------------------------------------------------
 //
 void 
-PltAllocator_base::do_free(void *obj)
+PltSlabAllocator::free(void *obj, size_t size)
 {
-    if (obj == 0) return;
-
-#if 0 || PLT_DEBUG_PEDANTIC
-	cerr << "Returning 0x" << hex << (unsigned long) obj << endl;
-#endif	
-
-    node * q;
-    if (nodelist) {
-        q = nodelist;
-        nodelist = nodelist->next;
-    } else {
-        q = new node;
-    }
-    q->obj = obj;
-    q->next = objlist;
-    objlist = q;
-} // PltAllocator_base::do_free
+    if ( obj == 0 ) return;
+
+    if ( size > MAX_OBJ_SIZE ) {
+        ::operator delete(obj);
+        return;
+    }
+
+    size_t cls = sizeClass(size ? size : 1);
+    PltSlabCache &cache = slab_caches[cls];
+    PLT_SLAB_NEXT(obj) = cache.objects;
+    cache.objects = obj;
+    ++cache.frees;
+    if ( ++cache.count == 1 ) {
+        slab_register_thread();
+    } else if ( cache.count >= 2 * MAGAZINE_SIZE ) {
+        slab_spill(slab_depots[cls], cache);
+    }
+} // PltSlabAllocator::free
+
+
+// ----------------------------------------------------------------------------
+//
+void
+PltSlabAllocator::flushThreadCache()
+{
+    for ( size_t cls = 0; cls < CLASS_COUNT; ++cls ) {
+        PltSlabCache &cache = slab_caches[cls];
+        PltSlabDepot &depot = slab_depots[cls];
+
+        while ( cache.count >= MAGAZINE_SIZE ) {
+            slab_spill(depot, cache);
+        }
+        if ( cache.objects ) {
+            void * last = cache.objects;
+            while ( PLT_SLAB_NEXT(last) ) {
+                last = PLT_SLAB_NEXT(last);
+            }
+            depot.orphans.pushChain(cache.objects, last);
+            cache.objects = 0;
+            cache.count = 0;
+        }
+        slab_publish(depot, cache);
+    }
+} // PltSlabAllocator::flushThreadCache
+
+
+// ----------------------------------------------------------------------------
+//
+bool
+PltSlabAllocator::getUsage(size_t cls, PltSlabUsage &usage)
+{
+    if ( cls >= CLASS_COUNT ) {
+        return false;
+    }
+    PltSlabDepot &depot = slab_depots[cls];
+    usage.objsize   = (cls + 1) * GRANULE;
+    usage.slabs     = (size_t) depot.slabs;
+    usage.bytes     = usage.slabs * SLAB_SIZE;
+    usage.allocs    = (size_t) depot.allocs;
+    usage.frees     = (size_t) depot.frees;
+    usage.magazines = (size_t) depot.nmagazines;
+    return true;
+} // PltSlabAllocator::getUsage
+
+
+// ----------------------------------------------------------------------------
+//
+void
+PltSlabAllocator::getTotalUsage(PltSlabUsage &usage)
+{
+    usage.objsize = 0;
+    usage.slabs = usage.bytes = usage.allocs = usage.frees
+        = usage.magazines = 0;
+    for ( size_t cls = 0; cls < CLASS_COUNT; ++cls ) {
+        PltSlabUsage u;
+        getUsage(cls, u);
+        usage.slabs     += u.slabs;
+        usage.bytes     += u.bytes;
+        usage.allocs    += u.allocs;
+        usage.frees     += u.frees;
+        usage.magazines += u.magazines;
+    }
+} // PltSlabAllocator::getTotalUsage
 
 /* End of plt/alloc.cpp */
@@ -24,6 +24,7 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "plt/string.h"
+#include "plt/thread.h"
 #include <ctype.h>
 #include <stdio.h>
 
@@ -57,6 +58,27 @@ PltString::invariant() const
 }
 #endif
 
+//////////////////////////////////////////////////////////////////////
+// String representations may be shared between threads, so their
+// reference counts are changed atomically. The last one to let go of
+// a representation frees it.
+//////////////////////////////////////////////////////////////////////
+
+static inline void
+addRef(PltString::srep *p)
+{
+    PltAtomic::add(&p->refcount, 1);
+}
+
+static inline void
+release(PltString::srep *p)
+{
+    if ( PltAtomic::add(&p->refcount, -1) == 0 ) {
+        delete [] p->s;
+        delete p;
+    }
+}
+
 //////////////////////////////////////////////////////////////////////
 
 PltString::PltString()
@@ -103,7 +125,7 @@ PltString::PltString(const PltString &r)
 {
     p = r.p ;   
     if (r.p) {
-        r.p->refcount++;
+        addRef(r.p);
     }
     PLT_CHECK_INVARIANT();
 }
@@ -113,10 +135,7 @@ PltString::PltString(const PltString &r)
 PltString::~PltString()
 {
     if (p) {
-        if ( --(p->refcount) == 0 ) {
-            delete [] (p->s);
-            delete p;
-        }
+        release(p);
     }
 }
 
@@ -157,12 +176,8 @@ PltString::operator = (const PltString & r)
 {
     PLT_PRECONDITION( ok() && r.ok() );
     
-    (r.p->refcount) ++;
-
-    if ( --(p->refcount) == 0 ) {
-        delete [] p->s;
-        delete p;
-    }
+    addRef(r.p);
+    release(p);
     p = r.p;
     PLT_CHECK_INVARIANT();
     PLT_POSTCONDITION( ok() );
@@ -185,7 +200,7 @@ PltString::operator = (const char *sa)
         // Storage has been reserved.
         if (p->refcount > 1) {
             // clone to maintain value semantics
-            p->refcount --;
+            release(p);
             p = new srep;
         } else {
             delete [] p->s;
@@ -201,10 +216,7 @@ PltString::operator = (const char *sa)
     } else {
         // Failed to reserve storage for the characters.
         // Go into bad state.
-        if (--(p->refcount) == 0) {
-            delete [] p->s;
-            delete p;
-        }
+        release(p);
         p = 0;
     }
     PLT_CHECK_INVARIANT();
@@ -286,10 +298,7 @@ PltString::operator += (const PltString & str)
             np = 0;
         }
     }
-    if ( --(p->refcount) == 0 ) {
-        delete [] p->s;
-        delete p;
-    }
+    release(p);
     p = np;
     PLT_CHECK_INVARIANT();
     return *this;
@@ -395,7 +404,6 @@ PltString::cloneIfNeeded()
     PLT_PRECONDITION( ok() );
     if ((p->refcount) > 1) { 
         // clone to maintain value semantics
-        --(p->refcount);
         srep *np = new srep;
         if (np) {
             np->len = p->len;
@@ -407,6 +415,7 @@ PltString::cloneIfNeeded()
                 np = 0;
             }
         }
+        release(p);
         p = np;
     }
     PLT_CHECK_INVARIANT();
@@ -0,0 +1,114 @@
+/* -*-plt-c++-*- */
+/*
+ * Copyright (c) 1996, 1997, 1998, 1999
+ * Lehrstuhl fuer Prozessleittechnik, RWTH Aachen
+ * D-52064 Aachen, Germany.
+ * All rights reserved.
+ *
+ * This file is part of the ACPLT/KS Package which is licensed as open
+ * source under the Artistic License; you can use, redistribute and/or
+ * modify it under the terms of that license.
+ *
+ * You should have received a copy of the Artistic License along with
+ * this Package; see the file ARTISTIC-LICENSE. If not, write to the
+ * Copyright Holder.
+ *
+ * THIS PACKAGE IS PROVIDED "AS IS" AND WITHOUT ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED WARRANTIES
+ * OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+
+#include "plt/thread.h"
+
+//////////////////////////////////////////////////////////////////////
+
+PltThread::PltThread()
+: _running(false)
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+
+PltThread::~PltThread()
+{
+    PLT_ASSERT(!_running);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+#if PLT_USE_THREADS && PLT_SYSTEM_NT
+
+DWORD WINAPI
+PltThread::entry(LPVOID arg)
+{
+    ((PltThread *) arg)->run();
+    return 0;
+}
+
+bool
+PltThread::start()
+{
+    if ( _running ) {
+        return false;
+    }
+    _thread = CreateThread(0, 0, entry, this, 0, 0);
+    _running = _thread != 0;
+    return _running;
+}
+
+void
+PltThread::join()
+{
+    if ( _running ) {
+        WaitForSingleObject(_thread, INFINITE);
+        CloseHandle(_thread);
+        _running = false;
+    }
+}
+
+#elif PLT_USE_THREADS
+
+void *
+PltThread::entry(void *arg)
+{
+    ((PltThread *) arg)->run();
+    return 0;
+}
+
+bool
+PltThread::start()
+{
+    if ( _running ) {
+        return false;
+    }
+    _running = pthread_create(&_thread, 0, entry, this) == 0;
+    return _running;
+}
+
+void
+PltThread::join()
+{
+    if ( _running ) {
+        pthread_join(_thread, 0);
+        _running = false;
+    }
+}
+
+#else
+
+bool
+PltThread::start()
+{
+    return false;
+}
+
+void
+PltThread::join()
+{
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////
+/* EOF plt/thread.cpp */